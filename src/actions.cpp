@@ -15,9 +15,8 @@
 #include "classes.hpp"
 #include "actions.hpp"
 
-Action *Action::_action_list = NULL;
-Action *Action::_last = NULL;
-Action **Action::_action_tail= &_action_list;
+Slab Action::_slab("Action", sizeof(Action));
+Slab AttrSet::_slab("AttrSet", sizeof(AttrSet));
 
 /**
  * @brief Action creation
@@ -62,8 +61,9 @@ Action::Action(int tag, Single *single, MetaObj *CObj_ctx, ObjectType *old_obj,
    }
 
    _n_of_attrs = -1;
-   memset(_mod_attr, is_external, MAXATTRS);
-   memset(_mod_str_attr, 0, MAXATTRS);
+   _expiry = FALSE;
+   _all_attrs = is_external;
+   _mod_attrs = NULL;
 
    _next = NULL;
 }
@@ -77,6 +77,9 @@ Action::~Action()
    if (_tag == MODIFY_TAG)
        free_mod_str();
 
+   if (_mod_attrs != NULL)
+       delete _mod_attrs;
+
    if (_old_obj != NULL && _old_obj != _single->obj())
         free( _old_obj );
 
@@ -94,7 +97,7 @@ Action::fill_n_attrs()
 {
    ObjClass *the_class;
 
-   the_class = *ObjClass::get_class(_single->obj()->attr[0].str.str_p);
+   the_class = ObjClass::class_of(_single->obj());
 
    if (the_class != NULL)
      _n_of_attrs = the_class->n_attrs();
@@ -118,14 +121,14 @@ Action *Action::pop(Action *&initial)
    }
   
    if (act == NULL){
-     _action_tail = &initial;
+     Engine::current()->_action_tail = &initial;
      return NULL;
    }
  
    initial = initial->_next;
  
    if (initial == NULL)
-     _action_tail = &initial;
+     Engine::current()->_action_tail = &initial;
 
    return act;
 }
@@ -136,9 +139,11 @@ Action *Action::pop(Action *&initial)
  */
 void Action::push()
 {
-   *_action_tail = this;
-   _action_tail = &(_next);
-   _last = this;
+   Engine *engine = Engine::current();
+
+   *engine->_action_tail = this;
+   engine->_action_tail = &(_next);
+   engine->_last = this;
 }
 
 /**
@@ -150,11 +155,14 @@ void Action::free_mod_str()
 {
     int i;
  
+    if (_mod_attrs == NULL)     // Only the strings replaced by the rules
+        return;
+
     if (_n_of_attrs == -1 ) fill_n_attrs();
 
     for (i=0; i < _n_of_attrs; i++)
     {
-        if (_mod_str_attr[i])
+        if (_mod_attrs->has(i))
         {
             if (_old_obj->attr[i].str.dynamic_flags == DYNAMIC)
                 free(_old_obj->attr[i].str.str_p);
@@ -178,7 +186,7 @@ void Action::objswap()
 
    for (n = 0; n < _n_of_attrs; n++)    // Here n_attrs includes attr[0]
    {          
-       if (_mod_attr[n])
+       if (is_mod_attr(n))
        {
          tmp_attr = _old_obj->attr[n];
          _old_obj->attr[n] = obj->attr[n];
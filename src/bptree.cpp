@@ -0,0 +1,970 @@
+/**
+ * @file bptree.cpp
+ * @author Francisco Alcaraz
+ * @brief B+tree memories of the AND nodes. The multilevel BTree of a side of an AND node has a BTree per
+ *        value of each key and every comparison goes through the MetaObjs down to the attributes of the objects.
+ *        A BPTree keeps all the items in the leaves of a single tree, ordered by the keys and then as the last
+ *        level of the multilevel one, so the items are walked in the same order by both memories.
+ *        Every entry keeps a copy of the values of its keys (numbers and interned strings), so the searches
+ *        compare them without reaching the objects, and the leaves are linked to walk the items one after other.
+ *        The fanout, the entries of a node, is given at construction.
+ *        The values of each key are kept in a column of the node, so the numeric ones of the first key
+ *        are ranked all at once with SIMD compares before the binary search
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bptree.hpp"
+#include "keys.hpp"
+#include "error.hpp"
+
+#ifdef BP_SIMD
+#include <immintrin.h>
+#endif
+
+typedef void (*BPRankFunc)(const long *keys, int count, long value, int &less, int &less_eq);
+
+/**
+ * @brief Rank of a value in a column of numeric keys: how many are lower and how many are lower or equal
+ *
+ * @param keys The column
+ * @param count Number of keys
+ * @param value The value
+ * @param less Where to store the number of keys lower than the value
+ * @param less_eq Where to store the number of keys lower or equal
+ */
+PRIVATE void rank_scalar(const long *keys, int count, long value, int &less, int &less_eq)
+{
+    int lt = 0, gt = 0;
+
+    for (int n = 0; n < count; n++)
+    {
+        lt += (keys[n] < value);
+        gt += (keys[n] > value);
+    }
+    less = lt;
+    less_eq = count - gt;
+}
+
+#ifdef BP_SIMD
+
+/**
+ * @brief rank_scalar with SSE4.2, two keys by compare
+ *
+ */
+__attribute__((target("sse4.2")))
+PRIVATE void rank_sse42(const long *keys, int count, long value, int &less, int &less_eq)
+{
+    __m128i val = _mm_set1_epi64x(value);
+    __m128i key;
+    int lt = 0, gt = 0, n;
+
+    for (n = 0; n + 2 <= count; n += 2)
+    {
+        key = _mm_loadu_si128((const __m128i *)(keys + n));
+        lt += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(val, key))));
+        gt += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(key, val))));
+    }
+    for (; n < count; n++)
+    {
+        lt += (keys[n] < value);
+        gt += (keys[n] > value);
+    }
+    less = lt;
+    less_eq = count - gt;
+}
+
+/**
+ * @brief rank_scalar with AVX2, four keys by compare
+ *
+ */
+__attribute__((target("avx2")))
+PRIVATE void rank_avx2(const long *keys, int count, long value, int &less, int &less_eq)
+{
+    __m256i val = _mm256_set1_epi64x(value);
+    __m256i key;
+    int lt = 0, gt = 0, n;
+
+    for (n = 0; n + 4 <= count; n += 4)
+    {
+        key = _mm256_loadu_si256((const __m256i *)(keys + n));
+        lt += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(val, key))));
+        gt += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, val))));
+    }
+    for (; n < count; n++)
+    {
+        lt += (keys[n] < value);
+        gt += (keys[n] > value);
+    }
+    less = lt;
+    less_eq = count - gt;
+}
+
+#endif
+
+/**
+ * @brief Choose the rank function for the CPU the engine runs on
+ *
+ * @return BPRankFunc The function
+ */
+PRIVATE BPRankFunc select_rank()
+{
+#ifdef BP_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return rank_avx2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return rank_sse42;
+#endif
+    return rank_scalar;
+}
+
+PRIVATE BPRankFunc rank_keys = select_rank();
+
+/**
+ * @brief Enable or disable the SIMD rank of the numeric keys in the B+tree nodes.
+ *    Without it, or without a CPU that supports it, the keys are compared one by one
+ *
+ * @param status TRUE/FALSE
+ */
+PUBLIC
+void set_simd_rank(int status)
+{
+    rank_keys = status ? select_rank() : rank_scalar;
+}
+
+/**
+ * @brief Construct a new empty BPTree
+ *
+ * @param fanout Maximum number of items of a leaf, and of separators of an inner node
+ */
+BPTree::BPTree(int fanout)
+{
+    _root = NULL;
+    _fanout = (fanout < BP_MIN_FANOUT) ? BP_MIN_FANOUT : fanout;
+    _n_items = 0;
+    _n_keys = 0;
+}
+
+/**
+ * @brief Destroy the BPTree. The items must have been freed (see Free)
+ *
+ */
+BPTree::~BPTree()
+{
+    freeNode(_root);
+}
+
+/**
+ * @brief Allocate a node. The leaves have room for the items and their keys, the inner nodes also for the children
+ *
+ * @param leaf TRUE for a leaf
+ * @return BPNode* The node, empty
+ */
+BPNode *
+BPTree::newNode(int leaf)
+{
+    size_t size = sizeof(BPNode) + _fanout * (sizeof(void *) + _n_keys * sizeof(BPKey));
+    BPNode *node;
+
+    if (!leaf)
+        size += (_fanout + 1) * sizeof(BPNode *);
+
+    if ((node = (BPNode *)malloc(size)) == NULL)
+        engine_fatal_err("malloc: %s\n", strerror(errno));
+
+    node->_leaf = leaf;
+    node->_count = 0;
+    node->_next = NULL;
+    return node;
+}
+
+/**
+ * @brief Free a node and its subtree, not the items
+ *
+ * @param node The node
+ */
+void
+BPTree::freeNode(BPNode *node)
+{
+    if (node == NULL)
+        return;
+
+    if (!node->_leaf)
+        for (int n = 0; n <= node->_count; n++)
+            freeNode(children(node)[n]);
+    free(node);
+}
+
+/**
+ * @brief Take the values of the keys of an item to look for it, or for the items with its keys
+ *
+ * @param target Where to keep them
+ * @param item The item, its keys are taken from the target side of the KeyManager
+ * @param keys The KeyManager
+ */
+void
+BPTree::setTarget(BPTarget &target, const void *item, KeyManager *keys) const
+{
+    target.item = item;
+    target.keys = keys;
+    for (int nk = 0; nk < _n_keys; nk++)
+        keys->keyValue(item, nk, target.key[nk]);
+}
+
+/**
+ * @brief Copy an entry, the item (or separator) and its keys
+ *
+ * @param dst Node where to copy it
+ * @param d Position in dst
+ * @param src Node where it is
+ * @param s Position in src
+ */
+void
+BPTree::copyEntry(BPNode *dst, int d, const BPNode *src, int s) const
+{
+    items(dst)[d] = items(src)[s];
+    for (int nk = 0; nk < _n_keys; nk++)
+        column(dst, nk)[d] = column(src, nk)[s];
+}
+
+/**
+ * @brief Move several entries, the nodes may be the same one
+ *
+ * @param dst Node where to move them
+ * @param d First position in dst
+ * @param src Node where they are
+ * @param s First position in src
+ * @param n Number of entries
+ */
+void
+BPTree::moveEntries(BPNode *dst, int d, const BPNode *src, int s, int n) const
+{
+    if (n <= 0)
+        return;
+    memmove(items(dst) + d, items(src) + s, n * sizeof(void *));
+    for (int nk = 0; nk < _n_keys; nk++)
+        memmove(column(dst, nk) + d, column(src, nk) + s, n * sizeof(BPKey));
+}
+
+/**
+ * @brief Set the item of a target and its keys in an entry
+ *
+ * @param node The node
+ * @param n Position
+ * @param target The item and its keys
+ */
+void
+BPTree::setEntry(BPNode *node, int n, const BPTarget &target) const
+{
+    items(node)[n] = (void *)target.item;
+    for (int nk = 0; nk < _n_keys; nk++)
+        column(node, nk)[n] = target.key[nk];
+}
+
+/**
+ * @brief Rank of the first key of a target in a node whose first key is numeric. The entries are ordered
+ *      by that key first, so the ones that may be equal to the target are between less and less_eq
+ *
+ * @param target The target
+ * @param node The node
+ * @param less Where to store the number of entries with a lower first key
+ * @param less_eq Where to store the number of entries with a lower or equal first key
+ */
+void
+BPTree::rankKey(const BPTarget &target, const BPNode *node, int &less, int &less_eq) const
+{
+    (*rank_keys)(&column(node, 0)->num, node->_count, target.key[0].num, less, less_eq);
+}
+
+/**
+ * @brief Compare a key of a target with the one of an entry, as KeyManager::compareKey does with the objects.
+ *      The values kept are compared directly, the rest through the objects
+ *
+ * @param target The target
+ * @param node The node
+ * @param n Position of the entry
+ * @param nk Number of key
+ * @return int comparison result (<0 target lower, 0 equal, >0 target bigger)
+ */
+int
+BPTree::compareKey(const BPTarget &target, const BPNode *node, int n, int nk) const
+{
+    const BPKey &tgt = target.key[nk];
+    const BPKey &key = column(node, nk)[n];
+
+    switch (_type[nk])
+    {
+        case TYPE_NUM:
+            return (tgt.num < key.num) ? -1 : (tgt.num > key.num);
+        case TYPE_FLO:
+            return (tgt.flo < key.flo) ? -1 : (tgt.flo == key.flo) ? 0 : 1;
+        case TYPE_STR:
+            if (tgt.str != BP_STR_NOT_KEPT && key.str != BP_STR_NOT_KEPT)
+                return (tgt.str == key.str) ? 0 : strcmp(tgt.str, key.str);
+            break;
+    }
+    return target.keys->compareKey(target.item, items(node)[n], nk);
+}
+
+/**
+ * @brief Compare the first keys of a target with the ones of an entry
+ *
+ * @param target The target
+ * @param node The node
+ * @param n Position of the entry
+ * @param n_keys Number of keys to compare
+ * @return int comparison result of the first different key, 0 if all are equal
+ */
+int
+BPTree::compareKeys(const BPTarget &target, const BPNode *node, int n, int n_keys) const
+{
+    int result;
+
+    for (int nk = 0; nk < n_keys; nk++)
+        if ((result = compareKey(target, node, n, nk)) != 0)
+            return result;
+    return 0;
+}
+
+/**
+ * @brief Compare a target with an entry, by the keys and then by the compare function of the items
+ *
+ * @param target The target
+ * @param node The node
+ * @param n Position of the entry
+ * @param func Compare function of the items
+ * @param list Additional params of the function
+ * @return int comparison result
+ */
+int
+BPTree::compare(const BPTarget &target, const BPNode *node, int n, BTCompareFunc func, va_list list) const
+{
+    int result = compareKeys(target, node, n, _n_keys);
+
+    if (result == 0)
+        result = (*func)(target.item, items(node)[n], list);
+    return result;
+}
+
+/**
+ * @brief Tell if an entry is before the first item of a search by keys
+ *
+ * @param target The target
+ * @param node The node
+ * @param n Position of the entry
+ * @param n_eq Keys that must be equal
+ * @param lower Bound of the next key: BT_RANGE_NONE, BT_RANGE_OPEN or BT_RANGE_CLOSED
+ * @return int TRUE if it is before
+ */
+int
+BPTree::before(const BPTarget &target, const BPNode *node, int n, int n_eq, int lower) const
+{
+    int result = compareKeys(target, node, n, n_eq);
+
+    if (result != 0 || lower == BT_RANGE_NONE)
+        return result > 0;
+
+    result = compareKey(target, node, n, n_eq);
+    return (lower == BT_RANGE_CLOSED) ? result > 0 : result >= 0;
+}
+
+/**
+ * @brief Binary search of the first entry of a node that is not lower than a target
+ *
+ * @param target The target
+ * @param node The node
+ * @param func Compare function of the items
+ * @param list Additional params of the function
+ * @param found Set to TRUE if that entry is equal to the target
+ * @return int Position of the entry, _count if all are lower
+ */
+int
+BPTree::searchEntry(const BPTarget &target, const BPNode *node, BTCompareFunc func, va_list list, int &found) const
+{
+    int i = 0, j = node->_count, loc, result;
+
+    found = FALSE;
+    if (_n_keys > 0 && _type[0] == TYPE_NUM)
+        rankKey(target, node, i, j);
+    while (i < j)
+    {
+        loc = i + (j - i) / 2;
+        result = compare(target, node, loc, func, list);
+        if (result > 0)
+            i = loc + 1;
+        else
+        {
+            if (result == 0)
+                found = TRUE;
+            j = loc;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief First leaf of a subtree. Its first item is the separator of the subtree in its parent
+ *
+ * @param node Root of the subtree
+ * @return const BPNode* The leaf
+ */
+const BPNode *
+BPTree::first(const BPNode *node) const
+{
+    while (!node->_leaf)
+        node = children(node)[0];
+    return node;
+}
+
+/**
+ * @brief Insert an item in a subtree. A full node is split, the right half is returned
+ *      to be linked in the parent, with the first item of its first leaf as separator
+ *
+ * @param node Root of the subtree
+ * @param target The item and its keys
+ * @param func Compare function of the items
+ * @param list Additional params of the function
+ * @param pos Where the item is (or was found)
+ * @param found Set to TRUE if the item was already in the tree
+ * @return BPNode* The new right node, or NULL if the node was not split
+ */
+BPNode *
+BPTree::insert(BPNode *node, const BPTarget &target, BTCompareFunc func, va_list list, void **&pos, int &found)
+{
+    BPNode *right, *child;
+    int s, half;
+
+    s = searchEntry(target, node, func, list, found);
+
+    if (node->_leaf)
+    {
+        if (found)
+        {
+            pos = &items(node)[s];
+            return NULL;
+        }
+
+        if (node->_count < _fanout)
+        {
+            moveEntries(node, s + 1, node, s, node->_count - s);
+            setEntry(node, s, target);
+            node->_count++;
+            pos = &items(node)[s];
+            return NULL;
+        }
+
+        // Split: the left half keeps (_fanout + 1) / 2 items
+        right = newNode(TRUE);
+        half = (_fanout + 1) / 2;
+        if (s < half)
+        {
+            moveEntries(right, 0, node, half - 1, _fanout - half + 1);
+            right->_count = _fanout - half + 1;
+            node->_count = half - 1;
+            moveEntries(node, s + 1, node, s, node->_count - s);
+            setEntry(node, s, target);
+            node->_count++;
+            pos = &items(node)[s];
+        }
+        else
+        {
+            moveEntries(right, 0, node, half, s - half);
+            setEntry(right, s - half, target);
+            moveEntries(right, s - half + 1, node, s, _fanout - s);
+            right->_count = _fanout - half + 1;
+            node->_count = half;
+            pos = &items(right)[s - half];
+        }
+        right->_next = node->_next;
+        node->_next = right;
+        return right;
+    }
+
+    // Inner node: the separator equal to the target is the first item of the child at its right
+    if (found)
+        s++;
+    if ((child = insert(children(node)[s], target, func, list, pos, found)) == NULL)
+        return NULL;
+
+    if (node->_count < _fanout)
+    {
+        moveEntries(node, s + 1, node, s, node->_count - s);
+        memmove(children(node) + s + 2, children(node) + s + 1, (node->_count - s) * sizeof(BPNode *));
+        copyEntry(node, s, first(child), 0);
+        children(node)[s + 1] = child;
+        node->_count++;
+        return NULL;
+    }
+
+    // Split: with the new one there are _fanout + 1 separators, the left half keeps
+    // half of them and the next one is left out, it is the first item of the right half
+    right = newNode(FALSE);
+    half = _fanout / 2;
+    if (s < half)
+    {
+        moveEntries(right, 0, node, half, _fanout - half);
+        memcpy(children(right), children(node) + half, (_fanout - half + 1) * sizeof(BPNode *));
+        right->_count = _fanout - half;
+        node->_count = half - 1;
+        moveEntries(node, s + 1, node, s, node->_count - s);
+        memmove(children(node) + s + 2, children(node) + s + 1, (node->_count - s) * sizeof(BPNode *));
+        copyEntry(node, s, first(child), 0);
+        children(node)[s + 1] = child;
+        node->_count++;
+    }
+    else if (s == half)
+    {
+        moveEntries(right, 0, node, half, _fanout - half);
+        children(right)[0] = child;
+        memcpy(children(right) + 1, children(node) + half + 1, (_fanout - half) * sizeof(BPNode *));
+        right->_count = _fanout - half;
+        node->_count = half;
+    }
+    else
+    {
+        moveEntries(right, 0, node, half + 1, s - half - 1);
+        copyEntry(right, s - half - 1, first(child), 0);
+        moveEntries(right, s - half, node, s, _fanout - s);
+        memcpy(children(right), children(node) + half + 1, (s - half) * sizeof(BPNode *));
+        children(right)[s - half] = child;
+        memcpy(children(right) + s - half + 1, children(node) + s + 1, (_fanout - s) * sizeof(BPNode *));
+        right->_count = _fanout - half;
+        node->_count = half;
+    }
+    return right;
+}
+
+/**
+ * @brief Insert an item. BTree::WasFound() tells if it was already in the tree
+ *
+ * @param item The item
+ * @param keys The KeyManager of the side of the memory
+ * @param func Compare function of the items with the same keys
+ * @param ... Additional params to be passed to the function
+ * @return void** Where the item is in the tree (If may be replaced)
+ */
+void **
+BPTree::Insert(void *item, KeyManager *keys, BTCompareFunc func, ...)
+{
+    BPTarget target;
+    BPNode *right, *root;
+    void **pos = NULL;
+    int found;
+    va_list list;
+
+    // The keys are known with the first item
+    if (_root == NULL)
+    {
+        _n_keys = keys->numKeys();
+        if (_n_keys > BP_MAX_KEYS)
+            engine_fatal_err("Too many keys for a B+tree memory: %d\n", _n_keys);
+        for (int nk = 0; nk < _n_keys; nk++)
+            _type[nk] = keys->keyInSet(item, nk) ? BP_NOT_KEPT : keys->keyType(nk);
+        _root = newNode(TRUE);
+    }
+
+    setTarget(target, item, keys);
+
+    va_start(list, func);
+    if ((right = insert(_root, target, func, list, pos, found)) != NULL)
+    {
+        root = newNode(FALSE);
+        copyEntry(root, 0, first(right), 0);
+        children(root)[0] = _root;
+        children(root)[1] = right;
+        root->_count = 1;
+        _root = root;
+    }
+    va_end(list);
+
+    BTree::Found = found;
+    if (!found)
+        _n_items++;
+    return pos;
+}
+
+/**
+ * @brief Fill again a child of an inner node that has less items, or separators, than the half of the fanout.
+ *      It takes one from a sibling or, if they cannot give it, it is joined to one of them
+ *
+ * @param node The inner node
+ * @param n Position of the child
+ */
+void
+BPTree::rebalance(BPNode *node, int n)
+{
+    BPNode *child = children(node)[n];
+    BPNode *left = (n > 0) ? children(node)[n - 1] : NULL;
+    BPNode *right = (n < node->_count) ? children(node)[n + 1] : NULL;
+    int min = _fanout / 2;
+
+    if (child->_count >= min)
+        return;
+
+    if (left != NULL && left->_count > min)
+    {
+        moveEntries(child, 1, child, 0, child->_count);
+        if (child->_leaf)
+        {
+            copyEntry(child, 0, left, left->_count - 1);
+            copyEntry(node, n - 1, child, 0);
+        }
+        else
+        {
+            memmove(children(child) + 1, children(child), (child->_count + 1) * sizeof(BPNode *));
+            copyEntry(child, 0, node, n - 1);
+            children(child)[0] = children(left)[left->_count];
+            copyEntry(node, n - 1, left, left->_count - 1);
+        }
+        left->_count--;
+        child->_count++;
+    }
+    else if (right != NULL && right->_count > min)
+    {
+        if (child->_leaf)
+        {
+            copyEntry(child, child->_count, right, 0);
+            moveEntries(right, 0, right, 1, right->_count - 1);
+            copyEntry(node, n, right, 0);
+        }
+        else
+        {
+            copyEntry(child, child->_count, node, n);
+            children(child)[child->_count + 1] = children(right)[0];
+            copyEntry(node, n, right, 0);
+            moveEntries(right, 0, right, 1, right->_count - 1);
+            memmove(children(right), children(right) + 1, right->_count * sizeof(BPNode *));
+        }
+        right->_count--;
+        child->_count++;
+    }
+    else
+    {
+        // The child, or its right sibling, is joined to the one at its left
+        if (left == NULL)
+        {
+            left = child;
+            child = right;
+            n++;
+        }
+        if (child->_leaf)
+        {
+            moveEntries(left, left->_count, child, 0, child->_count);
+            left->_count += child->_count;
+            left->_next = child->_next;
+        }
+        else
+        {
+            copyEntry(left, left->_count, node, n - 1);
+            moveEntries(left, left->_count + 1, child, 0, child->_count);
+            memcpy(children(left) + left->_count + 1, children(child), (child->_count + 1) * sizeof(BPNode *));
+            left->_count += child->_count + 1;
+        }
+        free(child);
+
+        moveEntries(node, n - 1, node, n, node->_count - n);
+        memmove(children(node) + n, children(node) + n + 1, (node->_count - n) * sizeof(BPNode *));
+        node->_count--;
+    }
+}
+
+/**
+ * @brief Remove an item from a subtree
+ *
+ * @param node Root of the subtree
+ * @param target The item and its keys
+ * @param func Compare function of the items
+ * @param list Additional params of the function
+ * @return void* The item found, or NULL
+ */
+void *
+BPTree::remove(BPNode *node, const BPTarget &target, BTCompareFunc func, va_list list)
+{
+    void *item;
+    int s, found;
+
+    s = searchEntry(target, node, func, list, found);
+
+    if (node->_leaf)
+    {
+        if (!found)
+            return NULL;
+        item = items(node)[s];
+        moveEntries(node, s, node, s + 1, node->_count - s - 1);
+        node->_count--;
+        return item;
+    }
+
+    if (found)
+        s++;
+    if ((item = remove(children(node)[s], target, func, list)) == NULL)
+        return NULL;
+
+    // The separators are always items in the tree, the first of the subtree at their right
+    if (s > 0 && items(node)[s - 1] == item)
+        copyEntry(node, s - 1, first(children(node)[s]), 0);
+
+    rebalance(node, s);
+    return item;
+}
+
+/**
+ * @brief Remove an item from the BPTree
+ *
+ * @param item The item
+ * @param keys The KeyManager of the side of the memory
+ * @param func Compare function of the items with the same keys
+ * @param ... Additional params to be passed to the function
+ * @return void* The item found in the tree, or NULL
+ */
+void *
+BPTree::Delete(void *item, KeyManager *keys, BTCompareFunc func, ...)
+{
+    BPTarget target;
+    BPNode *root;
+    void *found;
+    va_list list;
+
+    if (_root == NULL)
+        return NULL;
+
+    setTarget(target, item, keys);
+
+    va_start(list, func);
+    found = remove(_root, target, func, list);
+    va_end(list);
+
+    if (found == NULL)
+        return NULL;
+    _n_items--;
+
+    if (_root->_count == 0)
+    {
+        root = _root;
+        _root = (root->_leaf) ? NULL : children(root)[0];
+        free(root);
+    }
+    return found;
+}
+
+/**
+ * @brief Look for an item
+ *
+ * @param item The item
+ * @param keys The KeyManager of the side of the memory
+ * @param func Compare function of the items with the same keys
+ * @param ... Additional params to be passed to the function
+ * @return const void* The item found, or NULL
+ */
+const void *
+BPTree::Find(const void *item, KeyManager *keys, BTCompareFunc func, ...) const
+{
+    BPTarget target;
+    const BPNode *node = _root;
+    const void *result = NULL;
+    int s, found = FALSE;
+    va_list list;
+
+    if (node == NULL)
+        return NULL;
+
+    setTarget(target, item, keys);
+
+    va_start(list, func);
+    for (;;)
+    {
+        s = searchEntry(target, node, func, list, found);
+        if (node->_leaf)
+            break;
+        node = children(node)[found ? s + 1 : s];
+    }
+    va_end(list);
+
+    if (found)
+        result = items(node)[s];
+    return result;
+}
+
+/**
+ * @brief Place the walk of a search by keys on its first item
+ *
+ * @param target The target
+ * @param n_eq Keys that must be equal to the ones of the target
+ * @param lower Bound of the next key: BT_RANGE_NONE, BT_RANGE_OPEN or BT_RANGE_CLOSED
+ * @param upper Bound of the next key: BT_RANGE_NONE, BT_RANGE_OPEN or BT_RANGE_CLOSED
+ * @return BPState The walk state
+ */
+BPState
+BPTree::search(const BPTarget &target, int n_eq, int lower, int upper) const
+{
+    BPState state;
+    const BPNode *node = _root;
+    int i, j, loc;
+
+    if (node == NULL)
+        return state;
+
+    for (;;)
+    {
+        i = 0;
+        j = node->_count;
+        if (_n_keys > 0 && _type[0] == TYPE_NUM && (n_eq > 0 || lower != BT_RANGE_NONE))
+        {
+            rankKey(target, node, i, j);
+            if (n_eq == 0)
+                i = j = (lower == BT_RANGE_CLOSED) ? i : j;
+        }
+        while (i < j)
+        {
+            loc = i + (j - i) / 2;
+            if (before(target, node, loc, n_eq, lower))
+                i = loc + 1;
+            else
+                j = loc;
+        }
+        if (node->_leaf)
+            break;
+        node = children(node)[i];
+    }
+
+    state.leaf = node;
+    state.pos = i;
+    state.n_eq = n_eq;
+    state.upper = upper;
+    state.tree = this;
+    state.target = target;
+    return state;
+}
+
+/**
+ * @brief Iterator of the items with the same keys than an item, as BTree::FindByKeys
+ *
+ * @param item The item, usually of the other side
+ * @param keys The KeyManager from the side of the item to the side of the memory
+ * @return BPState The iterator, to be walked with Walk
+ */
+BPState
+BPTree::FindByKeys(const void *item, KeyManager *keys) const
+{
+    BPTarget target;
+
+    if (_root == NULL)
+        return BPState();
+
+    setTarget(target, item, keys);
+    return search(target, _n_keys, BT_RANGE_NONE, BT_RANGE_NONE);
+}
+
+/**
+ * @brief Iterator of the items with the same keys than an item except the last one, whose value must be in a range
+ *      given by the value of the item, as BTree::FindRangeByKeys
+ *
+ * @param item The item that gives the keys and the bounds
+ * @param keys The KeyManager from the side of the item to the side of the memory
+ * @param lower Lower bound of the last key: BT_RANGE_NONE, BT_RANGE_OPEN (> item) or BT_RANGE_CLOSED (>= item)
+ * @param upper Upper bound of the last key: BT_RANGE_NONE, BT_RANGE_OPEN (< item) or BT_RANGE_CLOSED (<= item)
+ * @return BPState The iterator, to be walked with Walk
+ */
+BPState
+BPTree::FindRangeByKeys(const void *item, KeyManager *keys, int lower, int upper) const
+{
+    BPTarget target;
+
+    if (_root == NULL)
+        return BPState();
+
+    setTarget(target, item, keys);
+    return search(target, _n_keys - 1, lower, upper);
+}
+
+/**
+ * @brief Iterator of all the items
+ *
+ * @return BPState The iterator, to be walked with Walk
+ */
+BPState
+BPTree::getIterator() const
+{
+    BPState state;
+
+    if (_root != NULL)
+    {
+        state.leaf = first(_root);
+        state.n_eq = 0;
+        state.upper = BT_RANGE_NONE;
+        state.tree = this;
+    }
+    return state;
+}
+
+/**
+ * @brief Walk through the items of an iterator, from leaf to leaf. It will returns the next item at the next call
+ *
+ * @param state The iterator
+ * @return const void* Item found, NULL at the end
+ */
+// Static
+const void *
+BPTree::Walk(BPState &state)
+{
+    const BPTree *tree = state.tree;
+    int result;
+
+    while (state.leaf != NULL && state.pos >= state.leaf->_count)
+    {
+        state.leaf = state.leaf->_next;
+        state.pos = 0;
+    }
+    if (state.leaf == NULL)
+        return NULL;
+
+    if (state.n_eq > 0 && tree->compareKeys(state.target, state.leaf, state.pos, state.n_eq) != 0)
+    {
+        state.leaf = NULL;
+        return NULL;
+    }
+
+    if (state.upper != BT_RANGE_NONE)
+    {
+        result = tree->compareKey(state.target, state.leaf, state.pos, state.n_eq);
+        if (result < 0 || (result == 0 && state.upper == BT_RANGE_OPEN))
+        {
+            state.leaf = NULL;
+            return NULL;
+        }
+    }
+
+    return tree->items(state.leaf)[state.pos++];
+}
+
+/**
+ * @brief Free all the items, calling to a function with each one. The tree is left empty
+ *
+ * @param func The function
+ * @param ... List of arguments to be passed to the function after the item
+ */
+void
+BPTree::Free(BTSimpleFunc func, ...)
+{
+    va_list list;
+    BPNode *leaf;
+
+    if (_root == NULL)
+        return;
+
+    va_start(list, func);
+    for (leaf = (BPNode *)first(_root); leaf != NULL; leaf = leaf->_next)
+        for (int n = 0; n < leaf->_count; n++)
+            (*func)(items(leaf)[n], list);
+    va_end(list);
+
+    freeNode(_root);
+    _root = NULL;
+    _n_items = 0;
+}
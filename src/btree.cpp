@@ -11,8 +11,9 @@
 #include <stdlib.h>
 
 #include "btree.hpp"
+#include "btreet.hpp"
 
-int BTree::Found;
+BT_TLS int BTree::Found;
 
 /**
  * @brief Insert an item in the BTree
@@ -45,49 +46,7 @@ void **BTree::Insert(void *Item, BTCompareFunc Func, ...)
 
 void **BTree::InsertList(void *Item, BTCompareFunc Func, va_list List)
 {
-   #ifdef DEBUG
-      cout << "I";
-   #endif
-
-   bool MoveUp;
-   BTNode *NewRight;
-   void *NewItem;
-   void **BTItemPos;
-   BTNode **RootNodePos;
-   int numkeys = numKeys();
-
-   RootNodePos = &Root;
-   for (int nk=0; nk<numkeys; nk++)
-   {
-      Found = false;
-      BTItemPos = NULL;
-      MoveUp = (*RootNodePos)->PushDown(Item, NewItem, NewRight, BTItemPos, &Found, KeysMgr, nk);
-
-      if (MoveUp)   // create a new root node
-      {
-         *RootNodePos = new BTNode(NewItem, *RootNodePos, NewRight);
-         if (Item == NewItem)
-            BTItemPos = (void **)(*RootNodePos)->keyPointer(0);
-      }
-
-      if (!Found) *BTItemPos = NULL; // Create a null BTNode (empty tree)
-      RootNodePos = (BTNode **)BTItemPos;
-   }
-
-   Found = false;
-   BTItemPos = NULL;
-   MoveUp = (*RootNodePos)->PushDown(Item, NewItem, NewRight, BTItemPos, &Found, Func, List);
-
-   if (MoveUp)   // create a new root node
-   {
-      *RootNodePos = new BTNode(NewItem, *RootNodePos, NewRight);
-      if (Item == NewItem)
-         BTItemPos = (void **)(*RootNodePos)->keyPointer(0);
-   }
-
-   if (!Found) NumItems++;
-
-   return BTItemPos;
+   return InsertT<BTFuncCompare, BTKeyManager>(Item, BTFuncCompare(Func, List));
 }
 
 /**
@@ -120,22 +79,7 @@ void *BTree::Delete(void *Item, BTCompareFunc Func, ...)
  */
 void *BTree::DeleteList(void *Item, BTCompareFunc Func, va_list List)
 {
-   #ifdef DEBUG
-     cout << "R";
-   #endif
-
-   void *ItemFound = NULL;
-
-   if (Root== NULL) return NULL;
-   Root->Delete(Item, &ItemFound, Func, List, KeysMgr);
-
-   if (Root->Empty())
-   {
-      delete Root;
-      Root = NULL;
-   }
-   if (ItemFound!= NULL) NumItems--;
-   return ItemFound;
+   return DeleteT<BTFuncCompare, BTKeyManager>(Item, BTFuncCompare(Func, List));
 }
 
 /**
@@ -168,19 +112,7 @@ const void *BTree::Find(const void *Item, BTCompareFunc Func, ...) const
  */
 const void *BTree::FindList(const void *Item, BTCompareFunc Func, va_list List) const
 {
-   #ifdef DEBUG
-     cout << "R";
-   #endif
-
-   BTNode *RootNode;
-   int numkeys = numKeys();
-
-   RootNode = Root;
-   for (int nk=0; RootNode && nk<numkeys; nk++)
-      RootNode = (BTNode *)RootNode->Find(Item, KeysMgr, nk);
-
-   if (RootNode == NULL) return NULL;
-   return RootNode->Find(Item, Func, List);
+   return FindT<BTFuncCompare, BTKeyManager>(Item, BTFuncCompare(Func, List));
 }
 
 /**
@@ -213,20 +145,7 @@ void * const *BTree::FindDir(const void *Item, BTCompareFunc Func, ...) const
  */
 void * const *BTree::FindDirList(const void *Item, BTCompareFunc Func, va_list List) const
 {
-
-   #ifdef DEBUG
-     cout << "R";
-   #endif
-
-   BTNode *RootNode;
-   int numkeys = numKeys();
-
-   RootNode = Root;
-   for (int nk=0; RootNode && nk<numkeys; nk++)
-      RootNode = (BTNode *)RootNode->Find(Item, KeysMgr, nk);
-
-   if (RootNode == NULL) return NULL;
-   return RootNode->FindDir(Item, Func, List);
+   return FindDirT<BTFuncCompare, BTKeyManager>(Item, BTFuncCompare(Func, List));
 }
 
 /**
@@ -242,14 +161,48 @@ BTState BTree::FindByKeys(const void *Item) const
    #endif
 
    BTState result;
+   BTNode *RootNode = FindKeysRoot<BTKeyManager>(Item, numKeys());
+
+   if (RootNode) result.Push(RootNode);
+   return result;
+}
+
+/**
+ * @brief Find the items with the same keys than an Item except the last one, whose value must be in a range
+ *    given by the value of the Item. As FindByKeys they are walked with Walk
+ *
+ * @param Item The item that gives the keys and the bounds
+ * @param lower Lower bound of the last key: BT_RANGE_NONE, BT_RANGE_OPEN (> Item) or BT_RANGE_CLOSED (>= Item)
+ * @param upper Upper bound of the last key: BT_RANGE_NONE, BT_RANGE_OPEN (< Item) or BT_RANGE_CLOSED (<= Item)
+ * @return BTRangeState (the walk state)
+ */
+BTRangeState BTree::FindRangeByKeys(const void *Item, int lower, int upper) const
+{
+   BTRangeState result;
    BTNode *RootNode;
    int numkeys = numKeys();
 
-   RootNode = Root;
-   for (int nk=0; RootNode && nk<numkeys; nk++)
-      RootNode = (BTNode *)RootNode->Find(Item, KeysMgr, nk);
+   result.first = NULL;
+   result.target = Item;
+   result.mgr = KeysMgr;
+   result.numkey = numkeys - 1;
+   result.upper = upper;
 
-   if (RootNode) result.Push(RootNode);
+   RootNode = FindKeysRoot<BTKeyManager>(Item, numkeys - 1);
+
+   if (RootNode == NULL)
+      return result;
+
+   if (lower == BT_RANGE_NONE)
+      result.keys.Push(RootNode);
+   else
+   {
+      const void *Equal;
+
+      RootNode->SearchNodeBiggerThan(Item, KeysMgr, numkeys - 1, result.keys, Equal);
+      if (lower == BT_RANGE_CLOSED)
+         result.first = Equal;
+   }
    return result;
 }
 
@@ -265,6 +218,18 @@ const void *BTree::Walk(BTState &state)
    return BTNode::Walk(state);
 }
 
+/**
+ * @brief Walk through the items found by FindRangeByKeys. It will returns the next object at the next call in a iteractive way
+ * 
+ * @param state BTRangeState where the walk is going on
+ * @return const void* Item found, NULL at the end of the range
+ */
+// Static
+const void *BTree::Walk(BTRangeState &state)
+{
+   return BTNode::WalkRange(state);
+}
+
 /**
  * @brief Walk through a BTree calling to a func with every object
  * 
@@ -296,19 +261,12 @@ void BTree::WalkBy(BTSimpleConstFunc Func, ...) const
 BTState BTree::FindBiggerThan(const void *Item, BTCompareFunc Func, ...)
 {
    BTState result;
-   BTNode *RootNode;
-   int numkeys = numKeys();
-
    va_list List;
-   va_start (List, Func);
-
-   RootNode = Root;
-   for (int nk=0; RootNode && nk<numkeys; nk++)
-      RootNode = (BTNode *)RootNode->Find(Item, KeysMgr, nk);
 
-   if (RootNode) RootNode->SearchNodeBiggerThan(Item, Func, List, result);
-   
+   va_start (List, Func);
+   result = FindBiggerThanT<BTFuncCompare, BTKeyManager>(Item, BTFuncCompare(Func, List));
    va_end(List);
+
    return result;
 }
 
@@ -413,6 +371,18 @@ BTNode::BTNode(void * item, BTNode *left, BTNode*right)
    Key[0] = item;
    Branch[0] = left;
    Branch[1] = right;
+   Items = 1 + ItemsOf(left) + ItemsOf(right);
+}
+
+/**
+ * @brief Count again the items of the subtree of the node from the counts of its branches
+ * 
+ */
+void BTNode::Recount()
+{
+   Items = Count;
+   for (int i = 0; i <= Count; i++)
+      Items += ItemsOf(Branch[i]);
 }
 
 /**
@@ -478,81 +448,6 @@ void BTNode::DumpKeys(BTPrinterFunc Func, BTPrintFunc Func2, int nk) const
 
 
 
-/**
- * @brief Search for an item in a node. A binary search is performed comparing the target with the key in the middle 
- *    of the search interval over the keys, moving the interval margins according to the comparison result
- * 
- * @param Target the item serached for
- * @param Func Comapare function. Must return -1, 0, or 1
- * @param List Variable list of additional arguments passed to Func
- * @param Location the offset tested. It will store the final position when found
- * @return true when found, false elsewhere and the search must continue in the branch between last two (consecutive) keys
- */
-bool BTNode::SearchNode(const void * Target, BTCompareFunc Func, va_list List, int & Location) const
-{
-   bool Found;
-   int i,j;
-   int result;
-
-   Found = false;
-   i=-1; j=Count; result = 1; Location=-1;
-   while (result != 0 && (j-i)>1)
-   {
-       Location = i + (j-i)/2;
-       result = (* Func)(Target, Key[Location], List);
-       if (result>0)
-           i=Location;
-       else if (result<0)
-           j=Location--;
-   }
-
-   Found = (result == 0);
-
-   return Found;
-}
-
-/**
- * @brief Search for an item in a node using a keyManager. The peer to compare to is taken going down the lower level BTrees 
- *    until reaching the last one. Then the item at key[0] is chosen
- *    A binary search is performed comparing the target with the key in the middle 
- *    of the search interval over the keys, moving the interval margins according to the comparison result
- * 
- * @param Target the item serached for
- * @param KeysMgr contains the number of keys and the Comapare function
- * @param numkey current key number (form 0: top level to KeysMgr->numKeys(): lower level)
- * @param Location the offset tested. It will store the final position when found
- * @return true when found, false elsewhere and the search must continue in the branch between last two (consecutive) keys
- */
-bool BTNode::SearchNode(const void * Target, BTKeyManager *KeysMgr, int numkey, int & Location) const
-{
-   bool Found;
-   int i,j;
-   int result;
-
-   Found = false;
-   i=-1; j=Count; result = 1; Location=-1;
-   while (result != 0 && (j-i)>1)
-   {
-       void *Internal;
-
-       Location = i + (j-i)/2;
-
-       Internal = Key[Location];
-       for (int nk=numkey; nk < KeysMgr->numKeys(); nk++)
-           Internal = ((BTNode *)Internal)->Key[0];
-
-       result = KeysMgr->compareKey(Target, Internal, numkey);
-       if (result>0)
-           i=Location;
-       else if (result<0)
-           j=Location--;
-   }
-
-   Found = (result == 0);
-
-   return Found;
-}
-
 /**
  * @brief Make space in the current Keys and Branch arrays at Location offset and then set there a new key value and the branch to its right
  *    if Location is -1 it means the last key
@@ -687,401 +582,78 @@ void BTNode::Split(void *&CurrItem, BTNode *&CurrRight, int Location)
    CurrRight = NewRight;
    CurrItem = Key[Count - 1];
    Count--;
-}
-
-/**
- * @brief Add a new object to the tree rebalancing the nodes maintaining the number of keys between MaxKeys and MinKeys
- * 
- * @param CurrentItem The item to add
- * @param NewItem The item that is being moved 
- * @param NewRight The new node at the right branch of NewItem in the superior node
- * @param BTItemPos Pointer to where the currentItem is stored
- * @param Found where to store if the object (CurrentItem) was found or not
- * @param Func Compare function. Must return -1, 0, or 1
- * @param List va_list of additional parameters to be passed to the compare function
- * @return true when NewItem/NewRight must me moved to the superior node
- * @return false when that is not needed
- */
-bool  BTNode::PushDown(void *CurrentItem, void *&NewItem, BTNode *&NewRight, void **&BTItemPos, int *Found,
-                       BTCompareFunc Func, va_list List)
-{
-   int Location;
-   bool MoveUp, isTheObject;
-
-   #ifdef DEBUG
-      cout << "P ";
-   #endif
-
-   if (this == NULL)   // stopping case
-   {  // cannot insert into empty tree
-      MoveUp = true;
-      NewItem = CurrentItem;
-      NewRight = NULL;
-   }
-   else  // recursive case
-   {
-      if (SearchNode(CurrentItem, Func, List, Location))
-      {
-         // Communicate the element found and return with false
-         // to end the process
-         BTItemPos = &Key[Location];
-         *Found = true;
-         return false;
-      }
-
-      MoveUp = Branch[Location + 1]->PushDown(CurrentItem, NewItem, NewRight, BTItemPos, Found, Func, List);
-
-      isTheObject = (NewItem == CurrentItem);
-
-      if (MoveUp)
-      {
-         if (Count < MaxKeys)
-         {
-            MoveUp = false;
-            AddItemToRight(NewItem, NewRight, Location + 1);
-            if (isTheObject) BTItemPos = &Key[Location+1];
-         }
-         else
-         {
-            MoveUp = true;
-            Split(NewItem, NewRight, Location);
-
-            if (isTheObject)
-            {
-               if (Location < MinKeys) BTItemPos = &Key[Location+1];
-               else BTItemPos = &(NewRight->Key[Location-MinKeys]);
-            }
-
-         }
-      }
-   }
-   return MoveUp;
-}
-/**
- * @brief Add a new object to the tree rebalancing the nodes maintaining the number of keys between MaxKeys and MinKeys. Multikey version
- * 
- * @param CurrentItem The item to add
- * @param NewItem The item that is being moved 
- * @param NewRight The new node at the right branch of NewItem in the superior node
- * @param BTItemPos Pointer to where the currentItem is stored
- * @param Found where to store if the object (CurrentItem) was found or not
- * @param KeysMgr Keys Manager that includes a compare function and the number of keys
- * @param numkey current numkey
- * @return true when NewItem/NewRight must me moved to the superior node
- * @return false when that is not needed
- */
-
-bool  BTNode::PushDown(void *CurrentItem, void *&NewItem, BTNode *&NewRight, void **&BTItemPos, int *Found,
-                       BTKeyManager *KeysMgr, int numkey)
-{
-   int Location;
-   bool MoveUp, isTheObject;
-
-   #ifdef DEBUG
-      cout << "P ";
-   #endif
-
-   if (this == NULL)   // stopping case
-   {  // cannot insert into empty tree
-      MoveUp = true;
-      NewItem = CurrentItem;
-      NewRight = NULL;
-   }
-   else  // recursive case
-   {
-      if (SearchNode(CurrentItem, KeysMgr, numkey, Location))
-      {
-         // Communicate the element found and return with false
-         // to end the process
-         BTItemPos = &Key[Location];
-         *Found = true;
-         return false;
-      }
-
-      MoveUp = Branch[Location + 1]->PushDown(CurrentItem, NewItem, NewRight, BTItemPos, Found, KeysMgr, numkey);
-
-      isTheObject = (NewItem == CurrentItem);
-
-      if (MoveUp)
-      {
-         if (Count < MaxKeys)
-         {
-            MoveUp = false;
-            AddItemToRight(NewItem, NewRight, Location + 1);
-            if (isTheObject) BTItemPos = &Key[Location+1];
-         }
-         else
-         {
-            MoveUp = true;
-            Split(NewItem, NewRight, Location);
-
-            if (isTheObject)
-            {
-               if (Location < MinKeys) BTItemPos = &Key[Location+1];
-               else BTItemPos = &(NewRight->Key[Location-MinKeys]);
-            }
 
-         }
-      }
-   }
-   return MoveUp;
+   Recount();
+   NewRight->Recount();
 }
 
 /**
- * @brief The delete algorithm to maintain the tree balanced is as follows:
- *    - first a search is done to locate the item
- *    - starting by the branch to its right and going deeper in the tree by branches[0] the next object in order is found
- *    - this next element is removed from where it is and will replace the position where the item found is
- *    - With this procedure only leave nodes are being reduced their keys
- *    - if The leave node gets less keys than minKeys, this node can increase their keys taking the next key 
- *      of the parent node that will be replaced by the first item of the brach to its right
- *    - sometimes we will have to get from the left side, so we will put at position 0 the previous key of the parent  
- *      and that will be substituted by the last item of the previous branch  
- *    - This operations are known as right/left rotations
+ * @brief Fill again the branch at the right of a location that has less keys than MinKeys after a deletion
+ *    (see Delete). A key is taken from a sibling by a left or right rotation or, if they cannot give it,
+ *    the branch is joined to a sibling
  * 
- * @param Item The item to remove from the tree
- * @param ItemFound The pointer to object found that is considered equal to the item passed (but may be physically different object)
- * @param Func Function to compare items. Must return -1, 0 or 1
- * @param List variable arguments that will be passed to the compare function
- * @param KeysMgr Key manager of the tree. May be null if that tree is simple
- * @param numkey number of keys (multikeys -> tres of tress)
- * @param nextItemSearch If is being searched the next object in the tree
- * @return true Id the node has less keys than minKeys and require rotations or joins
- * @return false otherwise
+ * @param Location The location, its branch is Branch[Location+1]
  */
-bool  BTNode::Delete(void *Item, void **ItemFound,
-                     BTCompareFunc Func, va_list List,
-                     BTKeyManager *KeysMgr, int numkey, 
-                     bool nextItemSearch)
+void BTNode::Rebalance(int Location)
 {
-   int Location;
-   int Found;
-   int reorder;
-   int numkeys;
-
-   numkeys = ((!KeysMgr) ? 0 : KeysMgr->numKeys());
-
-   if (nextItemSearch)
+   // We try a left rotation
+   if (Location < (Count-1) && Branch[Location+2]->Count > MinKeys)
    {
-      Found = (Branch[0] == NULL);
-      Location = (Found ? 0 : -1);
+      // Left Rotation
+      int moved = 1 + ItemsOf(Branch[Location+2]->Branch[0]);
+
+      Branch[Location+1]->AddItemToRight(Key[Location+1], Branch[Location+2]->Branch[0], -1);
+      Key[Location+1] = Branch[Location+2]->Key[0];
+      Branch[Location+2]->DeleteItemToLeft(0);
+      Branch[Location+1]->Items += moved;
+      Branch[Location+2]->Items -= moved;
    }
-   else
+   // and, if we couldn't, a right rotation
+   else if (Location >=0 && Branch[Location]->Count > MinKeys)
    {
-      if (numkey<numkeys)
-         Found = SearchNode(Item, KeysMgr, numkey, Location);
-      else
-         Found = SearchNode(Item, Func, List, Location);
+      // Right rotation
+      int moved = 1 + ItemsOf(Branch[Location]->Branch[Branch[Location]->Count]);
+
+      Branch[Location+1]->AddItemToLeft(Key[Location], Branch[Location]->Branch[Branch[Location]->Count], 0);
+      Key[Location] = Branch[Location]->Key[Branch[Location]->Count - 1];
+      Branch[Location]->DeleteItemToRight(-1);
+      Branch[Location+1]->Items += moved;
+      Branch[Location]->Items -= moved;
    }
 
-   if (!nextItemSearch && Found && numkey < numkeys)
-   {
-      BTNode *root = (BTNode *)Key[Location];
-      root->Delete(Item, ItemFound, Func, List, KeysMgr, numkey+1, nextItemSearch);
-      if (root->Empty())
-         delete root;
-      else return false;
-   }
-
-   if (Found)
+   else
    {
-      if (Branch[Location+1])
-      {
-         void *Next;
-
-         if ((nextItemSearch || numkey == numkeys) && ItemFound) *ItemFound = Key[Location];
-         reorder = Branch[Location+1]->Delete(Item, &Next, Func, List, KeysMgr, numkey, true);
-         Key[Location] = Next;
-      }
-      else
+      // Else we join nodes at by-left and by-right branches. 
+      // The addition of keys always will be lower than Maxkeys due MaxKey = MinKeys*2 + 1
+      if (Count > 1)
       {
-         if ((nextItemSearch || numkey == numkeys) && ItemFound) *ItemFound = Key[Location];
+         BTNode *toDelete;
+         if (Location<0) Location=0;
+         Branch[Location]->Items += 1 + Branch[Location+1]->Items;
+         Branch[Location]->AddItemToRight(Key[Location], Branch[Location+1]->Branch[0], -1);
+         for (int i=0; i<Branch[Location+1]->Count; i++)
+            Branch[Location]->AddItemToRight(Branch[Location+1]->Key[i], Branch[Location+1]->Branch[i+1], -1);
+         toDelete = Branch[Location+1];
          DeleteItemToRight(Location);
-         return (Count < MinKeys);
-      }
-   }
-   else if (Branch[Location+1]) reorder =  Branch[Location+1]->Delete(Item, ItemFound, Func, List, KeysMgr, numkey, nextItemSearch);
-   else reorder = false;
-    
-   if (reorder)
-   {
-      
-      // We try a left rotation
-      if (Location < (Count-1) && Branch[Location+2]->Count > MinKeys)
-      {
-         // Left Rotation
-         Branch[Location+1]->AddItemToRight(Key[Location+1], Branch[Location+2]->Branch[0], -1);
-         Key[Location+1] = Branch[Location+2]->Key[0];
-         Branch[Location+2]->DeleteItemToLeft(0);
-      }
-      // and, if we couldn't, a right rotation
-      else if (Location >=0 && Branch[Location]->Count > MinKeys)
-      {
-         // Right rotation
-         Branch[Location+1]->AddItemToLeft(Key[Location], Branch[Location]->Branch[Branch[Location]->Count], 0);
-         Key[Location] = Branch[Location]->Key[Branch[Location]->Count - 1];
-         Branch[Location]->DeleteItemToRight(-1);
+         delete toDelete;
       }
-
       else
       {
-         // Else we join nodes at by-left and by-right branches. 
-         // The addition of keys always will be lower than Maxkeys due MaxKey = MinKeys*2 + 1
-         if (Count > 1)
-         {
-            BTNode *toDelete;
-            if (Location<0) Location=0;
-            Branch[Location]->AddItemToRight(Key[Location], Branch[Location+1]->Branch[0], -1);
-            for (int i=0; i<Branch[Location+1]->Count; i++)
-               Branch[Location]->AddItemToRight(Branch[Location+1]->Key[i], Branch[Location+1]->Branch[i+1], -1);
-            toDelete = Branch[Location+1];
-            DeleteItemToRight(Location);
-            delete toDelete;
-         }
-         else
-         {
-            int i;
-            BTNode *left, *right;
-            left = Branch[0];
-            right = Branch[1];
-            for (i=0; i<left->Count; i++)
-               AddItemToLeft(left->Key[i], left->Branch[i], i);
-            Branch[i] = left->Branch[i];
-            Branch[i+1] = right->Branch[0];
-            for (i=0; i<right->Count; i++)
-               AddItemToRight(right->Key[i], right->Branch[i+1], -1);
-            delete left;
-            delete right;
-         }
-
+         int i;
+         BTNode *left, *right;
+         left = Branch[0];
+         right = Branch[1];
+         for (i=0; i<left->Count; i++)
+            AddItemToLeft(left->Key[i], left->Branch[i], i);
+         Branch[i] = left->Branch[i];
+         Branch[i+1] = right->Branch[0];
+         for (i=0; i<right->Count; i++)
+            AddItemToRight(right->Key[i], right->Branch[i+1], -1);
+         delete left;
+         delete right;
       }
-   }
-   return (Count < MinKeys);
-}
 
-/**
- * @brief Find an item in a tree
- * 
- * @param Item to search for 
- * @param Func Compare function. Must return -1, 0, or 1
- * @param List variable list of additional arguments that will be added when calling Func
- * @return The item found or NULL if nor found
- */
-const void *BTNode::Find(const void *Item, BTCompareFunc Func, va_list List) const
-{
-   int Location;
-   bool Found;
-   const BTNode *CurrentNode;
-
-   Found = false;
-   CurrentNode = this;
-
-   while ((CurrentNode != NULL) && (! Found))
-   {
-      if (CurrentNode->SearchNode(Item, Func, List, Location))
-         Found = true;
-
-      else CurrentNode = CurrentNode->Branch[Location + 1];
    }
-
-   if (Found)
-      return CurrentNode->Key[Location];
-   else 
-      return NULL;
-}
-
-/**
- * @brief Find an item in a tree. Use KeysManager
- * 
- * @param Item to search for 
- * @param KeysMgr that contains the compare function and the number of keys (levels of trees of trees)
- * @param numkey current key number (level at what we are)
- * @return The item found or NULL if nor found
- */
-const void *BTNode::Find(const void *Item, BTKeyManager *KeysMgr, int numkey) const
-{
-   int Location;
-   bool Found;
-   const BTNode *CurrentNode;
-
-   Found = false;
-   CurrentNode = this;
-
-   while ((CurrentNode != NULL) && (! Found))
-   {
-      if (CurrentNode->SearchNode(Item, KeysMgr, numkey, Location))
-         Found = true;
-
-      else CurrentNode = CurrentNode->Branch[Location + 1];
-   }
-
-   if (Found)
-      return CurrentNode->Key[Location];
-   else 
-      return NULL;
-}
-
-/**
- * @brief Find an item in a tree. Return a pointer to where the item found is stored
- * 
- * @param Item to search for 
- * @param Func Compare function. Must return -1, 0, or 1
- * @param List variable list of additional arguments that will be added when calling Func
- * @return The pointer to where the item found is stored or NULL if nor found
- */
-void * const *BTNode::FindDir(const void *Item, BTCompareFunc Func, va_list List) const
-{
-   int Location;
-   bool Found;
-   const BTNode *CurrentNode;
-
-   Found = false;
-   CurrentNode = this;
-
-   while ((CurrentNode != NULL) && (! Found))
-   {
-      if (CurrentNode->SearchNode(Item, Func, List, Location))
-         Found = true;
-
-      else CurrentNode = CurrentNode->Branch[Location + 1];
-   }
-
-   if (Found)
-      return &CurrentNode->Key[Location];
-   else 
-      return NULL;
-}
-
-/**
- * @brief Find an item in a tree. Use KeysManager. Return a pointer to where the item found is stored
- * 
- * @param Item to search for 
- * @param KeysMgr that contains the compare function and the number of keys (levels of trees of trees)
- * @param numkey current key number (level at what we are)
- * @return The pointer to where the item found is stored or NULL if nor found
- */
-
-void * const *BTNode::FindDir(const void *Item, BTKeyManager *KeysMgr, int numkey) const
-{
-   int Location;
-   bool Found;
-   const BTNode *CurrentNode;
-
-   Found = false;
-   CurrentNode = this;
-
-   while ((CurrentNode != NULL) && (! Found))
-   {
-      if (CurrentNode->SearchNode(Item, KeysMgr, numkey, Location))
-         Found = true;
-
-      else CurrentNode = CurrentNode->Branch[Location + 1];
-   }
-
-   if (Found)
-      return &CurrentNode->Key[Location];
-   else 
-      return NULL;
 }
 
 /**
@@ -1116,43 +688,61 @@ const void *BTNode::Walk(BTState &state)
 }
 
 /**
- * @brief Setup a BTstate from where a given item is to walk from there
+ * @brief The first item in order of the subtree of this node, the leftmost one
  * 
- * @param Target item found 
- * @param Func Compare function. Must return -1, 0, or 1
- * @param List variable list of additional arguments that will be added when calling Func
- * @param state the state that is setup as the result of the search
+ * @return const void* the first item
  */
-void
-BTNode::SearchNodeBiggerThan(const void * Target, BTCompareFunc Func, va_list List, BTState &state) const
+const void *BTNode::First() const
 {
-    bool Found;
-    int i,j;
-    int result;
-    const BTNode *node = this;
+    const BTNode *CurrentNode = this;
 
-    Found = false;
-    while ((node != NULL) && !Found)
-    {
-        int loc;
-        state.Push(node);
-       
-        result = 1; i=0; j=node->Count-1;
+    while (CurrentNode->Branch[0])
+        CurrentNode = CurrentNode->Branch[0];
 
-        while (result!=0 && i<=j)
+    return CurrentNode->Key[0];
+}
+
+/**
+ * @brief The last item in order of the subtree of this node, the rightmost one
+ * 
+ * @return const void* the last item
+ */
+const void *BTNode::Last() const
+{
+    const BTNode *CurrentNode = this;
+
+    while (CurrentNode->Branch[CurrentNode->Count])
+        CurrentNode = CurrentNode->Branch[CurrentNode->Count];
+
+    return CurrentNode->Key[CurrentNode->Count - 1];
+}
+
+/**
+ * @brief The item in a position of the order of the subtree of this node. The counts of the items of the
+ *    branches tell which one to go down, so it takes a node per level
+ * 
+ * @param n The position, from 0 and lower than the items of the subtree
+ * @return const void* the item
+ */
+const void *BTNode::Nth(int n) const
+{
+    const BTNode *CurrentNode = this;
+    int i, left;
+
+    while (CurrentNode != NULL)
+    {
+        for (i = 0; i < CurrentNode->Count; i++)
         {
-            loc = i + (j-i)/2;
-            result = (* Func)(Target, node->Key[loc], List);
-            if (result>0)
-                i=loc + 1;
-            else if (result<0)
-                j=loc - 1;
+            left = ItemsOf(CurrentNode->Branch[i]);
+            if (n < left)
+                break;
+            if (n == left)
+                return CurrentNode->Key[i];
+            n -= left + 1;
         }
-
-        if (Found = (result == 0)) i = loc+1;
-        state.stack[state.level].loc = i;
-        node = node->Branch[i];
+        CurrentNode = CurrentNode->Branch[i];
     }
+    return NULL;
 }
 
 /**
@@ -1162,9 +752,10 @@ BTNode::SearchNodeBiggerThan(const void * Target, BTCompareFunc Func, va_list Li
  * @param KeysMgr that contains the compare function and the number of keys (levels of trees of trees)
  * @param numkey current key number (level at what we are)
  * @param state the state that is setup as the result of the search
+ * @param Equal where to store the item of this level with the same key than Target, or NULL
  */
 void
-BTNode::SearchNodeBiggerThan(const void * Target, BTKeyManager *KeysMgr, int numkey, BTState &state) const
+BTNode::SearchNodeBiggerThan(const void * Target, BTKeyManager *KeysMgr, int numkey, BTState &state, const void *&Equal) const
 {
     bool Found;
     int i,j;
@@ -1172,6 +763,7 @@ BTNode::SearchNodeBiggerThan(const void * Target, BTKeyManager *KeysMgr, int num
     const BTNode *node = this;
 
     Found = false;
+    Equal = NULL;
     while ((node != NULL) && !Found)
     {
         int loc;
@@ -1185,7 +777,7 @@ BTNode::SearchNodeBiggerThan(const void * Target, BTKeyManager *KeysMgr, int num
 
             loc = i + (j-i)/2;
 
-            Internal = Key[loc];
+            Internal = node->Key[loc];
             for (int nk=numkey; nk < KeysMgr->numKeys(); nk++)
                 Internal = ((BTNode *)Internal)->Key[0];
 
@@ -1197,9 +789,54 @@ BTNode::SearchNodeBiggerThan(const void * Target, BTKeyManager *KeysMgr, int num
                 j=loc - 1;
         }
 
-        if (Found = (result == 0)) i = loc+1;
+        if (Found = (result == 0))
+        {
+            Equal = node->Key[loc];
+            i = loc+1;
+        }
         state.stack[state.level].loc = i;
         node = node->Branch[i];
     }
 }
 
+/**
+ * @brief Walk through the items of a range of the last key. The trees of the values of the last key are walked
+ *        one after the other until the value is out of the upper bound
+ * 
+ * @param state where the walk state is stored
+ * @return const void* the next item found
+ */
+// static
+const void *BTNode::WalkRange(BTRangeState &state)
+{
+    const void *item, *internal;
+    int result;
+
+    while (state.items.level < 0 || (item = Walk(state.items)) == NULL)
+    {
+        if (state.first != NULL)
+        {
+            item = state.first;
+            state.first = NULL;
+        }
+        else if ((item = Walk(state.keys)) == NULL)
+            return NULL;
+
+        if (state.upper != BT_RANGE_NONE)
+        {
+            internal = item;
+            for (int nk=state.numkey; nk < state.mgr->numKeys(); nk++)
+                internal = ((BTNode *)internal)->Key[0];
+
+            result = state.mgr->compareKey(state.target, internal, state.numkey);
+            if (result < 0 || (result == 0 && state.upper == BT_RANGE_OPEN))
+            {
+                state.keys.level = -1;
+                return NULL;
+            }
+        }
+        state.items = BTState((const BTNode *)item);
+    }
+    return item;
+}
+
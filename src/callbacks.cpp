@@ -11,6 +11,8 @@
 
 #include "engine.h"
 #include "callbacks.hpp"
+#include "context.hpp"
+#include "cbring.hpp"
 // List of callbacks
 struct CallBackList
 {
@@ -71,24 +73,44 @@ void del_callback_func(int when_flags, CallBackFunc f)
 }
 
 /**
- * @brief The function called internally when an object is created
+ * @brief Call the callback functions defined for an event
  * 
+ * @param when WHEN_INSERTED, WHEN_MODIFIED, WHEN_RETRACTED or WHEN_NOT_USED
  * @param obj Object
  * @param ctx Context (Left Side of Rule matching)
  * @param n_objs Number of objects in the context
  */
 PUBLIC
-void object_created(ObjectType *obj, ObjectType **ctx, int n_objs)
+void call_callbacks(int when, ObjectType *obj, ObjectType **ctx, int n_objs)
 {
    CallBackList *p;
 
    for (p=list ; p!= NULL; p = p->next)
    {
-     if ((p->when_flags & WHEN_INSERTED) != 0)
-       (* p->f)(WHEN_INSERTED, obj, ctx, n_objs);
+     if ((p->when_flags & when) != 0)
+       (* p->f)(when, obj, ctx, n_objs);
    }
 }
 
+/**
+ * @brief The function called internally when an object is created
+ * 
+ * @param obj Object
+ * @param ctx Context (Left Side of Rule matching)
+ * @param n_objs Number of objects in the context
+ */
+PUBLIC
+void object_created(ObjectType *obj, ObjectType **ctx, int n_objs)
+{
+   CallBackRing *ring = Engine::current()->_cb_ring;
+
+   // In asynchronous mode the callbacks are called by engine_poll_events
+   if (ring->async())
+     ring->put(WHEN_INSERTED, obj, ctx, n_objs);
+   else
+     call_callbacks(WHEN_INSERTED, obj, ctx, n_objs);
+}
+
 /**
  * @brief The function called internally when an object is modified
  * 
@@ -99,13 +121,12 @@ void object_created(ObjectType *obj, ObjectType **ctx, int n_objs)
 PUBLIC
 void object_modified(ObjectType *obj, ObjectType **ctx, int n_objs)
 {
-   CallBackList *p;
+   CallBackRing *ring = Engine::current()->_cb_ring;
 
-   for (p=list ; p!= NULL; p = p->next)
-   {
-     if ((p->when_flags & WHEN_MODIFIED) != 0)
-       (* p->f)(WHEN_MODIFIED, obj, ctx, n_objs);
-   }
+   if (ring->async())
+     ring->put(WHEN_MODIFIED, obj, ctx, n_objs);
+   else
+     call_callbacks(WHEN_MODIFIED, obj, ctx, n_objs);
 }
 
 /**
@@ -116,13 +137,12 @@ void object_modified(ObjectType *obj, ObjectType **ctx, int n_objs)
 PUBLIC
 void object_deleted(ObjectType *obj)
 {
-   CallBackList *p;
- 
-   for (p=list ; p!= NULL; p = p->next)
-   {
-     if ((p->when_flags & WHEN_RETRACTED) != 0)
-       (* p->f)(WHEN_RETRACTED, obj, NULL, 0);
-   }
+   CallBackRing *ring = Engine::current()->_cb_ring;
+
+   if (ring->async())
+     ring->put(WHEN_RETRACTED, obj, NULL, 0);
+   else
+     call_callbacks(WHEN_RETRACTED, obj, NULL, 0);
 }
 
 /**
@@ -133,12 +153,11 @@ void object_deleted(ObjectType *obj)
 PUBLIC
 void object_no_more_used(ObjectType *obj)
 {
-   CallBackList *p;
- 
-   for (p=list ; p!= NULL; p = p->next)
-   {
-     if ((p->when_flags & WHEN_NOT_USED) != 0)
-       (* p->f)(WHEN_NOT_USED, obj, NULL, 0);
-   }
+   CallBackRing *ring = Engine::current()->_cb_ring;
+
+   if (ring->async())
+     ring->put(WHEN_NOT_USED, obj, NULL, 0);
+   else
+     call_callbacks(WHEN_NOT_USED, obj, NULL, 0);
 }
  
@@ -0,0 +1,384 @@
+/**
+ * @file cbring.cpp
+ * @author Francisco Alcaraz
+ * @brief Asynchronous delivery of the callbacks. When it is enabled in an engine (engine_async_callbacks)
+ *        object_created, object_modified, object_deleted and object_no_more_used queue the event with its context
+ *        in a preallocated ring and return, so a slow callback does not stop the inference.
+ *        Another thread calls the callbacks later with engine_poll_events. When the ring is full the engine
+ *        waits for the consumer (CALLBACKS_BLOCK), overwrites the oldest event (CALLBACKS_DROP_OLDEST) or
+ *        doubles the ring (CALLBACKS_GROW)
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "engine.h"
+#include "cbring.hpp"
+#include "callbacks.hpp"
+#include "context.hpp"
+#include "error.hpp"
+
+/**
+ * @brief Construct a new CallBackRing:: CallBackRing object. The events are not allocated until it is opened
+ *
+ */
+CallBackRing::CallBackRing()
+{
+  _events = NULL;
+  _size = 0;
+  _head = 0;
+  _tail = 0;
+  _policy = CALLBACKS_SYNC;
+  _closed = TRUE;
+  _pollers = 0;
+  _dropped = 0;
+
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_not_empty, NULL);
+  pthread_cond_init(&_not_full, NULL);
+  pthread_cond_init(&_no_pollers, NULL);
+}
+
+/**
+ * @brief Destroy the CallBackRing:: CallBackRing object. The events not delivered are lost
+ *
+ */
+CallBackRing::~CallBackRing()
+{
+  for (; _head != _tail; _head++)
+    if (_events[_head & (_size - 1)]._ctx != NULL)
+      free(_events[_head & (_size - 1)]._ctx);
+
+  free(_events);
+  pthread_cond_destroy(&_no_pollers);
+  pthread_cond_destroy(&_not_full);
+  pthread_cond_destroy(&_not_empty);
+  pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * @brief Double the size of the ring keeping the events in order. Called with the lock taken
+ *
+ */
+void CallBackRing::grow()
+{
+  CallBackEvent *events;
+  ULong n, n_events = _tail - _head;
+
+  if ((events = (CallBackEvent *)malloc(2 * _size * sizeof(CallBackEvent))) == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  for (n = 0; n < n_events; n++)
+    events[n] = _events[(_head + n) & (_size - 1)];
+
+  free(_events);
+  _events = events;
+  _size *= 2;
+  _head = 0;
+  _tail = n_events;
+}
+
+/**
+ * @brief Start the asynchronous mode, or change its policy if it was already started
+ *
+ * @param policy CALLBACKS_BLOCK, CALLBACKS_DROP_OLDEST or CALLBACKS_GROW
+ * @param size Minimum number of events of the ring. It is rounded up to a power of 2. Ignored if the ring was already allocated
+ */
+void CallBackRing::open(int policy, ULong size)
+{
+  ULong n_events;
+
+  pthread_mutex_lock(&_lock);
+  if (_events == NULL)
+  {
+    for (n_events = 2; n_events < size; n_events *= 2);
+
+    if ((_events = (CallBackEvent *)malloc(n_events * sizeof(CallBackEvent))) == NULL)
+      engine_fatal_err("malloc: %s\n", strerror(errno));
+    _size = n_events;
+  }
+  _policy = policy;
+  _closed = FALSE;
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief End the asynchronous mode. The threads waiting in engine_poll_events return and
+ *        this call waits until all of them are out. The events pending can be taken later with get
+ *
+ */
+void CallBackRing::close()
+{
+  pthread_mutex_lock(&_lock);
+  _closed = TRUE;
+  pthread_cond_broadcast(&_not_empty);
+  pthread_cond_broadcast(&_not_full);
+  while (_pollers > 0)
+    pthread_cond_wait(&_no_pollers, &_lock);
+  _policy = CALLBACKS_SYNC;
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief Queue an event. Called from the thread that runs the engine
+ *
+ * @param when WHEN_INSERTED, WHEN_MODIFIED, WHEN_RETRACTED or WHEN_NOT_USED
+ * @param obj The object
+ * @param ctx The context, it will be passed to the callbacks
+ * @param n_objs Number of objects in the context
+ */
+void CallBackRing::put(int when, ObjectType *obj, ObjectType **ctx, int n_objs)
+{
+  CallBackEvent *event;
+
+  pthread_mutex_lock(&_lock);
+  if (_tail - _head == _size)
+  {
+    switch (_policy)
+    {
+      case CALLBACKS_BLOCK:
+        while (_tail - _head == _size && !_closed)
+          pthread_cond_wait(&_not_full, &_lock);
+        if (_tail - _head < _size)
+          break;
+        // The ring has been closed by other thread. Drop the oldest one
+        // no break
+
+      case CALLBACKS_DROP_OLDEST:
+        event = &_events[_head & (_size - 1)];
+        if (event->_ctx != NULL)
+          free(event->_ctx);
+        _head++;
+        _dropped++;
+        break;
+
+      case CALLBACKS_GROW:
+        grow();
+        break;
+    }
+  }
+
+  event = &_events[_tail & (_size - 1)];
+  event->_when = when;
+  event->_obj = obj;
+  event->_ctx = ctx;
+  event->_n_objs = n_objs;
+  _tail++;
+
+  pthread_cond_signal(&_not_empty);
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief Register a consumer thread. Must be followed by a call to leave
+ *
+ * @return int FALSE if the asynchronous mode is not started
+ */
+int CallBackRing::enter()
+{
+  int ok;
+
+  pthread_mutex_lock(&_lock);
+  if ((ok = !_closed))
+    _pollers++;
+  pthread_mutex_unlock(&_lock);
+
+  return ok;
+}
+
+/**
+ * @brief Take the oldest event
+ *
+ * @param event The event taken. Its context must be passed to the callbacks or freed
+ * @param wait If TRUE and the ring is empty waits for an event or the end of the asynchronous mode
+ * @return int TRUE if an event has been taken
+ */
+int CallBackRing::get(CallBackEvent &event, int wait)
+{
+  int ok;
+
+  pthread_mutex_lock(&_lock);
+  while (wait && _head == _tail && !_closed)
+    pthread_cond_wait(&_not_empty, &_lock);
+
+  if ((ok = (_head != _tail)))
+  {
+    event = _events[_head & (_size - 1)];
+    _head++;
+    pthread_cond_signal(&_not_full);
+  }
+  pthread_mutex_unlock(&_lock);
+
+  return ok;
+}
+
+/**
+ * @brief Unregister a consumer thread
+ *
+ */
+void CallBackRing::leave()
+{
+  pthread_mutex_lock(&_lock);
+  if (--_pollers == 0)
+    pthread_cond_broadcast(&_no_pollers);
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief Number of events pending
+ *
+ * @return ULong The events queued and not yet taken
+ */
+ULong CallBackRing::pending()
+{
+  ULong n_events;
+
+  pthread_mutex_lock(&_lock);
+  n_events = _tail - _head;
+  pthread_mutex_unlock(&_lock);
+
+  return n_events;
+}
+
+/**
+ * @brief Number of events lost by CALLBACKS_DROP_OLDEST
+ *
+ * @return long The events dropped since the creation of the engine
+ */
+long CallBackRing::dropped()
+{
+  long n_events;
+
+  pthread_mutex_lock(&_lock);
+  n_events = _dropped;
+  pthread_mutex_unlock(&_lock);
+
+  return n_events;
+}
+
+//
+// API of the asynchronous callbacks
+//
+
+/**
+ * @brief Select how the callbacks are called in the engine selected in the calling thread.
+ *      It must be called from the thread that runs the engine
+ *
+ * @param policy CALLBACKS_SYNC (inside the inference, the default), CALLBACKS_BLOCK, CALLBACKS_DROP_OLDEST or CALLBACKS_GROW
+ * @param size Size of the ring, 0 for MAXCBEVENTS
+ * @return int TRUE, or ERROR if the policy is not valid
+ */
+PUBLIC
+int engine_async_callbacks(int policy, int size)
+{
+  return rce_engine_async_callbacks(Engine::current(), policy, size);
+}
+
+/**
+ * @brief Call the callbacks of the events queued in the engine selected in the calling thread.
+ *      It is called from other thread than the one that runs the engine
+ *
+ * @param max_events Maximum number of events to deliver, 0 for all the events queued at the call
+ * @param wait If TRUE and there is no event queued waits for one or for the end of the asynchronous mode
+ * @return int Number of events delivered
+ */
+PUBLIC
+int engine_poll_events(int max_events, int wait)
+{
+  return rce_engine_poll_events(Engine::current(), max_events, wait);
+}
+
+/**
+ * @brief Number of events lost due to CALLBACKS_DROP_OLDEST in the engine selected in the calling thread
+ *
+ * @return long The number of events dropped
+ */
+PUBLIC
+long engine_dropped_events()
+{
+  return rce_engine_dropped_events(Engine::current());
+}
+
+/**
+ * @brief engine_async_callbacks over an engine instance. When the asynchronous mode ends the events
+ *      pending are delivered in the calling thread
+ *
+ * @param engine The engine
+ * @param policy CALLBACKS_SYNC, CALLBACKS_BLOCK, CALLBACKS_DROP_OLDEST or CALLBACKS_GROW
+ * @param size Size of the ring, 0 for MAXCBEVENTS
+ * @return int TRUE, or ERROR if the policy is not valid
+ */
+PUBLIC
+int rce_engine_async_callbacks(rce_engine_t *engine, int policy, int size)
+{
+  CallBackEvent event;
+
+  switch (policy)
+  {
+    case CALLBACKS_SYNC:
+      if (engine->_cb_ring->async())
+      {
+        engine->_cb_ring->close();
+        while (engine->_cb_ring->get(event, FALSE))
+          call_callbacks(event._when, event._obj, event._ctx, event._n_objs);
+      }
+      break;
+
+    case CALLBACKS_BLOCK:
+    case CALLBACKS_DROP_OLDEST:
+    case CALLBACKS_GROW:
+      engine->_cb_ring->open(policy, (size > 0) ? size : MAXCBEVENTS);
+      break;
+
+    default:
+      return ERROR;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief engine_poll_events over an engine instance
+ *
+ * @param engine The engine
+ * @param max_events Maximum number of events to deliver, 0 for all the events queued at the call
+ * @param wait If TRUE and there is no event queued waits for one or for the end of the asynchronous mode
+ * @return int Number of events delivered
+ */
+PUBLIC
+int rce_engine_poll_events(rce_engine_t *engine, int max_events, int wait)
+{
+  CallBackRing *ring = engine->_cb_ring;
+  CallBackEvent event;
+  int n;
+
+  if (!ring->enter())
+    return 0;
+
+  // Not more than the events queued now, so the engine cannot keep the consumer here forever
+  if (max_events <= 0)
+    max_events = ring->pending();
+
+  for (n = 0; (n < max_events || (wait && n == 0)) && ring->get(event, wait && n == 0); n++)
+    call_callbacks(event._when, event._obj, event._ctx, event._n_objs);
+
+  ring->leave();
+
+  return n;
+}
+
+/**
+ * @brief engine_dropped_events over an engine instance
+ *
+ * @param engine The engine
+ * @return long The number of events dropped
+ */
+PUBLIC
+long rce_engine_dropped_events(rce_engine_t *engine)
+{
+  return engine->_cb_ring->dropped();
+}
@@ -29,6 +29,9 @@ PRIVATE int curr_attr;
 
 PRIVATE Node root(INTRA, 0, 0); // Root of the final, generated, tree
 
+ObjClass *ObjClass::_classes[MAXCLASSES];
+int ObjClass::_n_classes = 0;
+
 /**
  * @brief Construct a new Obj Class:: Obj Class object
  *
@@ -43,6 +46,7 @@ ObjClass::ObjClass(char *name, int abstract, ULong temp_flags)
   _num_of_attrs = 1;
   _num_of_attrs_inherited = 0;
   strncpy(_name, name, MAXNAME);
+  _interned_name = engine_intern(_name);
   _next_class = NULL;
   _subclass = NULL;
   _superclass = NULL;
@@ -51,8 +55,14 @@ ObjClass::ObjClass(char *name, int abstract, ULong temp_flags)
   _temp_flags = temp_flags;
   _last_node_of_class_def = NULL;
   _is_a_restriction = FALSE;
+  _partition_attr = -1;
   // class_apttern if filled when is known it is a superclass or a restriction
   _class_pattern = NULL;
+
+  _id = _n_classes++;
+  _classes[_id] = this;
+  memset(_ancestors, 0, sizeof(_ancestors));
+  _ancestors[_id / CLASS_WORD_BITS] = 1UL << (_id % CLASS_WORD_BITS);
 }
 
 /**
@@ -65,6 +75,7 @@ ObjClass::~ObjClass()
 
   class_p = ObjClass::get_class(_name);
   (*class_p) = (*class_p)->_next_class;
+  _classes[_id] = NULL;
 
   if (_class_pattern != NULL)
     delete _class_pattern;
@@ -101,6 +112,26 @@ ObjClass::get_class(char *classname)
   return class_p;
 }
 
+/**
+ * @brief Look for the class of an object by its class name and stamp its id in the object
+ *
+ * @param obj The object
+ * @return ObjClass* NULL if the class is unknown, then the object keeps CLASS_UNKNOWN
+ */
+ObjClass *ObjClass::stamp_class(ObjectType *obj)
+{
+  ObjClass *the_class;
+
+  if (obj->attr[0].str.str_p == NULL || (the_class = *get_class(obj->attr[0].str.str_p)) == NULL)
+  {
+    obj->class_id = CLASS_UNKNOWN;
+    return NULL;
+  }
+
+  obj->class_id = the_class->_id;
+  return the_class;
+}
+
 /**
  * @brief set the last node in the nodes tree that checks the bellonging of an object to this class
  *
@@ -136,6 +167,30 @@ void ObjClass::inherit_class(ObjClass *supercl_p)
 
   // Also each class is pointing to its superclass
   _superclass = supercl_p;
+  for (i = 0; i < MAXCLASSES / (int)CLASS_WORD_BITS; i++)
+    _ancestors[i] |= supercl_p->_ancestors[i];
+
+  // The objects of the subclasses go to the same shard than those of the superclass
+  _partition_attr = supercl_p->_partition_attr;
+}
+
+/**
+ * @brief Set the attribute used to route the objects of this class to a shard (PARTITION BY)
+ *
+ * @param name Name of the attribute
+ */
+void ObjClass::set_partition(char *name)
+{
+  int ind;
+
+  if ((ind = attr_index(name)) == -1)
+    comp_err("Attribute %s not defined for class %s\n", name, _name);
+
+  else if (_attr[ind].type == TYPE_PATTERN)
+    comp_err("Attribute %s of type OBJECT cannot be used to partition the class %s\n", name, _name);
+
+  else
+    _partition_attr = ind;
 }
 
 /**
@@ -197,6 +252,9 @@ def_class(char *name, int abstract, int event)
 
   if ((*class_p) == NULL)
   {
+    if (ObjClass::n_classes() == MAXCLASSES)
+      comp_err("Too many classes (MAX=%d)\n", MAXCLASSES);
+
     curr_class = (*class_p) = new ObjClass(name, abstract, event);
   }
   else
@@ -278,6 +336,18 @@ def_attr(char *name, int type)
   free(name);
 }
 
+/**
+ * @brief Declare the partition attribute of the current class (PARTITION BY)
+ * 
+ * @param name Name of the attribute
+ */
+PUBLIC void
+partition_class(char *name)
+{
+  curr_class->set_partition(name);
+  free(name);
+}
+
 /**
  * @brief Class compilations has ended, Last node is stored due rule code related to this class will hang from there
  * 
@@ -466,10 +536,10 @@ void ObjClass::add_class_check()
       // and also after its superclass (if any)
 
       _class_pattern = new Pattern(this, ST_NORMAL, &root, TRUE);
-      _class_pattern->add_class_check(_name);
+      _class_pattern->add_class_check(_id);
       for (ObjClass *super = _superclass; super != NULL; super = super->_superclass)
         root.insert_class_check(&(super->_last_node_of_class_def),
-                                _name, FALSE);
+                                _id, FALSE);
     }
     else
     {
@@ -530,30 +600,6 @@ int ObjClass::could_be_equal_obj(ObjClass *cl1, ObjClass *cl2)
   }
 }
 
-/**
- * @brief Check if this class is a subclass of another Superclass 
- * 
- * @param cl2 SuperClass
- * @return int 
- */
-int ObjClass::is_subclass(ObjClass *cl2)
-{
-
-  ObjClass *clx;
-
-  if (this == cl2)
-    return (TRUE);
-
-  for (clx = _superclass;
-       clx != NULL;
-       clx = clx->_superclass)
-  {
-    if (clx == cl2)
-      return (TRUE);
-  }
-  return (FALSE);
-}
-
 //
 // CLASS RELATED NODES DELETION
 //
@@ -606,6 +652,7 @@ void ObjClass::delete_all()
   {
     delete first_class;
   }
+  _n_classes = 0;
 }
 
 //
@@ -656,6 +703,23 @@ get_class(char *name, int *n_attrs)
   return (void *)(*the_class);
 }
 
+/**
+ * @brief Get the id of the class identified by a name, to create its objects with new_object_of_class
+ * 
+ * @param name Name of the class
+ * @return int The id of the class, CLASS_UNKNOWN if it is not defined
+ */
+int get_class_id(char *name)
+{
+  ObjClass **the_class;
+  char namelower[MAXNAME];
+
+  strlowerncpy(namelower, name, MAXNAME);
+  the_class = ObjClass::get_class(namelower);
+
+  return (*the_class != NULL) ? (*the_class)->id() : CLASS_UNKNOWN;
+}
+
 /**
  * @brief Gets the attribute name by its number
  * 
@@ -6,17 +6,42 @@
  *    Are used as tuples of two Singles meta-objects that made matching in the left hand part of some rule. 
  *    In case of needing to link a third meta object, a new compound on top will link the existing Compound tuple by the left
  *    and that third object by its right, so the order is maintained 
+ *    Each Compound may also keep a flat tuple with where the object of every position is, so they are reached
+ *    without going down the tree. A Compound joined by right to another one fills the free positions
+ *    of the tuple of its left, so the tuple of a chain of joins is shared by all of them
  * @version 1.0
  * 
  * @copyright Copyright (c) 2022
  * 
  */
 
+#include <string.h>
+
 #include "engine.h"
 #include "single.hpp"
 #include "compound.hpp"
 #include "load.hpp"
 
+Slab Compound::_slab("Compound", sizeof(Compound));
+
+#define TUPLE_SIZE(capacity) (sizeof(Tuple) + ((capacity) - TUPLE_MIN_ITEMS) * sizeof(MetaObj **))
+
+Slab Compound::_tuple_slabs[TUPLE_SLABS] = {{"Tuple4", TUPLE_SIZE(4)}, {"Tuple8", TUPLE_SIZE(8)},
+                                            {"Tuple16", TUPLE_SIZE(16)}, {"Tuple32", TUPLE_SIZE(32)}};
+
+int Compound::_flat_tuples = TRUE;
+
+/**
+ * @brief Enable or disable the flat tuples of the Compounds created from now on
+ *
+ * @param status TRUE/FALSE
+ */
+PUBLIC
+void set_flat_tuples(int status)
+{
+  Compound::_flat_tuples = status;
+}
+
 //
 // CLASS COMPOUND
 //
@@ -51,6 +76,8 @@ Compound::Compound(MetaObj *left, MetaObj *right, long t1, long t2)
     _n_right =_right->compound()->_n_left +
               _right->compound()->_n_right;
 
+  build_tuple();
+
   if (trace >= 2)
     fprintf(trace_file, "### new Comp %lx\n", (unsigned long int)this);
 
@@ -79,6 +106,8 @@ Compound::Compound(MetaObj *left)
  
   _n_right=0;
 
+  build_tuple();
+
   if (trace >= 2)
     fprintf(trace_file, "### new Comp %lx\n", (unsigned long int)this);
 }
@@ -103,10 +132,132 @@ Compound::Compound(Compound &other)
   _right  = other._right;
   _left   = other._left;
 
+  // The tuple of the other one is not shared, the copy is made to change its objects (see duplicate_struct)
+  _tuple  = NULL;
+  _tuple_ext = FALSE;
+
   if (trace >= 2)
     fprintf(trace_file, "### new Comp %lx\n", (unsigned long int)this);
 }
 
+/**
+ * @brief Copy to a flat tuple where the objects of the positions of a MetaObj are
+ * 
+ * @param items Where to copy them
+ * @param dir Where the MetaObj is stored
+ * @param n Number of positions it takes
+ */
+// static
+void
+Compound::fill_tuple(MetaObj ***items, MetaObj **dir, int n)
+{
+  MetaObj *obj = *dir;
+  int i;
+
+  if (n == 0)
+    return;
+
+  if (obj->class_type() != COMPOUND)
+  {
+    // A Set may take the positions of the compound it replaced (see set_call)
+    for (i = 0; i < n; i++)
+      items[i] = dir;
+  }
+  else if (obj->compound()->_tuple != NULL)
+    memcpy(items, obj->compound()->_tuple->_item, n * sizeof(MetaObj **));
+  else
+    for (i = 0; i < n; i++)
+      items[i] = obj->compound()->tree_dir(i);
+}
+
+/**
+ * @brief Take the flat tuple of the compound. The one of its left is shared if the positions of the right
+ *    are still free there (no other compound was joined to that left), else a new one is taken from the Slab
+ *    of its capacity, with room to be extended by the compounds joined to this one
+ * 
+ */
+void
+Compound::build_tuple()
+{
+  int size = _n_left + _n_right;
+  int used, slab;
+  Tuple *prefix;
+
+  _tuple = NULL;
+  _tuple_ext = FALSE;
+
+  if (!_flat_tuples || size > TUPLE_MAX_ITEMS)
+    return;
+
+  prefix = (_left->class_type() == COMPOUND) ? _left->compound()->_tuple : NULL;
+  used = _n_left;
+
+  if (prefix != NULL && size <= (TUPLE_MIN_ITEMS << prefix->_slab) &&
+      (size == _n_left || __atomic_compare_exchange_n(&prefix->_used, &used, size, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)))
+  {
+    if (MetaObj::_atomic_links)
+      __atomic_add_fetch(&prefix->_links, 1, __ATOMIC_RELAXED);
+    else
+      prefix->_links++;
+    _tuple = prefix;
+    _tuple_ext = (size > _n_left);
+  }
+  else
+  {
+    for (slab = 0; slab < TUPLE_SLABS - 1 && (TUPLE_MIN_ITEMS << slab) <= size; slab++);
+
+    _tuple = (Tuple *)_tuple_slabs[slab].alloc();
+    _tuple->_links = 1;
+    _tuple->_used = size;
+    _tuple->_slab = slab;
+    fill_tuple(_tuple->_item, &_left, _n_left);
+  }
+  fill_tuple(_tuple->_item + _n_left, &_right, _n_right);
+}
+
+/**
+ * @brief Leave the flat tuple. The positions taken in the tuple of the left are freed for other compounds
+ * 
+ */
+void
+Compound::release_tuple()
+{
+  int used = _n_left + _n_right;
+  int links;
+
+  if (_tuple == NULL)
+    return;
+
+  if (_tuple_ext)
+    __atomic_compare_exchange_n(&_tuple->_used, &used, _n_left, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+
+  if (MetaObj::_atomic_links)
+    links = __atomic_sub_fetch(&_tuple->_links, 1, __ATOMIC_ACQ_REL);
+  else
+    links = --_tuple->_links;
+
+  if (links == 0)
+    _tuple_slabs[_tuple->_slab].release(_tuple);
+
+  _tuple = NULL;
+  _tuple_ext = FALSE;
+}
+
+/**
+ * @brief Where the object of a position is stored, taken from the left or the right whatever the tuple of this compound
+ * 
+ * @param n Position
+ * @return MetaObj** Where the Single or Set at that position is
+ */
+MetaObj **
+Compound::tree_dir(const int n)
+{
+  MetaObj **dir = (n >= _n_left) ? &_right : &_left;
+  int pos = (n >= _n_left) ? n - _n_left : n;
+
+  return ((*dir)->class_type() == COMPOUND) ? (*dir)->compound()->tuple_dir(pos) : dir;
+}
+
 /**
  * @brief Creeate a new compound made by the union of this by left and another MetaObj by right
  * 
@@ -131,7 +282,7 @@ Compound::join_by_right_untimed(MetaObj *right_to_join)
  * @return int <0 , 0 or >0
  */
 int 
-Compound::compare(const MetaObj *c_obj2, va_list) const
+Compound::compare(const MetaObj *c_obj2) const
 {
   int res;
 
@@ -164,14 +315,13 @@ Compound::compare_objs(const MetaObj *c_obj2, int pos_offset, va_list list) cons
  * 
  * @param obj1 Object to be compere with left part of obj2
  * @param obj2
- * @param list Variable list of arguments to be passed to the compare function
  * @return int 
  */
 // static
 int 
-Compound::compare_with_left(const MetaObj *obj1, const MetaObj *obj2, va_list list)
+Compound::compare_with_left(const MetaObj *obj1, const MetaObj *obj2, va_list)
 {
-  return obj2->compound()->_left->compare(obj1, list);
+  return CompareWithLeft()(obj1, obj2);
 }
 
 /**
@@ -179,14 +329,13 @@ Compound::compare_with_left(const MetaObj *obj1, const MetaObj *obj2, va_list li
  * 
  * @param obj1 
  * @param obj2
- * @param list Variable list of arguments to be passed to the compare function
  * @return int 
  */
 // static
 int 
-Compound::compare_left_with_left(const MetaObj *obj1, const MetaObj *obj2, va_list list)
+Compound::compare_left_with_left(const MetaObj *obj1, const MetaObj *obj2, va_list)
 {
-  return obj2->compound()->_left->compare(obj1->compound()->_left, list);
+  return obj2->compound()->_left->compare(obj1->compound()->_left);
 }
 
 /**
@@ -198,6 +347,8 @@ Compound::compare_left_with_left(const MetaObj *obj1, const MetaObj *obj2, va_li
 MetaObj *
 Compound::operator[](const int n)
 {
+  if (_tuple != NULL)
+    return *_tuple->_item[n];
 
   if (n>=_n_left)
     return (*_right)[n - _n_left];
@@ -250,6 +401,7 @@ Compound::duplicate_struct(int link_singles)
   res = new Compound(*this);
   res->_left = _left->duplicate_struct(link_singles);
   res->_right= _right->duplicate_struct(link_singles);
+  res->build_tuple();
   return res;
 }
 
@@ -263,11 +415,16 @@ Compound::duplicate_struct(int link_singles)
 MetaObj *
 Compound::delete_struct(int unlink_singles, int only_minimize_rhs)
 {
+  MetaObj *left = _left, *right = _right;
+
   if (_left != NULL)
      _left = _left ->delete_struct(unlink_singles, only_minimize_rhs);
 
   if (_right!= NULL)
      _right = _right->delete_struct(unlink_singles, only_minimize_rhs);
+
+  if (_left != left || _right != right)
+     release_tuple();
   
   if (! only_minimize_rhs || (_left == NULL && _right == NULL)) {
     int n = links();
@@ -290,6 +447,10 @@ Compound::meta_dir(MetaObj **dir, const int n, const int n_objs)
 {
   if (n_objs < _n_left + _n_right)
   {
+    // The address of several positions may be written (see set_call), the tuple would point to the old ones
+    if (n_objs > 1)
+      release_tuple();
+
     if (n >= _n_left)      
       return _right->meta_dir(&_right, n - _n_left, n_objs);
     else
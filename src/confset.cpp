@@ -13,9 +13,10 @@
 #include "compound.hpp"
 #include "confset.hpp"
 #include "nodes.hpp"
+#include "context.hpp"
+#include "btreet.hpp"
 
-// Three levels of priority
-PRIVATE ConflictSet *conflict_set[3] = {NULL};
+Slab ConflictSet::_slab("ConflictSet", sizeof(ConflictSet));
 
 /**
  * @brief Construct a new Conflict Set:: Conflict Set object
@@ -44,13 +45,13 @@ ConflictSet::ConflictSet(int tag, Node *prod_node, Compound *prod_compound)
  */
 void ConflictSet::insert(int cat)
 {
-  _next = conflict_set[cat];
+  _next = Engine::current()->_conflict_set[cat];
   _prev = NULL;
 
   if (_next != NULL)
     _next->_prev = this;
 
-  conflict_set[cat] = this;
+  Engine::current()->_conflict_set[cat] = this;
   _inserted = TRUE;
 }
 
@@ -66,7 +67,7 @@ void ConflictSet::remove(int cat)
     if (_prev != NULL)
       _prev->_next = _next;
     else
-      conflict_set[cat] = _next;
+      Engine::current()->_conflict_set[cat] = _next;
  
     if (_next != NULL)
       _next->_prev = _prev;
@@ -74,22 +75,51 @@ void ConflictSet::remove(int cat)
   delete this;
 }
 
+/**
+ * @brief Move to the Conflict Set of the current engine a queue of a category built in other engine
+ *        (a view used by the parallel propagation). The items are inserted in the same order they were queued there,
+ *        and those already present in the Conflict Set are freed as prod_call does
+ * 
+ * @param list The queue (the last item queued first)
+ * @param cat Category == Priority of the rule
+ * @param list_mem The memory of the Conflict Set where the items of the queue are
+ */
+void ConflictSet::move_list(ConflictSet *list, int cat, BTree &list_mem)
+{
+  ConflictSet *cs, *prev;
+  BTree &tree_cat = Engine::current()->_conflict_set_mem[cat];
+
+  if (list == NULL)
+    return;
+
+  for (cs = list; cs->_next != NULL; cs = cs->_next);
+
+  for (; cs != NULL; cs = prev)
+  {
+    prev = cs->_prev;
+    (void)BTreeT<ConflictSet, CompareCSet>(&list_mem).Delete(cs);
+
+    if (*BTreeT<ConflictSet, CompareCSet>(&tree_cat).Insert(cs) != cs)
+    {
+      cs->_prod_compound->left()->unlink();
+      cs->_prod_compound->unlink();
+      delete cs;
+    }
+    else cs->insert(cat);
+  }
+}
+
 /**
  * @brief Simple compare function based in rod_nodes memory address and secondary in comparing left sides
  * 
  * @param cset1 
  * @param cset2 
- * @param list Variable list of additional arguments to be passed to the compare method
  * @return int 
  */
 int ConflictSet::compare_cset(const ConflictSet *cset1, 
-                              const ConflictSet *cset2, va_list list)
+                              const ConflictSet *cset2, va_list)
 {
-  int res;
-
-  if ((res = (char *)cset1->_prod_node - (char *)cset2->_prod_node) == 0)
-    res = cset2->_prod_compound->left()->compare(cset1->_prod_compound->left(), list);
-  return res;
+  return CompareCSet()(cset1, cset2);
 }
 
 /**
@@ -104,7 +134,7 @@ ConflictSet *ConflictSet::best_cset(int *categoria)
   int cat;
   ConflictSet *cs;
 
-  for(cat=0; cat < 3 && (cs=conflict_set[cat]) == NULL; cat++);
+  for(cat=0; cat < 3 && (cs=Engine::current()->_conflict_set[cat]) == NULL; cat++);
   (*categoria) = cat;
   return cs;
 }
@@ -0,0 +1,511 @@
+/**
+ * @file context.cpp
+ * @author Francisco Alcaraz
+ * @brief Engine instances. The execution state (pending actions, conflict set and node memories)
+ *        lives in an Engine object, so several independent engines may share the same compiled package,
+ *        each of them running in its own thread. The classic API works over the engine selected in the
+ *        calling thread, that is the default engine unless other one is selected
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "context.hpp"
+#include "actions.hpp"
+#include "confset.hpp"
+#include "set.hpp"
+#include "nodes.hpp"
+#include "btreet.hpp"
+#include "error.hpp"
+
+ENGINE_TLS Engine *Engine::_current = &Engine::_default;
+ENGINE_TLS ObjectType *Engine::_old_obj_modify = NULL;
+Engine *Engine::_engines = NULL;
+ULong Engine::_n_mem_slots = 0;
+ULong Engine::_n_mark_slots = 0;
+Engine Engine::_default;
+
+PRIVATE pthread_mutex_t engines_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Free an entry of the schedule of the TIMER nodes
+ *
+ * @param item The entry
+ */
+PRIVATE
+void del_timer_due(void *item, va_list)
+{
+  delete (TimerDue *)item;
+}
+
+/**
+ * @brief Construct a new Engine:: Engine object, with empty memories
+ *
+ */
+Engine::Engine()
+{
+  _action_list = NULL;
+  _last = NULL;
+  _action_tail = &_action_list;
+  _conflict_set[0] = _conflict_set[1] = _conflict_set[2] = NULL;
+  _in_the_loop = FALSE;
+  _n_inf = 0;
+  _ring = new EventRing(MAXSUBMIT);
+  _cb_ring = new CallBackRing();
+  _snaps = new SnapshotQueue();
+  _mem = NULL;
+  _hash_mem = NULL;
+  _bp_mem = NULL;
+  _timer_due = NULL;
+  _n_mem = 0;
+  _marks = NULL;
+  _n_marks = 0;
+  _set_log = new SetLog();
+  _expiring = FALSE;
+  _set_expiry = NULL;
+  _is_view = FALSE;
+
+  pthread_mutex_lock(&engines_lock);
+  _next_engine = _engines;
+  _engines = this;
+  pthread_mutex_unlock(&engines_lock);
+}
+
+/**
+ * @brief Construct a view of an engine for a worker of the parallel propagation (see parallel.cpp).
+ *        It works over the memories of the engine but keeps apart the actions and the Conflict Set
+ *        produced, to be merged later in the engine. It is not in the list of engines
+ *
+ * @param engine The engine, it can be changed with view_of
+ */
+Engine::Engine(Engine *engine)
+{
+  _action_list = NULL;
+  _last = NULL;
+  _action_tail = &_action_list;
+  _conflict_set[0] = _conflict_set[1] = _conflict_set[2] = NULL;
+  _in_the_loop = FALSE;
+  _n_inf = 0;
+  _ring = NULL;
+  _cb_ring = NULL;
+  _snaps = NULL;
+  _expiring = FALSE;
+  _set_expiry = NULL;
+  _next_engine = NULL;
+  _is_view = TRUE;
+  view_of(engine);
+}
+
+/**
+ * @brief Destroy the Engine:: Engine object. The memories must be empty (see reset)
+ *
+ */
+Engine::~Engine()
+{
+  Engine **p;
+  ULong n;
+
+  // A view does not own the memories
+  if (_is_view)
+    return;
+
+  pthread_mutex_lock(&engines_lock);
+  for (p = &_engines; *p != NULL && *p != this; p = &((*p)->_next_engine));
+  if (*p != NULL)
+    *p = _next_engine;
+  pthread_mutex_unlock(&engines_lock);
+
+  for (n = 0; n < _n_mem; n++)
+  {
+    if (_mem[n] != NULL)
+      delete _mem[n];
+    if (_hash_mem[n] != NULL)
+      delete _hash_mem[n];
+    if (_bp_mem[n] != NULL)
+      delete _bp_mem[n];
+  }
+  free(_mem);
+  free(_hash_mem);
+  free(_bp_mem);
+  _timers.Free(del_timer_due);
+  free(_timer_due);
+  free(_marks);
+  delete _set_log;
+  delete _ring;
+  delete _cb_ring;
+  delete _snaps;
+}
+
+/**
+ * @brief Grow the tables of memories of this engine to have a slot
+ *
+ * @param slot Slot of the memory
+ */
+void Engine::grow_mem_tables(ULong slot)
+{
+  ULong new_n = (_n_mem < 64) ? 64 : _n_mem * 2;
+
+  while (new_n <= slot)
+    new_n *= 2;
+
+  _mem = (BTree **)realloc(_mem, new_n * sizeof(BTree *));
+  _hash_mem = (HashMem **)realloc(_hash_mem, new_n * sizeof(HashMem *));
+  _bp_mem = (BPTree **)realloc(_bp_mem, new_n * sizeof(BPTree *));
+  _timer_due = (TimerDue **)realloc(_timer_due, new_n * sizeof(TimerDue *));
+  if (_mem == NULL || _hash_mem == NULL || _bp_mem == NULL || _timer_due == NULL)
+    engine_fatal_err("realloc: %s\n", strerror(errno));
+  memset(_mem + _n_mem, 0, (new_n - _n_mem) * sizeof(BTree *));
+  memset(_hash_mem + _n_mem, 0, (new_n - _n_mem) * sizeof(HashMem *));
+  memset(_bp_mem + _n_mem, 0, (new_n - _n_mem) * sizeof(BPTree *));
+  memset(_timer_due + _n_mem, 0, (new_n - _n_mem) * sizeof(TimerDue *));
+  _n_mem = new_n;
+}
+
+/**
+ * @brief Memory of a slot not yet used in this engine. The tables of memories are grown if needed
+ *
+ * @param slot Slot of the memory
+ * @return BTree* The memory
+ */
+BTree *Engine::grow_mem(ULong slot)
+{
+  if (slot >= _n_mem)
+    grow_mem_tables(slot);
+
+  if (_mem[slot] == NULL)
+    _mem[slot] = new BTree();
+
+  return _mem[slot];
+}
+
+/**
+ * @brief Hash memory of a slot not yet used in this engine. The tables of memories are grown if needed
+ *
+ * @param slot Slot of the memory
+ * @return HashMem* The memory
+ */
+HashMem *Engine::grow_hash_mem(ULong slot)
+{
+  if (slot >= _n_mem)
+    grow_mem_tables(slot);
+
+  if (_hash_mem[slot] == NULL)
+    _hash_mem[slot] = new HashMem();
+
+  return _hash_mem[slot];
+}
+
+/**
+ * @brief B+tree memory of a slot not yet used in this engine. The tables of memories are grown if needed
+ *
+ * @param slot Slot of the memory
+ * @return BPTree* The memory
+ */
+BPTree *Engine::grow_bp_mem(ULong slot)
+{
+  if (slot >= _n_mem)
+    grow_mem_tables(slot);
+
+  if (_bp_mem[slot] == NULL)
+    _bp_mem[slot] = new BPTree();
+
+  return _bp_mem[slot];
+}
+
+/**
+ * @brief Propagation mark of a slot not yet used in this engine. The table of marks is grown
+ *
+ * @param slot Slot of the node
+ * @return int& The mark
+ */
+int &Engine::grow_marks(ULong slot)
+{
+  ULong new_n = (_n_marks < 64) ? 64 : _n_marks * 2;
+
+  while (new_n <= slot)
+    new_n *= 2;
+
+  _marks = (int *)realloc(_marks, new_n * sizeof(int));
+  if (_marks == NULL)
+    engine_fatal_err("realloc: %s\n", strerror(errno));
+  memset(_marks + _n_marks, 0, (new_n - _n_marks) * sizeof(int));
+  _n_marks = new_n;
+
+  return _marks[slot];
+}
+
+/**
+ * @brief Empty all the memories of the engine, as if the package had just been loaded
+ *
+ */
+void Engine::reset()
+{
+  Engine *prev = select(this);
+  reset_pkg();
+  _n_inf = 0;
+  select(prev);
+}
+
+/**
+ * @brief Make a view to work over the memories of an engine. The tables of the engine must be
+ *        already grown for all the slots, so they will not be moved while the view uses them
+ *
+ * @param engine The engine
+ */
+void Engine::view_of(Engine *engine)
+{
+  _mem = engine->_mem;
+  _hash_mem = engine->_hash_mem;
+  _bp_mem = engine->_bp_mem;
+  _timer_due = engine->_timer_due;
+  _n_mem = engine->_n_mem;
+  _marks = engine->_marks;
+  _n_marks = engine->_n_marks;
+  _set_log = engine->_set_log;
+}
+
+/**
+ * @brief Select the engine of the calling thread
+ *
+ * @param engine The engine, NULL means the default one
+ * @return Engine* The engine previously selected
+ */
+Engine *Engine::select(Engine *engine)
+{
+  Engine *prev = _current;
+  _current = (engine == NULL) ? &_default : engine;
+  return prev;
+}
+
+/**
+ * @brief Assign a new memory slot to a node. The memory is created by each engine at its first use
+ *
+ * @return ULong The slot
+ */
+ULong Engine::new_mem()
+{
+  ULong slot;
+
+  pthread_mutex_lock(&engines_lock);
+  slot = _n_mem_slots++;
+  pthread_mutex_unlock(&engines_lock);
+  return slot;
+}
+
+/**
+ * @brief Assign a new propagation mark slot to a node
+ *
+ * @return ULong The slot
+ */
+ULong Engine::new_mark()
+{
+  ULong slot;
+
+  pthread_mutex_lock(&engines_lock);
+  slot = _n_mark_slots++;
+  pthread_mutex_unlock(&engines_lock);
+  return slot;
+}
+
+/**
+ * @brief Release a memory slot in all the engines. The memories must be already empty
+ *
+ * @param slot The slot
+ */
+void Engine::free_mem(ULong slot)
+{
+  Engine *engine;
+
+  pthread_mutex_lock(&engines_lock);
+  for (engine = _engines; engine != NULL; engine = engine->_next_engine)
+  {
+    if (slot < engine->_n_mem && engine->_mem[slot] != NULL)
+    {
+      delete engine->_mem[slot];
+      engine->_mem[slot] = NULL;
+    }
+    if (slot < engine->_n_mem && engine->_hash_mem[slot] != NULL)
+    {
+      delete engine->_hash_mem[slot];
+      engine->_hash_mem[slot] = NULL;
+    }
+    if (slot < engine->_n_mem && engine->_bp_mem[slot] != NULL)
+    {
+      delete engine->_bp_mem[slot];
+      engine->_bp_mem[slot] = NULL;
+    }
+    if (slot < engine->_n_mem && engine->_timer_due[slot] != NULL)
+    {
+      (void)BTreeT<TimerDue, TimerDue::Compare>(&engine->_timers).Delete(engine->_timer_due[slot]);
+      delete engine->_timer_due[slot];
+      engine->_timer_due[slot] = NULL;
+    }
+  }
+  pthread_mutex_unlock(&engines_lock);
+}
+
+/**
+ * @brief Call a function with each of the engines, but the current one, selected
+ *      Used to empty the memories of all the engines before the package, or a ruleset, is freed
+ *
+ * @param func The function
+ * @param arg Its argument
+ */
+void Engine::for_each_other(void (*func)(void *), void *arg)
+{
+  Engine *engine, *prev;
+
+  for (engine = _engines; engine != NULL; engine = engine->_next_engine)
+  {
+    if (engine != _current)
+    {
+      prev = select(engine);
+      func(arg);
+      select(prev);
+    }
+  }
+}
+
+//
+// API of the engine instances
+//
+
+/**
+ * @brief Create a new engine instance over the package loaded
+ *
+ * @return rce_engine_t* The engine
+ */
+PUBLIC
+rce_engine_t *rce_engine_new()
+{
+  return new Engine();
+}
+
+/**
+ * @brief Free an engine instance, retracting silently all the objects in its memories
+ *
+ * @param engine The engine
+ */
+PUBLIC
+void rce_engine_free(rce_engine_t *engine)
+{
+  if (engine == NULL || engine == &Engine::_default)
+    return;
+
+  engine->reset();
+
+  if (Engine::current() == engine)
+    Engine::select(NULL);
+
+  delete engine;
+}
+
+/**
+ * @brief Select the engine used by the calling thread with the classic API (engine_loop, engine_refresh...)
+ *
+ * @param engine The engine, NULL to return to the default engine
+ * @return rce_engine_t* The engine selected before
+ */
+PUBLIC
+rce_engine_t *rce_engine_select(rce_engine_t *engine)
+{
+  return Engine::select(engine);
+}
+
+/**
+ * @brief Engine selected by the calling thread
+ *
+ * @return rce_engine_t*
+ */
+PUBLIC
+rce_engine_t *rce_engine_current()
+{
+  return Engine::current();
+}
+
+/**
+ * @brief engine_loop over an engine instance
+ *
+ * @param engine The engine
+ * @param tag INSERT_TAG, MODIFY_TAG, od RETRACT_TAG
+ * @param obj The object to be propagated
+ */
+PUBLIC
+void rce_engine_loop(rce_engine_t *engine, int tag, ObjectType *obj)
+{
+  Engine *prev = Engine::select(engine);
+  engine_loop(tag, obj);
+  Engine::select(prev);
+}
+
+/**
+ * @brief engine_modify over an engine instance
+ *
+ * @param engine The engine
+ * @param obj The old version of the object, before being modified
+ */
+PUBLIC
+void rce_engine_modify(rce_engine_t *engine, ObjectType *obj)
+{
+  Engine *prev = Engine::select(engine);
+  engine_modify(obj);
+  Engine::select(prev);
+}
+
+/**
+ * @brief engine_refresh over an engine instance
+ *
+ * @param engine The engine
+ * @param real_time Time stamp
+ */
+PUBLIC
+void rce_engine_refresh(rce_engine_t *engine, long real_time)
+{
+  Engine *prev = Engine::select(engine);
+  engine_refresh(real_time);
+  Engine::select(prev);
+}
+
+/**
+ * @brief engine_next_expiry over an engine instance
+ *
+ * @param engine The engine
+ * @return long The time stamp, -1 if there is no object in a time window
+ */
+PUBLIC
+long rce_engine_next_expiry(rce_engine_t *engine)
+{
+  Engine *prev = Engine::select(engine);
+  long due = engine_next_expiry();
+  Engine::select(prev);
+  return due;
+}
+
+/**
+ * @brief Reset the memories of an engine instance
+ *
+ * @param engine The engine
+ */
+PUBLIC
+void rce_engine_reset(rce_engine_t *engine)
+{
+  engine->reset();
+}
+
+/**
+ * @brief Number of inferences made by an engine instance
+ *
+ * @param engine The engine
+ * @return int
+ */
+PUBLIC
+int rce_get_inf_cnt(rce_engine_t *engine)
+{
+  return engine->_n_inf;
+}
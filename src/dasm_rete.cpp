@@ -77,6 +77,15 @@ assoc assoc_matrix[] = {
     &Node::maxsa_call, (MAXS | TYPE_STR),
     &Node::count_call, COUNT,
     &Node::concat_call, CONCS,
+    &Node::pctsn_call, (PCTS | TYPE_NUM),
+    &Node::pctsf_call, (PCTS | TYPE_FLO),
+    &Node::pctsa_call, (PCTS | TYPE_STR),
+    &Node::rnksn_call, (RNKS | TYPE_NUM),
+    &Node::rnksf_call, (RNKS | TYPE_FLO),
+    &Node::rnksa_call, (RNKS | TYPE_STR),
+    &Node::dstsn_call, (DSTS | TYPE_NUM),
+    &Node::dstsf_call, (DSTS | TYPE_FLO),
+    &Node::dstsa_call, (DSTS | TYPE_STR),
     &Node::push_call, (PUSH | TYPE_NUM),
     &Node::pusha_call, (PUSH | TYPE_STR),
     &Node::pushs_call, (PUSHS | TYPE_NUM),
@@ -180,6 +189,13 @@ void dasm_rete(const char *prefix, ULong *code_array, int codelen)
               code_array[pp + AND_NODE_CODELEN_POS]);
         print_flags(code_array[pp + AND_NODE_FLAGS_POS]);
         fprintf(trace_file, " KEYS=%lu", code_array[pp + AND_NODE_NKEYS_POS]);
+        switch (code_array[pp + AND_NODE_RANGE_POS])
+        {
+          case TLT: fprintf(trace_file, " RANGE=<"); break;
+          case TLE: fprintf(trace_file, " RANGE=<="); break;
+          case TGT: fprintf(trace_file, " RANGE=>"); break;
+          case TGE: fprintf(trace_file, " RANGE=>="); break;
+        }
         fprintf(trace_file, "\n");
         /*
         * There are two other data used to store the memories
@@ -336,7 +352,7 @@ void dasm_rete(const char *prefix, ULong *code_array, int codelen)
         fprintf(trace_file, "%lu\tENDRULE\n", pp);
         break;
       case TCLASS:
-        fprintf(trace_file, "%lu\tTCLASS\t%s\n", pp, (char *)code_array[pp + 1]);
+        fprintf(trace_file, "%lu\tTCLASS\t%s\n", pp, ObjClass::by_id((int)code_array[pp + 1])->getname());
         pp++;
         break;
       case TNSOBJ:
@@ -438,6 +454,15 @@ void dasm_rete(const char *prefix, ULong *code_array, int codelen)
         case MAXS:
           fprintf(trace_file, "%lu\tMAXS", pp);
           break;
+        case PCTS:
+          fprintf(trace_file, "%lu\tPCTS", pp);
+          break;
+        case RNKS:
+          fprintf(trace_file, "%lu\tRNKS", pp);
+          break;
+        case DSTS:
+          fprintf(trace_file, "%lu\tDSTS", pp);
+          break;
         default:
           fprintf(trace_file, "%lu\t(%lX)", pp, code | type);
           break;
@@ -447,7 +472,8 @@ void dasm_rete(const char *prefix, ULong *code_array, int codelen)
 
         if (code == PUSHS || code == POPS ||
             code == SUMS || code == PRDS ||
-            code == MINS || code == MAXS)
+            code == MINS || code == MAXS ||
+            code == PCTS || code == RNKS || code == DSTS)
         {
           pp++;
           fprintf(trace_file, "%s\n", objstr(code_array[pp]));
@@ -562,6 +588,10 @@ void print_flags(ULong double_flags)
     fprintf(trace_file, "%sW", (nflags == 0) ? "(" : ", ");
   else
     fprintf(trace_file, "%sNW", (nflags == 0) ? "(" : ", ");
+  if (flags & IS_HASHED)
+    fprintf(trace_file, ", HASH");
+  if (flags & IS_BPTREE)
+    fprintf(trace_file, ", BPTREE");
 
   fprintf(trace_file, ")/");
 
@@ -583,6 +613,10 @@ void print_flags(ULong double_flags)
     fprintf(trace_file, "%sW", (nflags == 0) ? "(" : ", ");
   else
     fprintf(trace_file, "%sNW", (nflags == 0) ? "(" : ", ");
+  if (flags & IS_HASHED)
+    fprintf(trace_file, ", HASH");
+  if (flags & IS_BPTREE)
+    fprintf(trace_file, ", BPTREE");
 
   fprintf(trace_file, ")");
 }
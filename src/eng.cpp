@@ -22,32 +22,38 @@
 
 #include "engine.h"
 #include "nodes.hpp"
+#include "set.hpp"
 #include "error.hpp"
 #include "eng_p.hpp"
 
-int n_inf = 0;                 /* number of inferences made */
 int trace = 0;                 /* tracing level             */
 FILE *trace_file = stdout;     /* traces file               */
 
 /**
- * @brief reset the inferences counter
+ * @brief reset the inferences counter. In sharded mode the counters of all the shards
  *
  */
 PUBLIC
 void reset_inf_cnt()
 {
-  n_inf = 0;
+  if (Shard::routed())
+    Shard::reset_inf_cnt();
+  else
+    Engine::current()->_n_inf = 0;
 }
 
 /**
- * @brief Get the value of the inference counter
+ * @brief Get the value of the inference counter. In sharded mode the sum of all the shards
  *
  * @return int
  */
 PUBLIC
 int get_inf_cnt()
 {
-  return n_inf;
+  if (Shard::routed())
+    return Shard::inf_cnt();
+
+  return Engine::current()->_n_inf;
 }
 
 /**
@@ -174,7 +180,8 @@ PUBLIC void check_trace_file_size()
 PUBLIC
 void engine_modify(ObjectType *obj)
 {
-  ObjClass *the_class = *ObjClass::get_class(obj->attr[0].str.str_p);
+  ObjClass *the_class = ObjClass::class_of(obj);
+  ObjectType *&old_obj_modify = Engine::_old_obj_modify;
 
   if (the_class == NULL)
     engine_fatal_err("Unknown class %s in external object modification",
@@ -196,12 +203,18 @@ PUBLIC
 void engine_loop(int tag, ObjectType *obj)
 {
   Action *act;
+  Engine *engine = Engine::current();
 
-  static int in_the_loop = FALSE;
+  // In sharded mode the object is propagated by the engine of its shard
+  if (Shard::routed())
+  {
+    Shard::route(tag, obj);
+    return;
+  }
 
   if (tag == MODIFY_TAG)
   {
-    act = new Action(tag, new Single(obj), NULL, old_obj_modify, TRUE);
+    act = new Action(tag, new Single(obj), NULL, Engine::_old_obj_modify, TRUE);
     act->objswap();
     act->push();
   }
@@ -214,34 +227,35 @@ void engine_loop(int tag, ObjectType *obj)
 
   // To avoid additional propagations due to calls to this functions made by example in external functions 
   // this lock assure that the rest of calls will be queued until this propagation ends
-  if (!in_the_loop)
+  if (!engine->_in_the_loop)
   {
-    in_the_loop = TRUE;
+    engine->_in_the_loop = TRUE;
     do_loop(Action::main_list(), TRUE);
-    in_the_loop = FALSE;
+    engine->_in_the_loop = FALSE;
+
+    // Out of the propagation the memories can be copied for other threads
+    engine->_snaps->serve();
   }
 }
 
 /**
- * @brief This is the top function to perform a propagation of an Action in the net 
- *        and all the derived Actions until the conflict set will be empty
+ * @brief Propagate in the net the first Action of a list
  * 
- * @param my_init 
- * @param first_loop 
- * @return PUBLIC 
+ * @param my_init The list of actions
+ * @param first_loop If the action comes from engine_loop
+ * @param new_init Where the actions derived from this one will be queued
+ * @return Action* The action propagated, NULL if there were no action or its object had been deleted
  */
-PUBLIC
-void do_loop(Action *&my_init, int first_loop)
+PRIVATE
+Action *propagate_action(Action *&my_init, int first_loop, Action **&new_init)
 {
-  int not_empty_cs;
-  Action **new_init;
   Action *act;
 
   if (my_init == NULL)
-    return;
+    return NULL;
 
   if ((act = Action::pop(my_init)) == NULL)
-    return;
+    return NULL;
 
   if (act->_tag == MODIFY_TAG)
   {
@@ -267,7 +281,7 @@ void do_loop(Action *&my_init, int first_loop)
       free(act->_context);
 
     delete act;
-    return;
+    return NULL;
   }
 
   if (trace >= 2)
@@ -280,11 +294,16 @@ void do_loop(Action *&my_init, int first_loop)
     fprintf(trace_file, "\n");
   }
 
+  // The TCLASS nodes compare the class ids
+  ObjClass::class_of(act->_single->obj());
+
   Status st_aux(act);
   if (act->_tag == MODIFY_TAG)
   {
     ExecData data(st_aux, (MetaObj *&)act->_single, NULL, MODIFY_TAG, act->_side, act->_pos);
+    Set::begin_modify(act->_single->obj());
     act->_node->propagate_modify(data, act->_codep);
+    Set::end_modify();
     act->_single = (Single *&)data.left;
   }
 
@@ -300,6 +319,19 @@ void do_loop(Action *&my_init, int first_loop)
     act->_single->set_deleted();
   }
 
+  return act;
+}
+
+/**
+ * @brief Execute the rules of the Conflict Set and propagate the derived actions until the Conflict Set will be empty
+ * 
+ * @param new_init Where the derived actions are queued
+ */
+PRIVATE
+void run_inference(Action **new_init)
+{
+  int not_empty_cs;
+
   // Go deeper with the event, execute a rule and then repeat it with all the derived events until the Conflict Set will be empty
   do
   {
@@ -360,7 +392,17 @@ void do_loop(Action *&my_init, int first_loop)
       do_loop(*new_init, FALSE);
 
   } while (not_empty_cs);
+}
 
+/**
+ * @brief Communicate the end of the inference over the object of an Action and free the action
+ * 
+ * @param act The action
+ * @param first_loop If the action comes from engine_loop
+ */
+PRIVATE
+void end_action(Action *act, int first_loop)
+{
   // Communicate the retraction to the user at the end of the inferece, in reverse order
   // Only the objects not passed initially (!first_loop) that has been propagated
   // from the root (init_code_p == curr_pkg->code) of those that are not going to stay in the
@@ -395,6 +437,188 @@ void do_loop(Action *&my_init, int first_loop)
   delete act;
 }
 
+/**
+ * @brief Propagation of the retractions of the items out of their time windows queued by Node::timer_refresh.
+ *        All of them are propagated before the rules are executed, and the Sets with items expired are propagated
+ *        once for all of them (see Node::set_expiry). As in do_loop_batch, if the propagation of one of them derives
+ *        new actions, those actions and the rules are executed before continuing with the rest
+ * 
+ * @param my_init The list of actions, starting with the retractions
+ */
+PRIVATE
+void do_loop_expiry(Action *&my_init)
+{
+  Engine *engine = Engine::current();
+  Action **acts, **new_init, *act;
+  int n, n_acts, k;
+
+  for (n = 0, act = my_init; act != NULL && act->_expiry; act = act->_next)
+    n++;
+
+  if ((acts = (Action **)malloc(n * sizeof(Action *))) == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  n_acts = 0;
+  new_init = NULL;
+  engine->_expiring = TRUE;
+  do
+  {
+    if ((act = propagate_action(my_init, FALSE, new_init)) != NULL)
+      acts[n_acts++] = act;
+  } while (my_init != NULL && my_init->_expiry && (new_init == NULL || *new_init == NULL));
+  engine->_expiring = FALSE;
+
+  Node::set_expiry();
+
+  if (new_init != NULL)
+    run_inference(new_init);
+
+  for (k = 0; k < n_acts; k++)
+    end_action(acts[k], FALSE);
+
+  free(acts);
+}
+
+/**
+ * @brief This is the top function to perform a propagation of an Action in the net 
+ *        and all the derived Actions until the conflict set will be empty
+ * 
+ * @param my_init 
+ * @param first_loop 
+ * @return PUBLIC 
+ */
+PUBLIC
+void do_loop(Action *&my_init, int first_loop)
+{
+  Action **new_init;
+  Action *act;
+
+  if (my_init != NULL && my_init->_expiry)
+  {
+    do_loop_expiry(my_init);
+    return;
+  }
+
+  if ((act = propagate_action(my_init, first_loop, new_init)) == NULL)
+    return;
+
+  run_inference(new_init);
+  end_action(act, first_loop);
+}
+
+/**
+ * @brief Propagation of a batch of n Actions queued by engine_loop_batch. 
+ *        All of them are propagated before the rules are executed, so the Conflict Set is resolved once for the batch.
+ *        When the propagation of one of them derives new actions (e.g. the refresh of a time window) 
+ *        those actions and the rules are executed before continuing with the rest of the batch
+ * 
+ * @param my_init The list of actions
+ * @param n Number of actions of the batch
+ */
+PRIVATE
+void do_loop_batch(Action *&my_init, int n)
+{
+  Action **acts, **new_init, *act;
+  int i, n_acts, k;
+
+  if ((acts = (Action **)malloc(n * sizeof(Action *))) == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  for (i = 0; i < n;)
+  {
+    n_acts = 0;
+    new_init = NULL;
+    do
+    {
+      if ((act = propagate_action(my_init, TRUE, new_init)) != NULL)
+        acts[n_acts++] = act;
+      i++;
+    } while (i < n && (new_init == NULL || *new_init == NULL));
+
+    if (new_init != NULL)
+      run_inference(new_init);
+
+    for (k = 0; k < n_acts; k++)
+      end_action(acts[k], TRUE);
+  }
+
+  free(acts);
+}
+
+/**
+ * @brief Common part of engine_loop_batch and engine_loop_batch_mixed
+ * 
+ * @param tags The tag of each object, NULL if all of them have the same
+ * @param tag The tag of all the objects, when tags is NULL
+ * @param objs The objects
+ * @param n Number of objects
+ * @return int Number of objects propagated, ERROR if any tag is not INSERT_TAG or RETRACT_TAG
+ */
+PRIVATE
+int loop_batch(int *tags, int tag, ObjectType **objs, int n)
+{
+  Engine *engine = Engine::current();
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    if (tags != NULL)
+      tag = tags[i];
+    if (tag != INSERT_TAG && tag != RETRACT_TAG)
+      return ERROR;
+  }
+
+  // In sharded mode the objects are propagated by the engines of their shards
+  if (Shard::routed())
+  {
+    for (i = 0; i < n; i++)
+      Shard::route((tags != NULL) ? tags[i] : tag, objs[i]);
+    return n;
+  }
+
+  for (i = 0; i < n; i++)
+    (new Action((tags != NULL) ? tags[i] : tag, new Single(objs[i]), NULL, objs[i], TRUE))->push();
+
+  if (!engine->_in_the_loop && n > 0)
+  {
+    engine->_in_the_loop = TRUE;
+    do_loop_batch(Action::main_list(), n);
+    engine->_in_the_loop = FALSE;
+    engine->_snaps->serve();
+  }
+
+  return n;
+}
+
+/**
+ * @brief Propagate a batch of objects with the same tag. The rules are executed once all the objects 
+ *        have been propagated, instead of after each one of them as n calls to engine_loop would do
+ * 
+ * @param tag INSERT_TAG or RETRACT_TAG
+ * @param objs The objects to be propagated
+ * @param n Number of objects
+ * @return int Number of objects propagated, ERROR if the tag is not valid
+ */
+PUBLIC
+int engine_loop_batch(int tag, ObjectType **objs, int n)
+{
+  return loop_batch(NULL, tag, objs, n);
+}
+
+/**
+ * @brief Propagate a batch of objects, each one with its own tag. See engine_loop_batch
+ * 
+ * @param tags INSERT_TAG or RETRACT_TAG of each object
+ * @param objs The objects to be propagated
+ * @param n Number of objects
+ * @return int Number of objects propagated, ERROR if any tag is not valid
+ */
+PUBLIC
+int engine_loop_batch_mixed(int *tags, ObjectType **objs, int n)
+{
+  return loop_batch(tags, 0, objs, n);
+}
+
 //
 // Helpers for tracing
 //
@@ -432,7 +656,7 @@ void print_obj(FILE *file, const ObjectType *obj)
 
   fprintf(file, "%s(", STR(obj->attr[0].str.str_p));
 
-  the_class = *ObjClass::get_class(obj->attr[0].str.str_p);
+  the_class = ObjClass::class_of((ObjectType *)obj);
 
   if (the_class != NULL)
   {
@@ -576,12 +800,12 @@ int vectors_compare(const void *vec1, const void *vec2, va_list list)
  * @return the Object found 
  */
 PUBLIC
-ObjectType *get_obj_of_set(BTState *tree_state)
+ObjectType *get_obj_of_set(void *tree_state)
 {
 
   Single *mysingle;
 
-  mysingle = (Single *)BTree::Walk(*tree_state);
+  mysingle = (Single *)BTree::Walk(*(BTState *)tree_state);
 
   if (mysingle != NULL)
     return mysingle->obj();
@@ -618,9 +842,9 @@ void eng_destroy_set(BTState *tree_state)
  * @return int
  */
 PUBLIC
-int n_obj_of_set(BTState *tree_state)
+int n_obj_of_set(void *tree_state)
 {
-  return (tree_state->nitems());
+  return (((BTState *)tree_state)->nitems());
 }
 
 /**
@@ -629,9 +853,9 @@ int n_obj_of_set(BTState *tree_state)
  * @param tree_state 
  */
 PUBLIC
-void end_obj_of_set(BTState *tree_state)
+void end_obj_of_set(void *tree_state)
 {
-  delete tree_state;
+  delete (BTState *)tree_state;
 }
 
 /**
@@ -679,6 +903,7 @@ void objcpy(ObjectType *dest, ObjectType *ori, int n_attrs)
     dest->attr[n] = ori->attr[n];
 
   dest->user_data = ori->user_data;
+  dest->class_id = ori->class_id;
   dest->time = ori->time;
 }
 
@@ -708,6 +933,31 @@ ObjectType *new_object(int n_attrs, long time_val)
     obj->attr[n].str.dynamic_flags = 0;
   }
   obj->user_data = NULL;
+  obj->class_id = CLASS_UNKNOWN;
   obj->time = time_val;
   return obj;
 }
+
+/**
+ * @brief Create a new Object Type of a class, with all its attributes and its class name filled
+ *      The class id is stamped in the object so the engine does not look for its class by the name
+ * 
+ * @param class_id Id of the class, got by get_class_id
+ * @param time_val Timestamp
+ * @return ObjectType* The object created
+ */
+PUBLIC
+ObjectType *new_object_of_class(int class_id, long time_val)
+{
+  ObjClass *the_class = ObjClass::by_id(class_id);
+  ObjectType *obj;
+
+  if (the_class == NULL)
+    engine_fatal_err("Unknown class id %d in object creation", class_id);
+
+  obj = new_object(the_class->n_attrs() - 1, time_val);
+  obj->attr[0].str.str_p = engine_intern(the_class->getname());
+  obj->attr[0].str.dynamic_flags = INTERNED;
+  obj->class_id = class_id;
+  return obj;
+}
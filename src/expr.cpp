@@ -64,6 +64,7 @@ void match_val(int type, ...)
 {
   ULong data;
   float float_num;
+  char *str;
 
   va_list list;
   int curr_attr, attr_type;
@@ -93,7 +94,10 @@ void match_val(int type, ...)
     switch (type)
     {
     case TYPE_STR:
-      data = (ULong)va_arg(list, char *);
+      str = va_arg(list, char *);
+      data = (ULong)engine_intern(str);
+      if (str != NULL)
+        free(str);
       break;
     case TYPE_CHAR:
       type = TYPE_NUM; /* continues ...*/
@@ -933,6 +937,33 @@ int check_type(Expression **exp, int bool_in_stack)
     type = TYPE_STR;
     data_in_stack = TRUE;
     break;
+  case PCTS:
+  case RNKS:
+  case DSTS:
+    ref = (*exp)->data.fun_exp.args->arg_exp->data.val_exp.val.num;
+    patt_ref = patt_of_ref(ref);
+    if (!patt_ref->is_set())
+    {
+      comp_err("Reference variable not of a SET pattern\n");
+    }
+    type = type_of_ref(ref);
+    if (type != TYPE_NUM && type != TYPE_FLO && type != TYPE_STR)
+    {
+      comp_err("Reference to an attribute that can not be ordered\n");
+    }
+    // The percentile is an integer and the value to rank of the type of the attribute
+    if ((*exp)->op == PCTS && check_type(&((*exp)->data.fun_exp.args->sig->arg_exp), TRUE) != TYPE_NUM)
+    {
+      comp_err("Mismatch argument type\n");
+    }
+    if ((*exp)->op == RNKS && check_type(&((*exp)->data.fun_exp.args->sig->arg_exp), TRUE) != type)
+    {
+      comp_err("Mismatch argument type\n");
+    }
+    if ((*exp)->op != PCTS)
+      type = TYPE_NUM;
+    data_in_stack = TRUE;
+    break;
   default:
     comp_err("INTERNAL ERROR : Unknown node operator in expresion\n");
   }
@@ -1328,14 +1359,16 @@ int find_node_type(Expression *exp)
     else if (exp->op == SUMS || exp->op == PRDS ||
              exp->op == MINS || exp->op == MAXS ||
              exp->op == COUNT || exp->op == CONCS ||
-             exp->op == PUSHT)
+             exp->op == PCTS || exp->op == RNKS ||
+             exp->op == DSTS || exp->op == PUSHT)
     {
       // The reference goes in the first argument
 
       int ref = (int)exp->data.fun_exp.args->arg_exp->data.val_exp.val.num;
 
-      // Second argument for CONC (the separator)
-      if (exp->op == CONCS && find_node_type(exp->data.fun_exp.args->sig->arg_exp) == INTER_AND)
+      // Second argument for CONC (the separator), PCTS (the percentile) and RNKS (the value)
+      if ((exp->op == CONCS || exp->op == PCTS || exp->op == RNKS) &&
+          find_node_type(exp->data.fun_exp.args->sig->arg_exp) == INTER_AND)
         return INTER_AND;
 
       if (exp->op == COUNT || exp->op == PUSHT)
@@ -1413,9 +1446,12 @@ void join_required_objects(Expression *exp, int expr_type)
   case MINS:
   case MAXS:
   case CONCS:
+  case PCTS:
+  case RNKS:
+  case DSTS:
     ref = (int)exp->data.fun_exp.args->arg_exp->data.val_exp.val.num;
 
-    if (exp->op == CONCS)
+    if (exp->op == CONCS || exp->op == PCTS || exp->op == RNKS)
       join_required_objects(exp->data.fun_exp.args->sig->arg_exp, expr_type);
 
     patt = patt_of_ref(ref);
@@ -1631,6 +1667,32 @@ int compile_expresion(Expression *exp, int node_type)
     type = TYPE_STR;
     break;
 
+  case PCTS:
+  case RNKS:
+  case DSTS:
+    ref = exp->data.fun_exp.args->arg_exp->data.val_exp.val.num;
+    patt_ref = patt_of_ref(ref);
+    type = type_of_ref(ref);
+    op = exp->op | type;
+
+    // Compile of the second argument, the percentile or the value to rank
+    if (exp->op != DSTS)
+    {
+      (void)compile_expresion(exp->data.fun_exp.args->sig->arg_exp, node_type);
+      delete exp->data.fun_exp.args->sig;
+    }
+
+    patt_ref->get_inter_pos(&mem_ref, &pos_ref);
+    attr_ref = attr_of_ref(ref);
+    add_code(2, op, (mem_ref << 15) | (pos_ref << 8) | attr_ref);
+
+    if (exp->op != PCTS)
+      type = TYPE_NUM;
+    delete exp->data.fun_exp.args->arg_exp;
+    delete exp->data.fun_exp.args;
+    delete exp;
+    break;
+
   case CAST_BOO:
   case CAST_CHA:
   case CAST_OBJ:
@@ -1680,7 +1742,10 @@ int compile_expresion(Expression *exp, int node_type)
       break;
     case TYPE_STR:
       op = (exp->op | type);
-      data = (ULong)exp->data.val_exp.val.str;
+      // Interned, so it is compared by pointer with the INTERNED attributes
+      data = (ULong)engine_intern(exp->data.val_exp.val.str);
+      if (exp->data.val_exp.val.str != NULL)
+        free(exp->data.val_exp.val.str);
       add_code(2, op, data);
       break;
     case TYPE_FLO:
@@ -1855,9 +1920,10 @@ void notify_for_create(char *class_name, ULong flags)
            flags,
            0L,
            PUSH | TYPE_STR,
-           class_name,
+           engine_intern(class_name),
            POPS | TYPE_STR,
            (mem << 15) | (pos << 8));
+  free(class_name);
 
   set_curr_rule_exec_flags(flags);
 }
@@ -1981,9 +2047,10 @@ void notify_for_obj_imply(char *class_name)
            0L, // To unify lengths with con NEW/MODIFY (flags)
            0L,
            PUSH | TYPE_STR,
-           class_name,
+           engine_intern(class_name),
            POPS | TYPE_STR,
            (mem << 15) | (pos << 8));
+  free(class_name);
   
   if (curr_rule_exec_flags() & EXEC_TRIGGER)
     comp_err("Rule can't accept implied objects due to use of triggers\n");
@@ -0,0 +1,243 @@
+/**
+ * @file hashmem.cpp
+ * @author Francisco Alcaraz
+ * @brief Hash memories of the AND nodes. When all the keys of an AND node are equalities the multilevel BTree
+ *        of a side only serves to reach the items with the same values of the keys, one BTree level per key.
+ *        A HashMem reaches them with a single probe: the items with the same keys make a group, a BTree
+ *        ordered as the last level of the multilevel one, and the groups are kept in an open addressing table
+ *        with the hash of their keys. So the items of a group are walked in the same order by both memories
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "hashmem.hpp"
+#include "keys.hpp"
+#include "error.hpp"
+
+#define HASH_MEM_MIN_SIZE 16
+
+/**
+ * @brief Construct a new empty HashMem. The table is created with the first item
+ *
+ */
+HashMem::HashMem()
+{
+    _groups = NULL;
+    _size = 0;
+    _n_used = 0;
+    _n_groups = 0;
+    _n_items = 0;
+}
+
+/**
+ * @brief Destroy the HashMem. The items must have been freed (see Free)
+ *
+ */
+HashMem::~HashMem()
+{
+    for (ULong n = 0; n < _size; n++)
+        if (group(n) != NULL)
+            delete _groups[n]._items;
+    free(_groups);
+}
+
+/**
+ * @brief Look for the group of the items with the same keys than an item
+ *
+ * @param item The item, its keys are taken from the target side of the KeyManager
+ * @param hash The hash of its keys
+ * @param keys The KeyManager of the node, from the side of the item to the side of the memory
+ * @return HashGroup* The group or NULL
+ */
+HashGroup *
+HashMem::lookup(const void *item, ULong hash, KeyManager *keys) const
+{
+    HashGroup *group;
+    ULong mask, n;
+    int nk;
+
+    if (_size == 0)
+        return NULL;
+
+    mask = _size - 1;
+    for (n = hash & mask; (group = &_groups[n])->_items != NULL; n = (n + 1) & mask)
+    {
+        if (group->_items == HASH_DELETED || group->_hash != hash)
+            continue;
+
+        for (nk = 0; nk < keys->numKeys(); nk++)
+            if (keys->compareKey(item, group->_items->getElement(), nk) != 0)
+                break;
+
+        if (nk == keys->numKeys())
+            return group;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Move the groups to a new table, leaving out the emptied ones
+ *
+ * @param size Size of the new table, a power of two
+ */
+void
+HashMem::rehash(ULong size)
+{
+    HashGroup *old_groups = _groups;
+    ULong old_size = _size, mask, n, m;
+
+    if ((_groups = (HashGroup *)calloc(size, sizeof(HashGroup))) == NULL)
+        engine_fatal_err("calloc: %s\n", strerror(errno));
+    _size = size;
+    _n_used = _n_groups;
+
+    mask = size - 1;
+    for (n = 0; n < old_size; n++)
+    {
+        if (old_groups[n]._items == NULL || old_groups[n]._items == HASH_DELETED)
+            continue;
+
+        for (m = old_groups[n]._hash & mask; _groups[m]._items != NULL; m = (m + 1) & mask);
+        _groups[m] = old_groups[n];
+    }
+    free(old_groups);
+}
+
+/**
+ * @brief Insert an item in the group of its keys, created if it does not exist.
+ *      BTree::WasFound() tells if the item was already in the memory
+ *
+ * @param item The item
+ * @param keys The KeyManager of the side of the memory
+ * @param func Compare function of the items of a group
+ * @return void** Where the item is in its group
+ */
+void **
+HashMem::Insert(void *item, KeyManager *keys, BTCompareFunc func)
+{
+    ULong hash = keys->hashKeys(item);
+    HashGroup *group;
+    void **pos;
+    ULong mask, n;
+
+    if ((group = lookup(item, hash, keys)) == NULL)
+    {
+        // The emptied groups count as used, the table is cleaned of them when it is rehashed
+
+        if ((_n_used + 1) * 4 > _size * 3)
+            rehash((_size == 0) ? HASH_MEM_MIN_SIZE : ((_n_groups + 1) * 2 > _size) ? _size * 2 : _size);
+
+        mask = _size - 1;
+        for (n = hash & mask; _groups[n]._items != NULL && _groups[n]._items != HASH_DELETED; n = (n + 1) & mask);
+
+        group = &_groups[n];
+        if (group->_items == NULL)
+            _n_used++;
+        group->_hash = hash;
+        group->_items = new BTree();
+        _n_groups++;
+    }
+
+    pos = group->_items->Insert(item, func);
+    if (!BTree::WasFound())
+        _n_items++;
+
+    return pos;
+}
+
+/**
+ * @brief Remove an item. The group is emptied when it has no more items
+ *
+ * @param item The item
+ * @param keys The KeyManager of the side of the memory
+ * @param func Compare function of the items of a group
+ * @return void* The item found in the memory, or NULL
+ */
+void *
+HashMem::Delete(void *item, KeyManager *keys, BTCompareFunc func)
+{
+    HashGroup *group;
+    void *found;
+
+    if ((group = lookup(item, keys->hashKeys(item), keys)) == NULL)
+        return NULL;
+
+    if ((found = group->_items->Delete(item, func)) != NULL)
+        _n_items--;
+
+    if (group->_items->Empty())
+    {
+        delete group->_items;
+        group->_items = HASH_DELETED;
+        _n_groups--;
+    }
+
+    return found;
+}
+
+/**
+ * @brief Look for an item
+ *
+ * @param item The item
+ * @param keys The KeyManager of the side of the memory
+ * @param func Compare function of the items of a group
+ * @return const void* The item found in the memory, or NULL
+ */
+const void *
+HashMem::Find(const void *item, KeyManager *keys, BTCompareFunc func) const
+{
+    HashGroup *group;
+
+    if ((group = lookup(item, keys->hashKeys(item), keys)) == NULL)
+        return NULL;
+
+    return group->_items->Find(item, func);
+}
+
+/**
+ * @brief Iterator of the items with the same keys than an item, as BTree::FindByKeys
+ *
+ * @param item The item, usually of the other side
+ * @param keys The KeyManager from the side of the item to the side of the memory
+ * @return BTState The iterator, empty if there is no such items
+ */
+BTState
+HashMem::FindByKeys(const void *item, KeyManager *keys) const
+{
+    HashGroup *group;
+
+    if ((group = lookup(item, keys->hashKeys(item), keys)) == NULL)
+        return BTState();
+
+    return group->_items->getIterator();
+}
+
+/**
+ * @brief Free all the items, calling to a function with each one. The memory is left empty
+ *
+ * @param func The function
+ */
+void
+HashMem::Free(BTSimpleFunc func)
+{
+    for (ULong n = 0; n < _size; n++)
+    {
+        if (_groups[n]._items == NULL || _groups[n]._items == HASH_DELETED)
+            continue;
+
+        _groups[n]._items->Free(func);
+        delete _groups[n]._items;
+    }
+
+    free(_groups);
+    _groups = NULL;
+    _size = 0;
+    _n_used = 0;
+    _n_groups = 0;
+    _n_items = 0;
+}
@@ -7,15 +7,34 @@
  * @copyright Copyright (c) 2022
  * 
  */
+#include <string.h>
+
 #include "engine.h"
 #include "single.hpp"
 #include "nodes.hpp"
+#include "context.hpp"
 
 #ifndef ACTIONS_HH_INCLUDED
 #define ACTIONS_HH_INCLUDED
 
 #define CHANGE_TAG   255    // Used in MODIFY NO PROPAGATE actions
 
+#define ATTRSET_BITS (8 * sizeof(ULong))
+
+struct AttrSet              // Attributes modified by the rules in an Action
+{
+    ULong _bits[(MAXATTRS + ATTRSET_BITS - 1) / ATTRSET_BITS];
+
+    AttrSet() { memset(_bits, 0, sizeof(_bits)); };
+    void add(int attr) { _bits[attr / ATTRSET_BITS] |= 1UL << (attr % ATTRSET_BITS); };
+    int has(int attr) { return (_bits[attr / ATTRSET_BITS] >> (attr % ATTRSET_BITS)) & 1; };
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+};
+
 struct Action
 {
     Single *_single;
@@ -24,35 +43,44 @@ struct Action
     int _side;
     ObjectType *_old_obj;
     int _n_of_attrs;
-    char _mod_attr[MAXATTRS];
-    char _mod_str_attr[MAXATTRS];
+    int _all_attrs;         // External modification, all the attributes are taken as modified
+    AttrSet *_mod_attrs;    // Attributes modified by the rules, their old strings are freed. NULL if none
     Node *_node;
     ULong *_codep;
     int _from_the_root;
     ObjectType **_context;
     int _n_objs_in_ctx;
+    int _expiry;            // Retraction of an item out of its time window (see Node::timer_refresh)
  
     Action *_next;
  
-    static Action *_action_list;
-    static Action *_last;
-    static Action **_action_tail;
 
     Action(int tag, Single *obj, MetaObj *CObj_ctx, ObjectType *old_obj, int is_external = FALSE,
                    Node *node = NULL, ULong *codep =NULL, 
                    int side = LEFT_MEM, int pos=0);
     ~Action();   
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
     
     void push();
     static Action *pop(Action *&mi_inic);
     void objswap();
     void free_mod_str();
-    void store_mod_attr(int attr) { _mod_attr[attr] = 1; _mod_str_attr[attr]=1; };
+    void store_mod_attr(int attr)
+    {
+        if (_mod_attrs == NULL)
+            _mod_attrs = new AttrSet();
+        _mod_attrs->add(attr);
+    };
+    int is_mod_attr(int attr) { return _all_attrs || (_mod_attrs != NULL && _mod_attrs->has(attr)); };
     void fill_n_attrs();
 
-    static Action *&main_list() { return _action_list; };
-    static Action **tail() { return _action_tail; };
-    static Action *last() { return _last; };
+    static Action *&main_list() { return Engine::current()->_action_list; };
+    static Action **tail() { return Engine::current()->_action_tail; };
+    static Action *last() { return Engine::current()->_last; };
  
 };
  
@@ -0,0 +1,150 @@
+/**
+ * @file bptree.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the BPTree class. Memory of a side of an AND node kept in a B+tree whose entries
+ *        carry a copy of the values of the keys (see bptree.cpp)
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include "engine.h"
+#include "btree.hpp"
+
+#ifndef BPTREE_HH_INCLUDED
+#define BPTREE_HH_INCLUDED
+
+// Entries by node. 16 items and their keys fill few cache lines and keep the trees low
+#define BP_FANOUT 16
+#define BP_MIN_FANOUT 4
+
+// Maximum number of keys of the B+trees, the nodes with more keys keep multilevel BTrees
+#define BP_MAX_KEYS 8
+
+// Type of the keys whose values are not kept (attributes of SETs), they are compared with compareKey
+#define BP_NOT_KEPT 3
+
+// Value of the strings not kept, only the interned ones are (see KeyManager::keyValue)
+#define BP_STR_NOT_KEPT ((const char *)1)
+
+// The numeric keys of a node are ranked with SIMD compares when the compiler can build them,
+// the instructions are chosen at run time (AVX2, SSE4.2 or none)
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BP_SIMD
+#endif
+
+class KeyManager;
+
+union BPKey
+{
+    long num;
+    float flo;
+    const char *str;
+};
+
+struct BPNode
+{
+    int _leaf;                /* TRUE in the leaves, they have items, the inner nodes have separators */
+    int _count;               /* Number of items or separators */
+    BPNode *_next;            /* Next leaf, to walk the items in order */
+    /* Followed by the items (or separators), a column per key with its values and, in the inner nodes, the children */
+};
+
+/**
+ * @brief An item looked for, with the values of its keys taken once
+ *
+ */
+struct BPTarget
+{
+    const void *item;
+    KeyManager *keys;
+    BPKey key[BP_MAX_KEYS];
+};
+
+struct BPState
+{
+    const BPNode *leaf;       /* Leaf and position of the next item */
+    int pos;
+    int n_eq;                 /* Keys that must be equal to the ones of the target */
+    int upper;                /* Bound of the next key: BT_RANGE_NONE, BT_RANGE_OPEN or BT_RANGE_CLOSED */
+    const class BPTree *tree;
+    BPTarget target;
+
+    inline BPState()
+    {
+        leaf = NULL;
+        pos = 0;
+    };
+};
+
+class BPTree
+{
+private:
+    BPNode *_root;
+    int _fanout;
+    int _n_items;
+    int _n_keys;              /* Keys of the items, known with the first one */
+    int _type[BP_MAX_KEYS];   /* TYPE_NUM, TYPE_FLO, TYPE_STR or BP_NOT_KEPT */
+
+    void **items(const BPNode *node) const { return (void **)(node + 1); };
+    BPKey *column(const BPNode *node, int nk) const { return (BPKey *)((void **)(node + 1) + _fanout) + nk * _fanout; };
+    BPNode **children(const BPNode *node) const { return (BPNode **)column(node, _n_keys); };
+
+    BPNode *newNode(int leaf);
+    void setTarget(BPTarget &target, const void *item, KeyManager *keys) const;
+    void copyEntry(BPNode *dst, int d, const BPNode *src, int s) const;
+    void moveEntries(BPNode *dst, int d, const BPNode *src, int s, int n) const;
+    void setEntry(BPNode *node, int n, const BPTarget &target) const;
+    void rankKey(const BPTarget &target, const BPNode *node, int &less, int &less_eq) const;
+    int compareKey(const BPTarget &target, const BPNode *node, int n, int nk) const;
+    int compareKeys(const BPTarget &target, const BPNode *node, int n, int n_keys) const;
+    int compare(const BPTarget &target, const BPNode *node, int n, BTCompareFunc func, va_list list) const;
+    int before(const BPTarget &target, const BPNode *node, int n, int n_eq, int lower) const;
+    int searchEntry(const BPTarget &target, const BPNode *node, BTCompareFunc func, va_list list, int &found) const;
+    const BPNode *first(const BPNode *node) const;
+    BPNode *insert(BPNode *node, const BPTarget &target, BTCompareFunc func, va_list list, void **&pos, int &found);
+    void *remove(BPNode *node, const BPTarget &target, BTCompareFunc func, va_list list);
+    void rebalance(BPNode *node, int n);
+    void freeNode(BPNode *node);
+    BPState search(const BPTarget &target, int n_eq, int lower, int upper) const;
+
+public:
+    BPTree(int fanout = BP_FANOUT);
+    ~BPTree();
+
+    void **Insert(void *item, KeyManager *keys, BTCompareFunc func, ...);
+    void *Delete(void *item, KeyManager *keys, BTCompareFunc func, ...);
+    const void *Find(const void *item, KeyManager *keys, BTCompareFunc func, ...) const;
+    BPState FindByKeys(const void *item, KeyManager *keys) const;
+    BPState FindRangeByKeys(const void *item, KeyManager *keys, int lower, int upper) const;
+    BPState getIterator() const;
+    static const void *Walk(BPState &state);
+    void Free(BTSimpleFunc func, ...);
+
+    int numItems() const { return _n_items; };
+    int fanout() const { return _fanout; };
+};
+
+#endif
@@ -32,6 +32,13 @@ typedef void (*BTSimpleConstFunc)(const void *item_of_tree, va_list list);
 #define MaxKeysPlusOne (MaxKeys + 1)
 #define MinKeys 5
 
+// Found is kept per thread, so each engine instance may run in its own thread
+#if defined(__GNUC__)
+#define BT_TLS __thread
+#else
+#define BT_TLS thread_local
+#endif
+
 void Error(char *msg);
 
 class BTNode;
@@ -74,35 +81,59 @@ struct BTState
     inline int nitems() { return n_items; };
 };
 
+// Bounds of the range walked by FindRangeByKeys in the level of the last key
+#define BT_RANGE_NONE 0   // Unbounded
+#define BT_RANGE_OPEN 1   // The bound is excluded
+#define BT_RANGE_CLOSED 2 // The bound is included
+
+struct BTRangeState
+{
+    BTState keys;         // Walk of the level of the last key
+    BTState items;        // Walk of the items with the current value of the last key
+    const void *first;    // Value equal to the closed lower bound, walked before keys
+    const void *target;   // Item that gives the bounds
+    BTKeyManager *mgr;
+    int numkey;           // Level of the last key
+    int upper;            // Upper bound, BT_RANGE_NONE, BT_RANGE_OPEN or BT_RANGE_CLOSED
+};
+
 class BTNode
 {
 private:
     int Count;                      // Number of keys stored in the current node
+    int Items;                      // Number of keys stored in the subtree of the node, for the ranks (see Nth)
     void *Key[MaxKeys];             // Warning: indexing starts at 0, not 1
     BTNode *Branch[MaxKeysPlusOne]; // Fake pointers to child nodes
 
-    bool SearchNode(const void *Target, BTCompareFunc Func, va_list list, int &location) const;
-    bool SearchNode(const void *Target, BTKeyManager *KeysMgr, int numkey, int &location) const;
+    // The searches are templates on the comparator, see btreet.hpp
+    template <class Compare> bool SearchNode(const void *Target, const Compare &Cmp, int &location) const;
     void AddItemToLeft(void *NewItem, BTNode *NewRight, int Location);
     void AddItemToRight(void *NewItem, BTNode *NewRight, int Location);
     void DeleteItemToLeft(int location);
     void DeleteItemToRight(int location);
     void Split(void *&CurrItem, BTNode *&CurrRight, int Location);
+    void Rebalance(int Location);
+    void Recount();
+    static inline int ItemsOf(const BTNode *Node) { return (Node) ? Node->Items : 0; };
 
 public:
-    BTNode() { Count = 0; };
+    BTNode() { Count = 0; Items = 0; };
     BTNode(void *Item, BTNode *left, BTNode *right);
 
-    bool PushDown(void *CurrentItem, void *&NewItem, BTNode *&NewRight, void **&BTItemPos, int *Found, BTCompareFunc Func, va_list list);
-    bool PushDown(void *CurrentItem, void *&NewItem, BTNode *&NewRight, void **&BTItemPos, int *Found, BTKeyManager *KeysMgr, int numkey);
-    const void *Find(const void *Search, BTCompareFunc Func, va_list list) const;
-    const void *Find(const void *Search, BTKeyManager *KeysMgr, int numkey) const;
-    void *const *FindDir(const void *Search, BTCompareFunc Func, va_list list) const;
-    void *const *FindDir(const void *Search, BTKeyManager *KeysMgr, int numkey) const;
-    bool Delete(void *Search, void **Found, BTCompareFunc Func, va_list List, BTKeyManager *KeysMgr, int numkey = 0, bool nextItemSearch = false);
+    template <class Compare>
+    static bool PushDown(BTNode *Node, void *CurrentItem, void *&NewItem, BTNode *&NewRight, void **&BTItemPos, int *Found, const Compare &Cmp);
+    template <class Compare> const void *Find(const void *Search, const Compare &Cmp) const;
+    template <class Compare> void *const *FindDir(const void *Search, const Compare &Cmp) const;
+    template <class Compare, class KeyMgr>
+    bool Delete(void *Search, void **Found, const Compare &Cmp, KeyMgr *KeysMgr, int numkey = 0, bool nextItemSearch = false);
     static const void *Walk(BTState &state);
-    void SearchNodeBiggerThan(const void *Target, BTCompareFunc Func, va_list List, BTState &state) const;
-    void SearchNodeBiggerThan(const void *Target, BTKeyManager *KeysMgr, int numkey, BTState &state) const;
+    const void *First() const;
+    const void *Last() const;
+    template <class Compare> void SearchNodeBiggerThan(const void *Target, const Compare &Cmp, BTState &state) const;
+    void SearchNodeBiggerThan(const void *Target, BTKeyManager *KeysMgr, int numkey, BTState &state, const void *&Equal) const;
+    static const void *WalkRange(BTRangeState &state);
+    const void *Nth(int n) const;
+    template <class Compare> int Rank(const void *Target, const Compare &Cmp) const;
     void Dump(BTPrintFunc Func, int nk, int ofsset = 0) const;
     void DumpKeys(BTPrinterFunc Func, BTPrintFunc Func2, int nk) const;
     bool Empty(void) const { return Count == 0; };
@@ -111,12 +142,16 @@ public:
 
 class BTree
 {
+    friend class BPTree;      // Its insertions also tell WasFound
+
 private:
-    static int Found;
+    static BT_TLS int Found;
     BTNode *Root; // fake pointer to the root node
     int NumItems;
     BTKeyManager *KeysMgr;
 
+    template <class KeyMgr> BTNode *FindKeysRoot(const void *Item, int numkeys) const;
+
 public:
     inline BTree()
     {
@@ -157,15 +192,29 @@ public:
     void *const *FindDir(const void *Search, BTCompareFunc Func, ...) const;
     void *const *FindDirList(const void *Search, BTCompareFunc Func, va_list List) const;
     BTState FindByKeys(const void *Item) const;
+    BTRangeState FindRangeByKeys(const void *Item, int lower, int upper) const;
     BTState getIterator() const
     {
         BTState iterator(Root, NumItems);
         return iterator;
     }
     static const void *Walk(BTState &state);
+    static const void *Walk(BTRangeState &state);
+    inline const void *getFirst() const { return (Root) ? Root->First() : NULL; };
+    inline const void *getLast() const { return (Root) ? Root->Last() : NULL; };
+    // Item in a position of the order (from 0), for the trees without keys
+    inline const void *getNth(int n) const { return (Root && n >= 0 && n < NumItems && numKeys() == 0) ? Root->Nth(n) : NULL; };
     void WalkBy(BTSimpleConstFunc func, ...) const;
     BTState FindBiggerThan(const void *item, BTCompareFunc Func, ...);
 
+    // Versions with a comparator object, inlined in the searches (see btreet.hpp)
+    template <class Compare, class KeyMgr> void **InsertT(void *Item, const Compare &Cmp);
+    template <class Compare, class KeyMgr> void *DeleteT(void *Search, const Compare &Cmp);
+    template <class Compare, class KeyMgr> const void *FindT(const void *Search, const Compare &Cmp) const;
+    template <class Compare, class KeyMgr> void *const *FindDirT(const void *Search, const Compare &Cmp) const;
+    template <class Compare, class KeyMgr> BTState FindBiggerThanT(const void *Item, const Compare &Cmp) const;
+    template <class Compare> int RankT(const void *Item, const Compare &Cmp) const;
+
     bool Empty(void) const { return (Root == NULL); };
     void Dump(BTPrintFunc Func = NULL)
     {
@@ -0,0 +1,552 @@
+/**
+ * @file btreet.hpp
+ * @author Francisco Alcaraz
+ * @brief Templated searches of the BTree. The algorithms of the nodes take the comparator as a template param,
+ *        so a comparator object (a struct with an int operator()(target, item) const) is inlined into the
+ *        search loops instead of being called through a BTCompareFunc with its va_list.
+ *        The C-style API of the BTree (Insert, Delete, Find... with BTCompareFunc and varargs) wraps its
+ *        callbacks in a BTFuncCompare and the levels of the keys use a BTKeyCompare.
+ *        BTreeT is the typed view of a BTree with its comparator
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef BTREET_HH_INCLUDED
+#define BTREET_HH_INCLUDED
+
+#include "btree.hpp"
+
+/**
+ * @brief Comparator that calls a BTCompareFunc with the additional params of the C-style API
+ *
+ */
+struct BTFuncCompare
+{
+   BTCompareFunc Func;
+   mutable va_list List;
+
+   inline BTFuncCompare(BTCompareFunc func, va_list list)
+   {
+      Func = func;
+      va_copy(List, list);
+   };
+   inline ~BTFuncCompare() { va_end(List); };
+   inline int operator()(const void *Target, const void *Item) const { return (*Func)(Target, Item, List); };
+
+private:
+   BTFuncCompare(const BTFuncCompare &);
+};
+
+/**
+ * @brief Comparator of a level of the keys of a multilevel BTree. The item to compare with is the first one
+ *    of the lower levels. With the class of the KeyManager (declared final) its compareKey is not a virtual call
+ *
+ */
+template <class KeyMgr>
+struct BTKeyCompare
+{
+   KeyMgr *KeysMgr;
+   int NumKey;
+
+   inline BTKeyCompare(KeyMgr *keysMgr, int numkey)
+   {
+      KeysMgr = keysMgr;
+      NumKey = numkey;
+   };
+   inline int operator()(const void *Target, const void *Internal) const
+   {
+      for (int nk = NumKey; nk < KeysMgr->numKeys(); nk++)
+         Internal = *((const BTNode *)Internal)->keyPointer(0);
+
+      // A NULL Target matches any item (see FreeList)
+      return (Target == NULL) ? 0 : KeysMgr->compareKey(Target, Internal, NumKey);
+   };
+};
+
+/**
+ * @brief Search for an item in a node. A binary search is performed comparing the target with the key in the middle
+ *    of the search interval over the keys, moving the interval margins according to the comparison result
+ *
+ * @param Target the item serached for
+ * @param Cmp Comparator
+ * @param Location the offset tested. It will store the final position when found
+ * @return true when found, false elsewhere and the search must continue in the branch between last two (consecutive) keys
+ */
+template <class Compare>
+bool BTNode::SearchNode(const void *Target, const Compare &Cmp, int &Location) const
+{
+   int i, j;
+   int result;
+
+   i = -1; j = Count; result = 1; Location = -1;
+   while (result != 0 && (j - i) > 1)
+   {
+      Location = i + (j - i) / 2;
+      result = Cmp(Target, Key[Location]);
+      if (result > 0)
+         i = Location;
+      else if (result < 0)
+         j = Location--;
+   }
+
+   return (result == 0);
+}
+
+/**
+ * @brief Add a new object to the tree rebalancing the nodes maintaining the number of keys between MaxKeys and MinKeys
+ *
+ * @param Node The node where to add it, NULL below the leaves
+ * @param CurrentItem The item to add
+ * @param NewItem The item that is being moved
+ * @param NewRight The new node at the right branch of NewItem in the superior node
+ * @param BTItemPos Pointer to where the currentItem is stored
+ * @param Found where to store if the object (CurrentItem) was found or not
+ * @param Cmp Comparator
+ * @return true when NewItem/NewRight must me moved to the superior node
+ * @return false when that is not needed
+ */
+// static
+template <class Compare>
+bool BTNode::PushDown(BTNode *Node, void *CurrentItem, void *&NewItem, BTNode *&NewRight, void **&BTItemPos, int *Found,
+                      const Compare &Cmp)
+{
+   int Location;
+   bool MoveUp, isTheObject;
+
+   #ifdef DEBUG
+      cout << "P ";
+   #endif
+
+   if (Node == NULL)   // stopping case
+   {  // cannot insert into empty tree
+      NewItem = CurrentItem;
+      NewRight = NULL;
+      return true;
+   }
+
+   if (Node->SearchNode(CurrentItem, Cmp, Location))
+   {
+      // Communicate the element found and return with false
+      // to end the process
+      BTItemPos = &Node->Key[Location];
+      *Found = true;
+      return false;
+   }
+
+   MoveUp = PushDown(Node->Branch[Location + 1], CurrentItem, NewItem, NewRight, BTItemPos, Found, Cmp);
+
+   if (!*Found)
+      Node->Items++;   // Counted again if it is split
+
+   isTheObject = (NewItem == CurrentItem);
+
+   if (MoveUp)
+   {
+      if (Node->Count < MaxKeys)
+      {
+         MoveUp = false;
+         Node->AddItemToRight(NewItem, NewRight, Location + 1);
+         if (isTheObject) BTItemPos = &Node->Key[Location+1];
+      }
+      else
+      {
+         MoveUp = true;
+         Node->Split(NewItem, NewRight, Location);
+
+         if (isTheObject)
+         {
+            if (Location < MinKeys) BTItemPos = &Node->Key[Location+1];
+            else BTItemPos = &(NewRight->Key[Location-MinKeys]);
+         }
+      }
+   }
+   return MoveUp;
+}
+
+/**
+ * @brief The delete algorithm to maintain the tree balanced is as follows:
+ *    - first a search is done to locate the item
+ *    - starting by the branch to its right and going deeper in the tree by branches[0] the next object in order is found
+ *    - this next element is removed from where it is and will replace the position where the item found is
+ *    - With this procedure only leave nodes are being reduced their keys
+ *    - if The leave node gets less keys than minKeys, this node can increase their keys taking the next key
+ *      of the parent node that will be replaced by the first item of the brach to its right
+ *    - sometimes we will have to get from the left side, so we will put at position 0 the previous key of the parent
+ *      and that will be substituted by the last item of the previous branch
+ *    - This operations are known as right/left rotations
+ *
+ * @param Item The item to remove from the tree
+ * @param ItemFound The pointer to object found that is considered equal to the item passed (but may be physically different object)
+ * @param Cmp Comparator of the items
+ * @param KeysMgr Key manager of the tree. May be null if that tree is simple
+ * @param numkey number of keys (multikeys -> tres of tress)
+ * @param nextItemSearch If is being searched the next object in the tree
+ * @return true Id the node has less keys than minKeys and require rotations or joins
+ * @return false otherwise
+ */
+template <class Compare, class KeyMgr>
+bool BTNode::Delete(void *Item, void **ItemFound, const Compare &Cmp, KeyMgr *KeysMgr, int numkey, bool nextItemSearch)
+{
+   int Location;
+   int Found;
+   int reorder;
+   int numkeys;
+
+   numkeys = ((!KeysMgr) ? 0 : KeysMgr->numKeys());
+
+   if (nextItemSearch)
+   {
+      Found = (Branch[0] == NULL);
+      Location = (Found ? 0 : -1);
+   }
+   else
+   {
+      if (numkey<numkeys)
+         Found = SearchNode(Item, BTKeyCompare<KeyMgr>(KeysMgr, numkey), Location);
+      else
+         Found = SearchNode(Item, Cmp, Location);
+   }
+
+   if (!nextItemSearch && Found && numkey < numkeys)
+   {
+      BTNode *root = (BTNode *)Key[Location];
+      root->Delete(Item, ItemFound, Cmp, KeysMgr, numkey+1, nextItemSearch);
+      if (root->Empty())
+         delete root;
+      else return false;
+   }
+
+   if (Found)
+   {
+      if (Branch[Location+1])
+      {
+         void *Next;
+
+         if ((nextItemSearch || numkey == numkeys) && ItemFound) *ItemFound = Key[Location];
+         reorder = Branch[Location+1]->Delete(Item, &Next, Cmp, KeysMgr, numkey, true);
+         Key[Location] = Next;
+         Items--;
+      }
+      else
+      {
+         if ((nextItemSearch || numkey == numkeys) && ItemFound) *ItemFound = Key[Location];
+         DeleteItemToRight(Location);
+         Items--;
+         return (Count < MinKeys);
+      }
+   }
+   else if (Branch[Location+1])
+   {
+      int BranchItems = Branch[Location+1]->Items;
+
+      reorder =  Branch[Location+1]->Delete(Item, ItemFound, Cmp, KeysMgr, numkey, nextItemSearch);
+      Items -= BranchItems - Branch[Location+1]->Items;
+   }
+   else reorder = false;
+
+   if (reorder)
+      Rebalance(Location);
+
+   return (Count < MinKeys);
+}
+
+/**
+ * @brief Find an item in a tree. Return a pointer to where the item found is stored
+ *
+ * @param Item to search for
+ * @param Cmp Comparator
+ * @return The pointer to where the item found is stored or NULL if nor found
+ */
+template <class Compare>
+void * const *BTNode::FindDir(const void *Item, const Compare &Cmp) const
+{
+   int Location;
+   const BTNode *CurrentNode;
+
+   CurrentNode = this;
+
+   while (CurrentNode != NULL)
+   {
+      if (CurrentNode->SearchNode(Item, Cmp, Location))
+         return &CurrentNode->Key[Location];
+
+      CurrentNode = CurrentNode->Branch[Location + 1];
+   }
+   return NULL;
+}
+
+/**
+ * @brief Find an item in a tree
+ *
+ * @param Item to search for
+ * @param Cmp Comparator
+ * @return The item found or NULL if nor found
+ */
+template <class Compare>
+const void *BTNode::Find(const void *Item, const Compare &Cmp) const
+{
+   void * const *ItemDir = FindDir(Item, Cmp);
+
+   return (ItemDir) ? *ItemDir : NULL;
+}
+
+/**
+ * @brief Setup a BTstate from where a given item is to walk from there
+ *
+ * @param Target item found
+ * @param Cmp Comparator
+ * @param state the state that is setup as the result of the search
+ */
+template <class Compare>
+void BTNode::SearchNodeBiggerThan(const void *Target, const Compare &Cmp, BTState &state) const
+{
+   bool Found;
+   int i, j;
+   int result;
+   const BTNode *node = this;
+
+   Found = false;
+   while ((node != NULL) && !Found)
+   {
+      int loc;
+      state.Push(node);
+
+      result = 1; i=0; j=node->Count-1;
+
+      while (result!=0 && i<=j)
+      {
+         loc = i + (j-i)/2;
+         result = Cmp(Target, node->Key[loc]);
+         if (result>0)
+            i=loc + 1;
+         else if (result<0)
+            j=loc - 1;
+      }
+
+      if (Found = (result == 0)) i = loc+1;
+      state.stack[state.level].loc = i;
+      node = node->Branch[i];
+   }
+}
+
+/**
+ * @brief Number of items of the subtree of this node lower than a target. The keys of each node before the branch
+ *    to go down are counted with the items of their branches
+ *
+ * @param Target the item to rank, it may be not in the tree
+ * @param Cmp Comparator
+ * @return int The number of items lower than Target
+ */
+template <class Compare>
+int BTNode::Rank(const void *Target, const Compare &Cmp) const
+{
+   const BTNode *CurrentNode = this;
+   int Location, i;
+   int Lower = 0;
+
+   while (CurrentNode != NULL)
+   {
+      bool Found = CurrentNode->SearchNode(Target, Cmp, Location);
+
+      for (i = 0; i <= Location; i++)
+         Lower += ItemsOf(CurrentNode->Branch[i]) + 1;
+      if (Found)
+         return Lower - 1;   // The target is not lower than itself
+      CurrentNode = CurrentNode->Branch[Location + 1];
+   }
+   return Lower;
+}
+
+/**
+ * @brief Root of the tree of the items with the same keys than an item, NULL if there is none
+ *
+ * @param Item The item
+ * @param numkeys Number of levels to go down
+ * @return BTNode* The root
+ */
+template <class KeyMgr>
+BTNode *BTree::FindKeysRoot(const void *Item, int numkeys) const
+{
+   BTNode *RootNode = Root;
+
+   for (int nk=0; RootNode && nk<numkeys; nk++)
+      RootNode = (BTNode *)RootNode->Find(Item, BTKeyCompare<KeyMgr>((KeyMgr *)KeysMgr, nk));
+   return RootNode;
+}
+
+/**
+ * @brief Insert an item in the BTree
+ *
+ * @param Item the item to be inserted
+ * @param Cmp Comparator
+ * @return void** The pointer to where the object was inserted in the BTree (If may be replaced)
+ */
+template <class Compare, class KeyMgr>
+void **BTree::InsertT(void *Item, const Compare &Cmp)
+{
+   #ifdef DEBUG
+      cout << "I";
+   #endif
+
+   bool MoveUp;
+   BTNode *NewRight;
+   void *NewItem;
+   void **BTItemPos;
+   BTNode **RootNodePos;
+   int numkeys = numKeys();
+
+   RootNodePos = &Root;
+   for (int nk=0; nk<numkeys; nk++)
+   {
+      Found = false;
+      BTItemPos = NULL;
+      MoveUp = BTNode::PushDown(*RootNodePos, Item, NewItem, NewRight, BTItemPos, &Found,
+                                BTKeyCompare<KeyMgr>((KeyMgr *)KeysMgr, nk));
+
+      if (MoveUp)   // create a new root node
+      {
+         *RootNodePos = new BTNode(NewItem, *RootNodePos, NewRight);
+         if (Item == NewItem)
+            BTItemPos = (void **)(*RootNodePos)->keyPointer(0);
+      }
+
+      if (!Found) *BTItemPos = NULL; // Create a null BTNode (empty tree)
+      RootNodePos = (BTNode **)BTItemPos;
+   }
+
+   Found = false;
+   BTItemPos = NULL;
+   MoveUp = BTNode::PushDown(*RootNodePos, Item, NewItem, NewRight, BTItemPos, &Found, Cmp);
+
+   if (MoveUp)   // create a new root node
+   {
+      *RootNodePos = new BTNode(NewItem, *RootNodePos, NewRight);
+      if (Item == NewItem)
+         BTItemPos = (void **)(*RootNodePos)->keyPointer(0);
+   }
+
+   if (!Found) NumItems++;
+
+   return BTItemPos;
+}
+
+/**
+ * @brief Remove an Item from a BTree
+ *
+ * @param Item the item to be removed
+ * @param Cmp Comparator
+ * @return void* The object that was found in the BTree.
+ */
+template <class Compare, class KeyMgr>
+void *BTree::DeleteT(void *Item, const Compare &Cmp)
+{
+   #ifdef DEBUG
+     cout << "R";
+   #endif
+
+   void *ItemFound = NULL;
+
+   if (Root== NULL) return NULL;
+   Root->Delete(Item, &ItemFound, Cmp, (KeyMgr *)KeysMgr);
+
+   if (Root->Empty())
+   {
+      delete Root;
+      Root = NULL;
+   }
+   if (ItemFound!= NULL) NumItems--;
+   return ItemFound;
+}
+
+/**
+ * @brief Find the address where an item is stored in a BTree
+ *
+ * @param Item the item to be found
+ * @param Cmp Comparator
+ * @return void* const* Where the object found is stored, NULL if not found
+ */
+template <class Compare, class KeyMgr>
+void * const *BTree::FindDirT(const void *Item, const Compare &Cmp) const
+{
+   #ifdef DEBUG
+     cout << "R";
+   #endif
+
+   BTNode *RootNode = FindKeysRoot<KeyMgr>(Item, numKeys());
+
+   if (RootNode == NULL) return NULL;
+   return RootNode->FindDir(Item, Cmp);
+}
+
+/**
+ * @brief Find an Item in a BTree
+ *
+ * @param Item the item to be found
+ * @param Cmp Comparator
+ * @return void* The object that was found in the BTree.
+ */
+template <class Compare, class KeyMgr>
+const void *BTree::FindT(const void *Item, const Compare &Cmp) const
+{
+   void * const *ItemDir = FindDirT<Compare, KeyMgr>(Item, Cmp);
+
+   return (ItemDir) ? *ItemDir : NULL;
+}
+
+/**
+ * @brief Return the state positioned on the first item in the tree that is bigger that the passed
+ * For this state the BTree may be iterated
+ *
+ * @param Item The item to find
+ * @param Cmp Comparator
+ * @return BTState
+ */
+template <class Compare, class KeyMgr>
+BTState BTree::FindBiggerThanT(const void *Item, const Compare &Cmp) const
+{
+   BTState result;
+   BTNode *RootNode = FindKeysRoot<KeyMgr>(Item, numKeys());
+
+   if (RootNode) RootNode->SearchNodeBiggerThan(Item, Cmp, result);
+   return result;
+}
+
+/**
+ * @brief Number of items of a tree without keys lower than another one (its position in the order if it is there)
+ *
+ * @param Item The item to rank
+ * @param Cmp Comparator
+ * @return int The number of items lower than Item
+ */
+template <class Compare>
+int BTree::RankT(const void *Item, const Compare &Cmp) const
+{
+   return (Root) ? Root->Rank(Item, Cmp) : 0;
+}
+
+/**
+ * @brief Typed view of a BTree whose items are compared with a comparator object.
+ *    The comparator (and the KeyManager class of the keys, if any) is inlined in the searches
+ *
+ */
+template <class Item, class Compare, class KeyMgr = BTKeyManager>
+class BTreeT
+{
+private:
+    BTree *_tree;
+    Compare _cmp;
+
+public:
+    inline BTreeT(BTree *tree, const Compare &cmp = Compare()) : _cmp(cmp) { _tree = tree; };
+
+    inline Item **Insert(void *item) { return (Item **)_tree->InsertT<Compare, KeyMgr>(item, _cmp); };
+    inline Item *Delete(const void *item) { return (Item *)_tree->DeleteT<Compare, KeyMgr>((void *)item, _cmp); };
+    inline Item *Find(const void *item) const { return (Item *)_tree->FindT<Compare, KeyMgr>(item, _cmp); };
+    inline BTState FindBiggerThan(const void *item) const { return _tree->FindBiggerThanT<Compare, KeyMgr>(item, _cmp); };
+    inline int Rank(const void *item) const { return _tree->RankT<Compare>(item, _cmp); };
+    inline Item *Nth(int n) const { return (Item *)_tree->getNth(n); };
+    inline BTree *tree() const { return _tree; };
+};
+
+#endif
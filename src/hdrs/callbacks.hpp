@@ -13,6 +13,7 @@
 
 #include "engine.h"
 
+PUBLIC void call_callbacks(int when, ObjectType *obj, ObjectType **ctx, int n_objs);
 PUBLIC void object_created(ObjectType *obj, ObjectType **ctx, int n_objs);
 PUBLIC void object_modified(ObjectType *obj, ObjectType **ctx, int n_objs);
 PUBLIC void object_deleted(ObjectType *obj);
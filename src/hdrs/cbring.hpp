@@ -0,0 +1,88 @@
+/**
+ * @file cbring.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the CallBackRing class. In asynchronous mode the object events of an engine are
+ *        queued in this ring instead of calling the callbacks inside the inference, and another thread
+ *        delivers them later with engine_poll_events
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include <pthread.h>
+
+#include "engine.h"
+
+#ifndef CBRING__HH_INCLUDED
+#define CBRING__HH_INCLUDED
+
+struct CallBackEvent
+{
+    int _when;                /* WHEN_INSERTED, WHEN_MODIFIED, WHEN_RETRACTED or WHEN_NOT_USED */
+    ObjectType *_obj;
+    ObjectType **_ctx;        /* Context of the rule, owned by the event until it is delivered */
+    int _n_objs;
+};
+
+class CallBackRing
+{
+private:
+    CallBackEvent *_events;
+    ULong _size;              /* Number of events, a power of 2 */
+    ULong _head;              /* Next event to deliver */
+    ULong _tail;              /* Next event to fill */
+    int _policy;              /* CALLBACKS_SYNC, CALLBACKS_BLOCK, CALLBACKS_DROP_OLDEST or CALLBACKS_GROW */
+    int _closed;
+    int _pollers;             /* Threads inside engine_poll_events */
+    long _dropped;            /* Events lost by CALLBACKS_DROP_OLDEST */
+    pthread_mutex_t _lock;
+    pthread_cond_t _not_empty;
+    pthread_cond_t _not_full;
+    pthread_cond_t _no_pollers;
+
+    void grow();
+
+public:
+    CallBackRing();
+    ~CallBackRing();
+
+    /**
+     * @brief Only the thread that runs the engine changes the policy, so it can check it without locking
+     *
+     * @return int TRUE if the events must be queued
+     */
+    int async() { return _policy != CALLBACKS_SYNC; };
+
+    void open(int policy, ULong size);
+    void close();
+    void put(int when, ObjectType *obj, ObjectType **ctx, int n_objs);
+    int enter();
+    int get(CallBackEvent &event, int wait);
+    void leave();
+    ULong pending();
+    long dropped();
+};
+
+#endif
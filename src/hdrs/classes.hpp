@@ -58,10 +58,14 @@
 #define IS_TRIGGER 4
 #define IS_TEMPORAL 8
 #define IS_PERMANENT 16
+#define IS_HASHED 32      /* Only in the flags of the AND nodes: the memory of that side is a HashMem */
+#define IS_BPTREE 64      /* Only in the flags of the AND nodes: the memory of that side is a BPTree */
 
 #define TIMED_MASK 3
 #define STORE_MASK 28
 
+#define CLASS_WORD_BITS (8 * sizeof(ULong))
+
 struct Attr
 {
   UChar type;
@@ -72,6 +76,7 @@ class ObjClass
 {
 private:
   char _name[MAXNAME];
+  const char *_interned_name;                                /* _name interned, to check the class name of the objects */
   int _num_of_attrs;
   int _num_of_attrs_inherited;
   Attr _attr[MAXATTRS];
@@ -85,22 +90,75 @@ private:
   int _is_abstract;
   ULong _temp_flags;
   int _is_a_restriction;
+  int _partition_attr;
+  int _id;                                                   /* Index in _classes, stamped in the objects */
+  ULong _ancestors[MAXCLASSES / CLASS_WORD_BITS];            /* Bits of the ids of this class and its superclasses */
+
+  static ObjClass *_classes[MAXCLASSES];
+  static int _n_classes;
+
+  static ObjClass *stamp_class(ObjectType *obj);
 
 public:
   ObjClass(char *name, int abstract, ULong temp_flags);
   ~ObjClass();
   void set_last_node_from_pattern();
   static ObjClass **get_class(char *classname);
+
+  /**
+   * @brief The class with this id
+   *
+   * @param class_id Id of the class
+   * @return ObjClass* NULL if there is no class with that id
+   */
+  static ObjClass *by_id(int class_id)
+  {
+    return (class_id >= 0 && class_id < _n_classes) ? _classes[class_id] : NULL;
+  };
+
+  /**
+   * @brief The class of an object. The id is taken from the class name the first time and stamped in the object.
+   *        The stamp is only trusted while it agrees with the class name, it may be stale after the package
+   *        is reloaded, the class name is changed or the object is built by the caller
+   *
+   * @param obj The object
+   * @return ObjClass* NULL if the class of the object is unknown
+   */
+  static ObjClass *class_of(ObjectType *obj)
+  {
+    ObjClass *the_class = by_id(obj->class_id);
+
+    return (the_class != NULL && the_class->is_named(obj->attr[0].str.str_p)) ? the_class : stamp_class(obj);
+  };
+
+  /**
+   * @brief If a name is the one of the class. The interned names are checked by pointer
+   *
+   * @param name The name
+   * @return int TRUE if it is
+   */
+  int is_named(const char *name)
+  {
+    return name == _interned_name || (name != NULL && strncmp(name, _name, MAXNAME) == 0);
+  };
+
+  int id() { return _id; };
+  static int n_classes() { return _n_classes; };
   void inherit_class(ObjClass *supercl_p);
   void new_attr(char *name, int type);
   void set_restricted() { _is_a_restriction = TRUE; };
+  void set_partition(char *name);
+  int partition_attr() { return _partition_attr; };
 
   static Node *get_real_root();
 
   int is_a_restriction() { return _is_a_restriction; };
   int is_abstract() { return _is_abstract; };
   int is_a_normal_class();
-  int is_subclass(ObjClass *cl2);
+  int is_subclass(ObjClass *cl2)
+  {
+    return (_ancestors[cl2->_id / CLASS_WORD_BITS] >> (cl2->_id % CLASS_WORD_BITS)) & 1;
+  };
   ULong temp_flags() { return _temp_flags; };
   int attr_index(char *name);
   int attr_type(int index) { return _attr[index].type; };
@@ -133,6 +191,7 @@ PUBLIC void join_class(char *name);
 PUBLIC void restrict_class(char *name);
 PUBLIC void is_a_base_class();
 PUBLIC void def_attr(char *name, int type);
+PUBLIC void partition_class(char *name);
 PUBLIC void end_def_class(void);
 PUBLIC int num_of_attrs(void);
 PUBLIC void print_net();
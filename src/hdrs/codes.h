@@ -85,6 +85,9 @@
 #define MINS 0x50C
 #define MAXS 0x510
 #define CONCS 0x514
+#define PCTS 0x518     /* Percentile, the median is the 50 */
+#define RNKS 0x51C
+#define DSTS 0x520
 
 #define OBJMOD 0x1000
 #define OBJDEL 0x1001
@@ -109,11 +112,12 @@
 #define AND_NODE_FLAGS_POS 3
 #define AND_NODE_NKEYS_POS 4
 #define AND_NODE_MEM_START_POS 5
+#define AND_NODE_RANGE_POS 7       /* Comparison of the range key, the last one (left OP right), or 0 */
 
 #define WAND_NODE_WTIME_POS 5
 #define WAND_NODE_MEM_START_POS 6
 
-#define LEN_AND_NODE 7
+#define LEN_AND_NODE 8
 #define LEN_WAND_NODE 8
 
 #define SET_NODE_MEM_POS 1
@@ -37,10 +37,31 @@ class Compound;
 
 #include "engine.h"
 #include "metaobj.hpp"
+#include "slab.hpp"
 
 #ifndef COMPOUN_HH_INCLUDED
 #define COMPOUN_HH_INCLUDED
 
+// Capacities of the flat tuples, from 4 to 32 objects. The Compounds of longer rules have no tuple
+#define TUPLE_MIN_ITEMS 4
+#define TUPLE_MAX_ITEMS 32
+#define TUPLE_SLABS 4
+
+/**
+ * @brief Flat tuple of a Compound with where the object of each position is stored (the _left or _right of
+ *    the compound that holds it), so it follows the changes of the objects (see set_state). The Compounds
+ *    joined by right to another one share its tuple when the positions after its prefix are free, so a chain
+ *    of joins fills a single array
+ *
+ */
+struct Tuple
+{
+  int _links;                       /* Compounds that share it */
+  int _used;                        /* Positions taken by them, the following ones are free */
+  int _slab;                        /* Slab of its capacity */
+  MetaObj **_item[TUPLE_MIN_ITEMS]; /* Followed by the rest of the capacity */
+};
+
 class Compound : public MetaObj
 {
 private:
@@ -48,22 +69,40 @@ private:
   int _n_right;
   MetaObj *_left;
   MetaObj *_right;
+  Tuple *_tuple;                    /* Flat tuple of the objects or NULL */
+  int _tuple_ext;                   /* If this compound took the positions of its right in the tuple of its left */
+
+  static Slab _tuple_slabs[TUPLE_SLABS];
+
+  void build_tuple();
+  void release_tuple();
+  MetaObj **tree_dir(const int n);
+  MetaObj **tuple_dir(const int n) { return (_tuple != NULL) ? _tuple->_item[n] : tree_dir(n); };
+  static void fill_tuple(MetaObj ***items, MetaObj **dir, int n);
 
 public:
+  static int _flat_tuples;          /* If the new Compounds take a flat tuple (see set_flat_tuples) */
+
   // Creation, composition and expand
   Compound(MetaObj *left_comp, MetaObj *right_comp, long t1 = 0L, long t2 = 0L);
   Compound(MetaObj *left_comp);
   Compound(Compound &otro);
+  ~Compound() { release_tuple(); };
+
+  // Allocation in the Slab of the class
+  static Slab _slab;
+  static void *operator new(size_t) { return _slab.alloc(); };
+  static void operator delete(void *item) { _slab.release(item); };
 
   inline void expand(MetaObj **left, MetaObj **right);
   MetaObj *&left() { return _left; };
-  void set_left(MetaObj *left_comp) { _left = left_comp; };
+  void set_left(MetaObj *left_comp) { _left = left_comp; release_tuple(); };
   void set_right(MetaObj *right_comp) { _right = right_comp; };
   MetaObj *&right() { return _right; };
   MetaObj *join_by_right_untimed(MetaObj *right_comp);
 
   // Compare and implementation of virtual functions
-  int compare(const MetaObj *obj2, va_list list) const;
+  int compare(const MetaObj *obj2) const;
   int compare_objs(const MetaObj *obj2, int pos_offset, va_list list) const;
 
   static int compare_with_left(const MetaObj *obj1,
@@ -71,6 +110,23 @@ public:
   static int compare_left_with_left(const MetaObj *obj1,
                                     const MetaObj *obj2, va_list list);
 
+  // Comparator of compare_with_left for the BTreeT (see btreet.hpp)
+  struct CompareWithLeft
+  {
+    int operator()(const void *obj1, const void *obj2) const
+    {
+      return ((const MetaObj *)obj2)->compound()->_left->compare((const MetaObj *)obj1);
+    };
+  };
+  // Comparator of compare_left_with_left
+  struct CompareLeftWithLeft
+  {
+    int operator()(const void *obj1, const void *obj2) const
+    {
+      return ((const MetaObj *)obj2)->compound()->_left->compare(((const MetaObj *)obj1)->compound()->_left);
+    };
+  };
+
   MetaObj *operator[](const int n);
   MetaObj **meta_dir(MetaObj **dir, const int n, const int n_objs);
   int n_objs() const;
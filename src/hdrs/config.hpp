@@ -38,6 +38,21 @@
 #define MAXARGS 256
 #define MAXSTR 4096 /* Biggest text */
 #define MAXPATTERNS 100
+#define MAXCLASSES 1024 /* Classes of a package. Their ids index the table of classes */
 #define MAXVARS 100
+#define MAXSUBMIT 4096 /* Events queued by engine_submit in each engine */
+#define MAXCBEVENTS 4096 /* Default size of the ring of asynchronous callbacks */
+#define MAXPARTHREADS 64 /* Threads of the parallel propagation */
+#define MAXLOADTHREADS 16 /* Threads reading the files of load_rsets */
+#define MAXSLABS 16 /* Kinds of structs with their own allocator */
+#define SLABITEMS 256 /* Items of each block taken from malloc by the allocators */
+#define SLABBATCH 64 /* Items moved at once between the cache of a thread and the allocator */
+
+/* Storage for the per thread execution state. initial-exec keeps the access as cheap as a static */
+#if defined(__GNUC__)
+#define ENGINE_TLS __thread __attribute__((tls_model("initial-exec")))
+#else
+#define ENGINE_TLS thread_local
+#endif
 
 #endif
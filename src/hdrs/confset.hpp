@@ -30,6 +30,7 @@
 #endif
 
 #include "metaobj.hpp"
+#include "compound.hpp"
 #include "nodes.hpp"
 
 #ifndef CONFSET_HH_INCLUDED
@@ -48,11 +49,32 @@ private:
 public:
   ConflictSet(int tag, Node *prod_node, Compound *prod_compound);
 
+  // Allocation in the Slab of the class
+  static Slab _slab;
+  static void *operator new(size_t) { return _slab.alloc(); };
+  static void operator delete(void *item) { _slab.release(item); };
+
   void insert(int cat);
   void remove(int cat);
+  static void move_list(ConflictSet *list, int cat, BTree &list_mem);
   static int compare_cset(const ConflictSet *item1,
                           const ConflictSet *item2,
                           va_list list);
+
+  // Comparator of compare_cset for the BTreeT (see btreet.hpp)
+  struct CompareCSet
+  {
+    int operator()(const void *item1, const void *item2) const
+    {
+      const ConflictSet *cset1 = (const ConflictSet *)item1;
+      const ConflictSet *cset2 = (const ConflictSet *)item2;
+      int res;
+
+      if ((res = (char *)cset1->_prod_node - (char *)cset2->_prod_node) == 0)
+        res = cset2->_prod_compound->left()->compare(cset1->_prod_compound->left());
+      return res;
+    };
+  };
   Compound *prod_compound() { return _prod_compound; };
   int tag() { return _tag; };
   static ConflictSet *best_cset(int *categoria);
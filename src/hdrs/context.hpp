@@ -0,0 +1,171 @@
+/**
+ * @file context.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the Engine class, the execution context of an engine instance.
+ *        Every instance owns its node memories, conflict set and pending actions, while
+ *        the compiled package (nodes, classes, rules) is shared by all the instances
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include "engine.h"
+#include "config.hpp"
+#include "btree.hpp"
+#include "hashmem.hpp"
+#include "bptree.hpp"
+#include "ring.hpp"
+#include "cbring.hpp"
+#include "snapshot.hpp"
+
+#ifndef CONTEXT_HH_INCLUDED
+#define CONTEXT_HH_INCLUDED
+
+struct Action;
+struct SetLog;
+struct SetExpiry;
+struct TimerDue;
+class ConflictSet;
+
+struct Engine
+{
+    Action *_action_list;            /* Pending actions                          */
+    Action *_last;                   /* Last action pushed                       */
+    Action **_action_tail;           /* Where to push the next action            */
+
+    ConflictSet *_conflict_set[3];   /* LIFO queues of the Conflict Set by priority */
+    BTree _conflict_set_mem[3];      /* Memories for the Conflict Set            */
+
+    int _in_the_loop;                /* Lock against reentrant propagations      */
+    int _n_inf;                      /* Number of inferences made                */
+
+    EventRing *_ring;                /* Events submitted from other threads      */
+    CallBackRing *_cb_ring;          /* Events for the callbacks in asynchronous mode */
+    SnapshotQueue *_snaps;           /* Snapshots requested by other threads     */
+
+    BTree **_mem;                    /* Node memories indexed by slot            */
+    HashMem **_hash_mem;             /* Hash memories of the AND nodes, by slot  */
+    BPTree **_bp_mem;                /* B+tree memories of the AND nodes, by slot */
+    ULong _n_mem;                    /* Size of the _mem, _hash_mem and _bp_mem tables */
+    int *_marks;                     /* Marks of the nodes reached in a modification */
+    ULong _n_marks;                  /* Size of the _marks table                 */
+    SetLog *_set_log;                /* Modifications logged for the aggregates of the sets */
+    int _expiring;                   /* Propagating the items out of their time windows */
+    SetExpiry *_set_expiry;          /* Sets with items expired, see Node::set_expiry */
+    BTree _timers;                   /* TIMER nodes ordered by the time their oldest item expires */
+    TimerDue **_timer_due;           /* Entry of each TIMER node in _timers, by the slot of its memory */
+
+    Engine *_next_engine;
+    int _is_view;                    /* Worker of the parallel propagation, see view_of */
+
+    static ENGINE_TLS Engine *_current; /* Engine of the calling thread          */
+    static ENGINE_TLS ObjectType *_old_obj_modify; /* Copy made by engine_modify in the calling thread */
+    static Engine _default;          /* Engine used by the classic API           */
+    static Engine *_engines;         /* All the engines created                  */
+    static ULong _n_mem_slots;       /* Memory slots assigned to the nodes       */
+    static ULong _n_mark_slots;      /* Mark slots assigned to the nodes         */
+
+    Engine();
+    Engine(Engine *engine);
+    ~Engine();
+
+    void grow_mem_tables(ULong slot);
+    BTree *grow_mem(ULong slot);
+    HashMem *grow_hash_mem(ULong slot);
+    BPTree *grow_bp_mem(ULong slot);
+    int &grow_marks(ULong slot);
+    void reset();
+    void view_of(Engine *engine);
+
+    /**
+     * @brief Memory of a node in this engine. The node code keeps the slot, not the memory
+     *
+     * @param slot Slot stored in the node code at load time
+     * @return BTree* The memory
+     */
+    BTree *mem(ULong slot)
+    {
+        return (slot < _n_mem && _mem[slot] != NULL) ? _mem[slot] : grow_mem(slot);
+    };
+
+    /**
+     * @brief Hash memory of a node in this engine, for the sides of the AND nodes flagged IS_HASHED
+     *
+     * @param slot Slot stored in the node code at load time
+     * @return HashMem* The memory
+     */
+    HashMem *hash_mem(ULong slot)
+    {
+        return (slot < _n_mem && _hash_mem[slot] != NULL) ? _hash_mem[slot] : grow_hash_mem(slot);
+    };
+
+    /**
+     * @brief B+tree memory of a node in this engine, for the sides of the AND nodes flagged IS_BPTREE
+     *
+     * @param slot Slot stored in the node code at load time
+     * @return BPTree* The memory
+     */
+    BPTree *bp_mem(ULong slot)
+    {
+        return (slot < _n_mem && _bp_mem[slot] != NULL) ? _bp_mem[slot] : grow_bp_mem(slot);
+    };
+
+    /**
+     * @brief Propagation mark of a node in this engine
+     *
+     * @param slot Slot of the node, assigned when it is created
+     * @return int& The mark
+     */
+    int &mark(ULong slot)
+    {
+        return (slot < _n_marks) ? _marks[slot] : grow_marks(slot);
+    };
+
+    /**
+     * @brief Entry of a TIMER node in the schedule of this engine (see Node::timer_schedule)
+     *
+     * @param slot Slot of the memory of the node
+     * @return TimerDue*& The entry, NULL if the node is not scheduled
+     */
+    TimerDue *&timer_due(ULong slot)
+    {
+        if (slot >= _n_mem)
+            grow_mem_tables(slot);
+        return _timer_due[slot];
+    };
+
+    static Engine *current() { return _current; };
+    static Engine *select(Engine *engine);
+    static BTree *node_mem(ULong slot) { return _current->mem(slot); };
+    static HashMem *node_hash_mem(ULong slot) { return _current->hash_mem(slot); };
+    static BPTree *node_bp_mem(ULong slot) { return _current->bp_mem(slot); };
+    static int &node_mark(ULong slot) { return _current->mark(slot); };
+    static ULong new_mem();
+    static ULong new_mark();
+    static void free_mem(ULong slot);
+    static void for_each_other(void (*func)(void *), void *arg);
+};
+
+#endif
@@ -41,7 +41,6 @@
 #define RIGHT_MEM 1
 #define LEFT_MEM 0
 
-extern PUBLIC int n_inf;              /* number of inferences made */
 extern PUBLIC int trace;              /* tracing flag              */
 extern PUBLIC FILE *trace_file;       /* traces file               */
 
@@ -50,10 +49,10 @@ PUBLIC void do_loop(Action *&list, int first_loop);
 
 // Other auxiliary functions
 
-PUBLIC ObjectType *get_obj_of_set(BTState *tree_state);
+PUBLIC ObjectType *get_obj_of_set(void *tree_state);
 PUBLIC void eng_destroy_set(BTState *tree_state);
-PUBLIC int n_obj_of_set(BTState *tree_state);
-PUBLIC void end_obj_of_set(BTState *tree_state);
+PUBLIC int n_obj_of_set(void *tree_state);
+PUBLIC void end_obj_of_set(void *tree_state);
 
 PUBLIC void objcpy(ObjectType *dest, ObjectType *ori, int n_attrs);
 PUBLIC void check_trace_file_size();
@@ -46,6 +46,8 @@
 #include "btree.hpp" 
 #include "error.hpp" 
 #include "callbacks.hpp" 
+#include "context.hpp"
+#include "shards.hpp"
 
 #define MAX_NVECT 15000   // Maximo numero de objetos en trazas
 
@@ -60,8 +62,6 @@ struct vector_key{
 typedef void (*RemoveFunc)(void *&);
 
 
-PRIVATE ObjectType *old_obj_modify  = NULL;  /* Para guardar el obj ante mod externa */
-
 PRIVATE char trace_file_name[256]="stdout";  /* Salida de trazas nombre fichero */
 PRIVATE unsigned long trace_file_size = TRACE_FILE_SIZE;  /* trazas tamagno maximo */
 PRIVATE int trace_file_size_control = FALSE; /* Control del tamanio del f trazas*/
@@ -41,6 +41,7 @@
 /* Constants to control the protection over string values */
 #define PROTECTED 2
 #define DYNAMIC 1
+#define INTERNED 4      /* Returned by engine_intern. Never freed, equal strings are the same pointer */
 
 /* Boolean contants */
 
@@ -49,6 +50,10 @@
 
 #define NULL_STR_VALUE 0
 
+/* Class id of the objects created by new_object, taken from the class name when they are propagated */
+
+#define CLASS_UNKNOWN -1
+
 /* Constants for engine_loop */
 
 #define INSERT_TAG 0x1
@@ -87,6 +92,12 @@
 #define WHEN_EVENTS (WHEN_INSERTED | WHEN_MODIFIED | WHEN_RETRACTED)
 #define WHEN_ALL (WHEN_INSERTED | WHEN_MODIFIED | WHEN_RETRACTED | WHEN_NOT_USED)
 
+/* DELIVERY OF THE CALLBACKS (engine_async_callbacks) */
+#define CALLBACKS_SYNC 0
+#define CALLBACKS_BLOCK 1
+#define CALLBACKS_DROP_OLDEST 2
+#define CALLBACKS_GROW 3
+
 #define WITH_UTF8
 
 typedef unsigned long ULong;
@@ -116,6 +127,7 @@ typedef struct obj_data
 {
         long time;
         void *user_data;
+        int class_id;
         Value attr[1];
 } ObjectType;
 
@@ -124,6 +136,22 @@ typedef void (*ExternFunction)(Value *, int /*tag*/);
 /* Comunication to the user of changing in objects. The contexts can be free whenever */
 typedef void (*CallBackFunc)(int when_flag, ObjectType *obj, ObjectType **ctx, int n_objs);
 
+/* Engine instance. Each one has its own memories over the package loaded */
+typedef struct Engine rce_engine_t;
+
+/* Copy of the objects kept in the memories of an engine (engine_snapshot) */
+typedef struct Snapshot rce_snapshot_t;
+
+/* Occupancy of the allocator of a kind of internal struct (engine_slab_stats) */
+typedef struct
+{
+        const char *name;       /* Single, Compound, Set, MatchCount, ConflictSet, Action or AttrSet */
+        long size;              /* Bytes of each item */
+        long blocks;            /* Blocks taken from malloc */
+        long items;             /* Items in the blocks */
+        long in_use;            /* Items allocated */
+} rce_slab_stats_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -148,12 +176,18 @@ extern "C"
 
         /* Do the temporal refresh of the engine */
         PUBLIC void engine_refresh(long real_time);
+        PUBLIC long engine_next_expiry();
 
         /* To define callback functions to communicate events (event listeners) */
         /* The context arrays may be free whenever */
         PUBLIC void add_callback_func(int when_flags, CallBackFunc f);
         PUBLIC void del_callback_func(int when_flags, CallBackFunc f);
 
+        /* Asynchronous callbacks. The events are queued and delivered by other thread */
+        PUBLIC int engine_async_callbacks(int policy, int size);  /* 0 for the default size */
+        PUBLIC int engine_poll_events(int max_events, int wait); /* 0 for all the events queued */
+        PUBLIC long engine_dropped_events();
+
         /* To define external functions */
         PUBLIC void def_function(const char *name, ExternFunction f);
 
@@ -170,16 +204,78 @@ extern "C"
         PUBLIC void reset_pkg();
         PUBLIC int load_rset(char *path);
         PUBLIC int load_rset_str(char *text);
+        PUBLIC int load_rsets(char **paths, int n_paths);
         PUBLIC void free_rset(char *name);
         PUBLIC void reset_rset(char *name);
 
         /* Management of objects (creation and propagation) */
         PUBLIC ObjectType *new_object(int n_attrs, long time);
+        PUBLIC ObjectType *new_object_of_class(int class_id, long time);
         PUBLIC void engine_modify(ObjectType *obj);
         PUBLIC void engine_loop(int tag, ObjectType *obj);
+        PUBLIC int engine_loop_batch(int tag, ObjectType **objs, int n);          /* INSERT_TAG or RETRACT_TAG */
+        PUBLIC int engine_loop_batch_mixed(int *tags, ObjectType **objs, int n);
+
+        /* Queue of events in front of engine_loop. Any thread can submit, only one drains */
+        PUBLIC int engine_submit(int tag, ObjectType *obj);  /* FALSE if the queue is full */
+        PUBLIC int engine_drain(int max_events);            /* 0 for all the events queued */
+
+        /* Engine instances. The functions above work over the engine selected in the calling thread */
+        PUBLIC rce_engine_t *rce_engine_new();
+        PUBLIC void rce_engine_free(rce_engine_t *engine);
+        PUBLIC rce_engine_t *rce_engine_select(rce_engine_t *engine); /* NULL selects the default engine */
+        PUBLIC rce_engine_t *rce_engine_current();
+        PUBLIC void rce_engine_modify(rce_engine_t *engine, ObjectType *obj);
+        PUBLIC void rce_engine_loop(rce_engine_t *engine, int tag, ObjectType *obj);
+        PUBLIC void rce_engine_refresh(rce_engine_t *engine, long real_time);
+        PUBLIC long rce_engine_next_expiry(rce_engine_t *engine);
+        PUBLIC int rce_engine_submit(rce_engine_t *engine, int tag, ObjectType *obj);
+        PUBLIC int rce_engine_drain(rce_engine_t *engine, int max_events);
+        PUBLIC int rce_engine_async_callbacks(rce_engine_t *engine, int policy, int size);
+        PUBLIC int rce_engine_poll_events(rce_engine_t *engine, int max_events, int wait);
+        PUBLIC long rce_engine_dropped_events(rce_engine_t *engine);
+        PUBLIC void rce_engine_reset(rce_engine_t *engine);
+        PUBLIC int rce_get_inf_cnt(rce_engine_t *engine);
+
+        /* Sharded mode. engine_loop routes the objects to the shards by the attribute declared with PARTITION BY */
+        PUBLIC int rce_shards_start(int n_shards);
+        PUBLIC void rce_shards_sync();
+        PUBLIC void rce_shards_stop();
+
+        /* Snapshots of the memories for other threads. Walked with get_obj_of_set, n_obj_of_set and end_obj_of_set */
+        PUBLIC rce_snapshot_t *engine_snapshot(char *ruleset, char *rule, char *class_name, int timeout); /* NULL for all, timeout in ms */
+        PUBLIC void engine_serve_snapshots();
+        PUBLIC rce_snapshot_t *rce_engine_snapshot(rce_engine_t *engine, char *ruleset, char *rule, char *class_name, int timeout);
+        PUBLIC void *snapshot_objs(rce_snapshot_t *snap);
+        PUBLIC void snapshot_free(rce_snapshot_t *snap);
+
+        /* Parallel propagation of the insertions into the independent subnets. 0 threads stops it */
+        PUBLIC int engine_parallel(int n_threads);
+
+        /* Hash memories in the AND nodes loaded from now on (TRUE by default) */
+        PUBLIC void set_hash_memories(int status);
+
+        /* B+tree memories in the AND nodes loaded from now on that are not hashed (TRUE by default) */
+        PUBLIC void set_bptree_memories(int status);
+
+        /* Range keys in the AND nodes loaded from now on that compare two numeric attributes (TRUE by default) */
+        PUBLIC void set_range_keys(int status);
+
+        /* SIMD rank of the numeric keys in the B+tree nodes (TRUE by default) */
+        PUBLIC void set_simd_rank(int status);
+
+        /* Flat tuples of the objects matched in the Compounds created from now on (TRUE by default) */
+        PUBLIC void set_flat_tuples(int status);
+
+        /* Interned strings, for the attributes flagged as INTERNED */
+        PUBLIC char *engine_intern(const char *str);
+
+        /* Occupancy of the allocators of the internal structs. Returns the number of stats filled */
+        PUBLIC int engine_slab_stats(rce_slab_stats_t *stats, int max_stats);
 
         /* Management of object classes, inheritance and attributes */
         PUBLIC void *get_class(char *name, int *n_attr);
+        PUBLIC int get_class_id(char *name);
         PUBLIC int class_is_subclass_of(char *name1, char *name2);
         PUBLIC char *attr_name(void *objclass, int n_attr);
         PUBLIC int attr_type(void *objclass, int n_attr);
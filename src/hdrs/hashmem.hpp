@@ -0,0 +1,86 @@
+/**
+ * @file hashmem.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the HashMem class. Memory of a side of an AND node whose keys are all equalities,
+ *        kept in a hash table of groups instead of the multilevel BTree (see hashmem.cpp)
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include "engine.h"
+#include "btree.hpp"
+
+#ifndef HASHMEM_HH_INCLUDED
+#define HASHMEM_HH_INCLUDED
+
+class KeyManager;
+
+struct HashGroup
+{
+    ULong _hash;              /* Hash of the keys of the items, cached */
+    BTree *_items;            /* Items with the same keys. NULL if free, HASH_DELETED if it was emptied */
+};
+
+#define HASH_DELETED ((BTree *)1)
+
+class HashMem
+{
+private:
+    HashGroup *_groups;       /* Open addressing, linear probing */
+    ULong _size;              /* Power of two */
+    ULong _n_used;            /* Groups with items or emptied */
+    ULong _n_groups;          /* Groups with items */
+    int _n_items;
+
+    HashGroup *lookup(const void *item, ULong hash, KeyManager *keys) const;
+    void rehash(ULong size);
+
+public:
+    HashMem();
+    ~HashMem();
+
+    void **Insert(void *item, KeyManager *keys, BTCompareFunc func);
+    void *Delete(void *item, KeyManager *keys, BTCompareFunc func);
+    const void *Find(const void *item, KeyManager *keys, BTCompareFunc func) const;
+    BTState FindByKeys(const void *item, KeyManager *keys) const;
+    void Free(BTSimpleFunc func);
+
+    int numItems() const { return _n_items; };
+    ULong size() const { return _size; };
+
+    /**
+     * @brief The items of a group, to walk all the memory
+     *
+     * @param n Position in the table, from 0 to size() - 1
+     * @return BTree* NULL if there is no group at that position
+     */
+    BTree *group(ULong n) const
+    {
+        return (_groups[n]._items != HASH_DELETED) ? _groups[n]._items : NULL;
+    };
+};
+
+#endif
@@ -10,9 +10,10 @@
 
 #include "engine.h"
 #include "btree.hpp"
+#include "bptree.hpp"
 #include "eng.hpp"
 
-class KeyManager : public BTKeyManager
+class KeyManager final : public BTKeyManager
 {
     private:
         int _int_side;  // Node Memory Side where the tree is
@@ -28,5 +29,9 @@ class KeyManager : public BTKeyManager
     static const Value * getObjInfo(MetaObj *obj, ULong data, ULong side);
     bool keysModified(int objpos, ObjectType *obj, ObjectType *old_obj);
     int compareKey(const void *target, const void *internal, int numkey);
+    ULong hashKeys(const void *target);
+    int keyType(int numkey) { return (_keys[numkey]>>30) & 0x3; };
+    void keyValue(const void *target, int numkey, BPKey &key);
+    bool keyInSet(const void *target, int numkey);
 };
 
@@ -94,8 +94,27 @@ typedef struct arg_str
 //    with the name of teh function in data.fun_exp.name, or a primitive call
 //    (with its particular op code). The arguments will go in data.fun_exp.args
 
+typedef struct
+{
+  int token;
+  int line;           /* Line where the token ends */
+  int colon;          /* IDENT followed by ':', a PATT_VAR inside a rule */
+  StackType lval;
+} LexToken;
+
+typedef struct
+{
+  LexToken *tokens;
+  int n_tokens;
+  int size;
+  int n_read;         /* Tokens passed to the parser, that owns their strings */
+} TokenList;
+
 PUBLIC int read_pkg(char *text);
 PUBLIC int read_rset(char *text);
+PUBLIC void lex_text(char *text, TokenList *list);
+PUBLIC int read_rset_tokens(TokenList *list);
+PUBLIC void free_tokens(TokenList *list);
 PUBLIC int get_curr_line(void);
 
 int eng_lex();
@@ -54,8 +54,19 @@ typedef struct {
 } TokenText_Type;
  
 
-static char *input;
+#define LEX_ERROR 1001    /* The message is in the value of the token */
+
+typedef struct {
+  char *input;
+  char c;             /* Next character, already read */
+  int line_num;
+  int colon;          /* The last identifier was followed by ':' */
+  StackType lval;
+} LexState;
+
+static LexState lex_state = { NULL, 0, 1, FALSE, { NULL } };
 static int line_num = 1;
+static TokenList *replay = NULL;    /* Tokens read in advance, NULL to read from lex_state */
  
 static TokenText_Type TokenText[] = {
         { _PACKAGE,             "package"       },
@@ -70,6 +81,8 @@ static TokenText_Type TokenText[] = {
         { UNTIMED,              "untimed"       },
         { FUNCTION,             "function"      },
         { WINDOW,               "window"        },
+        { PARTITION,            "partition"     },
+        { BY,                   "by"            },
         { PROCEDURE,            "procedure"     },
         { IS_A,                 "is_a"          },
         { RESTRICTS,            "restricts"     },
@@ -89,6 +102,10 @@ static TokenText_Type TokenText[] = {
         { MIN_SET,              "min"           },
         { MAX_SET,              "max"           },
         { CONCAT_SET,           "concat"        },
+        { MEDIAN_SET,           "median"        },
+        { PERCENTILE_SET,       "percentile"    },
+        { RANK_SET,             "rank"          },
+        { DISTINCT_SET,         "distinct_count" },
         { TIME_FUN,             "time"          },
         { CREATE,               "create"        },
         { MODIFY,               "modify"        },
@@ -106,12 +123,15 @@ static TokenText_Type TokenText[] = {
 
 
 
-PRIVATE void first_printable(char &c);
-PRIVATE int read_ident(char &c);
-PRIVATE int read_number(char &c);
-PRIVATE int read_char(char &c);
-PRIVATE int read_str(char &c);
-PRIVATE int read_special(char &c);
+PRIVATE int next_token(LexState &st);
+PRIVATE int lex_error(LexState &st, const char *msg);
+PRIVATE int replay_token();
+PRIVATE void first_printable(LexState &st);
+PRIVATE int read_ident(LexState &st);
+PRIVATE int read_number(LexState &st);
+PRIVATE int read_char(LexState &st);
+PRIVATE int read_str(LexState &st);
+PRIVATE int read_special(LexState &st);
 
 
 #endif
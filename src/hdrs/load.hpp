@@ -43,6 +43,7 @@ extern FILE *trace_file;
 // (Included in engine.h)
 PUBLIC void load_code(ULong *pcode, int len_code, Node *node);
 PUBLIC void reset_code(ULong *pcode, int len_code, int free_code);
+PUBLIC void load_and_mem(ULong *pcode);
 
 #endif
 
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <pthread.h>
  
 #include "engine.h"
 
@@ -58,8 +59,31 @@
 
 
 
+typedef struct
+{
+  char *path;
+  TokenList tokens;
+  const char *call;         /* The call that failed reading the file, NULL if it was read */
+  int err;
+  int ready;
+} RsetFile;
+
+typedef struct
+{
+  RsetFile *files;
+  int n_files;
+  int next;                 /* Next file to be read */
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+} RsetLoad;
+
+PRIVATE void net_changed();
 PRIVATE void del_and_node_mem_item(void* item, va_list);
+PRIVATE void read_rset_file(RsetFile *file);
+PRIVATE void *read_rset_files(void *load);
 PRIVATE void del_asym_node_lmem_item(void* count, va_list);
 PRIVATE void del_set_node_mem_item(void* item, va_list list);
 PRIVATE void del_prod_node_mem_item(void* item, va_list list);
+PRIVATE void reset_pkg_of_engine(void *);
+PRIVATE void reset_rset_of_engine(void *name);
 
@@ -59,6 +59,11 @@ class MetaObj // Abstract class
     int  _links;
 
   public:
+    static int _atomic_links;   /* The links are shared by several threads (see parallel.cpp) */
+
+    // Virtual, so a delete through any type releases the object into the Slab of its class
+    virtual ~MetaObj() {};
+
     // Derived class casting
     ClassType class_type() const	{ return _type; };
     Set *set() const			{ return (Set *)this; };
@@ -80,7 +85,7 @@ class MetaObj // Abstract class
     virtual int n_objs() const = 0;
 
     // Comparison
-    virtual int compare(const MetaObj *obj2, va_list list) const = 0;
+    virtual int compare(const MetaObj *obj2) const = 0;
     virtual int compare_objs(const MetaObj *obj2, int pos_offset, va_list list) const = 0;
 
     // Object Life control
@@ -100,6 +105,35 @@ class MetaObj // Abstract class
     static int compare_t(const void *c_obj1, const void *c_obj2, va_list list); // Compare w/ time 
     static int compare_tw(const void *c_obj1, const void *c_obj2, va_list list); // Compare w/ time window
 
+    // Comparators of the BTreeT (see btreet.hpp), the orders of metacmp, compare_t and compare_tw without va_list
+    struct Compare
+    {
+      int operator()(const void *c_obj1, const void *c_obj2) const
+      {
+        return ((const MetaObj *)c_obj2)->compare((const MetaObj *)c_obj1);
+      };
+    };
+    struct CompareT
+    {
+      int operator()(const void *c_obj1, const void *c_obj2) const
+      {
+        int res;
+        // From higher to lower T
+        if ((res = ((const MetaObj *)c_obj2)->_t2 - ((const MetaObj *)c_obj1)->_t2) == 0)
+          res = ((const MetaObj *)c_obj2)->compare((const MetaObj *)c_obj1);
+        return res;
+      };
+    };
+    struct CompareTW
+    {
+      long t2_limit;
+      CompareTW(long limit) { t2_limit = limit; };
+      int operator()(const void *, const void *c_obj2) const
+      {
+        return ((const MetaObj *)c_obj2)->_t2 - t2_limit;
+      };
+    };
+
     // Control of the objects in modification
     virtual void set_state(ObjState ost, Status *st, int pos) = 0;
 
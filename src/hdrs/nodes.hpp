@@ -33,15 +33,18 @@
 
 
 #include <stdio.h>
+#include <limits.h>
 
 
 
 #include "engine.h"
 
+#include "config.hpp"
 #include "codes.h"
 #include "error.hpp"
 #include "expr.hpp"
 #include "metaobj.hpp"
+#include "slab.hpp"
 #include "status.hpp"
 #include "btree.hpp"
 #include "dasm_rete.hpp"
@@ -76,6 +79,7 @@
 #define NODE_REACHED -1
 
 class Node;
+struct ParFork;
 
 
 struct NodeLink
@@ -112,12 +116,94 @@ struct ExecData
     };
 };
 
+struct SetExpiry        // Set with items expired, propagated once for all of them (see Node::set_expiry)
+{
+    Node *node;
+    ULong *codep;
+    MetaObj *left;      // What arrived with the first item expired, to find the Set
+    Status *st;
+    int side;
+    int pos;
+    SetExpiry *next;
+
+    SetExpiry(Node *SetNode, ULong *Codep, ExecData &data);
+    ~SetExpiry();
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+};
+
+struct TimerDue         // Time when the oldest item of a TIMER node gets out of its window (see Node::timer_schedule)
+{
+    long due;           // Time of the oldest item plus the window
+    Node *node;
+    ULong *codep;
+
+    // Comparator of the schedule of the engine (Engine::_timers), by due time
+    struct Compare
+    {
+      int operator()(const void *item1, const void *item2) const
+      {
+        const TimerDue *due1 = (const TimerDue *)item1;
+        const TimerDue *due2 = (const TimerDue *)item2;
+
+        if (due1->due != due2->due)
+          return (due1->due < due2->due) ? -1 : 1;
+        if (due1->codep != due2->codep)
+          return (due1->codep < due2->codep) ? -1 : 1;
+        return 0;
+      };
+    };
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+};
+
 struct MatchCount
 {
     MetaObj *item;
     int count;
 
     MatchCount(MetaObj *it) { count=0; item=it; };
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+};
+
+struct ClassDispatch          /* Children of the root by the class id of their TCLASS, see Node::build_class_dispatch */
+{
+    int _n_classes;
+    int *_first;              /* The children for the class c are _child[_first[c]] .. _child[_first[c+1] - 1] */
+    Node **_child;            /* The unknown classes (CLASS_UNKNOWN) are the class _n_classes */
+    int *_side;               /* Side where each child is entered */
+    int *_skip;               /* Code already tested by the dispatch (the TCLASS) */
+    ULong _version;           /* Node::_n_changes when it was built */
+};
+
+struct AlphaEntry             /* Constant tested by a child, see Node::build_alpha_index */
+{
+    ULong _key;               /* The integer or the string */
+    int _child;               /* Index of the child in AlphaIndex::_child */
+};
+
+struct AlphaIndex             /* Children of an INTRA node that test an attribute against different constants */
+{
+    int _type;                /* TYPE_NUM or TYPE_STR */
+    ULong _operand;           /* Operand of the PUSHS of the attribute */
+    int _n_children;
+    Node **_child;            /* All the children, in the order of the node */
+    int *_side;
+    int _n_rest;
+    int *_rest;               /* Children not in the index, in order */
+    int _n_entries;
+    AlphaEntry *_entries;     /* Sorted by constant and child */
+    ULong _version;           /* Node::_n_changes when it was built */
 };
 
 struct ItemOut
@@ -139,23 +225,32 @@ class Node
      int 	_n_items_r;
      int 	_curr_pos;
      int	_mark;
+     ULong      _mark_slot;     /* Slot of the propagation mark in the Engine */
      int        _n_paths;
      Node       *_eq_node_left;
      Node       *_eq_node_right;
      Node 	*_parent_left;
      Node 	*_parent_right;
      NodeLink 	*_fork;
+     ParFork    *_par_fork;     /* Groups of children propagated in parallel, see parallel.cpp */
+     ULong      _par_stamp;     /* Marks of the walk that builds the groups */
+     int        _par_group;
+     ClassDispatch *_dispatch;  /* Only in the root */
+     AlphaIndex *_alpha;        /* Only in INTRA nodes with several children testing constants */
+     ULong      _alpha_stamp;   /* Marks of the walk that builds the indexes */
 
-     static Value data_stack[DATA_STACK_SIZE]; /* Stack de datos              */
-     static Value *dstack_p;                   /* Puntero al stack de datos   */
-     static BTree conflict_set_mem[3];          /* Memorias para los CSET      */
-     static int cmp_result;                    /* Para relaciones de orden en conj */
-     static int checkingScope;                 /* Flag de exploracion en modificaciones */
-     static ULong *code_p;                     /* posicion de ejecucion       */
+     // Execution state of the calling thread. The memories are in the Engine (see context.hpp)
+     static ENGINE_TLS Value data_stack[DATA_STACK_SIZE]; /* Stack de datos              */
+     static ENGINE_TLS Value *dstack_p;                   /* Puntero al stack de datos   */
+     static ENGINE_TLS int cmp_result;                    /* Para relaciones de orden en conj */
+     static ENGINE_TLS int checkingScope;                 /* Flag de exploracion en modificaciones */
+     static ENGINE_TLS ULong *code_p;                     /* posicion de ejecucion       */
 
 
    public :
 
+     static ULong _n_changes;   /* Changes in the connections of the net, see parallel.cpp */
+
      typedef int (*IntFunction)(Node *node, ExecData &data);
 
      Node(int type, int lcode, ULong *codes);
@@ -178,6 +273,19 @@ class Node
      Node * 	current_child(int &fork_side_conn, NodeIter &iter);
      Node * 	next_child(int &fork_side_conn, NodeIter &iter);
      Node *     last_child();
+     ParFork *& par_fork()                      { return _par_fork; };
+     ULong &    par_stamp()                     { return _par_stamp; };
+     int &      par_group()                     { return _par_group; };
+     int        par_safe();
+     void       build_class_dispatch();
+     void       free_class_dispatch();
+     void       build_alpha_indexes(ULong stamp);
+     void       build_alpha_index();
+     void       free_alpha_index();
+     int        alpha_test(int &type, ULong &operand, ULong &key);
+     static int alpha_cmp(int type, ULong key1, ULong key2);
+     int        class_checked()                 { return (_lcode >= 2 && _code[0] == (ULong)&Node::test_class_call) ? 
+                                                         (int)_code[1] : CLASS_UNKNOWN; };
      void 	connect_node(Node *parent, int side);
      void 	disconnect_node(Node *parent, int side);
      void 	update_n_items(int side);
@@ -188,7 +296,7 @@ class Node
      ULong      get_code(int pos)		{ return _code[pos]; }
      void 	add_code(int code_len, ULong *code, int check_set_node = FALSE);
      void       add_code(Node *source, int check_set_node = FALSE);
-     ULong *    getInterKeysInCode(ULong *code, int code_len, int *nkey);
+     ULong *    getInterKeysInCode(ULong *code, int code_len, int *nkey, ULong *range);
      void       insert_code(int pos, int code_len);
      int 	eq_code(Node const * const node);
      ULong & 	code(int n)			{ return _code[n]; };
@@ -221,7 +329,7 @@ class Node
      Node * 	find_node_in_path(int type, int init = TRUE);
      Node * 	insert_intra_node(Node **last_intra, Node *real_root,
                                   int code_len, ULong *list_codes);
-     void       insert_class_check(Node **last_intra, char *class_name, 
+     void       insert_class_check(Node **last_intra, int class_id, 
                                    int own_check);
      static void new_inter_assoc(int time);
      Node * 	add_to_inter_assoc(Node *last_intra_set, StValues st_this, ULong flags_this);
@@ -245,6 +353,11 @@ class Node
      void	propagate_modify(ExecData &data, ULong *codep = NULL);
      int 	propagate(ExecData &data, ULong *codep = NULL);
      void	propagate_reached_nodes(ExecData &data, ULong *codep=NULL);
+     int        class_dispatch()                { return _dispatch != NULL && _dispatch->_version == _n_changes; };
+     int        propagate_by_class(ExecData &data);
+     void       propagate_reached_by_class(ExecData &data, int mark);
+     int        alpha_index()                   { return _alpha != NULL && _alpha->_version == _n_changes; };
+     int        propagate_by_alpha(ExecData &data);
 
      static void 	setChecking(int value);
      int 	execute_code(ExecData &data, ULong *codep);
@@ -300,6 +413,15 @@ class Node
      static int 	maxsa_call(Node *node, ExecData &data);
      static int 	count_call(Node *node, ExecData &data);
      static int 	concat_call(Node *node, ExecData &data);
+     static int 	pctsn_call(Node *node, ExecData &data);
+     static int 	pctsf_call(Node *node, ExecData &data);
+     static int 	pctsa_call(Node *node, ExecData &data);
+     static int 	rnksn_call(Node *node, ExecData &data);
+     static int 	rnksf_call(Node *node, ExecData &data);
+     static int 	rnksa_call(Node *node, ExecData &data);
+     static int 	dstsn_call(Node *node, ExecData &data);
+     static int 	dstsf_call(Node *node, ExecData &data);
+     static int 	dstsa_call(Node *node, ExecData &data);
      static int 	pusha_call(Node *node, ExecData &data);
      static int 	push_call(Node *node, ExecData &data);
      static int 	pushs_call(Node *node, ExecData &data);
@@ -342,8 +464,13 @@ class Node
      void 	set_call_INSERT(ExecData &data, MetaObj **LeftItemInMem_p=NULL);
      void 	set_call_RETRACT(ExecData &data, MetaObj *LeftItemInMem=NULL);
      void 	set_call_MODIFY(ExecData &data);
+     void 	set_call_EXPIRY(ExecData &data);
+     static void 	set_expiry();
      static int 	timer_call(Node *node, ExecData &data);
-     int 	timer_refresh(ULong *codep, long time_mark, bool extern_refresh);
+     int 	timer_refresh(ULong *codep, long time_mark);
+     void 	timer_schedule(ULong *codep, long refreshed = LONG_MIN);
+     static void 	timer_refresh_due(long real_time);
+     static long 	timer_next_due();
      static int 	prod_call(Node *node, ExecData &data);
      static int 	run_cs();
      void 	perform_execution(int tag, Compound *ProdCompound);
@@ -361,6 +488,20 @@ class Node
      static int 	cmp_count_with_object_t(const void *c_obj1, const void *c_obj2, va_list list);
      static int 	cmp_count_with_object_tw(const void *c_obj1, const void *c_obj2, va_list list);
 
+     // Comparators of the MatchCounts with a MetaObj for the BTreeT (see btreet.hpp), Compare is the one of the items
+     template <class Compare>
+     struct CountCompare
+     {
+        Compare cmp;
+
+        CountCompare() {};
+        CountCompare(const Compare &c) : cmp(c) {};
+        int operator()(const void *c_obj1, const void *c_obj2) const
+        {
+           return cmp(c_obj1, ((const MatchCount *)c_obj2)->item);
+        };
+     };
+
      static void    free_rule(void *node, va_list);
      void	free_nodes_up(int en_intra);
      void	free_from_last_intra();
@@ -0,0 +1,121 @@
+/**
+ * @file parallel.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the Parallel class. The insertion of an object is propagated concurrently
+ *        into the independent subnets that hang from a node (the groups of its children that share no node)
+ *        by a pool of threads
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include <pthread.h>
+
+#include "engine.h"
+#include "config.hpp"
+#include "nodes.hpp"
+#include "context.hpp"
+#include "load.hpp"
+
+#ifndef PARALLE_HH_INCLUDED
+#define PARALLE_HH_INCLUDED
+
+struct Action;
+class ConflictSet;
+
+struct ParFork
+{
+    int _n_children;
+    Node **_child;            /* Children in the order of the node */
+    int *_side;               /* Side where each child is entered */
+    int _n_groups;
+    int *_first;              /* The children of the group g are _members[_first[g]] .. _members[_first[g+1] - 1] */
+    int *_members;            /* Indexes of the children ordered by group */
+};
+
+struct ParSegment             /* What the propagation of a child has left to be merged in the engine */
+{
+    Engine *_view;
+    Action *_actions;
+    ConflictSet *_cs[3];
+};
+
+struct ParRange               /* Groups assigned to a thread. The rest of threads can steal from it */
+{
+    int _next;
+    int _end;
+    char _pad[56];
+};
+
+class Parallel
+{
+private:
+    static pthread_t _threads[MAXPARTHREADS];
+    static Engine *_views[MAXPARTHREADS + 1];    /* The one of the calling thread is the first */
+    static int _n_threads;
+    static ULong _forks_version;                 /* Node::_n_changes when the groups were built */
+
+    static pthread_mutex_t _job_lock;            /* A propagation at once */
+    static pthread_mutex_t _lock;
+    static pthread_cond_t _work_cond;
+    static pthread_cond_t _idle_cond;
+    static int _job_open;
+    static ULong _generation;
+    static int _active;
+    static int _stop;
+
+    static Engine *_engine;                      /* The job */
+    static ExecData *_data;
+    static ParFork *_fork;
+    static ParSegment *_segs;
+    static int _n_segs;
+    static ParRange _ranges[MAXPARTHREADS + 1];
+    static int _n_parts;
+
+    static ENGINE_TLS int _in_worker;
+
+    static void *worker(void *part);
+    static void run(int part);
+    static int take(int part);
+    static void merge();
+    static ParFork *new_fork(Node *node, ULong stamp);
+
+public:
+    /**
+     * @brief The children of a fork are propagated in parallel if the pool is running, the groups are
+     *        up to date and it is not already a parallel propagation
+     *
+     * @return int TRUE if enabled
+     */
+    static int enabled() { return _n_threads > 0 && !_in_worker && trace == 0 && _forks_version == Node::_n_changes; };
+
+    static int start(int n_threads);
+    static void stop();
+    static void build_forks();
+    static void free_fork(ParFork *fork);
+    static int propagate(Node *node, ExecData &data);
+};
+
+#endif
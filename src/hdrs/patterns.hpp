@@ -80,7 +80,7 @@ class Pattern
     ULong setupFlags();
     static void initFlags(ULong value, int from_rule);
     void add_intra_node(int code_len, ULong *code);
-    void add_class_check(char *name);
+    void add_class_check(int class_id);
     static void new_inter_assoc(int time);
     void add_to_assoc();
     void add_to_assoc(AccessMode access);
@@ -0,0 +1,65 @@
+/**
+ * @file ring.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the EventRing class. A bounded lock-free queue of object events with many producers
+ *        (engine_submit) and one consumer (engine_drain) in front of engine_loop
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include "engine.h"
+
+#ifndef RING____HH_INCLUDED
+#define RING____HH_INCLUDED
+
+struct RingSlot
+{
+    ULong _seq;               /* Turn of the slot. Equal to the position when free, position+1 when filled */
+    int _tag;
+    ObjectType *_obj;
+    ObjectType *_old_obj;     /* Copy made by engine_modify, for MODIFY_TAG */
+};
+
+class EventRing
+{
+private:
+    RingSlot *_slots;
+    ULong _mask;              /* Number of slots - 1. The number of slots is a power of 2 */
+    char _pad0[64];
+    ULong _tail;              /* Next position to fill, shared by the producers */
+    char _pad1[64];
+    ULong _head;              /* Next position to take, only used by the consumer */
+
+public:
+    EventRing(ULong size);
+    ~EventRing();
+
+    int put(int tag, ObjectType *obj, ObjectType *old_obj);
+    int get(int &tag, ObjectType *&obj, ObjectType *&old_obj);
+    ULong size() { return _mask + 1; };
+};
+
+#endif
@@ -32,6 +32,7 @@
 #include <stdio.h>
 
 #include "engine.h"
+#include "btree.hpp"
 
 
 #ifndef RULES___HH_INCLUDED
@@ -63,6 +64,7 @@ PUBLIC void free_curr_ruleset();
 
 PUBLIC void reset_package();
 PUBLIC void reset_ruleset(char *name);
+PUBLIC void for_each_rule(char *ruleset, char *rule, BTSimpleConstFunc func, ...);
 
 PUBLIC void set_curr_rule_exec_flags(int flags);
 PUBLIC int curr_rule_exec_flags();
@@ -38,6 +38,7 @@ class Set;
 #include "error.hpp"
 
 #include "metaobj.hpp"
+#include "slab.hpp"
 #include "single.hpp"
 #include "btree.hpp"
 
@@ -45,6 +46,88 @@ class Set;
 #ifndef SET_____HH_INCLUDED
 #define SET_____HH_INCLUDED
 
+// Aggregates kept by a Set from the first time they are read (see Set::aggr)
+#define SET_AGGR_SUM_N   0
+#define SET_AGGR_SUM_F   1
+#define SET_AGGR_PROD_N  2
+#define SET_AGGR_PROD_F  3
+#define SET_AGGR_ORDER_N 4    /* Items ordered by the value, for the minimum and the maximum */
+#define SET_AGGR_ORDER_F 5
+#define SET_AGGR_ORDER_A 6    /* The items with a NULL string are not ordered */
+
+// Reads of a Set before keeping its aggregates
+#define SET_NOT_READ           0
+#define SET_READ               1
+#define SET_CHANGED_AFTER_READ 2
+
+// Operation of a Set over all its items expired (see Set::expire_elem)
+#define SET_EXPIRY_OP 4
+
+// Modifications remembered by an engine for the aggregates of its sets (see Set::sync)
+#define SET_LOG_SIZE 64
+
+/**
+ * @brief Value of an item when it was counted in an aggregate, to take it out later
+ *
+ */
+struct SetValue
+{
+    MetaObj *_item;
+    Value _value;
+
+    inline SetValue(MetaObj *item) { _item = item; };
+    inline SetValue(MetaObj *item, const Value &value) { _item = item; _value = value; };
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+};
+
+struct SetAggr
+{
+    SetAggr *_next;
+    int _kind;
+    int _attr;
+    long _num;                /* Integer sum, or product of the odd parts of the integer values */
+    double _flo;              /* Float sum, or product of the float values but the zeros */
+    int _zeros;               /* Values equal to 0 in the products */
+    int _twos;                /* Factors 2 of the integer product */
+    int _stale;               /* Float values taken out, the float sum or product is counted again when read */
+    BTree _values;            /* SetValues of the items counted, by item */
+    BTree _order;             /* The same SetValues ordered by (value, item) */
+    int _distinct;            /* Distinct values of the order tree, kept from the first time it is read (-1 before) */
+
+    inline SetAggr(int kind, int attr) : _values(), _order()
+    {
+        _next = NULL;
+        _kind = kind;
+        _attr = attr;
+        _num = (kind == SET_AGGR_PROD_N) ? 1 : 0;
+        _flo = (kind == SET_AGGR_PROD_F) ? 1 : 0;
+        _zeros = _twos = 0;
+        _stale = FALSE;
+        _distinct = -1;
+    };
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+};
+
+/**
+ * @brief The last objects modified in an engine. A modification is not propagated to the nodes whose tests
+ *        are not passed by the object, so the sets look here for the items that may have changed (see Set::sync)
+ *
+ */
+struct SetLog
+{
+    long _stamp;                      /* Twice the modifications, plus one while one is propagated */
+    ObjectType *_objs[SET_LOG_SIZE];  /* Objects of the last modifications */
+
+    inline SetLog() { _stamp = 0; };
+};
 
 class Set : public MetaObj
 {
@@ -53,20 +136,49 @@ class Set : public MetaObj
     int _last_op;
     int _state;
     MetaObj *_last_obj;
+    SetAggr *_aggr;           /* Aggregates kept */
+    int _reads;               /* SET_NOT_READ, SET_READ or SET_CHANGED_AFTER_READ, the aggregates are kept since then (see aggr) */
+    MetaObj *_pending;        /* Item whose object is in modification, held out of the aggregates (see sync) */
+    long _stamp;              /* Stamp of the SetLog at the last sync */
+    BTree _expired;           /* Items out of their time window, taken out all at once (see expire_elem) */
+
+    SetAggr *aggr(int kind, int n_attr, int keep = FALSE);
+    void free_aggr();
+    void sync();
+    void count_item(MetaObj *item);
+    void uncount_item(MetaObj *item);
+    void count_item(SetAggr *aggr, MetaObj *item, const Value &value);
+    void uncount_item(SetAggr *aggr, MetaObj *item);
+    void recount(SetAggr *aggr);
+    void free_expired();
+    int pending_value(const SetAggr *aggr, const Value *&value) const;
+    const Value *percentile(int kind, int n_attr, long percent);
+    long rank(int kind, int n_attr, const Value &value);
+    long distinct(int kind, int n_attr);
 
   public :
-    inline Set() : _mem() {
+    inline Set() : _mem(), _expired() {
         _type = SET;
         _t1 = _t2 = 0;
         _links = 1;
         _last_op = 0;
         _state = 0;
         _last_obj = NULL;
+        _aggr = NULL;
+        _reads = SET_NOT_READ;
+        _pending = NULL;
+        _stamp = 0;
     };
+    inline ~Set() { free_aggr(); free_expired(); };
+
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
 
     // Methods for the insertion and removing of items in the set
 
-    inline void flush_set() { _mem.Free( MetaObj::metadelete); };
+    inline void flush_set() { free_aggr(); free_expired(); _mem.Free( MetaObj::metadelete); };
     int is_null() 				{ return _mem.numItems() == 0; };
     int will_be_null() 			{ return _mem.numItems() <= 1; };
     MetaObj * add_elem(MetaObj *elem);
@@ -83,6 +195,17 @@ class Set : public MetaObj
         _state = _last_op ^ 0x3; // Opposite op = Inversing the bits (MODIFY will set to 0, nothing is done
     };
 
+    // Items retracted by the expiry of a time window, the Set changes once for all of them
+    int expire_elem(MetaObj *elem);
+    int will_be_null_by_expiry()     { return _mem.numItems() <= _expired.numItems(); };
+    inline void setExpiryOp()
+    {
+        _last_obj = NULL;
+        _last_op = SET_EXPIRY_OP;
+        _state = INSERT_TAG;     // The items expired are in the set until the new state is set
+    };
+    void end_expiry();
+
     // Operations over the elements
     long sum_set_n(int n_attr);
     float sum_set_f(int n_attr);
@@ -95,11 +218,24 @@ class Set : public MetaObj
     float max_set_f(int n_attr);
     char *max_set_a(int n_attr);
     char *concat(int n_attr, char *sep);
+    long percentile_set_n(int n_attr, long percent);
+    float percentile_set_f(int n_attr, long percent);
+    char *percentile_set_a(int n_attr, long percent);
+    long rank_set_n(int n_attr, long value);
+    long rank_set_f(int n_attr, float value);
+    long rank_set_a(int n_attr, char *value);
+    long distinct_set_n(int n_attr);
+    long distinct_set_f(int n_attr);
+    long distinct_set_a(int n_attr);
     MetaObj *first_item_of_set() const;
 
+    // The propagation of a modification is logged for the aggregates (see sync)
+    static void begin_modify(ObjectType *obj);
+    static void end_modify();
+
     // Implemantation of inherited methods
 
-    int compare(const MetaObj *obj2, va_list list) const;
+    int compare(const MetaObj *obj2) const;
     int compare_objs(const MetaObj *obj2, int pos_offset, va_list list) const;
     MetaObj * operator[](const int n);
     MetaObj **meta_dir(MetaObj **dir, const int n, const int n_objs);
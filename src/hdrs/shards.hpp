@@ -0,0 +1,101 @@
+/**
+ * @file shards.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the Shard class. In sharded mode the package is instantiated in several
+ *        engines, each one with its own thread, and the objects are routed to them by the value of
+ *        the partition attribute of their class (PARTITION BY)
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include <pthread.h>
+
+#include "engine.h"
+#include "context.hpp"
+
+#ifndef SHARDS__HH_INCLUDED
+#define SHARDS__HH_INCLUDED
+
+#define MAXSHARDS 64
+
+#define SHARD_REFRESH 0       /* Tag of the events that broadcast engine_refresh */
+
+struct ShardEvent
+{
+    int _tag;                 /* INSERT_TAG, MODIFY_TAG, RETRACT_TAG or SHARD_REFRESH */
+    ObjectType *_obj;
+    ObjectType *_old_obj;     /* Copy made by engine_modify, for MODIFY_TAG, or for the RETRACT_TAG out of the old shard */
+    long _time;               /* Time stamp, for SHARD_REFRESH */
+    ShardEvent *_next;
+};
+
+class Shard
+{
+private:
+    Engine *_engine;
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _work_cond;   /* Signaled when there are new events or the shard must stop */
+    pthread_cond_t _idle_cond;   /* Signaled when all the events have been propagated */
+    ShardEvent *_first;
+    ShardEvent **_tail;
+    int _busy;
+    int _stop;
+
+    static Shard *_shards[MAXSHARDS];
+    static int _n_shards;
+
+    static void *run(void *shard);
+    void propagate(ShardEvent *event);
+    static void swap_values(ObjectType *obj, ObjectType *copy);
+    static ShardEvent *new_event(int tag, ObjectType *obj, ObjectType *old_obj);
+
+public:
+    Shard();
+    ~Shard();
+
+    void put(ShardEvent *event);
+    void wait_idle();
+    void stop();
+
+    /**
+     * @brief In sharded mode the calls made out of the shards (those over the default engine) are routed
+     *
+     * @return int TRUE if the call must be routed to the shards
+     */
+    static int routed() { return Engine::current() == &Engine::_default && _n_shards > 0; };
+
+    static int start(int n_shards);
+    static void stop_all();
+    static void sync();
+    static int inf_cnt();
+    static void reset_inf_cnt();
+    static Shard *of_object(ObjectType *obj);
+    static void route(int tag, ObjectType *obj);
+    static void refresh(long real_time);
+};
+
+#endif
@@ -36,6 +36,7 @@
 #include "engine.h"
 #include "error.hpp"
 #include "metaobj.hpp"
+#include "slab.hpp"
 #include "load.hpp"
 
 #ifndef SINGLE__HH_INCLUDED
@@ -52,12 +53,19 @@ class Single: public MetaObj
     inline Single(ObjectType *object);
     inline Single();
     ObjectType *obj() 			{ return _obj; };
+    ObjectType *key_obj()		{ return (ObjectType *)_key; };	// The object itself, whatever its state is
     static Single *null_single()	{ return &_null_single; };
     void set_deleted()                  { _key = 0; };
+    void set_key(ObjectType *object)    { _key = (long int)object; };	// To look for the item of an object
     int has_been_deleted()              { return (_key == 0); };
 
+    // Allocation in the Slab of the class
+    static Slab _slab;
+    static void *operator new(size_t) { return _slab.alloc(); };
+    static void operator delete(void *item) { _slab.release(item); };
+
     // Virtual functions inherited
-    int compare(const MetaObj *obj2, va_list list) const;
+    int compare(const MetaObj *obj2) const;
     int compare_objs(const MetaObj *obj2, int pos_offset, va_list list) const;
     MetaObj * operator[](const int n);
     MetaObj **meta_dir(MetaObj **dir, const int n, const int n_objs);
@@ -0,0 +1,133 @@
+/**
+ * @file slab.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the Slab class. Allocator of items of a fixed size, for the structs that the inference
+ *        creates and frees all the time. Each thread takes and returns the items from its own cache, and only
+ *        batches of them go to or come from the allocator
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "config.hpp"
+
+#ifndef SLAB____HH_INCLUDED
+#define SLAB____HH_INCLUDED
+
+struct SlabItem
+{
+    SlabItem *_next;
+};
+
+struct SlabCache              /* Free items of a Slab in a thread */
+{
+    SlabItem *_free;
+    long _n_free;             /* Also read by engine_slab_stats from other threads */
+};
+
+struct SlabThread
+{
+    SlabCache _cache[MAXSLABS];
+    SlabThread *_prev;
+    SlabThread *_next;
+};
+
+class Slab
+{
+private:
+    const char *_name;
+    size_t _size;
+    int _id;
+    pthread_mutex_t _lock;
+    SlabItem *_depot;         /* Free items returned by the threads */
+    long _n_depot;
+    long _n_blocks;
+    long _n_items;
+
+    static Slab *_slabs[MAXSLABS];
+    static int _n_slabs;
+    static ENGINE_TLS SlabThread *_thread;
+    static SlabThread *_threads;                 /* The caches of all the threads */
+    static pthread_mutex_t _threads_lock;
+    static pthread_key_t _key;                   /* To return the caches when a thread ends */
+    static pthread_once_t _key_once;
+
+    static void create_key();
+    static void end_thread(void *thread);
+    static SlabThread *new_thread();
+    void refill(SlabCache *cache);
+    void flush(SlabCache *cache, long n_items);
+
+public:
+    Slab(const char *name, size_t size);
+
+    static int stats(rce_slab_stats_t *stats, int max_stats);
+
+    /**
+     * @brief Take an item
+     *
+     * @return void* The item, never NULL
+     */
+    void *alloc()
+    {
+        SlabThread *thread = (_thread != NULL) ? _thread : new_thread();
+        SlabCache *cache = &thread->_cache[_id];
+        SlabItem *item;
+
+        if (cache->_free == NULL)
+            refill(cache);
+
+        item = cache->_free;
+        cache->_free = item->_next;
+        __atomic_store_n(&cache->_n_free, cache->_n_free - 1, __ATOMIC_RELAXED);
+
+        return item;
+    };
+
+    /**
+     * @brief Return an item. It may have been taken by other thread
+     *
+     * @param p The item
+     */
+    void release(void *p)
+    {
+        SlabThread *thread = (_thread != NULL) ? _thread : new_thread();
+        SlabCache *cache = &thread->_cache[_id];
+        SlabItem *item = (SlabItem *)p;
+
+        item->_next = cache->_free;
+        cache->_free = item;
+        __atomic_store_n(&cache->_n_free, cache->_n_free + 1, __ATOMIC_RELAXED);
+
+        if (cache->_n_free > 2 * SLABBATCH)
+            flush(cache, SLABBATCH);
+    };
+};
+
+#endif
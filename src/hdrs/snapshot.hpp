@@ -0,0 +1,103 @@
+/**
+ * @file snapshot.hpp
+ * @author Francisco Alcaraz
+ * @brief Definition of the Snapshot and SnapshotQueue classes. Other threads may ask an engine for a copy of
+ *        the objects kept in the memories of its nodes, that the engine thread builds between two propagations
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+
+#ifndef PUBLIC
+#define PUBLIC
+#define PRIVATE static
+#endif
+
+#include <pthread.h>
+
+#include "engine.h"
+#include "config.hpp"
+#include "btree.hpp"
+
+#ifndef SNAPSHO_HH_INCLUDED
+#define SNAPSHO_HH_INCLUDED
+
+#define SNAP_QUEUED 0
+#define SNAP_BUILDING 1
+#define SNAP_READY 2
+
+class Node;
+class MetaObj;
+class ObjClass;
+class HashMem;
+class BPTree;
+
+struct Snapshot
+{
+    char _ruleset[MAXNAME];   /* Empty for all the RuleSets */
+    char _rule[MAXNAME];      /* Empty for all the Rules */
+    char _class[MAXNAME];     /* Empty for all the classes */
+    BTree _objs;              /* Singles with the copies of the objects, ordered by time */
+    int _state;               /* SNAP_QUEUED, SNAP_BUILDING or SNAP_READY */
+    int _abandoned;           /* The reader gave up while it was being built */
+    Snapshot *_next;
+
+    Snapshot(char *ruleset, char *rule, char *class_name);
+    ~Snapshot();
+
+    void build();
+    void collect_node(Node *node, BTree &visited, BTree &seen, ObjClass *filter);
+    void collect_mem(BTState state, int n_keys, int counters, BTree &seen, ObjClass *filter);
+    void collect_hash_mem(HashMem *mem, BTree &seen, ObjClass *filter);
+    void collect_bp_mem(BPTree *mem, BTree &seen, ObjClass *filter);
+    void collect(MetaObj *item, BTree &seen, ObjClass *filter);
+    void add(ObjectType *obj, BTree &seen, ObjClass *filter);
+};
+
+class SnapshotQueue
+{
+private:
+    Snapshot *_requests;      /* Requests pending, the oldest first */
+    Snapshot **_tail;
+    int _n_requests;
+    pthread_mutex_t _lock;
+    pthread_cond_t _served;
+
+    void serve_requests();
+
+public:
+    SnapshotQueue();
+    ~SnapshotQueue();
+
+    Snapshot *request(char *ruleset, char *rule, char *class_name, int timeout);
+
+    /**
+     * @brief Build the snapshots requested. Called by the engine thread out of any propagation,
+     *        so the memories are not changing. Only an atomic read when there is nothing requested
+     *
+     */
+    void serve()
+    {
+        if (__atomic_load_n(&_n_requests, __ATOMIC_ACQUIRE) > 0)
+            serve_requests();
+    };
+};
+
+#endif
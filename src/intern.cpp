@@ -0,0 +1,147 @@
+/**
+ * @file intern.cpp
+ * @author Francisco Alcaraz
+ * @brief Table of interned strings. Each different text is stored once and never freed, so two interned strings
+ *        are equal if and only if they are the same pointer. The strings flagged as INTERNED in the attributes
+ *        of the objects are compared by pointer in the equality tests of the net, and the compiler interns the
+ *        literals of the rules
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "error.hpp"
+
+#define INTERN_MIN_BUCKETS 1024
+
+typedef struct intern_sym
+{
+  struct intern_sym *next;
+  ULong hash;
+  char str[1];
+} InternSym;
+
+PRIVATE InternSym **buckets = NULL;
+PRIVATE ULong n_buckets = 0;
+PRIVATE ULong n_syms = 0;
+PRIVATE pthread_rwlock_t intern_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * @brief FNV-1a hash of a string
+ *
+ * @param str The string
+ * @return ULong The hash
+ */
+PRIVATE
+ULong hash_str(const char *str)
+{
+  ULong hash = 14695981039346656037UL;
+
+  for (; *str != '\0'; str++)
+    hash = (hash ^ (UChar)*str) * 1099511628211UL;
+
+  return hash;
+}
+
+/**
+ * @brief Look for a string in the table. Called with the lock taken
+ *
+ * @param str The string
+ * @param hash Its hash
+ * @return InternSym* The symbol or NULL
+ */
+PRIVATE
+InternSym *find_sym(const char *str, ULong hash)
+{
+  InternSym *sym;
+
+  if (n_buckets == 0)
+    return NULL;
+
+  for (sym = buckets[hash & (n_buckets - 1)]; sym != NULL; sym = sym->next)
+    if (sym->hash == hash && strcmp(sym->str, str) == 0)
+      return sym;
+
+  return NULL;
+}
+
+/**
+ * @brief Double the buckets of the table. Called with the write lock taken
+ *
+ */
+PRIVATE
+void grow_table()
+{
+  InternSym **new_buckets, *sym, *next;
+  ULong n, new_n_buckets = (n_buckets == 0) ? INTERN_MIN_BUCKETS : 2 * n_buckets;
+
+  if ((new_buckets = (InternSym **)calloc(new_n_buckets, sizeof(InternSym *))) == NULL)
+    engine_fatal_err("calloc: %s\n", strerror(errno));
+
+  for (n = 0; n < n_buckets; n++)
+  {
+    for (sym = buckets[n]; sym != NULL; sym = next)
+    {
+      next = sym->next;
+      sym->next = new_buckets[sym->hash & (new_n_buckets - 1)];
+      new_buckets[sym->hash & (new_n_buckets - 1)] = sym;
+    }
+  }
+
+  free(buckets);
+  buckets = new_buckets;
+  n_buckets = new_n_buckets;
+}
+
+/**
+ * @brief Intern a string. The value returned may be stored in an attribute with the flag INTERNED,
+ *        it must not be freed nor modified. Any thread may call it
+ *
+ * @param str The string
+ * @return char* The only copy of the string, NULL if str is NULL
+ */
+PUBLIC
+char *engine_intern(const char *str)
+{
+  InternSym *sym;
+  ULong hash;
+  size_t len;
+
+  if (str == NULL)
+    return NULL;
+
+  hash = hash_str(str);
+
+  pthread_rwlock_rdlock(&intern_lock);
+  sym = find_sym(str, hash);
+  pthread_rwlock_unlock(&intern_lock);
+
+  if (sym != NULL)
+    return sym->str;
+
+  pthread_rwlock_wrlock(&intern_lock);
+  if ((sym = find_sym(str, hash)) == NULL)      // Other thread may have inserted it
+  {
+    if (n_syms >= n_buckets)
+      grow_table();
+
+    len = strlen(str);
+    if ((sym = (InternSym *)malloc(sizeof(InternSym) + len)) == NULL)
+      engine_fatal_err("malloc: %s\n", strerror(errno));
+
+    memcpy(sym->str, str, len + 1);
+    sym->hash = hash;
+    sym->next = buckets[hash & (n_buckets - 1)];
+    buckets[hash & (n_buckets - 1)] = sym;
+    n_syms++;
+  }
+  pthread_rwlock_unlock(&intern_lock);
+
+  return sym->str;
+}
@@ -86,7 +86,8 @@ KeyManager::compareKey(const void *target, const void *internal, int numkey)
     switch(type)
     {
         case TYPE_NUM:
-            return (int)(attrib_tgt->num - attrib_int->num);
+            // Not the difference, it may not fit in an int and the range keys need the order
+            return (attrib_tgt->num < attrib_int->num) ? -1 : (attrib_tgt->num > attrib_int->num);
         case TYPE_STR:
             return (attrib_tgt->str.str_p == attrib_int->str.str_p ? 0 :
                         (attrib_tgt->str.str_p == NULL | attrib_int->str.str_p == NULL ? (long int)attrib_tgt->str.str_p - (long int)attrib_int->str.str_p :
@@ -103,6 +104,96 @@ KeyManager::compareKey(const void *target, const void *internal, int numkey)
     return -1;
 }
 
+/**
+ * @brief Hash of the values of the keys of a MetaObj. The MetaObjs that compareKey finds equal in all
+ *      the keys have the same hash, so the strings are hashed by their text
+ *
+ * @param target The MetaObj, its values are taken from the target side
+ * @return ULong The hash
+ */
+ULong
+KeyManager::hashKeys(const void *target)
+{
+    const Value *attrib;
+    const char *str;
+    ULong hash = 14695981039346656037UL;
+    ULong value;
+    unsigned int bits;
+
+    for (int nk=0; nk<numKeys(); nk++)
+    {
+        attrib = getObjInfo((MetaObj *&)target, _keys[nk], _tgt_side);
+
+        switch ((_keys[nk]>>30) & 0x3)
+        {
+            case TYPE_NUM:
+                value = (ULong)attrib->num;
+                break;
+            case TYPE_STR:
+                value = 0;
+                if (attrib->str.str_p != NULL)
+                    for (str = attrib->str.str_p; *str != '\0'; str++)
+                        value = (value ^ (UChar)*str) * 1099511628211UL;
+                break;
+            case TYPE_FLO:
+                // 0.0 and -0.0 are equal
+                bits = 0;
+                if (attrib->flo != 0.0)
+                    memcpy(&bits, &attrib->flo, sizeof(bits));
+                value = bits;
+                break;
+            default:
+                value = 0;
+        }
+        hash = (hash ^ value) * 1099511628211UL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * @brief Value of a key of a MetaObj, from the target side, to be kept by the B+tree memories (see bptree.cpp).
+ *      The strings are kept only if they are interned, so they stay while the object does
+ *
+ * @param target The MetaObj
+ * @param numkey Number of key
+ * @param key Where to store the value
+ */
+void
+KeyManager::keyValue(const void *target, int numkey, BPKey &key)
+{
+    const Value *attrib = getObjInfo((MetaObj *&)target, _keys[numkey], _tgt_side);
+
+    switch ((_keys[numkey]>>30) & 0x3)
+    {
+        case TYPE_NUM:
+            key.num = attrib->num;
+            break;
+        case TYPE_FLO:
+            key.flo = attrib->flo;
+            break;
+        default:
+            key.str = (attrib->str.str_p != NULL && (attrib->str.dynamic_flags & INTERNED)) ? attrib->str.str_p : BP_STR_NOT_KEPT;
+    }
+}
+
+/**
+ * @brief Checks if the value of a key of a MetaObj, from the target side, is taken from a SET.
+ *      It is the value of its first item, that may change with the items of the SET
+ *
+ * @param target The MetaObj
+ * @param numkey Number of key
+ * @return true it is from a SET
+ */
+bool
+KeyManager::keyInSet(const void *target, int numkey)
+{
+    ULong keydata = _keys[numkey];
+
+    if (_tgt_side == LEFT_MEM)
+        keydata = (keydata >> 15);
+    return (*(MetaObj *)target)[(keydata >> 8) & 0x7F]->class_type() != SINGLE;
+}
+
 /**
  * @brief Checks if the modification of an object has affected to the keys so it must be indexed again
  * 
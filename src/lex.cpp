@@ -49,7 +49,8 @@ read_pkg(char *text)
 {
   int err;
 
-  input = text;
+  lex_state.input = text;
+  lex_state.line_num = 1;
   init_lex = PKG_ID;
   line_num = 1;
 
@@ -69,7 +70,8 @@ read_rset(char *text)
 {
   int err;
 
-  input = text;
+  lex_state.input = text;
+  lex_state.line_num = 1;
   init_lex = RSET_ID;
   line_num = 1;
 
@@ -78,6 +80,99 @@ read_rset(char *text)
   return (err);
 }
 
+/**
+ * @brief Read all the tokens of a text in advance. It does not use the state of the parser,
+ *      so several texts may be read at once by different threads. The token that follows an identifier
+ *      is kept apart, as the identifier is a pattern var only inside a rule.
+ *      It stops at the end of the text or at the first lexical error
+ *
+ * @param text Text to read. It may be modified
+ * @param list The tokens read. They must be freed with free_tokens
+ */
+PUBLIC
+void lex_text(char *text, TokenList *list)
+{
+  LexState st;
+  LexToken *tok;
+
+  st.input = text;
+  st.line_num = 1;
+  st.colon = FALSE;
+  st.c = GETC(st.input);
+
+  list->tokens = NULL;
+  list->n_tokens = 0;
+  list->size = 0;
+  list->n_read = 0;
+
+  do
+  {
+    if (list->n_tokens == list->size)
+    {
+      list->size = (list->size == 0) ? 256 : 2 * list->size;
+      if ((list->tokens = (LexToken *)realloc(list->tokens, list->size * sizeof(LexToken))) == NULL)
+        engine_fatal_err("realloc: %s\n", strerror(errno));
+    }
+
+    tok = &list->tokens[list->n_tokens++];
+    tok->token = next_token(st);
+    tok->line = st.line_num;
+    tok->colon = (tok->token == IDENT && st.colon);
+    tok->lval = st.lval;
+
+  } while (tok->token != 0 && tok->token != LEX_ERROR);
+}
+
+/**
+ * @brief Compile a Rule Set from the tokens read with lex_text
+ *
+ * @param list The tokens
+ * @return int error
+ */
+PUBLIC int
+read_rset_tokens(TokenList *list)
+{
+  int err;
+
+  replay = list;
+  list->n_read = 0;
+  init_lex = RSET_ID;
+  line_num = 1;
+
+  err = eng_parse();
+
+  replay = NULL;
+
+  return (err);
+}
+
+/**
+ * @brief Free the tokens read with lex_text, and the strings of those not passed to the parser
+ *
+ * @param list The tokens
+ */
+PUBLIC
+void free_tokens(TokenList *list)
+{
+  int n;
+
+  if (replay == list)   // The compilation was aborted
+    replay = NULL;
+
+  for (n = list->n_read; n < list->n_tokens; n++)
+  {
+    if (list->tokens[n].token == IDENT)
+      free(list->tokens[n].lval.ident);
+    else if (list->tokens[n].token == STRING)
+      free(list->tokens[n].lval.str);
+  }
+
+  free(list->tokens);
+  list->tokens = NULL;
+  list->n_tokens = 0;
+  list->size = 0;
+}
+
 /**
  * @brief Control the activation of lex debugging
  *
@@ -121,7 +216,10 @@ int get_curr_line()
 PUBLIC
 int eng_lex()
 {
-  static char c;
+  int token;
+
+  if (replay != NULL)
+    return replay_token();
 
   // We readd the first character only at init state
   // Initially also we return a control token to select the syntax of Package of Ruleset
@@ -129,42 +227,119 @@ int eng_lex()
   if (init_lex)
   {
     int val = init_lex;
-    c = GETC(input);
+    lex_state.c = GETC(lex_state.input);
     init_lex = 0;
     return val;
   }
 
-  first_printable(c);
+  token = next_token(lex_state);
+  line_num = lex_state.line_num;
+  eng_lval = lex_state.lval;
 
-  if (c == 0)
+  if (token == LEX_ERROR)
+    comp_err("%s", lex_state.lval.str);
+
+  // Simple identifier, it is a pattern var if followed by ':'
+  if (token == IDENT && lex_state.colon && inside_rule())
+  {
+    lex_state.c = GETC(lex_state.input);
+    return PATT_VAR;
+  }
+
+  return token;
+}
+
+/**
+ * @brief Return the next token of those read in advance
+ *
+ * @return int token number, its value is stored at eng_lval
+ */
+PRIVATE
+int replay_token()
+{
+  LexToken *tok;
+
+  if (init_lex)
+  {
+    int val = init_lex;
+    init_lex = 0;
+    return val;
+  }
+
+  if (replay->n_read == replay->n_tokens)
+    return (0);
+
+  tok = &replay->tokens[replay->n_read++];
+  line_num = tok->line;
+  eng_lval = tok->lval;
+
+  if (tok->token == LEX_ERROR)
+    comp_err("%s", tok->lval.str);
+
+  // The next token is the ':'
+  if (tok->colon && inside_rule())
+  {
+    replay->n_read++;
+    return PATT_VAR;
+  }
+
+  return tok->token;
+}
+
+/**
+ * @brief Read the next token of a text
+ *
+ * @param st State of the reading
+ * @return int token number, the token value when reading an scalar is stored at st.lval
+ */
+PRIVATE
+int next_token(LexState &st)
+{
+  first_printable(st);
+
+  if (st.c == 0)
     return (0);
 
-  if (isalpha(c))
-    return read_ident(c);
+  if (isalpha(st.c))
+    return read_ident(st);
 
-  if (isdigit(c))
-    return read_number(c);
+  if (isdigit(st.c))
+    return read_number(st);
 
   /*
    * Otherwise the read character is returned and read the next
    */
 
-  if (c == '\'')
-    return read_char(c);
+  if (st.c == '\'')
+    return read_char(st);
 
-  if (c == '"')
-    return read_str(c);
+  if (st.c == '"')
+    return read_str(st);
 
-  return read_special(c);
+  return read_special(st);
+}
+
+/**
+ * @brief Keep a lexical error to be thrown by the caller
+ *
+ * @param st State of the reading
+ * @param msg The error
+ * @return int LEX_ERROR
+ */
+PRIVATE
+int lex_error(LexState &st, const char *msg)
+{
+  st.lval.str = (char *)msg;
+  return LEX_ERROR;
 }
 
 /**
  * @brief Move formar the input pointer until a non blank character
  *
- * @param c the first non blank found
+ * @param st State of the reading, st.c is the first non blank found
  */
 PRIVATE
-void first_printable(char &c)
+void first_printable(LexState &st)
 {
 
   // Identify the blank spaces while the EOF is not reached
@@ -176,51 +351,51 @@ void first_printable(char &c)
 
     // Blank chars
 
-    while (c <= ' ' && c != 0)
+    while (st.c <= ' ' && st.c != 0)
     {
-      if (c == '\n')
-        line_num++;
-      c = GETC(input);
+      if (st.c == '\n')
+        st.line_num++;
+      st.c = GETC(st.input);
     }
 
     // Commentaries
 
-    if (c == ';')
+    if (st.c == ';')
     {
-      while ((c = GETC(input)) != '\n' && c != 0)
+      while ((st.c = GETC(st.input)) != '\n' && st.c != 0)
         ;
     }
 
-  } while (c != 0 && c <= ' ');
+  } while (st.c != 0 && st.c <= ' ');
 }
 
 /**
  * @brief Read an identifier. It also identify the reserved words returning the specific token
  *
- * @param c first character (non blank)
+ * @param st State of the reading, st.c is the first character (non blank)
  * @return int token (is a number)
  */
 PRIVATE
-int read_ident(char &c)
+int read_ident(LexState &st)
 {
 
   TokenText_Type *tok_txt; // Here are the texts in lowercase of all reserved words
   char *pbuff;
   int len;
-  static char buffer[MAXNAME + 1];
+  char buffer[MAXNAME + 1];
 
   pbuff = buffer;
   len = 0;
 
   do
   {
-    *pbuff++ = tolower(c); // All the identifiers are in lowercase!!
+    *pbuff++ = tolower(st.c); // All the identifiers are in lowercase!!
     len++;
-    c = GETC(input);
-  } while (c != 0 && (isalnum(c) || c == '_') && len < MAXNAME);
+    st.c = GETC(st.input);
+  } while (st.c != 0 && (isalnum(st.c) || st.c == '_') && len < MAXNAME);
 
-  if (c != 0 && (isalnum(c) || c == '_') && len >= MAXNAME)
-    comp_err("Identifier too long\n");
+  if (st.c != 0 && (isalnum(st.c) || st.c == '_') && len >= MAXNAME)
+    return lex_error(st, "Identifier too long\n");
 
   *pbuff = '\0';
 
@@ -233,96 +408,90 @@ int read_ident(char &c)
   if (tok_txt->token != 0)
   {
     if (tok_txt->token == TRUE_VAL)
-      eng_lval.num = TRUE_VALUE;
+      st.lval.num = TRUE_VALUE;
     if (tok_txt->token == FALSE_VAL)
-      eng_lval.num = FALSE_VALUE;
+      st.lval.num = FALSE_VALUE;
     if (tok_txt->token == NULL_STR)
-      eng_lval.num = NULL_STR_VALUE;
+      st.lval.num = NULL_STR_VALUE;
     return (tok_txt->token);
   }
 
   else
   {
     // Simple identifier, may be a pattern var if follower by ':'
-    eng_lval.ident = strdup(buffer);
-    first_printable(c);
-    if (inside_rule() && c == ':')
-    {
-      c = GETC(input);
-      return PATT_VAR;
-    }
-    else
-    {
-      return (IDENT); /* IDENTIFIER */
-    }
+    // The caller knows if it is inside a rule
+    st.lval.ident = strdup(buffer);
+    first_printable(st);
+    st.colon = (st.c == ':');
+    return (IDENT); /* IDENTIFIER */
   }
 }
 
 /**
  * @brief Read a number
  * 
- * @param c First non blank character
+ * @param st State of the reading, st.c is the first non blank character
  * @return the token type
  */
 PRIVATE
-int read_number(char &c)
+int read_number(LexState &st)
 {
   // Read an integer (long) or a float
 
   char *pbuff;
   int len;
-  static char buffer[MAXNUMBER + 1];
+  char buffer[MAXNUMBER + 1];
 
   pbuff = buffer;
   len = 0;
 
   do
   {
-    *pbuff++ = c;
+    *pbuff++ = st.c;
     len++;
-    c = GETC(input);
-  } while (c != 0 && (isdigit(c) || c == '.') && len < MAXNUMBER);
+    st.c = GETC(st.input);
+  } while (st.c != 0 && (isdigit(st.c) || st.c == '.') && len < MAXNUMBER);
 
-  if (c != 0 && isdigit(c) && len >= MAXNUMBER)
-    comp_err("Number too long\n");
+  if (st.c != 0 && isdigit(st.c) && len >= MAXNUMBER)
+    return lex_error(st, "Number too long\n");
 
-  if ((c == 'E' || c == 'e') && len < MAXNUMBER)
+  if ((st.c == 'E' || st.c == 'e') && len < MAXNUMBER)
   {
     // Store E/e
 
-    *pbuff++ = c;
+    *pbuff++ = st.c;
     len++;
-    c = GETC(input);
+    st.c = GETC(st.input);
 
     // Check for the sign +/-
 
-    if ((c == '+' || c == '-') && len < MAXNUMBER)
+    if ((st.c == '+' || st.c == '-') && len < MAXNUMBER)
     {
-      *pbuff++ = c;
+      *pbuff++ = st.c;
       len++;
-      c = GETC(input);
+      st.c = GETC(st.input);
     }
 
-    while (c != 0 && isdigit(c) && len < MAXNUMBER)
+    while (st.c != 0 && isdigit(st.c) && len < MAXNUMBER)
     {
-      *pbuff++ = c;
+      *pbuff++ = st.c;
       len++;
-      c = GETC(input);
+      st.c = GETC(st.input);
     }
   }
 
-  if (c != 0 && isdigit(c) && len >= MAXNUMBER)
-    comp_err("Number too long\n");
+  if (st.c != 0 && isdigit(st.c) && len >= MAXNUMBER)
+    return lex_error(st, "Number too long\n");
 
   *pbuff = '\0';
 
-  eng_lval.num = (int)strtol(buffer, &pbuff, 10);
+  st.lval.num = (int)strtol(buffer, &pbuff, 10);
   if (*pbuff == '\0')
   {
     return INTEGER;
   }
 
-  eng_lval.flo = (float)strtod(buffer, &pbuff);
+  st.lval.flo = (float)strtod(buffer, &pbuff);
   if (*pbuff == '\0')
   {
     return FLOAT;
@@ -336,58 +505,58 @@ int read_number(char &c)
 /**
  * @brief Read the characters one by one. Also read numbers and control some escaped characters 
  * 
- * @param c First non blank character
+ * @param st State of the reading, st.c is the first non blank character
  * @return PRIVATE 
  */
 PRIVATE
-int read_char(char &c)
+int read_char(LexState &st)
 {
   char next_c;
 
-  c = GETC(input);
-  if (c == '\\')
+  st.c = GETC(st.input);
+  if (st.c == '\\')
   {
 
     // Special chars
 
-    c = GETC(input);
-    switch (c)
+    st.c = GETC(st.input);
+    switch (st.c)
     {
     case 'n':
-      c = '\n';
+      st.c = '\n';
       break;
     case 'r':
-      c = '\r';
+      st.c = '\r';
       break;
     case 't':
-      c = '\t';
+      st.c = '\t';
       break;
     case '0': // Octal
-      c = 0;
-      while (isdigit(next_c = GETC(input)))
-        c = (c << 3) + (next_c - '0');
-      UNGETC(next_c, input);
+      st.c = 0;
+      while (isdigit(next_c = GETC(st.input)))
+        st.c = (st.c << 3) + (next_c - '0');
+      UNGETC(next_c, st.input);
       break;
     default:
-      if (isdigit(c)) // Decimal
+      if (isdigit(st.c)) // Decimal
       {
-        c -= '0';
-        while (isdigit(next_c = GETC(input)))
-          c = c * 10 + (next_c - '0');
-        UNGETC(next_c, input);
+        st.c -= '0';
+        while (isdigit(next_c = GETC(st.input)))
+          st.c = st.c * 10 + (next_c - '0');
+        UNGETC(next_c, st.input);
       }
       else
-        comp_err("Unknown char\n");
+        return lex_error(st, "Unknown char\n");
       break;
     }
   }
 
-  next_c = GETC(input);
+  next_c = GETC(st.input);
 
   if (next_c == '\'')
   {
-    eng_lval.num = c;
-    c = GETC(input);
+    st.lval.num = st.c;
+    st.c = GETC(st.input);
     return CHAR;
   }
   else
@@ -399,60 +568,60 @@ int read_char(char &c)
 /**
  * @brief Read a string controlling some escaped characters
  * 
- * @param c First non blank character
+ * @param st State of the reading, st.c is the first non blank character
  * @return PRIVATE 
  */
 PRIVATE
-int read_str(char &c)
+int read_str(LexState &st)
 {
 
   char *pbuff;
   int len;
-  static char buffer[MAXSTR + 1];
+  char buffer[MAXSTR + 1];
   char next_c;
 
   pbuff = buffer;
   len = 0;
-  while ((c = GETC(input)) != 0 && c != '"' && len < MAXSTR)
+  while ((st.c = GETC(st.input)) != 0 && st.c != '"' && len < MAXSTR)
   {
-    if (c == '\\')
+    if (st.c == '\\')
     {
-      c = GETC(input);
-      switch (c)
+      st.c = GETC(st.input);
+      switch (st.c)
       {
       case '"':
-        c = '"';
+        st.c = '"';
         break;
       case 'n':
-        c = '\n';
+        st.c = '\n';
         break;
       case 'r':
-        c = '\r';
+        st.c = '\r';
         break;
       case 't':
-        c = '\t';
+        st.c = '\t';
         break;
       case '0': // Octales
-        c = 0;
-        while (isdigit(next_c = GETC(input)))
-          c = (c << 3) + (next_c - '0');
-        UNGETC(next_c, input);
+        st.c = 0;
+        while (isdigit(next_c = GETC(st.input)))
+          st.c = (st.c << 3) + (next_c - '0');
+        UNGETC(next_c, st.input);
         break;
       default:
-        if (isdigit(c)) // Decimal
+        if (isdigit(st.c)) // Decimal
         {
-          c -= '0';
-          while (isdigit(next_c = GETC(input)))
-            c = c * 10 + (next_c - '0');
-          UNGETC(next_c, input);
+          st.c -= '0';
+          while (isdigit(next_c = GETC(st.input)))
+            st.c = st.c * 10 + (next_c - '0');
+          UNGETC(next_c, st.input);
         }
         else
-          comp_err("Unknown char\n");
+          return lex_error(st, "Unknown char\n");
         break;
       }
     }
 
-    *pbuff++ = c;
+    *pbuff++ = st.c;
     len++;
   }
 
@@ -462,7 +631,7 @@ int read_str(char &c)
   //     unknown token for the syntax (SYNTAX_ERROR)
   // Else return the text found
 
-  if (c != '"')
+  if (st.c != '"')
   {
     return (SINTAX_ERROR);
   }
@@ -470,10 +639,10 @@ int read_str(char &c)
   {
     char *txtdir;
 
-    c = GETC(input);
+    st.c = GETC(st.input);
 
     txtdir = strdup(buffer);
-    eng_lval.str = txtdir;
+    st.lval.str = txtdir;
     return STRING;
   }
 }
@@ -481,20 +650,20 @@ int read_str(char &c)
 /**
  * @brief Deal with special symbols that has their own tokens (such as '->' = IMPL)
  * 
- * @param c First non blank character
+ * @param st State of the reading, st.c is the first non blank character
  * @return the token found (or char found)
  */
 PRIVATE
-int read_special(char &c)
+int read_special(LexState &st)
 {
   char c_init;
 
-  if (c == '-')
+  if (st.c == '-')
   {
-    c = GETC(input);
-    if (c == '>')
+    st.c = GETC(st.input);
+    if (st.c == '>')
     {
-      c = GETC(input);
+      st.c = GETC(st.input);
       return IMPL;
     }
     else
@@ -503,12 +672,12 @@ int read_special(char &c)
     }
   }
 
-  if (c == '!')
+  if (st.c == '!')
   {
-    c = GETC(input);
-    if (c == '=')
+    st.c = GETC(st.input);
+    if (st.c == '=')
     {
-      c = GETC(input);
+      st.c = GETC(st.input);
       return NEQ;
     }
     else
@@ -517,21 +686,21 @@ int read_special(char &c)
     }
   }
 
-  if (c == '.')
+  if (st.c == '.')
   {
-    c = GETC(input);
-    if (c == '.')
+    st.c = GETC(st.input);
+    if (st.c == '.')
     {
-      c = GETC(input);
-      if (c == '.')
+      st.c = GETC(st.input);
+      if (st.c == '.')
       {
-        c = GETC(input);
+        st.c = GETC(st.input);
         return DOTDOTDOT;
       }
       else
       {
-        UNGETC(c, input);
-        c = '.';
+        UNGETC(st.c, st.input);
+        st.c = '.';
         return '.';
       }
     }
@@ -539,8 +708,8 @@ int read_special(char &c)
       return '.';
   }
 
-  c_init = c;
-  c = GETC(input);
+  c_init = st.c;
+  st.c = GETC(st.input);
   return (c_init);
 }
 
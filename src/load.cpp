@@ -19,75 +19,16 @@
 #include "btree.hpp"
 #include "lex.hpp"
 #include "keys.hpp"
+#include "context.hpp"
+#include "shards.hpp"
+#include "parallel.hpp"
 #include "patterns.hpp"
 #include "load_p.hpp"
 
 PRIVATE int on_ruleset;
 PRIVATE int n_objs_retract;
-
-//
-// TimedFunctions. External calls to refresh the memories of the nodes and retract those object out of the window
-//
-class TimedFunc
-{
-  Node *node;
-  ULong *codep;
-  int (Node::*func)(ULong *, long, bool);
-
-public:
-  TimedFunc(Node *Nodo, ULong *Code, int (Node::*Func)(ULong *, long, bool))
-  {
-    node = Nodo;
-    codep = Code;
-    func = Func;
-  };
-  int eq(ULong *Codep) { return Codep == codep; };
-  void call(long time) { (node->*func)(codep, time, true); };
-  ULong *getcodep() { return codep; }
-  Node *getnode() { return node; }
-};
-
-class TimedFuncList : public TimedFunc
-{
-  TimedFuncList *next;
-
-public:
-  TimedFuncList(Node *Nodo, ULong *Code, int (Node::*Func)(ULong *, long, bool), TimedFuncList *list)
-      : TimedFunc(Nodo, Code, Func)
-  {
-    next = list;
-  };
-
-  void refresh(ULong time)
-  {
-    TimedFuncList *i;
-    for (i = this; i != NULL; i = i->next)
-    {
-      i->call(time);
-      // timer_key printf("REF node %d   code %d  key %d\n", i->getnode(), i->getcodep(), i->getkey());
-    }
-  };
-
-  static void unsubscribe(ULong *Code, TimedFuncList *&list)
-  {
-    TimedFuncList *i, *prev;
-
-    prev = NULL;
-    for (i = list; i != NULL && !i->eq(Code); i = i->next)
-      prev = i;
-
-    if (i != NULL)
-    {
-      if (prev == NULL)
-        list = i->next;
-      else
-        prev->next = i->next;
-      delete i;
-    }
-  };
-};
-
-TimedFuncList *TimedFuncSubsList = NULL;
+PRIVATE int hash_memories = TRUE;
+PRIVATE int bptree_memories = TRUE;
 
 /**
  * @brief Top function to load a Package
@@ -131,6 +72,7 @@ int load_pkg(char *path)
     text[fst.st_size] = '\0';
 
     read_pkg(text);
+    net_changed();
     res = 1;
   }
   else
@@ -168,6 +110,7 @@ int load_pkg_str(char *text)
     set_return_buff(&buff_jmp);
 
     read_pkg(text);
+    net_changed();
     res = 1;
   }
   else
@@ -194,6 +137,9 @@ int load_rset(char *path)
   struct stat fst;
   jmp_buf buff_jmp;
 
+  // The new nodes are linked to the net that the shards are running
+  Shard::sync();
+
   if (setjmp(buff_jmp) == 0)
   {
     set_return_buff(&buff_jmp);
@@ -215,6 +161,7 @@ int load_rset(char *path)
     text[fst.st_size] = '\0';
 
     read_rset(text);
+    net_changed();
     res = 1;
   }
   else
@@ -244,11 +191,15 @@ int load_rset_str(char *text)
   int res;
   jmp_buf buff_jmp;
 
+  // The new nodes are linked to the net that the shards are running
+  Shard::sync();
+
   if (setjmp(buff_jmp) == 0)
   {
     set_return_buff(&buff_jmp);
 
     read_rset(text);
+    net_changed();
     res = 1;
   }
   else
@@ -260,6 +211,180 @@ int load_rset_str(char *text)
   return res;
 }
 
+/**
+ * @brief Build again what is derived from the connections of the net: the groups of the parallel
+ *        propagation, the children of the root by class and the indexes of the constants tested
+ *
+ */
+PRIVATE
+void net_changed()
+{
+  static ULong alpha_stamp = 0;
+
+  Parallel::build_forks();
+  ObjClass::get_real_root()->build_class_dispatch();
+  ObjClass::get_real_root()->build_alpha_indexes(++alpha_stamp);
+}
+
+/**
+ * @brief Read a Rule Set file and its tokens. It may run in any thread
+ *
+ * @param file The file
+ */
+PRIVATE
+void read_rset_file(RsetFile *file)
+{
+  int fd;
+  char *text;
+  struct stat fst;
+
+  file->call = NULL;
+  file->tokens.tokens = NULL;
+  file->tokens.n_tokens = 0;
+  file->tokens.n_read = 0;
+
+  if ((fd = open(file->path, O_RDONLY)) < 0)
+  {
+    file->call = "open";
+    file->err = errno;
+    return;
+  }
+
+  if (fstat(fd, &fst) < 0)
+  {
+    file->call = "fstat";
+    file->err = errno;
+    close(fd);
+    return;
+  }
+
+  text = new char[fst.st_size + 1];
+  (void) !read(fd, text, fst.st_size);
+  text[fst.st_size] = '\0';
+  close(fd);
+
+  lex_text(text, &file->tokens);
+
+  delete[] text;
+}
+
+/**
+ * @brief Thread that reads the files of load_rsets in order
+ *
+ * @param load The files
+ * @return void* NULL
+ */
+PRIVATE
+void *read_rset_files(void *load)
+{
+  RsetLoad *rl = (RsetLoad *)load;
+  int n;
+
+  while ((n = __atomic_fetch_add(&rl->next, 1, __ATOMIC_RELAXED)) < rl->n_files)
+  {
+    read_rset_file(&rl->files[n]);
+
+    pthread_mutex_lock(&rl->lock);
+    rl->files[n].ready = TRUE;
+    pthread_cond_broadcast(&rl->ready);
+    pthread_mutex_unlock(&rl->lock);
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Top level function to load several Rule Set files. The files are read and their tokens
+ *      obtained by a pool of threads, while the calling thread compiles them in order into the net
+ *      as soon as each one is ready. A Rule Set with errors is freed and the rest are loaded
+ *
+ * @param paths File names
+ * @param n_paths Number of files
+ * @return int TRUE if all were compiled with no errors, FALSE otherwise
+ */
+PUBLIC
+int load_rsets(char **paths, int n_paths)
+{
+  RsetLoad rl;
+  pthread_t threads[MAXLOADTHREADS];
+  int n, n_threads, err, res = TRUE;
+  jmp_buf buff_jmp;
+
+  if (n_paths <= 0)
+    return TRUE;
+
+  // The new nodes are linked to the net that the shards are running
+  Shard::sync();
+
+  rl.files = new RsetFile[n_paths];
+  rl.n_files = n_paths;
+  rl.next = 0;
+  pthread_mutex_init(&rl.lock, NULL);
+  pthread_cond_init(&rl.ready, NULL);
+
+  for (n = 0; n < n_paths; n++)
+  {
+    rl.files[n].path = paths[n];
+    rl.files[n].ready = FALSE;
+  }
+
+  n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_threads > MAXLOADTHREADS)
+    n_threads = MAXLOADTHREADS;
+  if (n_threads > n_paths)
+    n_threads = n_paths;
+  if (n_threads < 1)
+    n_threads = 1;
+
+  for (n = 0; n < n_threads; n++)
+  {
+    if ((err = pthread_create(&threads[n], NULL, read_rset_files, &rl)) != 0)
+      engine_fatal_err("pthread_create: %s\n", strerror(err));
+  }
+
+  // The compilation uses the global state of the parser, a file at once
+  for (n = 0; n < n_paths; n++)
+  {
+    RsetFile *file = &rl.files[n];
+
+    pthread_mutex_lock(&rl.lock);
+    while (!file->ready)
+      pthread_cond_wait(&rl.ready, &rl.lock);
+    pthread_mutex_unlock(&rl.lock);
+
+    if (setjmp(buff_jmp) == 0)
+    {
+      set_return_buff(&buff_jmp);
+
+      if (file->call != NULL)
+      {
+        comp_err("%s: %s\n", file->call, strerror(file->err));
+      }
+
+      read_rset_tokens(&file->tokens);
+    }
+    else
+    {
+      free_curr_ruleset();
+      res = FALSE;
+    }
+
+    free_tokens(&file->tokens);
+  }
+
+  for (n = 0; n < n_threads; n++)
+    pthread_join(threads[n], NULL);
+
+  pthread_cond_destroy(&rl.ready);
+  pthread_mutex_destroy(&rl.lock);
+  delete[] rl.files;
+
+  // Once for all the Rule Sets
+  net_changed();
+
+  return res;
+}
+
 /**
  * @brief Reset package freeing al the node memories
  *  
@@ -291,6 +416,27 @@ void reset_rset(char *name)
   }
 }
 
+/**
+ * @brief Reset the package in the engine selected. Used with Engine::for_each_other
+ * 
+ */
+PRIVATE
+void reset_pkg_of_engine(void *)
+{
+  reset_pkg();
+}
+
+/**
+ * @brief Reset a Rule Set in the engine selected. Used with Engine::for_each_other
+ * 
+ * @param name Name of the rule set 
+ */
+PRIVATE
+void reset_rset_of_engine(void *name)
+{
+  reset_rset((char *)name);
+}
+
 /**
  * @brief Release the full package, as if no package were loaded
  * 
@@ -298,6 +444,12 @@ void reset_rset(char *name)
 PUBLIC
 void free_pkg()
 {
+  // The sharded mode ends with the package
+  Shard::stop_all();
+
+  // The memories of the rest of engines are emptied before the nodes are freed
+  Engine::for_each_other(reset_pkg_of_engine, NULL);
+
   on_ruleset = FALSE;
   free_package();
   ObjClass::delete_all();
@@ -314,6 +466,12 @@ void free_pkg()
 PUBLIC
 void free_rset(char *name)
 {
+  // The shards must be idle while their memories are emptied
+  Shard::sync();
+
+  // The memories of the rest of engines are emptied before the nodes are freed
+  Engine::for_each_other(reset_rset_of_engine, name);
+
   on_ruleset = TRUE;
   n_objs_retract = 0;
 
@@ -323,6 +481,50 @@ void free_rset(char *name)
     Do_loop(FALSE);
     n_objs_retract--;
   }
+
+  net_changed();
+}
+
+/**
+ * @brief Enable or disable the hash memories in the AND nodes loaded from now on.
+ *    The nodes already loaded keep their memories
+ *
+ * @param status TRUE/FALSE
+ */
+PUBLIC
+void set_hash_memories(int status)
+{
+  hash_memories = status;
+}
+
+/**
+ * @brief Enable or disable the B+tree memories in the AND nodes loaded from now on.
+ *    The nodes already loaded keep their memories
+ *
+ * @param status TRUE/FALSE
+ */
+PUBLIC
+void set_bptree_memories(int status)
+{
+  bptree_memories = status;
+}
+
+/**
+ * @brief Choose the memories of an AND node. When all its keys are equalities, that is, the node
+ *    has no range key, the memories of both sides are HashMems (flag IS_HASHED), else BPTrees (flag IS_BPTREE)
+ *    or, with too many keys, multilevel BTrees
+ *
+ * @param pcode Code of the AND node
+ */
+PUBLIC
+void load_and_mem(ULong *pcode)
+{
+  pcode[AND_NODE_FLAGS_POS] &= ~(((IS_HASHED | IS_BPTREE) << 16) | IS_HASHED | IS_BPTREE);
+
+  if (hash_memories && pcode[AND_NODE_NKEYS_POS] > 0 && pcode[AND_NODE_RANGE_POS] == 0)
+    pcode[AND_NODE_FLAGS_POS] |= ((IS_HASHED << 16) | IS_HASHED);
+  else if (bptree_memories && pcode[AND_NODE_NKEYS_POS] <= BP_MAX_KEYS)
+    pcode[AND_NODE_FLAGS_POS] |= ((IS_BPTREE << 16) | IS_BPTREE);
 }
 
 /**
@@ -350,6 +552,7 @@ void load_code(ULong *pcode, int len_code, Node *node)
     case AND:
       code_init = pcode + LEN_AND_NODE + pcode[AND_NODE_NKEYS_POS];
       ((Node::IntFunction *)pcode)[0] = &Node::and_call;
+      load_and_mem(pcode);
       pcode = code_init;
       break;
     case NAND:
@@ -385,7 +588,6 @@ void load_code(ULong *pcode, int len_code, Node *node)
     case TIMER:
       code_init = pcode + LEN_TIMER_NODE;
       ((Node::IntFunction *)pcode)[0] = &Node::timer_call;
-      TimedFuncSubsList = new TimedFuncList(node, pcode, &Node::timer_refresh, TimedFuncSubsList);
       pcode = code_init;
       break;
     case TOR:
@@ -574,6 +776,42 @@ void load_code(ULong *pcode, int len_code, Node *node)
       *pcode++ = (ULong)&Node::concat_call;
       pcode++; // The data
       break;
+    case PCTS | TYPE_NUM:
+      *pcode++ = (ULong)&Node::pctsn_call;
+      pcode++; // The data
+      break;
+    case PCTS | TYPE_FLO:
+      *pcode++ = (ULong)&Node::pctsf_call;
+      pcode++; // The data
+      break;
+    case PCTS | TYPE_STR:
+      *pcode++ = (ULong)&Node::pctsa_call;
+      pcode++; // The data
+      break;
+    case RNKS | TYPE_NUM:
+      *pcode++ = (ULong)&Node::rnksn_call;
+      pcode++; // The data
+      break;
+    case RNKS | TYPE_FLO:
+      *pcode++ = (ULong)&Node::rnksf_call;
+      pcode++; // The data
+      break;
+    case RNKS | TYPE_STR:
+      *pcode++ = (ULong)&Node::rnksa_call;
+      pcode++; // The data
+      break;
+    case DSTS | TYPE_NUM:
+      *pcode++ = (ULong)&Node::dstsn_call;
+      pcode++; // The data
+      break;
+    case DSTS | TYPE_FLO:
+      *pcode++ = (ULong)&Node::dstsf_call;
+      pcode++; // The data
+      break;
+    case DSTS | TYPE_STR:
+      *pcode++ = (ULong)&Node::dstsa_call;
+      pcode++; // The data
+      break;
     case POPS | TYPE_STR:
       *pcode++ = (ULong)&Node::popsa_call;
       pcode++; // The attribute
@@ -667,130 +905,152 @@ void reset_code(ULong *code, int len_code, int free_code)
     case AND:
     {
       code_init = pcode + LEN_AND_NODE + pcode[AND_NODE_NKEYS_POS];
-      BTree *t1 = (BTree *)pcode[AND_NODE_MEM_START_POS + 0];
+      if (pcode[AND_NODE_FLAGS_POS] & IS_HASHED)
+      {
+        Engine::node_hash_mem(pcode[AND_NODE_MEM_START_POS + 0])->Free(del_and_node_mem_item);
+        Engine::node_hash_mem(pcode[AND_NODE_MEM_START_POS + 1])->Free(del_and_node_mem_item);
+        if (free_code)
+        {
+          Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 0]);
+          Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 1]);
+        }
+        pcode = code_init;
+        break;
+      }
+      if (pcode[AND_NODE_FLAGS_POS] & IS_BPTREE)
+      {
+        Engine::node_bp_mem(pcode[AND_NODE_MEM_START_POS + 0])->Free(del_and_node_mem_item);
+        Engine::node_bp_mem(pcode[AND_NODE_MEM_START_POS + 1])->Free(del_and_node_mem_item);
+        if (free_code)
+        {
+          Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 0]);
+          Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 1]);
+        }
+        pcode = code_init;
+        break;
+      }
+      BTree *t1 = Engine::node_mem(pcode[AND_NODE_MEM_START_POS + 0]);
       KeyManager keyman1(LEFT_MEM, LEFT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_AND_NODE);
       t1->setKeyManager(&keyman1);
       t1->Free(del_and_node_mem_item);
       if (free_code)
-        delete t1;
-      BTree *t2 = (BTree *)pcode[AND_NODE_MEM_START_POS + 1];
+        Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 0]);
+      BTree *t2 = Engine::node_mem(pcode[AND_NODE_MEM_START_POS + 1]);
       KeyManager keyman2(RIGHT_MEM, RIGHT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_AND_NODE);
       t2->setKeyManager(&keyman2);
       t2->Free(del_and_node_mem_item);
       if (free_code)
-        delete t2;
+        Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 1]);
       pcode = code_init;
     }
     break;
     case NAND:
     {
       code_init = pcode + LEN_AND_NODE + pcode[AND_NODE_NKEYS_POS];
-      BTree *t1 = (BTree *)pcode[AND_NODE_MEM_START_POS + 0];
+      BTree *t1 = Engine::node_mem(pcode[AND_NODE_MEM_START_POS + 0]);
       KeyManager keyman1(LEFT_MEM, LEFT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_AND_NODE, true);
       t1->setKeyManager(&keyman1);
       t1->Free(del_asym_node_lmem_item);
       if (free_code)
-        delete t1;
-      BTree *t2 = (BTree *)pcode[AND_NODE_MEM_START_POS + 1];
+        Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 0]);
+      BTree *t2 = Engine::node_mem(pcode[AND_NODE_MEM_START_POS + 1]);
       KeyManager keyman2(RIGHT_MEM, RIGHT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_AND_NODE);
       t2->setKeyManager(&keyman2);
       t2->Free(del_and_node_mem_item);
       if (free_code)
-        delete t2;
+        Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 1]);
       pcode = code_init;
     }
     break;
     case OAND:
     {
       code_init = pcode + LEN_AND_NODE + pcode[AND_NODE_NKEYS_POS];
-      BTree *t1 = (BTree *)pcode[AND_NODE_MEM_START_POS + 0];
+      BTree *t1 = Engine::node_mem(pcode[AND_NODE_MEM_START_POS + 0]);
       KeyManager keyman1(LEFT_MEM, LEFT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_AND_NODE, true);
       t1->setKeyManager(&keyman1);
       t1->Free(del_asym_node_lmem_item);
       if (free_code)
-        delete t1;
-      BTree *t2 = (BTree *)pcode[AND_NODE_MEM_START_POS + 1];
+        Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 0]);
+      BTree *t2 = Engine::node_mem(pcode[AND_NODE_MEM_START_POS + 1]);
       KeyManager keyman2(RIGHT_MEM, RIGHT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_AND_NODE);
       t2->setKeyManager(&keyman2);
       t2->Free(del_and_node_mem_item);
       if (free_code)
-        delete t2;
+        Engine::free_mem(pcode[AND_NODE_MEM_START_POS + 1]);
       pcode = code_init;
     }
     break;
     case WAND:
     {
       code_init = pcode + LEN_WAND_NODE + pcode[AND_NODE_NKEYS_POS];
-      BTree *t1 = (BTree *)pcode[WAND_NODE_MEM_START_POS + 0];
+      BTree *t1 = Engine::node_mem(pcode[WAND_NODE_MEM_START_POS + 0]);
       KeyManager keyman1(LEFT_MEM, LEFT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_WAND_NODE);
       t1->setKeyManager(&keyman1);
       t1->Free(del_and_node_mem_item);
       if (free_code)
-        delete t1;
-      BTree *t2 = (BTree *)pcode[WAND_NODE_MEM_START_POS + 1];
+        Engine::free_mem(pcode[WAND_NODE_MEM_START_POS + 0]);
+      BTree *t2 = Engine::node_mem(pcode[WAND_NODE_MEM_START_POS + 1]);
       KeyManager keyman2(RIGHT_MEM, RIGHT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_WAND_NODE);
       t2->setKeyManager(&keyman2);
       t2->Free(del_and_node_mem_item);
       if (free_code)
-        delete t2;
+        Engine::free_mem(pcode[WAND_NODE_MEM_START_POS + 1]);
       pcode = code_init;
     }
     break;
     case NWAND:
     {
       code_init = pcode + LEN_WAND_NODE + pcode[AND_NODE_NKEYS_POS];
-      BTree *t1 = (BTree *)pcode[WAND_NODE_MEM_START_POS + 0];
+      BTree *t1 = Engine::node_mem(pcode[WAND_NODE_MEM_START_POS + 0]);
       KeyManager keyman1(LEFT_MEM, LEFT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_WAND_NODE, true);
       t1->setKeyManager(&keyman1);
       t1->Free(del_asym_node_lmem_item);
       if (free_code)
-        delete t1;
-      BTree *t2 = (BTree *)pcode[WAND_NODE_MEM_START_POS + 1];
+        Engine::free_mem(pcode[WAND_NODE_MEM_START_POS + 0]);
+      BTree *t2 = Engine::node_mem(pcode[WAND_NODE_MEM_START_POS + 1]);
       KeyManager keyman2(RIGHT_MEM, RIGHT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_WAND_NODE);
       t2->setKeyManager(&keyman2);
       t2->Free(del_and_node_mem_item);
       if (free_code)
-        delete t2;
+        Engine::free_mem(pcode[WAND_NODE_MEM_START_POS + 1]);
       pcode = code_init;
     }
     break;
     case OWAND:
     {
       code_init = pcode + LEN_WAND_NODE + pcode[AND_NODE_NKEYS_POS];
-      BTree *t1 = (BTree *)pcode[WAND_NODE_MEM_START_POS + 0];
+      BTree *t1 = Engine::node_mem(pcode[WAND_NODE_MEM_START_POS + 0]);
       KeyManager keyman1(LEFT_MEM, LEFT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_WAND_NODE, true);
       t1->setKeyManager(&keyman1);
       t1->Free(del_asym_node_lmem_item);
       if (free_code)
-        delete t1;
-      BTree *t2 = (BTree *)pcode[WAND_NODE_MEM_START_POS + 1];
+        Engine::free_mem(pcode[WAND_NODE_MEM_START_POS + 0]);
+      BTree *t2 = Engine::node_mem(pcode[WAND_NODE_MEM_START_POS + 1]);
       KeyManager keyman2(RIGHT_MEM, RIGHT_MEM, pcode[AND_NODE_NKEYS_POS], pcode + LEN_WAND_NODE);
       t2->setKeyManager(&keyman2);
       t2->Free(del_and_node_mem_item);
       if (free_code)
-        delete t2;
+        Engine::free_mem(pcode[WAND_NODE_MEM_START_POS + 1]);
       pcode = code_init;
     }
     break;
     case MAKESET:
     {
       code_init = pcode + LEN_SET_NODE;
-      BTree *t = (BTree *)pcode[SET_NODE_MEM_POS];
+      BTree *t = Engine::node_mem(pcode[SET_NODE_MEM_POS]);
       t->Free(del_set_node_mem_item, pcode);
       if (free_code)
-        delete t;
+        Engine::free_mem(pcode[SET_NODE_MEM_POS]);
       pcode = code_init;
     }
     break;
     case TIMER:
     {
       code_init = pcode + LEN_TIMER_NODE;
-      BTree *t = (BTree *)pcode[TIMER_NODE_MEM_POS];
+      BTree *t = Engine::node_mem(pcode[TIMER_NODE_MEM_POS]);
       t->Free(del_and_node_mem_item);
       if (free_code)
-        delete t;
-      if (free_code)
-        TimedFuncList::unsubscribe(pcode, TimedFuncSubsList);
+        Engine::free_mem(pcode[TIMER_NODE_MEM_POS]);
       pcode = code_init;
     }
     break;
@@ -811,7 +1071,7 @@ void reset_code(ULong *code, int len_code, int free_code)
       pcode += 6;      
       break;
     case TCLASS:
-      pcode += 2; // The name of class points to the name buffers inside ObjClass
+      pcode += 2; // The id of the class
       break;
     case TTRUE:
     case TFALSE:
@@ -867,6 +1127,15 @@ void reset_code(ULong *code, int len_code, int free_code)
     case MAXS | TYPE_STR:
     case COUNT:
     case CONCS:
+    case PCTS | TYPE_NUM:
+    case PCTS | TYPE_FLO:
+    case PCTS | TYPE_STR:
+    case RNKS | TYPE_NUM:
+    case RNKS | TYPE_FLO:
+    case RNKS | TYPE_STR:
+    case DSTS | TYPE_NUM:
+    case DSTS | TYPE_FLO:
+    case DSTS | TYPE_STR:
       pcode += 2;
       break;
     case PUSHO:
@@ -884,10 +1153,7 @@ void reset_code(ULong *code, int len_code, int free_code)
       pcode += 2;
       break;
     case PUSH | TYPE_STR:
-      pcode++;
-      if (free_code)
-        free((void *)(*pcode)); // The attribute
-      pcode++;
+      pcode += 2;               // The string is interned
       break;
     case PUSH | TYPE_NUM:
     case PUSH | TYPE_FLO:
@@ -906,10 +1172,10 @@ void reset_code(ULong *code, int len_code, int free_code)
       // when there are implied objects
       
       {
-        BTree *t = (BTree *)pcode[PROD_NODE_MEM_POS];
+        BTree *t = Engine::node_mem(pcode[PROD_NODE_MEM_POS]);
         t->Free(del_prod_node_mem_item, pcode + PROD_START_OBJ_POS, pcode[PROD_NODE_NOBJIMP_POS]);
         if (free_code)
-          delete t;
+          Engine::free_mem(pcode[PROD_NODE_MEM_POS]);
       }
       pcode = code_init;
       break;
@@ -936,15 +1202,34 @@ void reset_code(ULong *code, int len_code, int free_code)
 }
 
 /**
- * @brief Refresh engine calling to the timed functions with a real timestamp in order to free 
- *      those items that are timed or are in some memory at a Time Windowed Rule memory
+ * @brief Refresh engine with a real timestamp in order to free those items that are timed or are in some
+ *      memory at a Time Windowed Rule memory. Only the nodes with items due at that time are visited
  * 
  * @param real_time Time stamp
  */
 PUBLIC
 void engine_refresh(long real_time)
 {
-  TimedFuncSubsList->refresh(real_time);
+  if (Shard::routed())
+  {
+    Shard::refresh(real_time);
+    return;
+  }
+  Node::timer_refresh_due(real_time);
+
+  if (!Engine::current()->_in_the_loop)
+    Engine::current()->_snaps->serve();
+}
+
+/**
+ * @brief First time when engine_refresh will retract some object out of its time window
+ * 
+ * @return long The time stamp, -1 if there is no object in a time window
+ */
+PUBLIC
+long engine_next_expiry()
+{
+  return Node::timer_next_due();
 }
 
 /**
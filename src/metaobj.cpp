@@ -21,6 +21,8 @@
 #include "set.hpp"
 #include "load.hpp"
 
+int MetaObj::_atomic_links = FALSE;
+
 /**
  * @brief Calculates the final time window when joining this MetaObj to another and having into account if this 
  *    or the other object are timed or not in the current rule
@@ -54,15 +56,14 @@ MetaObj::comp_window(MetaObj *other, long &t1, long &t2, int w_this, int w_other
  * 
  * @param c_obj1 The first object 
  * @param c_obj2 The other object
- * @param list variable list of arguments to be passed o the compare function
  * @return int <0, 0, or >0
  */
 // static
 int
-MetaObj::metacmp(const void *c_obj1, const void *c_obj2, va_list list)
+MetaObj::metacmp(const void *c_obj1, const void *c_obj2, va_list)
 {
    // Segun la funcion de comparacion del obj en el arbol (c_obj2)
-   return ((MetaObj *)c_obj2)->compare((MetaObj *&)c_obj1, list);
+   return Compare()(c_obj1, c_obj2);
 }
 
 /**
@@ -88,18 +89,13 @@ MetaObj::metacmp_objs(const void *c_obj1, const void *c_obj2, va_list list)
  * 
  * @param c_obj1 The first object 
  * @param c_obj2 The other object
- * @param list variable list of arguments to be passed o the compare function
  * @return int <0, 0, or >0
  */
 int
-MetaObj::compare_t(const void *c_obj1, const void *c_obj2, va_list list)
+MetaObj::compare_t(const void *c_obj1, const void *c_obj2, va_list)
 {
-  int res;
   // Para conseguir una ordenacion de mayor a menor T
-  if ((res = ((MetaObj *)c_obj2)->_t2 - ((MetaObj *)c_obj1)->_t2) == 0)
-     res = ((MetaObj *)c_obj2)->compare((MetaObj *&)c_obj1, list);
-
-  return res;
+  return CompareT()(c_obj1, c_obj2);
 }
 
 /**
@@ -124,7 +120,7 @@ MetaObj::compare_tw(const void *c_obj1, const void *c_obj2, va_list list)
   va_end(copy);
 
   // It is ordered from higher to lower T
-  return ((MetaObj *)c_obj2)->_t2 - t2_limit;
+  return CompareTW(t2_limit)(c_obj1, c_obj2);
 }
 
 /**
@@ -188,7 +184,10 @@ MetaObj::print_tree(const void *item, va_list list)
 void
 MetaObj::link()
 {
-  _links++;
+  if (_atomic_links)
+    __atomic_add_fetch(&_links, 1, __ATOMIC_RELAXED);
+  else
+    _links++;
   if (trace >= 2){
     fprintf(trace_file, "## INC LINKS of %s %lx  to %d\n",(_type == SINGLE)?"SINGLE":(_type == COMPOUND)?"COMPOUND":"SET", (unsigned long int)this,_links);
     if (_type == SINGLE)
@@ -206,7 +205,12 @@ MetaObj::link()
 void
 MetaObj::unlink()
 {
-  _links--;
+  int links;
+
+  if (_atomic_links)
+    links = __atomic_sub_fetch(&_links, 1, __ATOMIC_ACQ_REL);
+  else
+    links = --_links;
 
   if (trace >= 2){
     fprintf(trace_file, "## DEC LINKS of %s %lx  to %d\n",(_type == SINGLE)?"SINGLE":(_type == COMPOUND)?"COMPOUND":"SET", (unsigned long int)this,_links);
@@ -214,7 +218,7 @@ MetaObj::unlink()
       fprintf(trace_file, "!! %lx\n", (unsigned long int)single()->obj());
   }
 
-  if (trace >= 2 && _links == 0)
+  if (trace >= 2 && links == 0)
   {
     if (_type == SINGLE)
       fprintf(trace_file, "UNLINK : Se borra el single 0x%lx %s\n",  (unsigned long int)this, clave(this->single()->obj()));
@@ -224,7 +228,15 @@ MetaObj::unlink()
       fprintf(trace_file, "UNLINK : Se borra un SET 0x%lx\n",  (unsigned long int)this);
   }
 
-  if (_links == 0)
-    delete this;
+  // Each class is freed in its own Slab
+  if (links == 0)
+  {
+    if (_type == SINGLE)
+      delete single();
+    else if (_type == COMPOUND)
+      delete compound();
+    else
+      delete set();
+  }
 }
 
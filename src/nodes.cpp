@@ -23,6 +23,15 @@
 #include "load.hpp"
 #include "eng.hpp"
 #include "status.hpp"
+#include "context.hpp"
+#include "parallel.hpp"
+
+ULong Node::_n_changes = 0;
+PRIVATE int alpha_sort_type;   /* Type of the constants sorted by cmp_alpha_entries */
+PRIVATE int range_keys = TRUE;
+Slab MatchCount::_slab("MatchCount", sizeof(MatchCount));
+Slab SetExpiry::_slab("SetExpiry", sizeof(SetExpiry));
+Slab TimerDue::_slab("TimerDue", sizeof(TimerDue));
 
 struct Context
 {
@@ -61,10 +70,17 @@ Node::Node(int type, int lcode, ULong *codes)
    _n_items_r   = 0;
    _curr_pos    = 0;
    _mark        = (IN_RULE_MARK | IN_PATH_MARK);
+   _mark_slot   = Engine::new_mark();
    _n_paths     = 1;
    _eq_node_left  = NULL;
    _eq_node_right = NULL;
    _fork	    = NULL;
+   _par_fork      = NULL;
+   _par_stamp     = 0;
+   _par_group     = 0;
+   _dispatch      = NULL;
+   _alpha         = NULL;
+   _alpha_stamp   = 0;
    _parent_left   = NULL;
    _parent_right  = NULL;
 
@@ -88,8 +104,15 @@ Node::Node(Node const &copy)
     _n_items_r   = copy._n_items_r;
     _curr_pos    = copy._curr_pos;
     _mark        = (IN_RULE_MARK | IN_PATH_MARK);
+    _mark_slot   = Engine::new_mark();
     _n_paths     = 1;
     _fork          = NULL;  // Will control all the children node. Are structs with { side, node and next }
+    _par_fork      = NULL;
+    _par_stamp     = 0;
+    _par_group     = 0;
+    _dispatch      = NULL;
+    _alpha         = NULL;
+    _alpha_stamp   = 0;
     _parent_left   = NULL;
     _parent_right  = NULL;
 
@@ -159,6 +182,10 @@ Node::~Node()
 
     if (_code != NULL)
         reset_code(_code, _lcode, TRUE);
+
+    Parallel::free_fork(_par_fork);
+    free_class_dispatch();
+    free_alpha_index();
 }
 
 //
@@ -242,6 +269,36 @@ Node::last_child()
     }
 }
 
+/**
+ * @brief Check if the node can be executed in a parallel propagation of an insertion (see parallel.cpp).
+ *        Its memories, if any, are only reached from its parents and it does not run external code.
+ *        The negations, optionals, sets and timers are excluded due an insertion can become a retraction
+ *        (that executes rules) or a new inference at these nodes
+ * 
+ * @return int TRUE if safe
+ */
+int
+Node::par_safe()
+{
+    int n;
+
+    // The RHS of the rule is not executed on insertion
+    if (_type == INTER_PROD)
+        return TRUE;
+
+    if (_type != INTRA && _type != INTER_AND)
+        return FALSE;
+
+    for (n = 0; n < _lcode; n++)
+    {
+        if (_code[n] == (ULong)&Node::user_func_call ||
+            _code[n] == (ULong)&Node::user_proc_call ||
+            _code[n] == (ULong)&Node::timer_call)
+            return FALSE;
+    }
+    return TRUE;
+}
+
 /**
  * @brief Get the side
  * 
@@ -274,6 +331,7 @@ Node::connect_node(Node *parent, int side)
     NodeLink **pos_ins;
     int has_children;
 
+    _n_changes++;
     has_children = (parent->_fork != NULL);
 
     for (pos_ins = &(parent->_fork);
@@ -317,6 +375,8 @@ Node::disconnect_node(Node *parent, int side)
     if (parent == NULL)
         return;
 
+    _n_changes++;
+
     if (parent == parent_node(side))
     {
         if (side == LEFT_MEM)
@@ -452,6 +512,18 @@ Node::get_obj_pos_after(int *pos)
 // NODE CODE MANAGEMENT
 //
 
+/**
+ * @brief Enable or disable the range keys of the AND nodes loaded from now on.
+ *    Without them the comparison is only checked by the code of the node
+ *
+ * @param status TRUE/FALSE
+ */
+PUBLIC
+void set_range_keys(int status)
+{
+  range_keys = status;
+}
+
 /**
  * @brief add a code of length code_len to this node
  * 
@@ -469,26 +541,43 @@ Node::add_code(int code_len, ULong *code, int check_set_node)
         if (is_inter() && _lcode > AND_NODE_CODELEN_POS)
         {
             int nkeys;
+            ULong range;
             ULong *keysInfo;
-            keysInfo = getInterKeysInCode(code, code_len, &nkeys);
+            keysInfo = getInterKeysInCode(code, code_len, &nkeys, &range);
             int len_and = (is_inter_w() ? LEN_WAND_NODE : LEN_AND_NODE);
 
-            if (nkeys>0)
+            // Only the AND nodes take a range key, and only one
+            if (range != 0 && (!range_keys || _code[0] != (ULong)&Node::and_call || _code[AND_NODE_RANGE_POS] != 0))
+                range = 0;
+
+            if (nkeys>0 || range != 0)
             {
-                int inc_len = nkeys + code_len - (5 * nkeys);
+                int new_keys = nkeys + (range != 0);
+                int inc_len = new_keys + code_len - (5 * nkeys);
                 _code = (ULong *)realloc((void*)(_code), (_lcode+inc_len) * sizeof(ULong));
                 
                 ULong *lastKeyOffset = _code+ len_and + _code[AND_NODE_NKEYS_POS];
                 if (_lcode - len_and -_code[AND_NODE_NKEYS_POS])
-                    memmove(lastKeyOffset+nkeys, lastKeyOffset, (_lcode - len_and -_code[AND_NODE_NKEYS_POS])*sizeof(ULong));
-                memcpy(lastKeyOffset, keysInfo, nkeys*sizeof(ULong));
-                _code[AND_NODE_NKEYS_POS] += nkeys;
+                    memmove(lastKeyOffset+new_keys, lastKeyOffset, (_lcode - len_and -_code[AND_NODE_NKEYS_POS])*sizeof(ULong));
+
+                // The range key is always the last one
+                if (!is_inter_w() && _code[AND_NODE_RANGE_POS] != 0)
+                {
+                    lastKeyOffset--;
+                    lastKeyOffset[new_keys] = lastKeyOffset[0];
+                }
+                memcpy(lastKeyOffset, keysInfo, new_keys*sizeof(ULong));
+                _code[AND_NODE_NKEYS_POS] += new_keys;
+                if (range != 0)
+                    _code[AND_NODE_RANGE_POS] = range;
+                if (_code[0] == (ULong)&Node::and_call)
+                    load_and_mem(_code);
 
                 if (code_len - (5 * nkeys))
                 {
-                    memcpy(_code + _lcode + nkeys, code + (5 * nkeys), code_len - (5 * nkeys));
+                    memcpy(_code + _lcode + new_keys, code + (5 * nkeys), (code_len - (5 * nkeys)) * sizeof(ULong));
                     _code[AND_NODE_CODELEN_POS] += code_len - (5 * nkeys);
-                    load_code(_code + _lcode+ nkeys, code_len - (5 * nkeys), this);
+                    load_code(_code + _lcode + new_keys, code_len - (5 * nkeys), this);
                 }
                 _lcode += inc_len;
 
@@ -1118,18 +1207,18 @@ Node::insert_intra_node(Node **last_intra, Node *real_root, int code_len, ULong
  *      this must be the root node
  * 
  * @param last_intra Last intra node
- * @param class_name 
+ * @param class_id Id of the class checked
  * @param own_check In case of FALSE it joins the rest of the INTRA nodes below last_intra even
  *      if this may represent that that last_intra has two parents by left. 
  *      In case of a subclass the last_intra are the INTRA nodes below the superclass checks
- *      and the class_name will be the subclassname
+ *      and the class_id will be the one of the subclass
  *          A1 is a subclass of A
  *                  A A1
  *                   B  (empty node, both joining by left)
  *                   C
  */
 void
-Node::insert_class_check(Node **last_intra, char *class_name, int own_check)
+Node::insert_class_check(Node **last_intra, int class_id, int own_check)
 {
     Node *last, *tclass_node;
     ULong codes[2];
@@ -1142,7 +1231,7 @@ Node::insert_class_check(Node **last_intra, char *class_name, int own_check)
     else
         last = (*last_intra); // There are some intra nodes below that class
     codes[0] = TCLASS;
-    codes[1] = (ULong)class_name;
+    codes[1] = (ULong)class_id;
 
     // we add the TCLASS code in the empty node and we create a new empty node below (new last_intra)
     tclass_node = insert_intra_node(&last, this, 2, codes); 
@@ -1163,6 +1252,299 @@ Node::insert_class_check(Node **last_intra, char *class_name, int own_check)
     }
 }
 
+/**
+ * @brief Build again the children of the root by class. Called when the net has been changed
+ *      An object only goes to the children whose TCLASS is its class and to those without TCLASS (if any).
+ *      The superclasses are not needed: each class has its own TCLASS joined to the nodes of its superclasses
+ *      Each list keeps the order of the children of the root
+ */
+void
+Node::build_class_dispatch()
+{
+    ClassDispatch *disp;
+    Node *child;
+    int side, n, c, n_classes, class_id, *pos;
+    NodeIter iter;
+
+    free_class_dispatch();
+
+    n_classes = ObjClass::n_classes();
+
+    disp = (ClassDispatch *)malloc(sizeof(ClassDispatch));
+    disp->_n_classes = n_classes;
+    disp->_first = (int *)calloc(n_classes + 2, sizeof(int));
+    pos = (int *)malloc((n_classes + 1) * sizeof(int));
+
+    // Count of children by class. Those without TCLASS are for all the classes
+
+    for (child = first_child(side, iter); child != NULL; child = next_child(side, iter))
+    {
+        if ((class_id = child->class_checked()) != CLASS_UNKNOWN && class_id < n_classes)
+            disp->_first[class_id + 1]++;
+        else
+            for (c = 0; c <= n_classes; c++)
+                disp->_first[c + 1]++;
+    }
+
+    for (c = 0; c <= n_classes; c++)
+    {
+        pos[c] = disp->_first[c];
+        disp->_first[c + 1] += disp->_first[c];
+    }
+
+    n = disp->_first[n_classes + 1];
+    disp->_child = (Node **)malloc((n + 1) * sizeof(Node *));
+    disp->_side = (int *)malloc((n + 1) * sizeof(int));
+    disp->_skip = (int *)malloc((n + 1) * sizeof(int));
+
+    for (child = first_child(side, iter); child != NULL; child = next_child(side, iter))
+    {
+        if ((class_id = child->class_checked()) != CLASS_UNKNOWN && class_id < n_classes)
+        {
+            disp->_child[pos[class_id]] = child;
+            disp->_side[pos[class_id]] = side;
+            disp->_skip[pos[class_id]++] = 2;
+        }
+        else
+        {
+            for (c = 0; c <= n_classes; c++)
+            {
+                disp->_child[pos[c]] = child;
+                disp->_side[pos[c]] = side;
+                disp->_skip[pos[c]++] = 0;
+            }
+        }
+    }
+
+    free(pos);
+
+    disp->_version = _n_changes;
+    _dispatch = disp;
+}
+
+/**
+ * @brief Free the children by class of the root
+ * 
+ */
+void
+Node::free_class_dispatch()
+{
+    if (_dispatch == NULL)
+        return;
+
+    free(_dispatch->_first);
+    free(_dispatch->_child);
+    free(_dispatch->_side);
+    free(_dispatch->_skip);
+    free(_dispatch);
+    _dispatch = NULL;
+}
+
+/**
+ * @brief Compare two constants of an AlphaIndex as TEQ does: the strings by their content (NULL is the lowest)
+ * 
+ * @param type TYPE_NUM or TYPE_STR
+ * @param key1 First constant
+ * @param key2 Second constant
+ * @return int <0, 0 or >0
+ */
+int
+Node::alpha_cmp(int type, ULong key1, ULong key2)
+{
+    if (type == TYPE_NUM)
+        return ((long)key1 < (long)key2) ? -1 : ((long)key1 > (long)key2);
+
+    if (key1 == key2)
+        return 0;
+    if (key1 == 0)
+        return -1;
+    if (key2 == 0)
+        return 1;
+    return strcmp((char *)key1, (char *)key2);
+}
+
+/**
+ * @brief Order of the entries of an AlphaIndex, by constant and then by child
+ * 
+ */
+PRIVATE
+int cmp_alpha_entries(const void *e1, const void *e2)
+{
+    const AlphaEntry *entry1 = (const AlphaEntry *)e1, *entry2 = (const AlphaEntry *)e2;
+    int res = Node::alpha_cmp(alpha_sort_type, entry1->_key, entry2->_key);
+
+    return (res != 0) ? res : entry1->_child - entry2->_child;
+}
+
+/**
+ * @brief Check if the code of this node begins testing an attribute of the object against a constant
+ *      (PUSHS attr, PUSH value, TEQ). Only integers (also CHAR and BOOL) and strings
+ * 
+ * @param type Where to write TYPE_NUM or TYPE_STR
+ * @param operand Where to write the operand of PUSHS
+ * @param key Where to write the constant
+ * @return int TRUE if it is such a test
+ */
+int
+Node::alpha_test(int &type, ULong &operand, ULong &key)
+{
+    if (_type != INTRA || _lcode < 5 || _code[0] != (ULong)&Node::pushs_call ||
+        ((_code[1] >> 15) & 0x1) != LEFT_MEM)
+        return FALSE;
+
+    if (_code[2] == (ULong)&Node::push_call && _code[4] == (ULong)&Node::teqn_call)
+        type = TYPE_NUM;
+    else if (_code[2] == (ULong)&Node::pusha_call && _code[4] == (ULong)&Node::teqa_call)
+        type = TYPE_STR;
+    else
+        return FALSE;
+
+    operand = _code[1];
+    key = _code[3];
+    return TRUE;
+}
+
+/**
+ * @brief Build again the indexes of the INTRA nodes below this one. Called when the net has been changed
+ * 
+ * @param stamp Stamp of the walk, to visit once the nodes with several parents
+ */
+void
+Node::build_alpha_indexes(ULong stamp)
+{
+    Node *child;
+    int side;
+    NodeIter iter;
+
+    if (_alpha_stamp == stamp)
+        return;
+    _alpha_stamp = stamp;
+
+    build_alpha_index();
+
+    for (child = first_child(side, iter); child != NULL; child = next_child(side, iter))
+        if (child->_type == INTRA)
+            child->build_alpha_indexes(stamp);
+}
+
+/**
+ * @brief Build the index of the children that test the same attribute against different constants
+ *      e.g. classX(type 3 ...), classX(type 7 ...). When an object arrives, the value of its attribute
+ *      is looked up once instead of executing the test of each child
+ *      If several attributes are tested by the children, the index is built for the most tested one
+ */
+void
+Node::build_alpha_index()
+{
+    AlphaIndex *alpha;
+    Node *child;
+    int side, n, m, n_children, count, best_count, type, best_type;
+    ULong operand, best_operand, key;
+    NodeIter iter;
+
+    free_alpha_index();
+
+    if (_type != INTRA)
+        return;
+
+    for (n_children = 0, child = first_child(side, iter); child != NULL; child = next_child(side, iter))
+        n_children++;
+
+    if (n_children < 2)
+        return;
+
+    alpha = (AlphaIndex *)malloc(sizeof(AlphaIndex));
+    alpha->_n_children = n_children;
+    alpha->_child = (Node **)malloc(n_children * sizeof(Node *));
+    alpha->_side = (int *)malloc(n_children * sizeof(int));
+
+    for (n = 0, child = first_child(side, iter); child != NULL; child = next_child(side, iter), n++)
+    {
+        alpha->_child[n] = child;
+        alpha->_side[n] = side;
+    }
+
+    // The attribute tested by more children
+
+    best_count = 0;
+    best_type = TYPE_NUM;
+    best_operand = 0;
+
+    for (n = 0; n < n_children; n++)
+    {
+        if (alpha->_side[n] != LEFT_MEM || !alpha->_child[n]->alpha_test(type, operand, key))
+            continue;
+
+        for (count = 0, m = n; m < n_children; m++)
+        {
+            ULong operand2, key2;
+            int type2;
+
+            if (alpha->_side[m] == LEFT_MEM && alpha->_child[m]->alpha_test(type2, operand2, key2) &&
+                type2 == type && operand2 == operand)
+                count++;
+        }
+
+        if (count > best_count)
+        {
+            best_count = count;
+            best_type = type;
+            best_operand = operand;
+        }
+    }
+
+    if (best_count < 2)
+    {
+        free(alpha->_child);
+        free(alpha->_side);
+        free(alpha);
+        return;
+    }
+
+    alpha->_type = best_type;
+    alpha->_operand = best_operand;
+    alpha->_n_entries = 0;
+    alpha->_entries = (AlphaEntry *)malloc(best_count * sizeof(AlphaEntry));
+    alpha->_n_rest = 0;
+    alpha->_rest = (int *)malloc(n_children * sizeof(int));
+
+    for (n = 0; n < n_children; n++)
+    {
+        if (alpha->_side[n] == LEFT_MEM && alpha->_child[n]->alpha_test(type, operand, key) &&
+            type == best_type && operand == best_operand)
+        {
+            alpha->_entries[alpha->_n_entries]._key = key;
+            alpha->_entries[alpha->_n_entries++]._child = n;
+        }
+        else
+            alpha->_rest[alpha->_n_rest++] = n;
+    }
+
+    alpha_sort_type = best_type;
+    qsort(alpha->_entries, alpha->_n_entries, sizeof(AlphaEntry), cmp_alpha_entries);
+
+    alpha->_version = _n_changes;
+    _alpha = alpha;
+}
+
+/**
+ * @brief Free the index of the children of this node
+ * 
+ */
+void
+Node::free_alpha_index()
+{
+    if (_alpha == NULL)
+        return;
+
+    free(_alpha->_child);
+    free(_alpha->_side);
+    free(_alpha->_rest);
+    free(_alpha->_entries);
+    free(_alpha);
+    _alpha = NULL;
+}
+
 
 //
 // OPTIMIZATION OF INTRA NODES
@@ -1736,13 +2118,13 @@ Node::create_AND_node(int type, ULong l_flags, ULong r_flags, Node *p_left, Node
     if (p_left->is_inter())
     {
         l_flags = p_left->_code[AND_NODE_FLAGS_POS];
-        l_flags = ((l_flags >> 16) | l_flags ) & 0xFFFF;
+        l_flags = ((l_flags >> 16) | l_flags ) & 0xFFFF & ~(IS_HASHED | IS_BPTREE);
     }
 
     if (p_right->is_inter())
     {
         r_flags = p_right->_code[AND_NODE_FLAGS_POS];
-        r_flags = ((r_flags >> 16) | r_flags ) & 0xFFFF;
+        r_flags = ((r_flags >> 16) | r_flags ) & 0xFFFF & ~(IS_HASHED | IS_BPTREE);
     }
 
     if (_curr_window_time != NO_TIMED && 
@@ -1762,8 +2144,8 @@ Node::create_AND_node(int type, ULong l_flags, ULong r_flags, Node *p_left, Node
         codes[AND_NODE_FLAGS_POS]   = ((l_flags << 16) | (r_flags & 0xFFFF)); // Flags L and R
         codes[WAND_NODE_WTIME_POS]  = _curr_window_time;
         // Memories
-        codes[WAND_NODE_MEM_START_POS]     = (ULong) new BTree(); 
-        codes[WAND_NODE_MEM_START_POS + 1] = (ULong) new BTree(); 
+        codes[WAND_NODE_MEM_START_POS]     = Engine::new_mem(); 
+        codes[WAND_NODE_MEM_START_POS + 1] = Engine::new_mem(); 
         node = new Node(type, LEN_WAND_NODE, codes);
     }
     else
@@ -1780,9 +2162,10 @@ Node::create_AND_node(int type, ULong l_flags, ULong r_flags, Node *p_left, Node
         codes[AND_NODE_N_ITEMS_POS] = 0;              // Number of items by left and right will be set at connection
         codes[AND_NODE_NKEYS_POS] =0;                 // Number of keys in the memories
         codes[AND_NODE_FLAGS_POS]   = ((l_flags << 16) | (r_flags & 0xFFFF)); // Flags L and R
+        codes[AND_NODE_RANGE_POS]   = 0;              // Range key, set with the keys
         // Memories
-        codes[AND_NODE_MEM_START_POS]     = (ULong) new BTree(); 
-        codes[AND_NODE_MEM_START_POS + 1] = (ULong) new BTree();
+        codes[AND_NODE_MEM_START_POS]     = Engine::new_mem(); 
+        codes[AND_NODE_MEM_START_POS + 1] = Engine::new_mem();
         node = new Node(type, LEN_AND_NODE, codes);
     }
     return node;
@@ -1804,7 +2187,7 @@ Node::create_TIMER_node(Node **last_intra, Node *real_root, int window)
 
     code[0] = TIMER;
     code[TIMER_NODE_WINDOW_POS] = window;
-    code[TIMER_NODE_MEM_POS] = (ULong) new BTree();
+    code[TIMER_NODE_MEM_POS] = Engine::new_mem();
 
     node = insert_intra_node(last_intra, real_root, LEN_TIMER_NODE, code);
     return node;
@@ -1825,7 +2208,7 @@ Node::create_SET_node(int first_pos, int n_objs)
     ULong code[LEN_SET_NODE];
 
     code[0] = MAKESET;
-    code[SET_NODE_MEM_POS] = (ULong) new BTree();
+    code[SET_NODE_MEM_POS] = Engine::new_mem();
     code[SET_NODE_CODELEN_POS] = 0L;  // Length of internal code
     code[SET_NODE_N_ITEMS_POS] = n_objs;
     code[SET_NODE_FIRST_ITEM_POS] = (first_pos << 8);
@@ -2181,6 +2564,9 @@ Node::shift_code(int side, int begin_shift, int how_many)
                     case PUSHT:
                     case COUNT:
                     case CONCS:
+                    case PCTS:
+                    case RNKS:
+                    case DSTS:
                     case SUMS:
                     case PRDS:
                     case MINS:
@@ -2303,6 +2689,9 @@ Node::move_code_mem(int side, int offset_pos)
                     case PUSHT:
                     case COUNT:
                     case CONCS:
+                    case PCTS:
+                    case RNKS:
+                    case DSTS:
                     case SUMS:
                     case PRDS:
                     case MINS:
@@ -2510,13 +2899,18 @@ Node::delete_AND_shortcut(Node *set_node_parent)
  *        This way makes incredibly faster, given al object, to find the other that accomplish with
  *        these conditions  
  * 
+ *        After them, a comparison between 2 numeric attributes (PUSH + PUSH + TLT, TLE, TGT or TGE) is returned
+ *        as a range key, stored after the others in the keys array. Its code is not removed, the range key only
+ *        bounds the items walked
+ * 
  * @param code Node code array
  * @param code_len length of code
  * @param nkey number of keys found
+ * @param range where to store the comparison of the range key (left OP right), 0 if there is not
  * @return ULong* Arrays of keys (to be copied some where due this is an static memory)
  */
 ULong *
-Node::getInterKeysInCode(ULong *code, int code_len, int *nkey)
+Node::getInterKeysInCode(ULong *code, int code_len, int *nkey, ULong *range)
 {
 
     /* Codification side + position + attr
@@ -2563,6 +2957,31 @@ Node::getInterKeysInCode(ULong *code, int code_len, int *nkey)
         }
         if (!ok) break;
     }
+
+    *range = 0;
+    if (offset+5<=code_len &&
+        (code[offset] == (PUSHS | TYPE_NUM) || code[offset] == (PUSHS | TYPE_FLO)) &&
+        code[offset + 2] == code[offset] &&
+        (code[offset+1] & 0x8000) != (code[offset+3] & 0x8000))
+    {
+        ULong op = code[offset + 4] & ~0x3;
+
+        if ((code[offset + 4] & 0x3) == (code[offset] & 0x3) &&
+            (op == TLT || op == TLE || op == TGT || op == TGE))
+        {
+            if (((code[offset+1] >>15) & 0x1) == RIGHT_MEM)
+            {
+                // right OP left is left OP' right
+                Keys[*nkey] = (((code[offset+3] & 0x7FFF) << 15) | (code[offset+1] & 0x7FFF) | ((code[offset]&0x3)<<30));
+                *range = (op == TLT) ? TGT : (op == TLE) ? TGE : (op == TGT) ? TLT : TLE;
+            }
+            else
+            {
+                Keys[*nkey] = (((code[offset+1] & 0x7FFF) << 15) | (code[offset+3] & 0x7FFF) | ((code[offset]&0x3)<<30));
+                *range = op;
+            }
+        }
+    }
     return Keys;
 }
 
@@ -29,13 +29,15 @@
 #include "eng.hpp"
 #include "confset.hpp"
 #include "keys.hpp"
+#include "btreet.hpp"
+#include "context.hpp"
+#include "parallel.hpp"
 
-ULong *Node::code_p;						/* Execution pointer					*/
-Value Node::data_stack[DATA_STACK_SIZE]; 	/* Data stack							*/
-Value *Node::dstack_p;						/* Pointer to the Data Stack			*/
-BTree Node::conflict_set_mem[3];			/* Memories for teh Conflict Set		*/
-int Node::cmp_result;						/* For the order relations in Sets	 	*/
-int Node::checkingScope = FALSE;			/* Flag to expore scope on modifications*/
+ENGINE_TLS ULong *Node::code_p;						/* Execution pointer					*/
+ENGINE_TLS Value Node::data_stack[DATA_STACK_SIZE]; 	/* Data stack							*/
+ENGINE_TLS Value *Node::dstack_p;						/* Pointer to the Data Stack			*/
+ENGINE_TLS int Node::cmp_result;						/* For the order relations in Sets	 	*/
+ENGINE_TLS int Node::checkingScope = FALSE;			/* Flag to expore scope on modifications*/
 
 
 //
@@ -117,6 +119,18 @@ int Node::propagate(ExecData &data, ULong *codep)
 	res_global = 0;
 	if (res >0)
 	{
+		// The independent subnets of the children can be propagated by the pool of threads
+		if (_par_fork != NULL && data.tag == INSERT_TAG && !checkingScope && Parallel::enabled() && Parallel::propagate(this, data))
+			return 0;
+
+		// From the root only to the children of the class of the object
+		if (_dispatch != NULL && class_dispatch())
+			return propagate_by_class(data);
+
+		// Only to the children that test the value of the attribute of the object
+		if (_alpha != NULL && alpha_index())
+			return propagate_by_alpha(data);
+
 		for (child = first_child(side_child, iter); child != NULL; child = next_child(side_child, iter))
 		{
 			// When reached a memory node (INTER) is not needed to propagate beyond
@@ -130,7 +144,7 @@ int Node::propagate(ExecData &data, ULong *codep)
 			if (res == NODE_REACHED)
 			{
 				res_global = NODE_REACHED;
-				_mark |= data.tag;
+				Engine::node_mark(_mark_slot) |= data.tag;
 			}
 		}
 
@@ -140,7 +154,7 @@ int Node::propagate(ExecData &data, ULong *codep)
 		if (res == NODE_REACHED)
 		{
 			// In modification we can reach a memory node (INTER) by both sides so we make an OR |
-			_mark |= (data.side == LEFT_MEM ? REACHED_BY_LEFT : REACHED_BY_RIGHT);
+			Engine::node_mark(_mark_slot) |= (data.side == LEFT_MEM ? REACHED_BY_LEFT : REACHED_BY_RIGHT);
 		}
 		res_global = res;
 	}
@@ -149,7 +163,7 @@ int Node::propagate(ExecData &data, ULong *codep)
 }
 
 /**
- * @brief Execute the nodes with _mark == NODE_REACHED with the tag from tha parent (data.tag)
+ * @brief Execute the nodes with mark == NODE_REACHED with the tag from tha parent (data.tag)
  * 
  * @param data struct that maintain the structure by left, by right, the tab, 
  * 		  the position of the main user object affected of the tag, etc.
@@ -160,12 +174,13 @@ void Node::propagate_reached_nodes(ExecData &data, ULong *codep)
 	Node *child;
 	int side_child;
 	NodeIter iter;
+	int mark = Engine::node_mark(_mark_slot);
 
 	if (codep == NULL) codep = _code;
 
-	if (_mark == NO_MARK) return;
+	if (mark == NO_MARK) return;
 
-	if ((_mark & REACHED_BY_LEFT) || (_mark & REACHED_BY_RIGHT))
+	if ((mark & REACHED_BY_LEFT) || (mark & REACHED_BY_RIGHT))
 	{
 		// The memory nodes are able to continue the propagation by themshelf
 		if (trace >= 2)
@@ -175,7 +190,7 @@ void Node::propagate_reached_nodes(ExecData &data, ULong *codep)
 		}
 
 		// Reset of the mark deppending of the side we are arriving the node at
-		_mark &= ~(data.side == LEFT_MEM ? REACHED_BY_LEFT : REACHED_BY_RIGHT);
+		Engine::node_mark(_mark_slot) &= ~(data.side == LEFT_MEM ? REACHED_BY_LEFT : REACHED_BY_RIGHT);
 
 		if (codep < _code + _lcode)
 		{
@@ -188,16 +203,152 @@ void Node::propagate_reached_nodes(ExecData &data, ULong *codep)
 				data.left->set_state(NEW_ST, data.st, data.pos);
 		}
 	}
+	else if (_dispatch != NULL && class_dispatch())
+	{
+		propagate_reached_by_class(data, mark);
+		Engine::node_mark(_mark_slot) = NO_MARK;
+	}
 	else
 	{
 		for (child = first_child(side_child, iter); child != NULL; child = next_child(side_child, iter))
 		{
-			// we take the propagation tag from the _mark
-			data.tag = _mark;
+			// we take the propagation tag from the mark
+			data.tag = mark;
 			data.side = side_child;
 			child->propagate_reached_nodes(data);
 		}
-		_mark = NO_MARK;
+		Engine::node_mark(_mark_slot) = NO_MARK;
+	}
+}
+
+/**
+ * @brief Propagation from the root to the children of the class of the object, see build_class_dispatch
+ * 		Their TCLASS is not executed again
+ * 
+ * @param data Execution data, the object is at the left
+ * @return int NODE_REACHED or 0
+ */
+int Node::propagate_by_class(ExecData &data)
+{
+	int res, res_global = 0, n, end;
+	ObjClass *the_class = ObjClass::class_of((*data.left)[0]->single()->obj());
+	int class_id = (the_class != NULL) ? the_class->id() : _dispatch->_n_classes;
+
+	if (class_id > _dispatch->_n_classes)
+		class_id = _dispatch->_n_classes;
+
+	end = _dispatch->_first[class_id + 1];
+	for (n = _dispatch->_first[class_id]; n < end; n++)
+	{
+		data.side = _dispatch->_side[n];
+		res = _dispatch->_child[n]->propagate(data, _dispatch->_child[n]->_code + _dispatch->_skip[n]);
+
+		if (res == NODE_REACHED)
+		{
+			res_global = NODE_REACHED;
+			Engine::node_mark(_mark_slot) |= data.tag;
+		}
+	}
+
+	return res_global;
+}
+
+/**
+ * @brief Propagation to the children of an INTRA node with an AlphaIndex, see build_alpha_index
+ * 		The value of the attribute is looked up in the constants of the index, and the children that
+ * 		test other constants are not visited. Those found continue their code after the test.
+ * 		The children are visited in the order of the node
+ * 
+ * @param data Execution data
+ * @return int NODE_REACHED or 0
+ */
+int Node::propagate_by_alpha(ExecData &data)
+{
+	AlphaIndex *alpha = _alpha;
+	ULong pos = (alpha->_operand >> 8) & 0x7F;
+	ULong attr = alpha->_operand & 0xFF;
+	MetaObj *meta = (*data.left)[(int)pos];
+	ObjectType *obj;
+	ULong value;
+	int res, res_global = 0, low, high, mid, rest, c;
+
+	// The value as PUSHS takes it
+
+	if (meta->class_type() == SINGLE)
+		obj = meta->single()->obj();
+	else // SET	!! SETS OF SIMPLES
+		obj = meta->set()->first_item_of_set()->single()->obj();
+
+	if (alpha->_type == TYPE_STR)
+		value = (ULong)obj->attr[attr].str.str_p;
+	else
+		value = (ULong)obj->attr[attr].num;
+
+	// First entry with the value
+
+	low = 0;
+	high = alpha->_n_entries;
+	while (low < high)
+	{
+		mid = (low + high) / 2;
+		if (alpha_cmp(alpha->_type, alpha->_entries[mid]._key, value) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	// Merge of the children found and the rest, both in the order of the node
+
+	rest = 0;
+	while (rest < alpha->_n_rest || 
+		   (low < alpha->_n_entries && alpha_cmp(alpha->_type, alpha->_entries[low]._key, value) == 0))
+	{
+		if (rest < alpha->_n_rest && 
+			(low >= alpha->_n_entries || alpha_cmp(alpha->_type, alpha->_entries[low]._key, value) != 0 ||
+			 alpha->_rest[rest] < alpha->_entries[low]._child))
+		{
+			c = alpha->_rest[rest++];
+			data.side = alpha->_side[c];
+			res = alpha->_child[c]->propagate(data);
+		}
+		else
+		{
+			c = alpha->_entries[low++]._child;
+			data.side = alpha->_side[c];
+			res = alpha->_child[c]->propagate(data, alpha->_child[c]->_code + 5);
+		}
+
+		if (res == NODE_REACHED)
+		{
+			res_global = NODE_REACHED;
+			Engine::node_mark(_mark_slot) |= data.tag;
+		}
+	}
+
+	return res_global;
+}
+
+/**
+ * @brief Propagation of the nodes reached from the root, only through the children of the class of the object
+ * 
+ * @param data Execution data, the object is at the left
+ * @param mark The mark of the root, the tag propagated
+ */
+void Node::propagate_reached_by_class(ExecData &data, int mark)
+{
+	int n, end;
+	ObjClass *the_class = ObjClass::class_of((*data.left)[0]->single()->obj());
+	int class_id = (the_class != NULL) ? the_class->id() : _dispatch->_n_classes;
+
+	if (class_id > _dispatch->_n_classes)
+		class_id = _dispatch->_n_classes;
+
+	end = _dispatch->_first[class_id + 1];
+	for (n = _dispatch->_first[class_id]; n < end; n++)
+	{
+		data.tag = mark;
+		data.side = _dispatch->_side[n];
+		_dispatch->_child[n]->propagate_reached_nodes(data);
 	}
 }
 
@@ -330,15 +481,14 @@ int Node::user_proc_call(Node *node, ExecData &data)
 int Node::test_class_call(Node *node, ExecData &data)
 {
 	
-	char * classname;
+	int class_id;
 
 	code_p++;
-	classname = (char*)(*code_p++);
+	class_id = (int)(*code_p++);
 
-	// The class name is the attribute 0
+	// The class id was stamped in the object when it was propagated from the root
 
-	return (strcmp((*data.left)[0]->single()->obj()->attr[0].str.str_p, 
-						classname) == 0);
+	return ((*data.left)[0]->single()->obj()->class_id == class_id);
 }
 		
 
@@ -655,11 +805,12 @@ int Node::teqa_call(Node *node, ExecData &data)
 	code_p++;
 	dstack_p-=2;
 
-	if (dstack_p->str.str_p == NULL)
-		if ((dstack_p+1)->str.str_p == NULL)
-			res = 1;
-		else 
-			res = 0;
+	if (dstack_p->str.str_p == (dstack_p+1)->str.str_p)
+		res = 1;
+	else if ((dstack_p->str.dynamic_flags & INTERNED) && ((dstack_p+1)->str.dynamic_flags & INTERNED))
+		res = 0;		// Two interned strings are equal only if they are the same
+	else if (dstack_p->str.str_p == NULL)
+		res = 0;
 	else
 		if((dstack_p+1)->str.str_p == NULL)
 			res = 0;
@@ -719,11 +870,12 @@ int Node::tnea_call(Node *, ExecData &/*data*/)
 	code_p++;
 	dstack_p-=2;
 
-	if (dstack_p->str.str_p == NULL)
-		if ((dstack_p+1)->str.str_p == NULL)
-			res = 0;
-		else 
-			res = 1;
+	if (dstack_p->str.str_p == (dstack_p+1)->str.str_p)
+		res = 0;
+	else if ((dstack_p->str.dynamic_flags & INTERNED) && ((dstack_p+1)->str.dynamic_flags & INTERNED))
+		res = 1;		// Two interned strings are equal only if they are the same
+	else if (dstack_p->str.str_p == NULL)
+		res = 1;
 	else
 		if((dstack_p+1)->str.str_p == NULL)
 			res = 1;
@@ -1401,6 +1553,253 @@ int Node::concat_call(Node *node, ExecData &data)
 	return(1);
 }
 
+/**
+ * @brief Execution of code PCTSN. Find the integer value of an attribute at a percentile (taken from the stack) of the elements in a Set
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::pctsn_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p--;
+	dstack_p->num = set->percentile_set_n((int)attr, dstack_p->num);
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code PCTSF. Find the float value of an attribute at a percentile (taken from the stack) of the elements in a Set
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::pctsf_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p--;
+	dstack_p->flo = set->percentile_set_f((int)attr, dstack_p->num);
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code PCTSA. Find the string value of an attribute at a percentile (taken from the stack) of the elements in a Set
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::pctsa_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p--;
+	dstack_p->str.str_p = set->percentile_set_a((int)attr, dstack_p->num);
+	dstack_p->str.dynamic_flags = DYNAMIC;
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code RNKSN. Count the elements in a Set with an integer value of an attribute lower than a value taken from the stack
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::rnksn_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p--;
+	dstack_p->num = set->rank_set_n((int)attr, dstack_p->num);
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code RNKSF. Count the elements in a Set with a float value of an attribute lower than a value taken from the stack
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::rnksf_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p--;
+	dstack_p->num = set->rank_set_f((int)attr, dstack_p->flo);
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code RNKSA. Count the elements in a Set with a string value of an attribute lower than a value taken from the stack
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::rnksa_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	long rank;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p--;
+	rank = set->rank_set_a((int)attr, dstack_p->str.str_p);
+
+	if (dstack_p->str.dynamic_flags == DYNAMIC)
+		free(dstack_p->str.str_p);
+
+	dstack_p->num = rank;
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code DSTSN. Count the distinct integer values of an attribute for all the elements in a Set
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::dstsn_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p->num = set->distinct_set_n((int)attr);
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code DSTSF. Count the distinct float values of an attribute for all the elements in a Set
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::dstsf_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p->num = set->distinct_set_f((int)attr);
+	dstack_p++;
+	return(1);
+}
+
+/**
+ * @brief Execution of code DSTSA. Count the distinct string values of an attribute for all the elements in a Set
+ * 		The result is left in the stack
+ * 
+ * @param node Current Node
+ * @param data Execution data
+ * @return int = 1 execution continues
+ */
+int Node::dstsa_call(Node *node, ExecData &data)
+{
+	code_p++;
+	ULong mem = ((*code_p) >> 15) & 0x1;
+	ULong pos = ((*code_p) >> 8) & 0x7F;
+	ULong attr = (*code_p++) & 0xFF;
+	Set *set;
+ 
+	if (mem == LEFT_MEM)
+		set = (*data.left)[(int)pos]->set();
+	else
+		set = (*data.right)[(int)pos]->set();
+
+	dstack_p->num = set->distinct_set_a((int)attr);
+	dstack_p++;
+	return(1);
+}
+
 /**
  * @brief Execution of code PUSHA. Store a string in the stack
  * 
@@ -1412,7 +1811,7 @@ int Node::pusha_call(Node *, ExecData &/*data*/)
 {
 	code_p++;
 	dstack_p->str.str_p = (char *)(*code_p++);
-	dstack_p->str.dynamic_flags = FALSE;		// The attribute value is this way protected and never will we freed unless in POPSA
+	dstack_p->str.dynamic_flags = INTERNED;		// The literals are interned by the compiler, so never freed
 	dstack_p++;
 	return(1);
 }
@@ -1528,6 +1927,39 @@ int Node::pusht_call(Node *node, ExecData &data)
  * Further INTER nodes will make complex structures with Compounds with other Compounds as children
  */
 
+/**
+ * @brief Bounds of the items of the other side of an AND node that may verify its range key.
+ * 		The range key is the last one and compares (left OP right) the value of the object arrived with
+ * 		the items stored, so the items are walked from the lower bound to the upper one.
+ * 		Modifications walk the items with any value, the conditions are checked in the OLD and in the NEW state
+ * 
+ * @param range The comparison of the range key (TLT, TLE, TGT or TGE)
+ * @param side The side where the object arrived
+ * @param tag The operation
+ * @param lower Where to store the lower bound of the items (BT_RANGE_NONE, BT_RANGE_OPEN or BT_RANGE_CLOSED)
+ * @param upper Where to store the upper bound of the items
+ */
+PRIVATE void range_bounds(ULong range, int side, int tag, int &lower, int &upper)
+{
+	lower = BT_RANGE_NONE;
+	upper = BT_RANGE_NONE;
+
+	if (tag != MODIFY_TAG)
+	{
+		// The items of the other side are the right ones when it arrives by left
+		if (side == RIGHT_MEM)
+			range = (range == TLT) ? TGT : (range == TLE) ? TGE : (range == TGT) ? TLT : TLE;
+
+		switch (range)
+		{
+			case TLT: lower = BT_RANGE_OPEN;   break; // obj < item
+			case TLE: lower = BT_RANGE_CLOSED; break; // obj <= item
+			case TGT: upper = BT_RANGE_OPEN;   break; // obj > item
+			case TGE: upper = BT_RANGE_CLOSED; break; // obj >= item
+		}
+	}
+}
+
 /**
  * @brief Execution of code AND.
  * 		The couples that verify the node's code progress toward its children nodes
@@ -1567,13 +1999,44 @@ void Node::and_call_by_left(ExecData &data)
 	if (store_in_and_node_by_LEFT(data))
 	{
 		MetaObj *item;
-		BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS + 1];
+		int lower, upper;
 		KeyManager keyman(RIGHT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE);
-		tree->setKeyManager(&keyman);
 
-		BTState state = tree->FindByKeys(data.left);
-		while (item= (MetaObj *)BTree::Walk(state))
-			check_and_cond(item, data);
+		range_bounds(code_p[AND_NODE_RANGE_POS], LEFT_MEM, data.tag, lower, upper);
+
+		if (code_p[AND_NODE_FLAGS_POS] & IS_HASHED)
+		{
+			BTState state = Engine::node_hash_mem(code_p[AND_NODE_MEM_START_POS + 1])->FindByKeys(data.left, &keyman);
+
+			while (item= (MetaObj *)BTree::Walk(state))
+				check_and_cond(item, data);
+		}
+		else if (code_p[AND_NODE_FLAGS_POS] & IS_BPTREE)
+		{
+			BPTree *tree = Engine::node_bp_mem(code_p[AND_NODE_MEM_START_POS + 1]);
+			BPState state = (code_p[AND_NODE_RANGE_POS] != 0) ? tree->FindRangeByKeys(data.left, &keyman, lower, upper) : tree->FindByKeys(data.left, &keyman);
+
+			while (item= (MetaObj *)BPTree::Walk(state))
+				check_and_cond(item, data);
+		}
+		else if (code_p[AND_NODE_RANGE_POS] != 0)
+		{
+			BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS + 1]);
+			tree->setKeyManager(&keyman);
+			BTRangeState state = tree->FindRangeByKeys(data.left, lower, upper);
+
+			while (item= (MetaObj *)BTree::Walk(state))
+				check_and_cond(item, data);
+		}
+		else
+		{
+			BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS + 1]);
+			tree->setKeyManager(&keyman);
+			BTState state = tree->FindByKeys(data.left);
+
+			while (item= (MetaObj *)BTree::Walk(state))
+				check_and_cond(item, data);
+		}
 	}
 
 	data.tag=old_tag;
@@ -1598,13 +2061,44 @@ void Node::and_call_by_right(ExecData &data)
 	if (store_in_and_node_by_RIGHT(data))
 	{
 		MetaObj *item;
-		BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS];
+		int lower, upper;
 		KeyManager keyman(LEFT_MEM, RIGHT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE);
-		tree->setKeyManager(&keyman);
 
-		BTState state = tree->FindByKeys(data.right);
-		while (item= (MetaObj *)BTree::Walk(state))
-			check_and_cond(item, data);
+		range_bounds(code_p[AND_NODE_RANGE_POS], RIGHT_MEM, data.tag, lower, upper);
+
+		if (code_p[AND_NODE_FLAGS_POS] & (IS_HASHED << 16))
+		{
+			BTState state = Engine::node_hash_mem(code_p[AND_NODE_MEM_START_POS])->FindByKeys(data.right, &keyman);
+
+			while (item= (MetaObj *)BTree::Walk(state))
+				check_and_cond(item, data);
+		}
+		else if (code_p[AND_NODE_FLAGS_POS] & (IS_BPTREE << 16))
+		{
+			BPTree *tree = Engine::node_bp_mem(code_p[AND_NODE_MEM_START_POS]);
+			BPState state = (code_p[AND_NODE_RANGE_POS] != 0) ? tree->FindRangeByKeys(data.right, &keyman, lower, upper) : tree->FindByKeys(data.right, &keyman);
+
+			while (item= (MetaObj *)BPTree::Walk(state))
+				check_and_cond(item, data);
+		}
+		else if (code_p[AND_NODE_RANGE_POS] != 0)
+		{
+			BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS]);
+			tree->setKeyManager(&keyman);
+			BTRangeState state = tree->FindRangeByKeys(data.right, lower, upper);
+
+			while (item= (MetaObj *)BTree::Walk(state))
+				check_and_cond(item, data);
+		}
+		else
+		{
+			BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS]);
+			tree->setKeyManager(&keyman);
+			BTState state = tree->FindByKeys(data.right);
+
+			while (item= (MetaObj *)BTree::Walk(state))
+				check_and_cond(item, data);
+		}
 	}
 
 	data.left = data.right;
@@ -1752,7 +2246,7 @@ void Node::nand_call_by_left(ExecData &data)
 	int tag_mask=0;
 	MatchCount *counter;
 	ULong flags;
-	BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS + 1];
+	BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS + 1]);
 	KeyManager keyman(RIGHT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE, true);
 	tree->setKeyManager(&keyman);
 
@@ -1842,7 +2336,7 @@ void Node::nand_call_by_right(ExecData &data)
 	if (store_in_and_node_by_RIGHT(data))
 	{
 		MatchCount *item;
-		BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS];
+		BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS]);
 		KeyManager keyman(LEFT_MEM, RIGHT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE, true);
 		tree->setKeyManager(&keyman);
 		BTState state = tree->FindByKeys(data.right);
@@ -2010,7 +2504,7 @@ void Node::oand_call_by_left(ExecData &data)
 	MatchCount *counter;
 	int how_many;
 	ULong flags;
-	BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS + 1];
+	BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS + 1]);
 	KeyManager keyman(RIGHT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE, true);
 	tree->setKeyManager(&keyman);
  
@@ -2067,7 +2561,7 @@ void Node::oand_call_by_right(ExecData &data)
 	if (store_in_and_node_by_RIGHT(data))
 	{
 		MatchCount *counter;
-		BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS];
+		BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS]);
 		KeyManager keyman(LEFT_MEM, RIGHT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE, true);
 		tree->setKeyManager(&keyman);
 		BTState state = tree->FindByKeys(data.right);
@@ -2230,6 +2724,56 @@ void Node::check_oand_cond(MatchCount *counter, MetaObj *item, ExecData &data,	i
 		MainItem->set_state(NEW_ST, data.st, data.pos);
 }
 
+/**
+ * @brief Insertion of an item in the memory of a side of an AND node, whatever the kind of the memory
+ * 
+ * @param hash HashMem of the side if IS_HASHED
+ * @param bptree BPTree of the side if IS_BPTREE
+ * @param tree BTree of the side otherwise
+ * @param item The item
+ * @param keyman KeyManager of the side
+ * @return void** Where the item (or the one that was found) is stored
+ */
+PRIVATE void **and_mem_insert(HashMem *hash, BPTree *bptree, BTree *tree, MetaObj *item, KeyManager &keyman)
+{
+	if (hash)
+		return hash->Insert(item, &keyman, MetaObj::metacmp);
+	else if (bptree)
+		return bptree->Insert(item, &keyman, MetaObj::metacmp);
+	else
+		return (void **)BTreeT<MetaObj, MetaObj::Compare, KeyManager>(tree).Insert(item);
+}
+
+/**
+ * @brief Deletion of an item from the memory of a side of an AND node, whatever the kind of the memory
+ * 
+ * @return MetaObj* The item deleted or NULL if not found
+ */
+PRIVATE MetaObj *and_mem_delete(HashMem *hash, BPTree *bptree, BTree *tree, MetaObj *item, KeyManager &keyman)
+{
+	if (hash)
+		return (MetaObj *)hash->Delete(item, &keyman, MetaObj::metacmp);
+	else if (bptree)
+		return (MetaObj *)bptree->Delete(item, &keyman, MetaObj::metacmp);
+	else
+		return BTreeT<MetaObj, MetaObj::Compare, KeyManager>(tree).Delete(item);
+}
+
+/**
+ * @brief Search of an item in the memory of a side of an AND node, whatever the kind of the memory
+ * 
+ * @return MetaObj* The item found or NULL
+ */
+PRIVATE MetaObj *and_mem_find(HashMem *hash, BPTree *bptree, BTree *tree, MetaObj *item, KeyManager &keyman)
+{
+	if (hash)
+		return (MetaObj *)hash->Find(item, &keyman, MetaObj::metacmp);
+	else if (bptree)
+		return (MetaObj *)bptree->Find(item, &keyman, MetaObj::metacmp);
+	else
+		return BTreeT<MetaObj, MetaObj::Compare, KeyManager>(tree).Find(item);
+}
+
 /**
  * @brief Store Control in the memory (BTree) an AND node by LEFT
  * 		if stored the MetaObj is linked (increments the #links by 1), if removed it is unlinked (decrements #links by 1)
@@ -2246,12 +2790,24 @@ int Node::store_in_and_node_by_LEFT(ExecData &data)
 	MetaObj * LeftItemInMem;
 	ULong flags;
 	int WasFound;
-	BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS];
+	HashMem *hash = NULL;
+	BPTree *bptree = NULL;
+	BTree *tree = NULL;
 	KeyManager keyman(LEFT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE);
-	tree->setKeyManager(&keyman);
 
 	flags = code_p[AND_NODE_FLAGS_POS]>>16;		//Left side Flags
 
+	// The memory is a HashMem when all the keys are equalities (see load_and_mem)
+	if (flags & IS_HASHED)
+		hash = Engine::node_hash_mem(code_p[AND_NODE_MEM_START_POS]);
+	else if (flags & IS_BPTREE)
+		bptree = Engine::node_bp_mem(code_p[AND_NODE_MEM_START_POS]);
+	else
+	{
+		tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS]);
+		tree->setKeyManager(&keyman);
+	}
+
 	switch (data.tag)
 	{
 		case INSERT_TAG:
@@ -2260,7 +2816,7 @@ int Node::store_in_and_node_by_LEFT(ExecData &data)
 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem = *(MetaObj **)tree->Insert(data.left, MetaObj::metacmp);
+				LeftItemInMem = *(MetaObj **)and_mem_insert(hash, bptree, tree, data.left, keyman);
 
 				// The object is linked if it was stored (was not found)
 				// also the inference continues due it is something new
@@ -2279,9 +2835,9 @@ int Node::store_in_and_node_by_LEFT(ExecData &data)
 				keys_mod = keyman.keysModified(data.pos, data.st->_obj, data.st->_old_obj);
 				data.left->set_state(OLD_ST, data.st, data.pos);
 				if (keys_mod)
-					LeftItemInMem = (MetaObj *)tree->Delete(data.left, MetaObj::metacmp);
+					LeftItemInMem = and_mem_delete(hash, bptree, tree, data.left, keyman);
 				else
-					LeftItemInMem = (MetaObj *)tree->Find(data.left, MetaObj::metacmp);
+					LeftItemInMem = and_mem_find(hash, bptree, tree, data.left, keyman);
  
 				if (LeftItemInMem)
 				{
@@ -2302,7 +2858,7 @@ int Node::store_in_and_node_by_LEFT(ExecData &data)
 				}
 				data.left->set_state(NEW_ST, data.st, data.pos);
 				if (!LeftItemInMem || keys_mod)
-					tree->Insert(data.left, MetaObj::metacmp);
+					and_mem_insert(hash, bptree, tree, data.left, keyman);
 
 				continue_inference = TRUE;
 			}
@@ -2311,7 +2867,7 @@ int Node::store_in_and_node_by_LEFT(ExecData &data)
 		case RETRACT_TAG: 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem = (MetaObj *)tree->Delete(data.left, MetaObj::metacmp);
+				LeftItemInMem = and_mem_delete(hash, bptree, tree, data.left, keyman);
 
 				continue_inference = (LeftItemInMem != NULL);
 
@@ -2354,12 +2910,24 @@ int Node::store_in_and_node_by_RIGHT(ExecData &data)
 	MetaObj * RightItemInMem;
 	ULong flags;
 	int WasFound;
-	BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS + 1];
+	HashMem *hash = NULL;
+	BPTree *bptree = NULL;
+	BTree *tree = NULL;
 	KeyManager keyman(RIGHT_MEM, RIGHT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE);
-	tree->setKeyManager(&keyman);
 
 	flags = code_p[AND_NODE_FLAGS_POS] & 0xFFFF;	// Right side Flags
 
+	// The memory is a HashMem when all the keys are equalities (see load_and_mem)
+	if (flags & IS_HASHED)
+		hash = Engine::node_hash_mem(code_p[AND_NODE_MEM_START_POS + 1]);
+	else if (flags & IS_BPTREE)
+		bptree = Engine::node_bp_mem(code_p[AND_NODE_MEM_START_POS + 1]);
+	else
+	{
+		tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS + 1]);
+		tree->setKeyManager(&keyman);
+	}
+
 
 	switch (data.tag)
 	{
@@ -2369,7 +2937,7 @@ int Node::store_in_and_node_by_RIGHT(ExecData &data)
 
 			if (!(flags & IS_TRIGGER))
 			{
-				RightItemInMem = *(MetaObj **)tree->Insert(data.right, MetaObj::metacmp);
+				RightItemInMem = *(MetaObj **)and_mem_insert(hash, bptree, tree, data.right, keyman);
  
 				// The object is linked if it was stored (was not found)
 				// also the inference continues due it is something new
@@ -2388,9 +2956,9 @@ int Node::store_in_and_node_by_RIGHT(ExecData &data)
 				keys_mod = keyman.keysModified(data.pos, data.st->_obj, data.st->_old_obj);
 				data.right->set_state(OLD_ST, data.st, data.pos);
 				if (keys_mod)
-					RightItemInMem = (MetaObj *)tree->Delete(data.right, MetaObj::metacmp);
+					RightItemInMem = and_mem_delete(hash, bptree, tree, data.right, keyman);
 				else
-					RightItemInMem = (MetaObj *)tree->Find(data.right, MetaObj::metacmp);
+					RightItemInMem = and_mem_find(hash, bptree, tree, data.right, keyman);
  
 				if (RightItemInMem)
 				{
@@ -2411,7 +2979,7 @@ int Node::store_in_and_node_by_RIGHT(ExecData &data)
 				}
 				data.right->set_state(NEW_ST, data.st, data.pos);
 				if (!RightItemInMem || keys_mod)
-					tree->Insert(data.right, MetaObj::metacmp);
+					and_mem_insert(hash, bptree, tree, data.right, keyman);
 
 				continue_inference = TRUE;
 			}
@@ -2421,7 +2989,7 @@ int Node::store_in_and_node_by_RIGHT(ExecData &data)
 
 			if (!(flags & IS_TRIGGER))
 			{
-				RightItemInMem = (MetaObj *)tree->Delete(data.right, MetaObj::metacmp);
+				RightItemInMem = and_mem_delete(hash, bptree, tree, data.right, keyman);
 
 				continue_inference = (RightItemInMem != NULL);
 
@@ -2466,9 +3034,10 @@ int Node::store_in_asym_node_by_LEFT(ExecData &data, MatchCount *&count)
 	MatchCount * LeftItemInMem;
 	MetaObj **LeftItemInMem_p;
 	ULong flags;
-	BTree *tree = (BTree *)code_p[AND_NODE_MEM_START_POS];
+	BTree *tree = Engine::node_mem(code_p[AND_NODE_MEM_START_POS]);
 	KeyManager keyman(LEFT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_AND_NODE, true);
 	tree->setKeyManager(&keyman);
+	BTreeT<MatchCount, CountCompare<MetaObj::Compare>, KeyManager> mem(tree);
 
 	flags = code_p[AND_NODE_FLAGS_POS]>>16;		// Right side Flags
 
@@ -2480,7 +3049,7 @@ int Node::store_in_asym_node_by_LEFT(ExecData &data, MatchCount *&count)
 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem_p = (MetaObj **)tree->Insert(data.left, (BTCompareFunc)cmp_count_with_object);
+				LeftItemInMem_p = (MetaObj **)mem.Insert(data.left);
 
 				// The object is linked if it was stored (was not found)
 				// also the inference continues due it is something new
@@ -2505,9 +3074,9 @@ int Node::store_in_asym_node_by_LEFT(ExecData &data, MatchCount *&count)
 				keys_mod = keyman.keysModified(data.pos, data.st->_obj, data.st->_old_obj);
 				data.left->set_state(OLD_ST, data.st, data.pos);
 				if (keys_mod)
-					LeftItemInMem = (MatchCount *)tree->Delete(data.left, (BTCompareFunc)cmp_count_with_object);
+					LeftItemInMem = mem.Delete(data.left);
 				else
-					LeftItemInMem = (MatchCount *)tree->Find(data.left, (BTCompareFunc)cmp_count_with_object);
+					LeftItemInMem = mem.Find(data.left);
  
 				if (LeftItemInMem)
 				{
@@ -2529,7 +3098,7 @@ int Node::store_in_asym_node_by_LEFT(ExecData &data, MatchCount *&count)
 				data.left->set_state(NEW_ST, data.st, data.pos);
 				if (!LeftItemInMem || keys_mod)
 				{
-					LeftItemInMem_p = (MetaObj **)tree->Insert(data.left, (BTCompareFunc)cmp_count_with_object);
+					LeftItemInMem_p = (MetaObj **)mem.Insert(data.left);
 					if (!LeftItemInMem)
 						LeftItemInMem = *((MatchCount **)LeftItemInMem_p) = new MatchCount(data.left);
 					else 
@@ -2543,7 +3112,7 @@ int Node::store_in_asym_node_by_LEFT(ExecData &data, MatchCount *&count)
 		case RETRACT_TAG: 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem = (MatchCount *)tree->Delete(data.left, (BTCompareFunc)cmp_count_with_object);
+				LeftItemInMem = mem.Delete(data.left);
 
 				continue_inference = (LeftItemInMem != NULL);
 
@@ -2608,7 +3177,7 @@ int Node::wand_call(Node *node, ExecData &data)
  */
 void Node::wand_call_by_left(ExecData &data)
 {
-	BTree *tree	= (BTree *)code_p[WAND_NODE_MEM_START_POS + 1];
+	BTree *tree	= Engine::node_mem(code_p[WAND_NODE_MEM_START_POS + 1]);
 	long window = (long)code_p[WAND_NODE_WTIME_POS];
 	ULong this_flags	= code_p[AND_NODE_FLAGS_POS] >> 16;
 	ULong other_flags = code_p[AND_NODE_FLAGS_POS] & 0xFFFF; 
@@ -2626,7 +3195,7 @@ void Node::wand_call_by_left(ExecData &data)
 		// If the timing is active between the objects we find objects with t2< t1 + window
 		// else we find simply by key
 		if ((this_flags & IS_TIMED) && (other_flags & IS_TIMED))
-			state = tree->FindBiggerThan(data.left, MetaObj::compare_tw, data.left->t1() + window + 1);
+			state = BTreeT<MetaObj, MetaObj::CompareTW, KeyManager>(tree, MetaObj::CompareTW(data.left->t1() + window + 1)).FindBiggerThan(data.left);
 		else
 			state = tree->FindByKeys(data.left);
 
@@ -2658,7 +3227,7 @@ void Node::wand_call_by_left(ExecData &data)
 void Node::wand_call_by_right(ExecData &data)
 {
 	
-	BTree *tree = (BTree *)code_p[WAND_NODE_MEM_START_POS];
+	BTree *tree = Engine::node_mem(code_p[WAND_NODE_MEM_START_POS]);
 	long window = (long)code_p[WAND_NODE_WTIME_POS];
 	ULong this_flags	= code_p[AND_NODE_FLAGS_POS] & 0xFFFF;
 	ULong other_flags	= code_p[AND_NODE_FLAGS_POS] >> 16;
@@ -2677,7 +3246,7 @@ void Node::wand_call_by_right(ExecData &data)
 		// If the timing is active between the objects we find objects with t2< t1 + window
 		// else we find simply by key
 		if ((this_flags & IS_TIMED) && (other_flags & IS_TIMED))
-			state = tree->FindBiggerThan(data.right, MetaObj::compare_tw, data.right->t1() + window + 1);
+			state = BTreeT<MetaObj, MetaObj::CompareTW, KeyManager>(tree, MetaObj::CompareTW(data.right->t1() + window + 1)).FindBiggerThan(data.right);
 		else
 			state = tree->FindByKeys(data.right);
 
@@ -2838,7 +3407,7 @@ int Node::nwand_call(Node *node, ExecData &data)
  */
 void Node::nwand_call_by_left(ExecData &data)
 {
-	BTree *tree	= (BTree *)code_p[WAND_NODE_MEM_START_POS + 1];
+	BTree *tree	= Engine::node_mem(code_p[WAND_NODE_MEM_START_POS + 1]);
 	long window = (long)code_p[WAND_NODE_WTIME_POS];
 	ULong this_flags  = code_p[AND_NODE_FLAGS_POS] >> 16;		// Left flags!
 	ULong other_flags = code_p[AND_NODE_FLAGS_POS] & 0xFFFF;	// Right_flags
@@ -2862,7 +3431,7 @@ void Node::nwand_call_by_left(ExecData &data)
 			// If the timing is active between the objects we find objects with t2< t1 + window
 			// else we find simply by key
 			if ((this_flags & IS_TIMED) && (other_flags & IS_TIMED))
-				state = tree->FindBiggerThan(data.left, MetaObj::compare_tw, data.left->t1() + window + 1);
+				state = BTreeT<MetaObj, MetaObj::CompareTW, KeyManager>(tree, MetaObj::CompareTW(data.left->t1() + window + 1)).FindBiggerThan(data.left);
 			else
 				state = tree->FindByKeys(data.left);
 
@@ -2937,7 +3506,7 @@ void Node::nwand_call_by_left(ExecData &data)
 void Node::nwand_call_by_right(ExecData &data)
 {
 
-	BTree *tree = (BTree *)code_p[WAND_NODE_MEM_START_POS];
+	BTree *tree = Engine::node_mem(code_p[WAND_NODE_MEM_START_POS]);
 	long window = (long)code_p[WAND_NODE_WTIME_POS];
 	ULong this_flags	= code_p[AND_NODE_FLAGS_POS] & 0xFFFF;
 	ULong other_flags	= code_p[AND_NODE_FLAGS_POS] >> 16;
@@ -2956,7 +3525,7 @@ void Node::nwand_call_by_right(ExecData &data)
 		// If the timing is active between the objects we find objects with t2< t1 + window
 		// else we find simply by key
 		if ((this_flags & IS_TIMED) && (other_flags & IS_TIMED))
-			state = tree->FindBiggerThan(data.right, Node::cmp_count_with_object_tw, data.right->t1() + window + 1);
+			state = BTreeT<MatchCount, CountCompare<MetaObj::CompareTW>, KeyManager>(tree, MetaObj::CompareTW(data.right->t1() + window + 1)).FindBiggerThan(data.right);
 		else
 			state = tree->FindByKeys(data.right);
 
@@ -3133,7 +3702,7 @@ void Node::owand_call_by_left(ExecData &data)
 {
 	MatchCount *counter;
 	int how_many;
-	BTree *tree	= (BTree *)code_p[WAND_NODE_MEM_START_POS + 1];
+	BTree *tree	= Engine::node_mem(code_p[WAND_NODE_MEM_START_POS + 1]);
 	long window = (long)code_p[WAND_NODE_WTIME_POS];
 	ULong this_flags	= code_p[AND_NODE_FLAGS_POS] >> 16;		// Left_flags!
 	ULong other_flags = code_p[AND_NODE_FLAGS_POS] & 0xFFFF;	// Right_flags
@@ -3162,7 +3731,7 @@ void Node::owand_call_by_left(ExecData &data)
 			// If the timing is active between the objects we find objects with t2< t1 + window
 		  	// else we find simply by key
 			if ((this_flags & IS_TIMED) && (other_flags & IS_TIMED))
-				state = tree->FindBiggerThan(data.left, MetaObj::compare_tw, data.left->t1() + window + 1);
+				state = BTreeT<MetaObj, MetaObj::CompareTW, KeyManager>(tree, MetaObj::CompareTW(data.left->t1() + window + 1)).FindBiggerThan(data.left);
 			else
 				state = tree->FindByKeys(data.left);
 
@@ -3203,7 +3772,7 @@ void Node::owand_call_by_left(ExecData &data)
 void Node::owand_call_by_right(ExecData &data)
 {
 	MatchCount *counter;
-	BTree *tree = (BTree *)code_p[WAND_NODE_MEM_START_POS];
+	BTree *tree = Engine::node_mem(code_p[WAND_NODE_MEM_START_POS]);
 	long window = (long)code_p[WAND_NODE_WTIME_POS];
 	ULong this_flags	= code_p[AND_NODE_FLAGS_POS] & 0xFFFF;
 	ULong other_flags   = code_p[AND_NODE_FLAGS_POS] >> 16;
@@ -3222,7 +3791,7 @@ void Node::owand_call_by_right(ExecData &data)
 		// If the timing is active between the objects we find objects with t2< t1 + window
 		// else we find simply by key
 		if ((this_flags & IS_TIMED) && (other_flags & IS_TIMED))
-			state = tree->FindBiggerThan(data.right, Node::cmp_count_with_object_tw, data.right->t1() + window + 1);
+			state = BTreeT<MatchCount, CountCompare<MetaObj::CompareTW>, KeyManager>(tree, MetaObj::CompareTW(data.right->t1() + window + 1)).FindBiggerThan(data.right);
 		else
 			state = tree->FindByKeys(data.right);
 
@@ -3410,9 +3979,10 @@ int Node::store_in_wand_node_by_LEFT(ExecData &data)
 	MetaObj * LeftItemInMem;
 	int continue_inference;
 	ULong flags;
-	BTree *tree = (BTree *)code_p[WAND_NODE_MEM_START_POS];
+	BTree *tree = Engine::node_mem(code_p[WAND_NODE_MEM_START_POS]);
 	KeyManager keyman(LEFT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_WAND_NODE);
 	tree->setKeyManager(&keyman);
+	BTreeT<MetaObj, MetaObj::CompareT, KeyManager> mem(tree);
 
 	flags = code_p[AND_NODE_FLAGS_POS]>>16;			//Left side Flags
 
@@ -3425,7 +3995,7 @@ int Node::store_in_wand_node_by_LEFT(ExecData &data)
 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem = *(MetaObj **)tree->Insert(data.left, MetaObj::compare_t);
+				LeftItemInMem = *mem.Insert(data.left);
 
 				// The object is linked if it was stored (was not found)
 				// also the inference continues due it is something new
@@ -3446,9 +4016,9 @@ int Node::store_in_wand_node_by_LEFT(ExecData &data)
 				data.left->set_state(OLD_ST, data.st, data.pos);
 
 				if (keys_mod)
-					LeftItemInMem = (MetaObj *)tree->Delete(data.left, MetaObj::compare_t);
+					LeftItemInMem = mem.Delete(data.left);
 				else
-					LeftItemInMem = (MetaObj *)tree->Find(data.left, MetaObj::compare_t);
+					LeftItemInMem = mem.Find(data.left);
 
 				if (LeftItemInMem)
 				{
@@ -3470,7 +4040,7 @@ int Node::store_in_wand_node_by_LEFT(ExecData &data)
 
 				data.left->set_state(NEW_ST, data.st, data.pos);
 				if (!LeftItemInMem || keys_mod)
-					tree->Insert(data.left, MetaObj::compare_t);
+					mem.Insert(data.left);
 
 				continue_inference = TRUE;
 			}
@@ -3479,7 +4049,7 @@ int Node::store_in_wand_node_by_LEFT(ExecData &data)
 		case RETRACT_TAG: 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem = (MetaObj *)tree->Delete(data.left, MetaObj::compare_t);
+				LeftItemInMem = mem.Delete(data.left);
 
 				continue_inference = (LeftItemInMem != NULL);
 
@@ -3522,9 +4092,10 @@ int Node::store_in_wand_node_by_RIGHT(ExecData &data)
 	MetaObj * RightItemInMem;
 	int continue_inference;
 	ULong flags;
-	BTree *tree = (BTree *)code_p[WAND_NODE_MEM_START_POS + 1];
+	BTree *tree = Engine::node_mem(code_p[WAND_NODE_MEM_START_POS + 1]);
 	KeyManager keyman(RIGHT_MEM, RIGHT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_WAND_NODE);
 	tree->setKeyManager(&keyman);
+	BTreeT<MetaObj, MetaObj::CompareT, KeyManager> mem(tree);
 
 	flags = code_p[AND_NODE_FLAGS_POS] & 0xFFFF;	// Right side Flags
 
@@ -3536,7 +4107,7 @@ int Node::store_in_wand_node_by_RIGHT(ExecData &data)
 			// IS_TEMPORAL flag imply the objects must be retracted when its time os out of window
 			if (!(flags & IS_TRIGGER))
 			{
-				RightItemInMem = *(MetaObj **)tree->Insert(data.right, MetaObj::compare_t);
+				RightItemInMem = *mem.Insert(data.right);
 
 				// The object is linked if it was stored (was not found)
 				// also the inference continues due it is something new
@@ -3555,9 +4126,9 @@ int Node::store_in_wand_node_by_RIGHT(ExecData &data)
 				keys_mod = keyman.keysModified(data.pos, data.st->_obj, data.st->_old_obj);
 				data.right->set_state(OLD_ST, data.st, data.pos);
 				if (keys_mod)
-					RightItemInMem = (MetaObj *)tree->Delete(data.right, MetaObj::compare_t);
+					RightItemInMem = mem.Delete(data.right);
 				else
-					RightItemInMem = (MetaObj *)tree->Find(data.right, MetaObj::compare_t);
+					RightItemInMem = mem.Find(data.right);
 
 				if (RightItemInMem)
 				{
@@ -3578,7 +4149,7 @@ int Node::store_in_wand_node_by_RIGHT(ExecData &data)
 				}
 				data.right->set_state(NEW_ST, data.st, data.pos);
 				if (!RightItemInMem || keys_mod)
-					tree->Insert(data.right, MetaObj::compare_t);
+					mem.Insert(data.right);
 
 				continue_inference = TRUE;
 			}
@@ -3587,7 +4158,7 @@ int Node::store_in_wand_node_by_RIGHT(ExecData &data)
 		case RETRACT_TAG: 
 			if (!(flags & IS_TRIGGER))
 			{
-				RightItemInMem = (MetaObj *)tree->Delete(data.right, MetaObj::compare_t);
+				RightItemInMem = mem.Delete(data.right);
 
 				continue_inference = (RightItemInMem != NULL);
 
@@ -3632,9 +4203,10 @@ int Node::store_in_Wasym_node_by_LEFT(ExecData &data, MatchCount *&count)
 	MatchCount * LeftItemInMem;
 	MetaObj **LeftItemInMem_p;
 	ULong flags;
-	BTree *tree = (BTree *)code_p[WAND_NODE_MEM_START_POS];
+	BTree *tree = Engine::node_mem(code_p[WAND_NODE_MEM_START_POS]);
 	KeyManager keyman(LEFT_MEM, LEFT_MEM, code_p[AND_NODE_NKEYS_POS], code_p + LEN_WAND_NODE, true);
 	tree->setKeyManager(&keyman);
+	BTreeT<MatchCount, CountCompare<MetaObj::CompareT>, KeyManager> mem(tree);
 
 	flags = code_p[AND_NODE_FLAGS_POS]>>16;			// Right side Flags
 
@@ -3646,7 +4218,7 @@ int Node::store_in_Wasym_node_by_LEFT(ExecData &data, MatchCount *&count)
 			// IS_TEMPORAL flag imply the objects must be retracted when its time os out of window
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem_p = (MetaObj **)tree->Insert(data.left, cmp_count_with_object_t);
+				LeftItemInMem_p = (MetaObj **)mem.Insert(data.left);
 
 				// The object is linked if it was stored (was not found)
 				// also the inference continues due it is something new
@@ -3671,11 +4243,11 @@ int Node::store_in_Wasym_node_by_LEFT(ExecData &data, MatchCount *&count)
 				data.left->set_state(OLD_ST, data.st, data.pos);
 				if (keys_mod)
 				{
-					LeftItemInMem = (MatchCount *)tree->Delete(data.left, cmp_count_with_object_t);
+					LeftItemInMem = mem.Delete(data.left);
 				}
 				else
 				{
-					LeftItemInMem = (MatchCount *)tree->Find(data.left, cmp_count_with_object_t);
+					LeftItemInMem = mem.Find(data.left);
 				}
 
 				if (LeftItemInMem)
@@ -3698,7 +4270,7 @@ int Node::store_in_Wasym_node_by_LEFT(ExecData &data, MatchCount *&count)
 				data.left->set_state(NEW_ST, data.st, data.pos);
 				if (!LeftItemInMem || keys_mod)
 				{
-					LeftItemInMem_p = (MetaObj **)tree->Insert(data.left, cmp_count_with_object_t);
+					LeftItemInMem_p = (MetaObj **)mem.Insert(data.left);
 					if (!LeftItemInMem)
 						LeftItemInMem = *((MatchCount **)LeftItemInMem_p) = new MatchCount(data.left);
 					else 
@@ -3712,7 +4284,7 @@ int Node::store_in_Wasym_node_by_LEFT(ExecData &data, MatchCount *&count)
 		case RETRACT_TAG: 
 			if (!(flags & IS_TRIGGER))
 			{
-				LeftItemInMem = (MatchCount *)tree->Delete(data.left, cmp_count_with_object_t);
+				LeftItemInMem = mem.Delete(data.left);
 
 				continue_inference = (LeftItemInMem != NULL);
 
@@ -3796,7 +4368,7 @@ void Node::set_call_INSERT(ExecData &data, MetaObj **LeftItemInMem_p /*=NULL*/)
 	MetaObj **PosSet, *LeftItemInMem;
 	MetaObj *Item;
 	int continue_inference;
-	BTree *tree = (BTree *)code_p[SET_NODE_MEM_POS];
+	BTree *tree = Engine::node_mem(code_p[SET_NODE_MEM_POS]);
 
 	int first_pos = (int)(code_p[SET_NODE_FIRST_ITEM_POS] >> 8);
 	int n_objs = (int)(code_p[SET_NODE_N_ITEMS_POS]);
@@ -3898,7 +4470,7 @@ void Node::set_call_RETRACT(ExecData &data, MetaObj *LeftItemInMem/*=NULL*/)
 	MetaObj **PosSet;
 	MetaObj *Item;
 	int continue_inference;
-	BTree *tree = (BTree *)code_p[SET_NODE_MEM_POS];
+	BTree *tree = Engine::node_mem(code_p[SET_NODE_MEM_POS]);
  
 	int first_pos = (int)(code_p[SET_NODE_FIRST_ITEM_POS] >> 8);
 	int n_objs = (int)(code_p[SET_NODE_N_ITEMS_POS]);
@@ -3924,6 +4496,18 @@ void Node::set_call_RETRACT(ExecData &data, MetaObj *LeftItemInMem/*=NULL*/)
 		Item_in_tree =	(*PosSet)->set()->find_elem(Item);
 
 		continue_inference = (Item_in_tree != NULL);
+
+		// In the expiry of time windows the Set is propagated once for all its items expired (see set_expiry)
+		if (continue_inference && Engine::current()->_expiring)
+		{
+			if ((*PosSet)->set()->expire_elem(Item_in_tree))
+			{
+				SetExpiry *expiry = new SetExpiry(this, code_p, data);
+				expiry->next = Engine::current()->_set_expiry;
+				Engine::current()->_set_expiry = expiry;
+			}
+			return;
+		}
  
 		if (continue_inference)
 		{
@@ -3987,6 +4571,130 @@ void Node::set_call_RETRACT(ExecData &data, MetaObj *LeftItemInMem/*=NULL*/)
 	}
 }
 
+/**
+ * @brief Retract at once all the items expired of a Set (see set_call_RETRACT). The Set is propagated as modified,
+ * 		  or retracted if all its items have expired
+ * 
+ * @param data Execution data, with what arrived with the first item expired
+ */
+void Node::set_call_EXPIRY(ExecData &data)
+{
+	MetaObj **PosSet, *LeftItemInMem;
+	Set *set;
+	int set_deleted;
+	BTree *tree = Engine::node_mem(code_p[SET_NODE_MEM_POS]);
+
+	int first_pos = (int)(code_p[SET_NODE_FIRST_ITEM_POS] >> 8);
+	int n_objs = (int)(code_p[SET_NODE_N_ITEMS_POS]);
+	ULong * begin_code = code_p + LEN_SET_NODE;
+	ULong * end_code = begin_code + code_p[SET_NODE_CODELEN_POS];
+
+	LeftItemInMem = (MetaObj *)tree->Find(data.left, MetaObj::metacmp_objs, NULL, NULL, begin_code, end_code);
+
+	// The Set has been retracted meanwhile with its items
+	if (LeftItemInMem == NULL)
+		return;
+
+	PosSet = LeftItemInMem->meta_dir(&LeftItemInMem, first_pos, n_objs);
+	set = (*PosSet)->set();
+
+	set_deleted = set->will_be_null_by_expiry();
+
+	if (set_deleted)
+		tree->Delete(data.left, MetaObj::metacmp_objs, NULL, NULL, begin_code, end_code);
+
+	set->setExpiryOp();
+
+	if (set_deleted)
+	{
+		if (trace >= 2)
+		{
+			fprintf(trace_file,  "SET EXPIRY: PROPAGATION TAG = %d\nOBJ = ", RETRACT_TAG);
+			LeftItemInMem->print(stdout, print_objkey);
+			fprintf(trace_file,  "\n");
+		}
+
+		ExecData new_data((*data.st), LeftItemInMem, NULL, RETRACT_TAG, data.side, data.pos);
+		propagate(new_data, end_code);
+	}
+
+	else
+	{
+		if (trace >= 2)
+		{
+			fprintf(trace_file,  "SET EXPIRY: PROPAGATION TAG = %d\nOBJ = ", MODIFY_TAG);
+			LeftItemInMem->print(stdout, print_objkey);
+			fprintf(trace_file,  "\n");
+		}
+
+		ExecData new_data((*data.st), LeftItemInMem, NULL, INSERT_TAG, data.side, data.pos);
+		propagate_modify(new_data, end_code);
+	}
+
+	set->end_expiry();
+
+	if (set_deleted)
+		LeftItemInMem -> delete_struct(FALSE, FALSE);	// Delete the set
+}
+
+/**
+ * @brief Construct a new SetExpiry:: SetExpiry object, holding what arrived with the first item expired of a Set
+ * 
+ * @param SetNode The node of the Set
+ * @param Codep Where the code of the SET node starts
+ * @param data Execution data
+ */
+SetExpiry::SetExpiry(Node *SetNode, ULong *Codep, ExecData &data)
+{
+	node = SetNode;
+	codep = Codep;
+	left = data.left;
+	left->link();
+	st = new Status(*data.st);
+	side = data.side;
+	pos = data.pos;
+	next = NULL;
+}
+
+/**
+ * @brief Destroy the SetExpiry:: SetExpiry object
+ * 
+ */
+SetExpiry::~SetExpiry()
+{
+	left->unlink();
+	delete st;
+}
+
+/**
+ * @brief Propagate the Sets with items expired in the current expiry, once for each Set, in the order 
+ * 		  they had their first item expired
+ * 
+ */
+void Node::set_expiry()
+{
+	Engine *engine = Engine::current();
+	SetExpiry *expiry, *list = NULL;
+
+	while ((expiry = engine->_set_expiry) != NULL)
+	{
+		engine->_set_expiry = expiry->next;
+		expiry->next = list;
+		list = expiry;
+	}
+
+	while ((expiry = list) != NULL)
+	{
+		list = expiry->next;
+
+		code_p = expiry->codep;
+		ExecData data(*expiry->st, expiry->left, NULL, RETRACT_TAG, expiry->side, expiry->pos);
+		expiry->node->set_call_EXPIRY(data);
+
+		delete expiry;
+	}
+}
+
 /**
  * @brief MODIFY an item in the tree. The object always come by left and nothing at right (is an INTRA node)
  * 
@@ -3998,7 +4706,7 @@ void Node::set_call_MODIFY(ExecData &data)
 	MetaObj *Item;
 	int continue_inference;
 	Status new_st(*data.st);
-	BTree *tree = (BTree *)code_p[SET_NODE_MEM_POS];
+	BTree *tree = Engine::node_mem(code_p[SET_NODE_MEM_POS]);
 
 	int first_pos = (int)(code_p[SET_NODE_FIRST_ITEM_POS] >> 8);
 	int n_objs = (int)(code_p[SET_NODE_N_ITEMS_POS]);
@@ -4119,7 +4827,8 @@ void Node::set_call_MODIFY(ExecData &data)
 int Node::timer_call(Node *node, ExecData &data)
 {
 	ULong window = code_p[TIMER_NODE_WINDOW_POS];
-	BTree *tree = (BTree *)code_p[TIMER_NODE_MEM_POS];
+	BTree *tree = Engine::node_mem(code_p[TIMER_NODE_MEM_POS]);
+	BTreeT<MetaObj, MetaObj::CompareT> mem(tree);
 	MetaObj *LeftItemInMem;
 	int continue_inference;
 
@@ -4133,7 +4842,7 @@ int Node::timer_call(Node *node, ExecData &data)
 			// If, as a consecuence of refresh some actions have been created, we will concatenate the insertion after them
 			// Thinking on the possible counts of elements, the old element must to get out the set before enter the new
 			
-			if ((tmr = node->timer_refresh(code_p, data.left->t1(), false)) > 0)
+			if ((tmr = node->timer_refresh(code_p, data.left->t1())) > 0)
 			{
 				data.left->link();
 				if (trace >= 2) fprintf(trace_file, "LINK+ timer_call\n");
@@ -4145,11 +4854,14 @@ int Node::timer_call(Node *node, ExecData &data)
 			}
 			else if (tmr == 0)
 			{
-				LeftItemInMem = *(MetaObj **)tree->Insert(data.left, MetaObj::compare_t);
+				LeftItemInMem = *mem.Insert(data.left);
 
 				// The object is stored if what is stored is the object
 				if (continue_inference = (LeftItemInMem != NULL && data.left == LeftItemInMem))
+				{
 					data.left->link();
+					node->timer_schedule(code_p);
+				}
 
 				if (trace >= 2) fprintf(trace_file, "LINK+ timer_call\n");
 			}
@@ -4161,7 +4873,7 @@ int Node::timer_call(Node *node, ExecData &data)
 		case MODIFY_TAG:
 			data.left->set_state(OLD_ST, data.st, data.pos);
 	
-			LeftItemInMem = (MetaObj *)tree->Find(data.left, MetaObj::compare_t);
+			LeftItemInMem = mem.Find(data.left);
 
 			continue_inference = (LeftItemInMem != NULL);
 
@@ -4188,7 +4900,7 @@ int Node::timer_call(Node *node, ExecData &data)
 
 			break;
 		case RETRACT_TAG: 
-			LeftItemInMem = (MetaObj *)tree->Delete(data.left, MetaObj::compare_t);
+			LeftItemInMem = mem.Delete(data.left);
 
 			continue_inference = (LeftItemInMem != NULL);
 
@@ -4227,14 +4939,15 @@ int Node::timer_call(Node *node, ExecData &data)
 }
 
 /**
- * @brief Retract all the elements older than the window in timed nodes (TIMER or ANDW an its variations)
+ * @brief Retract all the elements older than the window in timed nodes (TIMER or ANDW an its variations).
+ * 		  The retractions are only queued, so the memory is not changed while it is walked. They are 
+ * 		  propagated by the loop in progress or, in an external refresh, all at once (see timer_refresh_due)
  * 
  * @param codep Where the timed op code starts
  * @param timestamp Real time unix timestamp
- * @param extern_refresh If done externally
  * @return int Number of object flushed
  */
-int Node::timer_refresh(ULong *codep, long timestamp, bool extern_refresh)
+int Node::timer_refresh(ULong *codep, long timestamp)
 {
 	int number_of_objects_flushed = 0;
 
@@ -4244,10 +4957,10 @@ int Node::timer_refresh(ULong *codep, long timestamp, bool extern_refresh)
 
 	Single *ItemInMem;
 
-	BTree *mem = (BTree *)code_p[TIMER_NODE_MEM_POS];
+	BTree *mem = Engine::node_mem(code_p[TIMER_NODE_MEM_POS]);
 	BTState state;
 
-	state = mem->FindBiggerThan(NULL, MetaObj::compare_tw, (timestamp - window));
+	state = BTreeT<Single, MetaObj::CompareTW>(mem, MetaObj::CompareTW(timestamp - window)).FindBiggerThan(NULL);
 
 	while (ItemInMem = (Single *)mem->Walk(state))
 	{
@@ -4258,13 +4971,108 @@ int Node::timer_refresh(ULong *codep, long timestamp, bool extern_refresh)
 
 		Action *act = new Action(RETRACT_TAG, ItemInMem, NULL, ItemInMem->obj(),
 														FALSE, this, codep);
+		act->_expiry = TRUE;
 		act->push();
+	}
+	return number_of_objects_flushed;
+}
+
+/**
+ * @brief Keep the entry of a TIMER node in the schedule of the engine at the time its oldest item gets out 
+ * 		  of the window, so engine_refresh only visits the nodes with items to retract. The entry is removed
+ * 		  when the memory is empty. The retractions do not reschedule the node, its entry may stay earlier
+ * 		  than needed until it is visited (see timer_refresh_due)
+ * 
+ * @param codep Where the code of the TIMER node starts
+ * @param refreshed Time of the refresh just done in the node, the entry is kept after it
+ */
+void Node::timer_schedule(ULong *codep, long refreshed)
+{
+	Engine *engine = Engine::current();
+	BTreeT<TimerDue, TimerDue::Compare> timers(&engine->_timers);
+	TimerDue *&entry = engine->timer_due(codep[TIMER_NODE_MEM_POS]);
+	MetaObj *oldest = (MetaObj *)engine->mem(codep[TIMER_NODE_MEM_POS])->getLast();
+	long due;
+
+	if (oldest == NULL)
+	{
+		if (entry != NULL)
+		{
+			(void)timers.Delete(entry);
+			delete entry;
+			entry = NULL;
+		}
+		return;
+	}
 
-		if (extern_refresh)
-			do_loop(Action::main_list(), FALSE);
+	// Items as old as the limit may be kept by a refresh, they are retracted by the next one
+	due = oldest->t2() + (long)codep[TIMER_NODE_WINDOW_POS];
+	if (due <= refreshed)
+		due = refreshed + 1;
 
+	if (entry == NULL)
+	{
+		entry = new TimerDue;
+		entry->node = this;
+		entry->codep = codep;
 	}
-	return number_of_objects_flushed;
+	else if (entry->due == due)
+		return;
+	else
+		(void)timers.Delete(entry);
+
+	entry->due = due;
+	(void)timers.Insert(entry);
+}
+
+/**
+ * @brief Refresh, in the order of their due times, the TIMER nodes of the current engine that may have 
+ * 		  items out of the window at a time. The items expired in all of them are retracted in one 
+ * 		  propagation, and the rules are executed after it (see do_loop_expiry)
+ * 
+ * @param real_time Real time unix timestamp
+ */
+void Node::timer_refresh_due(long real_time)
+{
+	Engine *engine = Engine::current();
+	TimerDue *first;
+
+	while ((first = (TimerDue *)engine->_timers.getFirst()) != NULL && first->due <= real_time)
+	{
+		Node *node = first->node;
+		ULong *codep = first->codep;
+
+		node->timer_refresh(codep, real_time);
+		node->timer_schedule(codep, real_time);
+	}
+
+	while (Action::main_list() != NULL)
+		do_loop(Action::main_list(), FALSE);
+
+	// The nodes refreshed were scheduled before their items were retracted
+	(void)timer_next_due();
+}
+
+/**
+ * @brief First time when an item of the TIMER nodes of the current engine gets out of its window.
+ * 		  The entries left behind by the retractions are updated on the way
+ * 
+ * @return long The time, -1 if there is no item in a time window
+ */
+long Node::timer_next_due()
+{
+	Engine *engine = Engine::current();
+	TimerDue *first;
+	long due;
+
+	while ((first = (TimerDue *)engine->_timers.getFirst()) != NULL)
+	{
+		due = first->due;
+		first->node->timer_schedule(first->codep, due - 1);
+		if ((TimerDue *)engine->_timers.getFirst() == first && first->due == due)
+			return due;
+	}
+	return -1;
 }
 
 /**
@@ -4293,9 +5101,11 @@ int Node::prod_call(Node *node, ExecData &data)
 	n_objs_impl		= (int)code_p[PROD_NODE_NOBJIMP_POS];
 	flags			= code_p[PROD_NODE_FLAGS_POS];
 	objs_impl		= (int*)(code_p + PROD_START_OBJ_POS);
-	BTree *tree		= (BTree *)code_p[PROD_NODE_MEM_POS];
+	BTree *tree		= Engine::node_mem(code_p[PROD_NODE_MEM_POS]);
 
-	BTree &tree_cat = conflict_set_mem[cat];
+	BTree &tree_cat = Engine::current()->_conflict_set_mem[cat];
+	BTreeT<Compound, Compound::CompareWithLeft> prods(tree);
+	BTreeT<ConflictSet, ConflictSet::CompareCSet> csets(&tree_cat);
 
 	if (trace >= 2)
 	{
@@ -4319,7 +5129,7 @@ int Node::prod_call(Node *node, ExecData &data)
 			if (!(flags & EXEC_TRIGGER))
 			{
 				Compound *inserted;
-				inserted = *(Compound **)tree->Insert(ProdCompound, (BTCompareFunc)Compound::compare_left_with_left);
+				inserted = *BTreeT<Compound, Compound::CompareLeftWithLeft>(tree).Insert(ProdCompound);
 				if (inserted != ProdCompound)
 				{
 					// This never should happen
@@ -4330,7 +5140,7 @@ int Node::prod_call(Node *node, ExecData &data)
 			}
 
 			cs = new ConflictSet(data.tag, node, ProdCompound);
-			cs_inserted = *(ConflictSet **)tree_cat.Insert(cs, (BTCompareFunc)ConflictSet::compare_cset);
+			cs_inserted = *csets.Insert(cs);
 			if (cs_inserted !=	cs)		// If it was already there
 			{
 				delete cs;				// The current cs is freed
@@ -4349,7 +5159,7 @@ int Node::prod_call(Node *node, ExecData &data)
 
 			if (!(flags & EXEC_TRIGGER))
 			{
-				ProdCompound=(Compound *)tree->Find(data.left, (BTCompareFunc)Compound::compare_with_left);
+				ProdCompound=prods.Find(data.left);
 
 				if (ProdCompound == NULL)
 				{
@@ -4363,7 +5173,7 @@ int Node::prod_call(Node *node, ExecData &data)
 			ProdCompound->left()->set_state(NEW_ST, data.st, data.pos);
 
 			cs = new ConflictSet(data.tag, node, ProdCompound);
-			cs_inserted = *(ConflictSet **)tree_cat.Insert(cs, (BTCompareFunc)ConflictSet::compare_cset);
+			cs_inserted = *csets.Insert(cs);
 
 			if (cs_inserted !=	cs)		// If it was already there
 			{
@@ -4386,7 +5196,7 @@ int Node::prod_call(Node *node, ExecData &data)
 
 			if (!(flags & EXEC_TRIGGER))
 			{
-				ProdCompound = (Compound *)tree->Delete(data.left, (BTCompareFunc)Compound::compare_with_left);
+				ProdCompound = prods.Delete(data.left);
 				if (ProdCompound == NULL)
 				{
 					// This never should happen
@@ -4396,7 +5206,7 @@ int Node::prod_call(Node *node, ExecData &data)
 			}
 			
 			ConflictSet cs_muestra(data.tag, node, &prod_com_aux);
-			old = (ConflictSet *)tree_cat.Delete(&cs_muestra, (BTCompareFunc)ConflictSet::compare_cset);
+			old = csets.Delete(&cs_muestra);
  
 			if (old != NULL)				// The rule was already at the CS (May be in MODIFY or RETRACT)
 			{
@@ -4439,11 +5249,11 @@ int Node::run_cs()
 	ConflictSet *cs;
 
 	cs = ConflictSet::best_cset(&cat);
-	BTree &tree_cat = conflict_set_mem[cat];
+	BTree &tree_cat = Engine::current()->_conflict_set_mem[cat];
 
 	if (cs != NULL)
 	{
-		(void)tree_cat.Delete(cs, (BTCompareFunc)ConflictSet::compare_cset);
+		(void)BTreeT<ConflictSet, ConflictSet::CompareCSet>(&tree_cat).Delete(cs);
 		cs->execute(&Node::perform_execution);
 		cs->remove(cat);
 		return TRUE;
@@ -4509,7 +5319,7 @@ void Node::perform_execution(int tag, Compound *ProdCompound)
 			code_p+= n_objs;	// The indexes of the implied objects
 		}
 
-		n_inf++;
+		Engine::current()->_n_inf++;
 
 		if (trace)
 		{
@@ -4525,6 +5335,9 @@ void Node::perform_execution(int tag, Compound *ProdCompound)
 		ExecData exec_data(st_new, ProdCompound->left(), ProdCompound->right(), tag, LEFT_MEM, -1);
 		
 
+		// The stack may not have been used yet by this thread (the root does not execute the TCLASS)
+		dstack_p = data_stack;
+
 		int res=1;
 		while ( res>0 )
 		{
@@ -4912,24 +5725,29 @@ int Node::popsa_call(Node *node, ExecData &data)
 
 	dstack_p--;
 
-	if (dstack_p->str.str_p == NULL || value->str.str_p == NULL ||
-			strcmp(dstack_p->str.str_p, value->str.str_p) != 0)
+	if (dstack_p->str.str_p != value->str.str_p &&
+			(dstack_p->str.str_p == NULL || value->str.str_p == NULL ||
+			 ((dstack_p->str.dynamic_flags & INTERNED) && (value->str.dynamic_flags & INTERNED)) ||
+			 strcmp(dstack_p->str.str_p, value->str.str_p) != 0))
 	{
-		// if the data at the stack is DINAMIC it is used directly
+		// if the data at the stack is DINAMIC it is used directly, and if it is INTERNED it is shared
 		// otherwise a copy of it is done (an attribute of an object or something static hast the flag to 0)
 
 		if (dstack_p->str.dynamic_flags == DYNAMIC || dstack_p->str.str_p == NULL)
 			str = dstack_p->str.str_p;
+		else if (dstack_p->str.dynamic_flags & INTERNED)
+			str = dstack_p->str.str_p;
 		else
 			str = strdup(dstack_p->str.str_p);
 
 		// OLD VALUE
 		// If the old value is DYNAMIC it is freed (unless in MODIFY that is stored to be able to recreate the old status)
-		if (value->str.dynamic_flags == DYNAMIC) 	
+		// An INTERNED one is never freed, but in MODIFY it must be recreated too
+		if (value->str.dynamic_flags == DYNAMIC || (value->str.dynamic_flags & INTERNED))
 		{
 			if (Action::last()->_tag == MODIFY_TAG)
 				Action::last()->store_mod_attr(attr);
-			else
+			else if (value->str.dynamic_flags == DYNAMIC)
 				free(value->str.str_p);
 		}
 
@@ -4937,7 +5755,7 @@ int Node::popsa_call(Node *node, ExecData &data)
 		value->str.str_p = str;
 
 		if (str != NULL)
-			value->str.dynamic_flags = DYNAMIC;
+			value->str.dynamic_flags = (dstack_p->str.dynamic_flags & INTERNED) ? INTERNED : DYNAMIC;
 	}
 	else if (dstack_p->str.str_p != NULL && dstack_p->str.dynamic_flags == DYNAMIC)
 	{
@@ -5011,12 +5829,11 @@ int Node::execute_cmp(ULong *code, ULong *end_of_code, MetaObj *left, MetaObj *r
  * 
  * @param c_obj1 MetaObj
  * @param c_obj2 MatchCounter
- * @param list List of variable arguments taht will be passe dto the compare function
  * @return int <1, 0 , >1
  */
-int Node::cmp_count_with_object(const void *c_obj1, const void *c_obj2, va_list list)
+int Node::cmp_count_with_object(const void *c_obj1, const void *c_obj2, va_list)
 {
-	return ((MatchCount *)c_obj2)->item->compare((MetaObj *)c_obj1, list);
+	return ((MatchCount *)c_obj2)->item->compare((MetaObj *)c_obj1);
 }
 
 /**
@@ -0,0 +1,556 @@
+/**
+ * @file parallel.cpp
+ * @author Francisco Alcaraz
+ * @brief Parallel propagation. At load time the children of every node are split in groups whose subnets
+ *        share no node (so no memory). The insertion of an object that reaches one of these forks is propagated
+ *        into the groups concurrently by a pool of threads. Each thread works with a view of the engine (see context.hpp)
+ *        that uses its memories but keeps apart the actions and the Conflict Set items produced by every child.
+ *        These are merged in the engine in the order of the children, so the result is the same as the one
+ *        of the sequential propagation. Only the subnets that cannot execute rules or external code during an
+ *        insertion are allowed (see Node::par_safe)
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "engine.h"
+#include "load.hpp"
+#include "classes.hpp"
+#include "actions.hpp"
+#include "confset.hpp"
+#include "parallel.hpp"
+#include "error.hpp"
+
+pthread_t Parallel::_threads[MAXPARTHREADS];
+Engine *Parallel::_views[MAXPARTHREADS + 1];
+int Parallel::_n_threads = 0;
+ULong Parallel::_forks_version = (ULong)-1;
+
+pthread_mutex_t Parallel::_job_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t Parallel::_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Parallel::_work_cond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t Parallel::_idle_cond = PTHREAD_COND_INITIALIZER;
+int Parallel::_job_open = FALSE;
+ULong Parallel::_generation = 0;
+int Parallel::_active = 0;
+int Parallel::_stop = FALSE;
+
+Engine *Parallel::_engine = NULL;
+ExecData *Parallel::_data = NULL;
+ParFork *Parallel::_fork = NULL;
+ParSegment *Parallel::_segs = NULL;
+int Parallel::_n_segs = 0;
+ParRange Parallel::_ranges[MAXPARTHREADS + 1];
+int Parallel::_n_parts = 0;
+
+ENGINE_TLS int Parallel::_in_worker = FALSE;
+
+PRIVATE ULong curr_stamp = 0;
+
+//
+// GROUPS OF CHILDREN
+//
+
+/**
+ * @brief Group of a child, as an union-find set
+ *
+ * @param groups The union-find array
+ * @param n The child
+ * @return int The lowest child of its group
+ */
+PRIVATE
+int group_of(int *groups, int n)
+{
+  while (groups[n] != n)
+    n = groups[n] = groups[groups[n]];
+  return n;
+}
+
+/**
+ * @brief Put two children in the same group
+ *
+ * @param groups The union-find array
+ * @param a A child
+ * @param b Other child
+ */
+PRIVATE
+void join_groups(int *groups, int a, int b)
+{
+  a = group_of(groups, a);
+  b = group_of(groups, b);
+
+  if (a < b)
+    groups[b] = a;
+  else
+    groups[a] = b;
+}
+
+/**
+ * @brief Mark the subnet of a child. When a node already marked by other child is found, both children are joined
+ *
+ * @param node The node
+ * @param stamp The stamp of the walk
+ * @param child The child
+ * @param groups The union-find array
+ * @return int FALSE if a node of the subnet cannot be propagated in parallel
+ */
+PRIVATE
+int mark_subnet(Node *node, ULong stamp, int child, int *groups)
+{
+  Node *next;
+  NodeIter iter;
+  int side;
+
+  if (node->par_stamp() == stamp)
+  {
+    join_groups(groups, child, node->par_group());
+    return TRUE;
+  }
+
+  node->par_stamp() = stamp;
+  node->par_group() = child;
+
+  if (!node->par_safe())
+    return FALSE;
+
+  for (next = node->first_child(side, iter); next != NULL; next = node->next_child(side, iter))
+  {
+    if (!mark_subnet(next, stamp, child, groups))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Collect all the nodes of the net, each one once
+ *
+ * @param node The node where to start
+ * @param stamp The stamp of the walk
+ * @param nodes Where to collect them
+ * @param n_nodes Number of nodes collected
+ * @param size Size of nodes
+ */
+PRIVATE
+void collect_nodes(Node *node, ULong stamp, Node **&nodes, int &n_nodes, int &size)
+{
+  Node *next;
+  NodeIter iter;
+  int side;
+
+  if (node->par_stamp() == stamp)
+    return;
+  node->par_stamp() = stamp;
+
+  if (n_nodes == size)
+  {
+    size = (size == 0) ? 256 : size * 2;
+    if ((nodes = (Node **)realloc(nodes, size * sizeof(Node *))) == NULL)
+      engine_fatal_err("realloc: %s\n", strerror(errno));
+  }
+  nodes[n_nodes++] = node;
+
+  for (next = node->first_child(side, iter); next != NULL; next = node->next_child(side, iter))
+    collect_nodes(next, stamp, nodes, n_nodes, size);
+}
+
+/**
+ * @brief Build the groups of the children of a node
+ *
+ * @param node The node
+ * @param stamp The stamp of the walk
+ * @return ParFork* The groups, NULL if there is only one or any of them cannot be propagated in parallel
+ */
+ParFork *Parallel::new_fork(Node *node, ULong stamp)
+{
+  ParFork *fork;
+  Node *child;
+  NodeIter iter;
+  int side, n, g, n_children, n_groups, *groups;
+
+  for (n_children = 0, child = node->first_child(side, iter); child != NULL; child = node->next_child(side, iter))
+    n_children++;
+
+  if (n_children < 2)
+    return NULL;
+
+  groups = (int *)malloc(n_children * sizeof(int));
+  if (groups == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  for (n = 0; n < n_children; n++)
+    groups[n] = n;
+
+  for (n = 0, child = node->first_child(side, iter); child != NULL; child = node->next_child(side, iter), n++)
+  {
+    if (!mark_subnet(child, stamp, n, groups))
+    {
+      free(groups);
+      return NULL;
+    }
+  }
+
+  for (n_groups = 0, n = 0; n < n_children; n++)
+    if (group_of(groups, n) == n)
+      n_groups++;
+
+  if (n_groups < 2)
+  {
+    free(groups);
+    return NULL;
+  }
+
+  fork = (ParFork *)malloc(sizeof(ParFork));
+  if (fork == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  fork->_n_children = n_children;
+  fork->_n_groups = n_groups;
+  fork->_child = (Node **)malloc(n_children * sizeof(Node *));
+  fork->_side = (int *)malloc(n_children * sizeof(int));
+  fork->_first = (int *)malloc((n_groups + 1) * sizeof(int));
+  fork->_members = (int *)malloc(n_children * sizeof(int));
+  if (fork->_child == NULL || fork->_side == NULL || fork->_first == NULL || fork->_members == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  for (n = 0, child = node->first_child(side, iter); child != NULL; child = node->next_child(side, iter), n++)
+  {
+    fork->_child[n] = child;
+    fork->_side[n] = side;
+  }
+
+  // The groups are in the order of their first child, and the children in their order inside each group
+  for (g = 0, n_groups = 0, n = 0; g < n_children; g++)
+  {
+    if (group_of(groups, g) != g)
+      continue;
+
+    fork->_first[n_groups++] = n;
+    for (side = g; side < n_children; side++)
+      if (group_of(groups, side) == g)
+        fork->_members[n++] = side;
+  }
+  fork->_first[n_groups] = n_children;
+
+  free(groups);
+  return fork;
+}
+
+/**
+ * @brief Free the groups of a node
+ *
+ * @param fork The groups
+ */
+void Parallel::free_fork(ParFork *fork)
+{
+  if (fork == NULL)
+    return;
+
+  free(fork->_child);
+  free(fork->_side);
+  free(fork->_first);
+  free(fork->_members);
+  free(fork);
+}
+
+/**
+ * @brief Build again the groups of all the nodes of the net. Called when the net has been changed
+ *
+ */
+void Parallel::build_forks()
+{
+  Node **nodes = NULL, *root = ObjClass::get_real_root();
+  int n, n_nodes = 0, size = 0;
+
+  collect_nodes(root, ++curr_stamp, nodes, n_nodes, size);
+
+  for (n = 0; n < n_nodes; n++)
+  {
+    free_fork(nodes[n]->par_fork());
+
+    // The classes hang from the root, and an object only passes one of them
+    if (nodes[n] != root && nodes[n]->type() == INTRA)
+      nodes[n]->par_fork() = new_fork(nodes[n], ++curr_stamp);
+    else
+      nodes[n]->par_fork() = NULL;
+  }
+
+  free(nodes);
+  _forks_version = Node::_n_changes;
+}
+
+//
+// POOL OF THREADS
+//
+
+/**
+ * @brief Start the pool of threads
+ *
+ * @param n_threads Number of threads, the calling thread apart
+ * @return int The number of threads, or ERROR if it is not valid or the pool is already running
+ */
+int Parallel::start(int n_threads)
+{
+  int n, err;
+
+  if (n_threads <= 0 || n_threads > MAXPARTHREADS || _n_threads > 0)
+    return ERROR;
+
+  for (n = 0; n <= n_threads; n++)
+    _views[n] = new Engine(&Engine::_default);
+
+  _stop = FALSE;
+  MetaObj::_atomic_links = TRUE;
+
+  for (n = 0; n < n_threads; n++)
+  {
+    if ((err = pthread_create(&_threads[n], NULL, Parallel::worker, (void *)(long)(n + 1))) != 0)
+      engine_fatal_err("pthread_create: %s\n", strerror(err));
+  }
+
+  _n_threads = n_threads;
+  return n_threads;
+}
+
+/**
+ * @brief Stop the pool of threads. No propagation can be in progress
+ *
+ */
+void Parallel::stop()
+{
+  int n;
+
+  if (_n_threads == 0)
+    return;
+
+  pthread_mutex_lock(&_lock);
+  _stop = TRUE;
+  pthread_cond_broadcast(&_work_cond);
+  pthread_mutex_unlock(&_lock);
+
+  for (n = 0; n < _n_threads; n++)
+    pthread_join(_threads[n], NULL);
+
+  for (n = 0; n <= _n_threads; n++)
+    delete _views[n];
+
+  _n_threads = 0;
+  MetaObj::_atomic_links = FALSE;
+}
+
+/**
+ * @brief Main loop of the threads of the pool. Waits for a job and takes part in it
+ *
+ * @param part Index of the thread in the pool, from 1
+ * @return void* NULL
+ */
+void *Parallel::worker(void *part)
+{
+  ULong seen = 0;
+
+  pthread_mutex_lock(&_lock);
+  for (;;)
+  {
+    while (!_stop && (!_job_open || _generation == seen))
+      pthread_cond_wait(&_work_cond, &_lock);
+
+    if (_stop)
+      break;
+
+    seen = _generation;
+    _active++;
+    pthread_mutex_unlock(&_lock);
+
+    run((int)(long)part);
+
+    pthread_mutex_lock(&_lock);
+    if (--_active == 0)
+      pthread_cond_broadcast(&_idle_cond);
+  }
+  pthread_mutex_unlock(&_lock);
+
+  return NULL;
+}
+
+/**
+ * @brief Take a group to propagate. First from the range of the thread, then from the others
+ *
+ * @param part Index of the thread
+ * @return int The group, or -1 if all of them have been taken
+ */
+int Parallel::take(int part)
+{
+  int n, g;
+  ParRange *range;
+
+  for (n = 0; n < _n_parts; n++)
+  {
+    range = &_ranges[(part + n) % _n_parts];
+    if (__atomic_load_n(&range->_next, __ATOMIC_RELAXED) >= range->_end)
+      continue;
+
+    if ((g = __atomic_fetch_add(&range->_next, 1, __ATOMIC_RELAXED)) < range->_end)
+      return g;
+  }
+  return -1;
+}
+
+/**
+ * @brief Propagate the groups taken by a thread. Each child leaves its actions and its
+ *        Conflict Set items in its segment
+ *
+ * @param part Index of the thread
+ */
+void Parallel::run(int part)
+{
+  Engine *view = _views[part];
+  Engine *prev = Engine::select(view);
+  ParSegment *seg;
+  int g, n, c, cat;
+
+  view->view_of(_engine);
+  _in_worker = TRUE;
+
+  while ((g = take(part)) >= 0)
+  {
+    for (n = _fork->_first[g]; n < _fork->_first[g + 1]; n++)
+    {
+      c = _fork->_members[n];
+
+      ExecData data(*_data);
+      data.side = _fork->_side[c];
+      _fork->_child[c]->propagate(data);
+
+      seg = &_segs[c];
+      seg->_view = view;
+      seg->_actions = view->_action_list;
+      view->_action_list = NULL;
+      view->_action_tail = &view->_action_list;
+      view->_last = NULL;
+      for (cat = 0; cat < 3; cat++)
+      {
+        seg->_cs[cat] = view->_conflict_set[cat];
+        view->_conflict_set[cat] = NULL;
+      }
+    }
+  }
+
+  _in_worker = FALSE;
+  Engine::select(prev);
+}
+
+/**
+ * @brief Move to the engine what the children left in their segments, in the order of the children
+ *
+ */
+void Parallel::merge()
+{
+  ParSegment *seg;
+  Action *act, *next;
+  int c, cat;
+
+  for (c = 0; c < _fork->_n_children; c++)
+  {
+    seg = &_segs[c];
+
+    for (act = seg->_actions; act != NULL; act = next)
+    {
+      next = act->_next;
+      act->_next = NULL;
+      act->push();
+    }
+
+    for (cat = 0; cat < 3; cat++)
+      ConflictSet::move_list(seg->_cs[cat], cat, seg->_view->_conflict_set_mem[cat]);
+  }
+
+  for (c = 0; c < _n_parts; c++)
+  {
+    _engine->_n_inf += _views[c]->_n_inf;
+    _views[c]->_n_inf = 0;
+  }
+}
+
+/**
+ * @brief Propagate the children of a fork in parallel. The calling thread takes part
+ *
+ * @param node The node
+ * @param data The execution data of the node
+ * @return int FALSE if the pool is busy with other engine, so the propagation has to be done sequentially
+ */
+int Parallel::propagate(Node *node, ExecData &data)
+{
+  ParFork *fork = node->par_fork();
+  Engine *engine = Engine::current();
+  int n;
+
+  if (pthread_mutex_trylock(&_job_lock) != 0)
+    return FALSE;
+
+  // The tables of the engine must not be moved while the views are using them
+  if (engine->_n_mem < Engine::_n_mem_slots)
+    engine->grow_mem(Engine::_n_mem_slots - 1);
+  if (engine->_n_marks < Engine::_n_mark_slots)
+    engine->grow_marks(Engine::_n_mark_slots - 1);
+
+  if (_n_segs < fork->_n_children)
+  {
+    _n_segs = fork->_n_children;
+    if ((_segs = (ParSegment *)realloc(_segs, _n_segs * sizeof(ParSegment))) == NULL)
+      engine_fatal_err("realloc: %s\n", strerror(errno));
+  }
+
+  _engine = engine;
+  _data = &data;
+  _fork = fork;
+  _n_parts = (fork->_n_groups < _n_threads + 1) ? fork->_n_groups : _n_threads + 1;
+  for (n = 0; n < _n_parts; n++)
+  {
+    _ranges[n]._next = n * fork->_n_groups / _n_parts;
+    _ranges[n]._end = (n + 1) * fork->_n_groups / _n_parts;
+  }
+
+  pthread_mutex_lock(&_lock);
+  _job_open = TRUE;
+  _generation++;
+  pthread_cond_broadcast(&_work_cond);
+  pthread_mutex_unlock(&_lock);
+
+  run(0);
+
+  pthread_mutex_lock(&_lock);
+  _job_open = FALSE;
+  while (_active > 0)
+    pthread_cond_wait(&_idle_cond, &_lock);
+  pthread_mutex_unlock(&_lock);
+
+  Engine::select(engine);
+  merge();
+
+  pthread_mutex_unlock(&_job_lock);
+  return TRUE;
+}
+
+//
+// API
+//
+
+/**
+ * @brief Start or stop the parallel propagation. It must not be called while a propagation is in progress
+ *
+ * @param n_threads Number of threads of the pool, apart the calling one. 0 stops it
+ * @return int The number of threads, or ERROR if it is not valid
+ */
+PUBLIC
+int engine_parallel(int n_threads)
+{
+  Parallel::stop();
+
+  if (n_threads == 0)
+    return 0;
+
+  return Parallel::start(n_threads);
+}
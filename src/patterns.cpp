@@ -274,12 +274,12 @@ Pattern::get_pattern(int patt_no)
  * @brief Add a class-check node (INTRA node with TCLASS code in it) according to the class of this pattern
  *      and get the resulting last_intra node
  * 
- * @param name Name of the class
+ * @param class_id Id of the class
  */
 void
-Pattern::add_class_check(char *name)
+Pattern::add_class_check(int class_id)
 {
-   _root -> insert_class_check(&_last_intra, name, TRUE);
+   _root -> insert_class_check(&_last_intra, class_id, TRUE);
 }
 
 /**
@@ -9,6 +9,7 @@
  */
 
 #include <unistd.h>
+#include <pthread.h>
 #include "config.hpp"
 #include "primit_p.hpp"
 
@@ -38,6 +39,8 @@ static char *format_float(char *str, double num, int size, int precision, int fl
 #define FPRINTF 2
 static void gprintf_call(Value *stack, int prtype);
 
+static pthread_mutex_t outfile_lock = PTHREAD_MUTEX_INITIALIZER;
+
 // List of defined functions
 struct FuncList
 {
@@ -790,12 +793,14 @@ static void gprintf_call(Value *stack, int prtype)
       of = 0;
     if (of > 4)
       of = 4;
+    pthread_mutex_lock(&outfile_lock);  /* Several engines may share the files */
     if (outfile_flag[of] == 1)
     {
       outfile_flag[of] = 0;
       sprintf(outfile_name, "/tmp/eng_%d.%d", getpid(), of);
       outfile[of] = fopen(outfile_name, "a");
     }
+    pthread_mutex_unlock(&outfile_lock);
   }
 
   fmt = (char *)stack[nargs++].str.str_p;
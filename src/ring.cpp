@@ -0,0 +1,206 @@
+/**
+ * @file ring.cpp
+ * @author Francisco Alcaraz
+ * @brief Bounded lock-free queue of object events. Any thread can submit events to an engine (engine_submit)
+ *        while only one thread, the one that runs the engine, takes them to propagate them (engine_drain).
+ *        Each slot has a sequence number that says whose turn it is: the producer that has reserved the
+ *        position (by an atomic increment of the tail) or the consumer. No locks are used in any side
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "engine.h"
+#include "ring.hpp"
+#include "context.hpp"
+#include "error.hpp"
+
+/**
+ * @brief Construct a new EventRing:: EventRing object
+ *
+ * @param size Minimum number of slots. It is rounded up to a power of 2
+ */
+EventRing::EventRing(ULong size)
+{
+  ULong n, n_slots;
+
+  for (n_slots = 2; n_slots < size; n_slots *= 2);
+
+  _slots = (RingSlot *)malloc(n_slots * sizeof(RingSlot));
+  if (_slots == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  for (n = 0; n < n_slots; n++)
+    _slots[n]._seq = n;
+
+  _mask = n_slots - 1;
+  _tail = 0;
+  _head = 0;
+}
+
+/**
+ * @brief Destroy the EventRing:: EventRing object. The events not taken are lost
+ *
+ */
+EventRing::~EventRing()
+{
+  free(_slots);
+}
+
+/**
+ * @brief Queue an event. Can be called from any thread
+ *
+ * @param tag INSERT_TAG, MODIFY_TAG, od RETRACT_TAG
+ * @param obj The object
+ * @param old_obj The copy made by engine_modify, for MODIFY_TAG
+ * @return int TRUE if queued, FALSE if the ring is full
+ */
+int EventRing::put(int tag, ObjectType *obj, ObjectType *old_obj)
+{
+  RingSlot *slot;
+  ULong pos, seq;
+  long diff;
+
+  pos = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+  for (;;)
+  {
+    slot = &_slots[pos & _mask];
+    seq = __atomic_load_n(&slot->_seq, __ATOMIC_ACQUIRE);
+    diff = (long)seq - (long)pos;
+
+    if (diff == 0)
+    {
+      // The slot is free in this turn. Try to reserve it
+      if (__atomic_compare_exchange_n(&_tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    }
+    else if (diff < 0)
+      return FALSE; // Not yet taken by the consumer: full
+    else
+      pos = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+  }
+
+  slot->_tag = tag;
+  slot->_obj = obj;
+  slot->_old_obj = old_obj;
+  __atomic_store_n(&slot->_seq, pos + 1, __ATOMIC_RELEASE);
+
+  return TRUE;
+}
+
+/**
+ * @brief Take the oldest event. Only the consumer thread can call it
+ *
+ * @param tag The tag of the event
+ * @param obj The object
+ * @param old_obj The copy made by engine_modify, for MODIFY_TAG
+ * @return int TRUE if an event has been taken, FALSE if the ring is empty
+ */
+int EventRing::get(int &tag, ObjectType *&obj, ObjectType *&old_obj)
+{
+  RingSlot *slot = &_slots[_head & _mask];
+
+  if (__atomic_load_n(&slot->_seq, __ATOMIC_ACQUIRE) != _head + 1)
+    return FALSE;
+
+  tag = slot->_tag;
+  obj = slot->_obj;
+  old_obj = slot->_old_obj;
+
+  // The slot is free for the producers of the next turn
+  __atomic_store_n(&slot->_seq, _head + _mask + 1, __ATOMIC_RELEASE);
+  _head++;
+
+  return TRUE;
+}
+
+//
+// API of the event queues
+//
+
+/**
+ * @brief Queue an event to be propagated in the engine selected in the calling thread. It may be called from any thread
+ *      For MODIFY_TAG the copy made by engine_modify in the same thread goes with the event
+ *
+ * @param tag INSERT_TAG, MODIFY_TAG, od RETRACT_TAG
+ * @param obj The object to be propagated
+ * @return int TRUE if queued, FALSE if the queue is full
+ */
+PUBLIC
+int engine_submit(int tag, ObjectType *obj)
+{
+  return rce_engine_submit(Engine::current(), tag, obj);
+}
+
+/**
+ * @brief Propagate the events queued with engine_submit in the engine selected.
+ *      Only a thread at once may drain an engine
+ *
+ * @param max_events Maximum number of events to propagate, 0 for all the events queued (up to the size of the queue)
+ * @return int Number of events propagated
+ */
+PUBLIC
+int engine_drain(int max_events)
+{
+  return rce_engine_drain(Engine::current(), max_events);
+}
+
+/**
+ * @brief engine_submit over an engine instance
+ *
+ * @param engine The engine
+ * @param tag INSERT_TAG, MODIFY_TAG, od RETRACT_TAG
+ * @param obj The object to be propagated
+ * @return int TRUE if queued, FALSE if the queue is full
+ */
+PUBLIC
+int rce_engine_submit(rce_engine_t *engine, int tag, ObjectType *obj)
+{
+  ObjectType *old_obj = NULL;
+
+  if (tag == MODIFY_TAG)
+    old_obj = Engine::_old_obj_modify;
+
+  if (!engine->_ring->put(tag, obj, old_obj))
+    return FALSE;
+
+  if (tag == MODIFY_TAG)
+    Engine::_old_obj_modify = NULL;
+
+  return TRUE;
+}
+
+/**
+ * @brief engine_drain over an engine instance
+ *
+ * @param engine The engine
+ * @param max_events Maximum number of events to propagate, 0 for all the events queued (up to the size of the queue)
+ * @return int Number of events propagated
+ */
+PUBLIC
+int rce_engine_drain(rce_engine_t *engine, int max_events)
+{
+  Engine *prev = Engine::select(engine);
+  ObjectType *obj, *old_obj, *my_old_obj = Engine::_old_obj_modify;
+  int tag, n;
+
+  // Not more than a full ring, so the producers cannot keep the consumer here forever
+  if (max_events <= 0)
+    max_events = engine->_ring->size();
+
+  for (n = 0; n < max_events && engine->_ring->get(tag, obj, old_obj); n++)
+  {
+    if (tag == MODIFY_TAG)
+      Engine::_old_obj_modify = old_obj;
+    engine_loop(tag, obj);
+  }
+
+  Engine::_old_obj_modify = my_old_obj;
+  Engine::select(prev);
+
+  return n;
+}
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 
 #include <btree.hpp>
 
@@ -20,6 +21,7 @@
 #include "patterns.hpp"
 #include "rules.hpp"
 #include "strlow.hpp"
+#include "context.hpp"
 
 struct PackageInfo
 {
@@ -197,7 +199,7 @@ void def_production()
   prod_code[PROD_NODE_RULESETNM_POS] = (ULong)strdup(curr_ruleset);
   prod_code[PROD_NODE_RULECAT_POS]   = curr_rulecat;
   prod_code[PROD_NODE_NOBJIMP_POS]   = 0L;
-  prod_code[PROD_NODE_MEM_POS]     = (ULong)new BTree();
+  prod_code[PROD_NODE_MEM_POS]     = Engine::new_mem();
   prod_code[PROD_NODE_FLAGS_POS]     = curr_rule_exec_flags();
   n_obj_impl = 0;
   curr_rulename = NULL;
@@ -389,6 +391,44 @@ reset_ruleset(char *name)
      rset->rules.WalkBy(Node::reset_rule);
 }
 
+/**
+ * @brief Call a function with the production node of some rules of the Package
+ * 
+ * @param ruleset Name of the RuleSet, NULL for all the RuleSets
+ * @param rule Name of the Rule, NULL for all the Rules
+ * @param func Function to be called with each production node
+ * @param ... Additional params to be passed to the function
+ */
+PUBLIC void
+for_each_rule(char *ruleset, char *rule, BTSimpleConstFunc func, ...)
+{
+   va_list list, copy;
+   BTState rsets = pkg.rulesets.getIterator();
+   BTState rules;
+   RulesetInfo sample(ruleset != NULL ? ruleset : (char *)"");
+   RulesetInfo *rset;
+   Node *node;
+
+   va_start(list, func);
+   while ((rset = (RulesetInfo *)BTree::Walk(rsets)) != NULL)
+   {
+      if (ruleset != NULL && compare_rulesets(rset, &sample, list) != 0)
+         continue;
+
+      rules = rset->rules.getIterator();
+      while ((node = (Node *)BTree::Walk(rules)) != NULL)
+      {
+         if (rule != NULL && strcasecmp((char *)node->get_code(PROD_NODE_RULENAME_POS), rule) != 0)
+            continue;
+
+         va_copy(copy, list);
+         (*func)(node, copy);
+         va_end(copy);
+      }
+   }
+   va_end(list);
+}
+
 /**
  * @brief Compare function between RuleSets used for the BTree of the Package
  * 
@@ -8,14 +8,21 @@
  *
  */
 #include <limits.h>
+#include <math.h>
 #include <string.h>
 
 #include "engine.h"
 
 #include "btree.hpp"
+#include "btreet.hpp"
 #include "single.hpp"
 #include "set.hpp"
 #include "nodes.hpp"
+#include "context.hpp"
+
+Slab Set::_slab("Set", sizeof(Set));
+Slab SetAggr::_slab("SetAggr", sizeof(SetAggr));
+Slab SetValue::_slab("SetValue", sizeof(SetValue));
 
 #ifndef FLT_MAX
 #define FLT_MAX 3.40282347e+38
@@ -35,7 +42,7 @@
  * @param other_set The other Set
  * @return int <0, 0, >0
  */
-int Set::compare(const MetaObj *other_set, va_list) const
+int Set::compare(const MetaObj *other_set) const
 {
   return ((char *)other_set->set() - (char *)this);
 }
@@ -166,6 +173,508 @@ void Set::fill_array(int &n, ObjectType *array[])
     counter->item->fill_array(n, array);
 }
 
+/**
+ * @brief Value of an attribute of the object of an item of the set
+ *
+ */
+PRIVATE inline const Value &value_of(const void *item, int n_attr)
+{
+  return ((const MetaObj *)item)->single()->obj()->attr[n_attr];
+}
+
+/**
+ * @brief Value of an attribute of the object itself of an item. The object of the item may be the copy before
+ *        a modification already propagated (see Single::set_state)
+ *
+ */
+PRIVATE inline const Value &final_value_of(const void *item, int n_attr)
+{
+  Single *single = ((const MetaObj *)item)->single();
+
+  return (single->has_been_deleted() ? single->obj() : single->key_obj())->attr[n_attr];
+}
+
+/**
+ * @brief Object in modification in an engine, NULL if none
+ *
+ */
+PRIVATE inline ObjectType *modified_obj(const SetLog *log)
+{
+  return (log->_stamp & 1) ? log->_objs[((log->_stamp + 1) >> 1) % SET_LOG_SIZE] : NULL;
+}
+
+/**
+ * @brief Order of the items by their address
+ *
+ */
+struct PointerCompare
+{
+  inline int operator()(const void *target, const void *internal) const
+  {
+    return (target > internal) - (target < internal);
+  };
+};
+
+/**
+ * @brief Order of the SetValues of an aggregate by item
+ *
+ */
+struct ItemCompare
+{
+  inline int operator()(const void *target, const void *internal) const
+  {
+    const MetaObj *item1 = ((const SetValue *)target)->_item;
+    const MetaObj *item2 = ((const SetValue *)internal)->_item;
+
+    return (item1 > item2) - (item1 < item2);
+  };
+};
+
+/**
+ * @brief Compare two values of the kind of an order aggregate
+ *
+ */
+PRIVATE inline int compare_values(int kind, const Value &value1, const Value &value2)
+{
+  if (kind == SET_AGGR_ORDER_N)
+    return (value1.num > value2.num) - (value1.num < value2.num);
+  else if (kind == SET_AGGR_ORDER_F)
+    return (value1.flo > value2.flo) - (value1.flo < value2.flo);
+  else
+    return strcmp(value1.str.str_p, value2.str.str_p);
+}
+
+/**
+ * @brief Order of the SetValues of the order trees of the aggregates: by the value counted and then by item
+ *
+ */
+struct OrderCompare
+{
+  int kind;
+
+  inline OrderCompare(int aggr_kind) { kind = aggr_kind; };
+  inline int operator()(const void *target, const void *internal) const
+  {
+    const SetValue *value1 = (const SetValue *)target;
+    const SetValue *value2 = (const SetValue *)internal;
+    int res = compare_values(kind, value1->_value, value2->_value);
+
+    if (res == 0)
+      res = (value1->_item > value2->_item) - (value1->_item < value2->_item);
+    return res;
+  };
+};
+
+/**
+ * @brief Order of a value among the SetValues of an order tree. It goes before (tie < 0) or after (tie > 0)
+ *        the items with the same value, so it is never found and its rank counts the lower ones or also the equal ones
+ *
+ */
+struct BoundCompare
+{
+  int kind;
+  int tie;
+
+  inline BoundCompare(int aggr_kind, int bound_tie) { kind = aggr_kind; tie = bound_tie; };
+  inline int operator()(const void *target, const void *internal) const
+  {
+    int res = compare_values(kind, ((const SetValue *)target)->_value, ((const SetValue *)internal)->_value);
+
+    return (res != 0) ? res : tie;
+  };
+};
+
+/**
+ * @brief Number of values of an order aggregate lower than a value
+ *
+ */
+PRIVATE inline int lower_values(SetAggr *aggr, const Value &value)
+{
+  SetValue bound(NULL, value);
+
+  return BTreeT<SetValue, BoundCompare>(&aggr->_order, BoundCompare(aggr->_kind, -1)).Rank(&bound);
+}
+
+/**
+ * @brief Number of values of an order aggregate equal to a value
+ *
+ */
+PRIVATE inline int equal_values(SetAggr *aggr, const Value &value)
+{
+  SetValue bound(NULL, value);
+
+  return BTreeT<SetValue, BoundCompare>(&aggr->_order, BoundCompare(aggr->_kind, 1)).Rank(&bound) -
+         lower_values(aggr, value);
+}
+
+/**
+ * @brief Insert a SetValue in the order tree of an aggregate, counting its value if it is new for the distinct ones
+ *
+ */
+PRIVATE void order_insert(SetAggr *aggr, SetValue *counted)
+{
+  BTreeT<SetValue, OrderCompare>(&aggr->_order, OrderCompare(aggr->_kind)).Insert(counted);
+
+  if (aggr->_distinct >= 0 && equal_values(aggr, counted->_value) == 1)
+    aggr->_distinct++;
+}
+
+/**
+ * @brief Delete a SetValue from the order tree of an aggregate, uncounting its value if it was the last one
+ *
+ */
+PRIVATE void order_delete(SetAggr *aggr, SetValue *counted)
+{
+  BTreeT<SetValue, OrderCompare>(&aggr->_order, OrderCompare(aggr->_kind)).Delete(counted);
+
+  if (aggr->_distinct >= 0 && equal_values(aggr, counted->_value) == 0)
+    aggr->_distinct--;
+}
+
+/**
+ * @brief Inverse of an odd number modulo 2^64. Each Newton iteration doubles the bits that are right (3 at the start)
+ *
+ */
+PRIVATE inline unsigned long odd_inverse(unsigned long odd)
+{
+  unsigned long inv = odd;
+
+  for (int n = 0; n < 5; n++)
+    inv *= 2 - odd * inv;
+  return inv;
+}
+
+/**
+ * @brief The integer product of the values counted by an aggregate, modulo 2^64 as the longs are multiplied
+ *
+ */
+PRIVATE inline long prod_of(const SetAggr *aggr)
+{
+  if (aggr->_zeros > 0 || aggr->_twos >= 64)
+    return 0;
+  return (long)((unsigned long)aggr->_num << aggr->_twos);
+}
+
+/**
+ * @brief Count an item in an aggregate with a value of its attribute
+ *
+ * @param aggr The aggregate
+ * @param item The item of the set
+ * @param value The value of the attribute
+ */
+void Set::count_item(SetAggr *aggr, MetaObj *item, const Value &value)
+{
+  SetValue *counted = new SetValue(item, value);
+  unsigned long num;
+  int twos;
+
+  BTreeT<SetValue, ItemCompare>(&aggr->_values).Insert(counted);
+
+  switch (aggr->_kind)
+  {
+  case SET_AGGR_SUM_N:
+    aggr->_num = (long)((unsigned long)aggr->_num + (unsigned long)value.num);
+    break;
+  case SET_AGGR_SUM_F:
+    aggr->_flo += value.flo;
+    break;
+  case SET_AGGR_PROD_N:
+    if (value.num == 0)
+      aggr->_zeros++;
+    else
+    {
+      // The factors 2 are counted apart, the odd part has an inverse to take it out
+      num = (unsigned long)value.num;
+      twos = __builtin_ctzl(num);
+      aggr->_twos += twos;
+      aggr->_num = (long)((unsigned long)aggr->_num * (num >> twos));
+    }
+    break;
+  case SET_AGGR_PROD_F:
+    if (value.flo == 0)
+      aggr->_zeros++;
+    else
+      aggr->_flo *= value.flo;
+    break;
+  case SET_AGGR_ORDER_A:
+    if (value.str.str_p == NULL)
+      break;
+    // The string of the object may be freed when it is modified
+    counted->_value.str.str_p = strdup(value.str.str_p);
+    // no break
+  default:
+    order_insert(aggr, counted);
+  }
+}
+
+/**
+ * @brief Take out an item from an aggregate with the value it was counted
+ *
+ * @param aggr The aggregate
+ * @param item The item of the set
+ */
+void Set::uncount_item(SetAggr *aggr, MetaObj *item)
+{
+  SetValue target(item);
+  SetValue *counted;
+  unsigned long num;
+  int twos;
+
+  if ((counted = BTreeT<SetValue, ItemCompare>(&aggr->_values).Delete(&target)) == NULL)
+    return;
+
+  const Value &value = counted->_value;
+
+  switch (aggr->_kind)
+  {
+  case SET_AGGR_SUM_N:
+    aggr->_num = (long)((unsigned long)aggr->_num - (unsigned long)value.num);
+    break;
+  case SET_AGGR_SUM_F:
+    aggr->_stale = TRUE;
+    break;
+  case SET_AGGR_PROD_N:
+    if (value.num == 0)
+      aggr->_zeros--;
+    else
+    {
+      num = (unsigned long)value.num;
+      twos = __builtin_ctzl(num);
+      aggr->_twos -= twos;
+      aggr->_num = (long)((unsigned long)aggr->_num * odd_inverse(num >> twos));
+    }
+    break;
+  case SET_AGGR_PROD_F:
+    if (value.flo == 0)
+      aggr->_zeros--;
+    else
+      aggr->_stale = TRUE;
+    break;
+  case SET_AGGR_ORDER_A:
+    if (value.str.str_p == NULL)
+      break;
+    order_delete(aggr, counted);
+    free(value.str.str_p);
+    break;
+  default:
+    order_delete(aggr, counted);
+  }
+  delete counted;
+}
+
+/**
+ * @brief Count an item in all the aggregates with the values of its object
+ *
+ * @param item The item of the set
+ */
+void Set::count_item(MetaObj *item)
+{
+  for (SetAggr *aggr = _aggr; aggr != NULL; aggr = aggr->_next)
+    count_item(aggr, item, final_value_of(item, aggr->_attr));
+}
+
+/**
+ * @brief Take out an item from all the aggregates
+ *
+ * @param item The item of the set
+ */
+void Set::uncount_item(MetaObj *item)
+{
+  for (SetAggr *aggr = _aggr; aggr != NULL; aggr = aggr->_next)
+    uncount_item(aggr, item);
+}
+
+/**
+ * @brief Bring the aggregates up to the modifications logged by the engine. The items of the objects modified since
+ *        the last sync are counted again, the modifications that do not pass the tests of the nodes of the set
+ *        do not reach it. The item of the object in modification is held out of the aggregates: its object may
+ *        have either the old or the new values (see Single::set_state), so the aggregates read take the current ones
+ *
+ */
+void Set::sync()
+{
+  SetLog *log = Engine::current()->_set_log;
+  ObjectType *modified;
+  MetaObj *item;
+  Single target;
+  long seq, n;
+
+  if (_stamp == log->_stamp)
+    return;
+
+  n = (_stamp + 1) >> 1;
+  seq = (log->_stamp + 1) >> 1;
+  modified = modified_obj(log);
+  _stamp = log->_stamp;
+
+  // The log has been overwritten, the aggregates will be built again if they are read
+  if (seq - n > SET_LOG_SIZE)
+  {
+    free_aggr();
+    return;
+  }
+
+  if (_pending != NULL && _pending->single()->key_obj() != modified)
+  {
+    count_item(_pending);
+    _pending = NULL;
+  }
+
+  while (n < seq)
+  {
+    n++;
+    target.set_key(log->_objs[n % SET_LOG_SIZE]);
+    if ((item = find_elem(&target)) == NULL || item == _pending)
+      continue;
+
+    uncount_item(item);
+    if (n == seq && modified != NULL)
+      _pending = item;
+    else
+      count_item(item);
+  }
+}
+
+/**
+ * @brief Get an aggregate of the set, kept since then by add_elem and delete_elem.
+ *        The set is walked while it has not changed after being read, as the sets built for each tuple of the
+ *        left side of their rules that are read just once. Then the aggregates are built
+ *
+ * @param kind SET_AGGR_SUM_N, SET_AGGR_SUM_F, SET_AGGR_PROD_N, SET_AGGR_PROD_F, SET_AGGR_ORDER_N, SET_AGGR_ORDER_F or SET_AGGR_ORDER_A
+ * @param n_attr Number of attribute
+ * @param keep TRUE to build it at the first read, when the walk would have to order the items anyway
+ * @return SetAggr* The aggregate, NULL if the set must be walked
+ */
+SetAggr *Set::aggr(int kind, int n_attr, int keep)
+{
+  SetAggr *aggr;
+  MatchCount *counter;
+  SetLog *log;
+  Single target;
+
+  if (_aggr != NULL)
+  {
+    sync();
+    for (aggr = _aggr; aggr != NULL; aggr = aggr->_next)
+      if (aggr->_kind == kind && aggr->_attr == n_attr)
+        return aggr;
+  }
+  else if (_reads != SET_CHANGED_AFTER_READ && !keep)
+  {
+    _reads = SET_READ;
+    return NULL;
+  }
+
+  if (_aggr == NULL)
+  {
+    log = Engine::current()->_set_log;
+    _stamp = log->_stamp;
+    _pending = NULL;
+    if (modified_obj(log) != NULL)
+    {
+      target.set_key(modified_obj(log));
+      _pending = find_elem(&target);
+    }
+  }
+
+  aggr = new SetAggr(kind, n_attr);
+
+  BTState state = _mem.getIterator();
+  while (counter = (MatchCount *)BTree::Walk(state))
+    if (counter->item != _pending)
+      count_item(aggr, counter->item, final_value_of(counter->item, n_attr));
+
+  aggr->_next = _aggr;
+  _aggr = aggr;
+  return aggr;
+}
+
+/**
+ * @brief Count again the values of a float aggregate after some of them have been taken out. Subtracting or
+ *        dividing them would lose the precision for good (1e20 + 1 - 1e20 is 0), and an infinite, a NaN or
+ *        a product underflowed could not be taken out
+ *
+ * @param aggr The aggregate
+ */
+void Set::recount(SetAggr *aggr)
+{
+  SetValue *counted;
+
+  aggr->_flo = (aggr->_kind == SET_AGGR_PROD_F) ? 1 : 0;
+  aggr->_zeros = 0;
+  aggr->_stale = FALSE;
+
+  BTState state = aggr->_values.getIterator();
+  while (counted = (SetValue *)BTree::Walk(state))
+  {
+    if (aggr->_kind == SET_AGGR_SUM_F)
+      aggr->_flo += counted->_value.flo;
+    else if (counted->_value.flo == 0)
+      aggr->_zeros++;
+    else
+      aggr->_flo *= counted->_value.flo;
+  }
+}
+
+PRIVATE void no_func(void *, va_list)
+{
+}
+
+PRIVATE void free_value(void *counted, va_list list)
+{
+  va_list copy;
+
+  va_copy(copy, list);
+  int kind = va_arg(copy, int);
+  va_end(copy);
+
+  if (kind == SET_AGGR_ORDER_A)
+    free(((SetValue *)counted)->_value.str.str_p);
+  delete (SetValue *)counted;
+}
+
+/**
+ * @brief Free the aggregates kept
+ *
+ */
+void Set::free_aggr()
+{
+  SetAggr *aggr;
+
+  while ((aggr = _aggr) != NULL)
+  {
+    _aggr = aggr->_next;
+    aggr->_order.Free(no_func);
+    aggr->_values.Free(free_value, aggr->_kind);
+    delete aggr;
+  }
+  _pending = NULL;
+}
+
+/**
+ * @brief A modification begins to be propagated in the engine of the calling thread, it is logged for the aggregates
+ *
+ * @param obj The object modified
+ */
+// static
+void Set::begin_modify(ObjectType *obj)
+{
+  SetLog *log = Engine::current()->_set_log;
+
+  log->_stamp++;
+  log->_objs[((log->_stamp + 1) >> 1) % SET_LOG_SIZE] = obj;
+}
+
+/**
+ * @brief The propagation of a modification has ended, the object has its final values
+ *
+ */
+// static
+void Set::end_modify()
+{
+  Engine::current()->_set_log->_stamp++;
+}
+
 /**
  * @brief Sum all the integer values of some attribute for all the items stored in this Set
  *
@@ -174,32 +683,51 @@ void Set::fill_array(int &n, ObjectType *array[])
  */
 long Set::sum_set_n(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_SUM_N, n_attr);
   long res = 0;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
-    res += counter->item->single()->obj()->attr[n_attr].num;
+  if (aggr == NULL)
+  {
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      res += value_of(counter->item, n_attr).num;
+    return res;
+  }
 
+  res = aggr->_num;
+  if (_pending != NULL)
+    res = (long)((unsigned long)res + (unsigned long)value_of(_pending, n_attr).num);
   return res;
 }
 
 /**
- * @brief Sum all the float values of some attribute for all the items stored in this Set
+ * @brief Sum all the float values of some attribute for all the items stored in this Set.
+ *        The sum kept is a double
  *
  * @param n_attr Number of attribute
  * @return float the resulting sum
  */
 float Set::sum_set_f(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_SUM_F, n_attr);
   float res = 0;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
-    res += counter->item->single()->obj()->attr[n_attr].flo;
+  if (aggr == NULL)
+  {
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      res += value_of(counter->item, n_attr).flo;
+    return res;
+  }
 
-  return res;
+  if (aggr->_stale)
+    recount(aggr);
+
+  if (_pending != NULL)
+    return (float)(aggr->_flo + value_of(_pending, n_attr).flo);
+  return (float)aggr->_flo;
 }
 
 /**
@@ -210,32 +738,53 @@ float Set::sum_set_f(int n_attr)
  */
 long Set::prod_set_n(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_PROD_N, n_attr);
   long res = 1;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
-    res *= counter->item->single()->obj()->attr[n_attr].num;
+  if (aggr == NULL)
+  {
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      res *= value_of(counter->item, n_attr).num;
+    return res;
+  }
 
+  res = prod_of(aggr);
+  if (_pending != NULL)
+    res = (long)((unsigned long)res * (unsigned long)value_of(_pending, n_attr).num);
   return res;
 }
 
 /**
- * @brief Multiply all the float values of some attribute for all the items stored in this Set
+ * @brief Multiply all the float values of some attribute for all the items stored in this Set.
+ *        The product kept is a double
  *
  * @param n_attr Number of attribute
  * @return float the resulting product
  */
 float Set::prod_set_f(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_PROD_F, n_attr);
   float res = 1;
+  double prod;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
-    res *= counter->item->single()->obj()->attr[n_attr].flo;
+  if (aggr == NULL)
+  {
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      res *= value_of(counter->item, n_attr).flo;
+    return res;
+  }
 
-  return res;
+  if (aggr->_stale)
+    recount(aggr);
+
+  prod = (aggr->_zeros > 0) ? 0 : aggr->_flo;
+  if (_pending != NULL)
+    prod *= value_of(_pending, n_attr).flo;
+  return (float)prod;
 }
 
 /**
@@ -246,16 +795,24 @@ float Set::prod_set_f(int n_attr)
  */
 long Set::min_set_n(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_ORDER_N, n_attr);
   long res = LONG_MAX;
+  const void *first;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
+  if (aggr == NULL)
   {
-    if (res > counter->item->single()->obj()->attr[n_attr].num)
-      res = counter->item->single()->obj()->attr[n_attr].num;
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      if (res > value_of(counter->item, n_attr).num)
+        res = value_of(counter->item, n_attr).num;
+    return res;
   }
 
+  if ((first = aggr->_order.getFirst()) != NULL)
+    res = ((const SetValue *)first)->_value.num;
+  if (_pending != NULL && res > value_of(_pending, n_attr).num)
+    res = value_of(_pending, n_attr).num;
   return res;
 }
 
@@ -267,16 +824,24 @@ long Set::min_set_n(int n_attr)
  */
 float Set::min_set_f(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_ORDER_F, n_attr);
   float res = FLT_MAX;
+  const void *first;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
+  if (aggr == NULL)
   {
-    if (res > counter->item->single()->obj()->attr[n_attr].flo)
-      res = counter->item->single()->obj()->attr[n_attr].flo;
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      if (res > value_of(counter->item, n_attr).flo)
+        res = value_of(counter->item, n_attr).flo;
+    return res;
   }
 
+  if ((first = aggr->_order.getFirst()) != NULL && res > ((const SetValue *)first)->_value.flo)
+    res = ((const SetValue *)first)->_value.flo;
+  if (_pending != NULL && res > value_of(_pending, n_attr).flo)
+    res = value_of(_pending, n_attr).flo;
   return res;
 }
 
@@ -289,16 +854,32 @@ float Set::min_set_f(int n_attr)
 char *
 Set::min_set_a(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_ORDER_A, n_attr);
   char *res = NULL;
+  char *str;
+  const void *first;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
+  if (aggr == NULL)
   {
-    char *str;
-    str = counter->item->single()->obj()->attr[n_attr].str.str_p;
-    if (str != NULL && (res == NULL || strcmp(str, res) < 0))
-      res = str;
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+    {
+      str = value_of(counter->item, n_attr).str.str_p;
+      if (str != NULL && (res == NULL || strcmp(str, res) < 0))
+        res = str;
+    }
+  }
+  else
+  {
+    if ((first = aggr->_order.getFirst()) != NULL)
+      res = ((const SetValue *)first)->_value.str.str_p;
+    if (_pending != NULL)
+    {
+      str = value_of(_pending, n_attr).str.str_p;
+      if (str != NULL && (res == NULL || strcmp(str, res) < 0))
+        res = str;
+    }
   }
 
   if (res == NULL)
@@ -315,16 +896,24 @@ Set::min_set_a(int n_attr)
  */
 long Set::max_set_n(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_ORDER_N, n_attr);
   long res = LONG_MIN;
+  const void *last;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
+  if (aggr == NULL)
   {
-    if (res < counter->item->single()->obj()->attr[n_attr].num)
-      res = counter->item->single()->obj()->attr[n_attr].num;
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      if (res < value_of(counter->item, n_attr).num)
+        res = value_of(counter->item, n_attr).num;
+    return res;
   }
 
+  if ((last = aggr->_order.getLast()) != NULL)
+    res = ((const SetValue *)last)->_value.num;
+  if (_pending != NULL && res < value_of(_pending, n_attr).num)
+    res = value_of(_pending, n_attr).num;
   return res;
 }
 
@@ -336,16 +925,24 @@ long Set::max_set_n(int n_attr)
  */
 float Set::max_set_f(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_ORDER_F, n_attr);
   float res = FLT_MIN;
+  const void *last;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
+  if (aggr == NULL)
   {
-    if (res < counter->item->single()->obj()->attr[n_attr].flo)
-      res = counter->item->single()->obj()->attr[n_attr].flo;
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+      if (res < value_of(counter->item, n_attr).flo)
+        res = value_of(counter->item, n_attr).flo;
+    return res;
   }
 
+  if ((last = aggr->_order.getLast()) != NULL && res < ((const SetValue *)last)->_value.flo)
+    res = ((const SetValue *)last)->_value.flo;
+  if (_pending != NULL && res < value_of(_pending, n_attr).flo)
+    res = value_of(_pending, n_attr).flo;
   return res;
 }
 
@@ -358,16 +955,32 @@ float Set::max_set_f(int n_attr)
 char *
 Set::max_set_a(int n_attr)
 {
+  SetAggr *aggr = this->aggr(SET_AGGR_ORDER_A, n_attr);
   char *res = NULL;
+  char *str;
+  const void *last;
   MatchCount *counter;
-  BTState state = _mem.getIterator();
 
-  while (counter = (MatchCount *)BTree::Walk(state))
+  if (aggr == NULL)
   {
-    char *str;
-    str = counter->item->single()->obj()->attr[n_attr].str.str_p;
-    if (str != NULL && (res == NULL || strcmp(str, res) > 0))
-      res = str;
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+    {
+      str = value_of(counter->item, n_attr).str.str_p;
+      if (str != NULL && (res == NULL || strcmp(str, res) > 0))
+        res = str;
+    }
+  }
+  else
+  {
+    if ((last = aggr->_order.getLast()) != NULL)
+      res = ((const SetValue *)last)->_value.str.str_p;
+    if (_pending != NULL)
+    {
+      str = value_of(_pending, n_attr).str.str_p;
+      if (str != NULL && (res == NULL || strcmp(str, res) > 0))
+        res = str;
+    }
   }
 
   if (res == NULL)
@@ -422,6 +1035,257 @@ Set::concat(int n_attr, char *sep)
   return buffer;
 }
 
+/**
+ * @brief Current value of the item in modification, held out of an order aggregate (see sync)
+ *
+ * @param aggr The aggregate
+ * @param value Where to store the value
+ * @return int TRUE if there is an item in modification and its value is ordered (not a NULL string)
+ */
+int Set::pending_value(const SetAggr *aggr, const Value *&value) const
+{
+  value = NULL;
+  if (_pending == NULL)
+    return FALSE;
+
+  value = &value_of(_pending, aggr->_attr);
+  if (aggr->_kind == SET_AGGR_ORDER_A && value->str.str_p == NULL)
+    value = NULL;
+  return (value != NULL);
+}
+
+/**
+ * @brief Value of some attribute at a percentile of the items stored in this Set, by the nearest rank: the lowest
+ *        value with at least that percent of the values lower or equal. The order tree of the values of the
+ *        attribute is kept since the first time, so it is found by the counts of its nodes
+ *
+ * @param kind SET_AGGR_ORDER_N, SET_AGGR_ORDER_F or SET_AGGR_ORDER_A
+ * @param n_attr Number of attribute
+ * @param percent The percentile, from 0 (the minimum) to 100 (the maximum)
+ * @return const Value* The value, NULL if the set has no value of the attribute
+ */
+const Value *Set::percentile(int kind, int n_attr, long percent)
+{
+  SetAggr *aggr = this->aggr(kind, n_attr, TRUE);
+  const Value *pending;
+  int n, pos, lower;
+
+  n = aggr->_order.numItems();
+  if (pending_value(aggr, pending))
+    n++;
+  if (n == 0)
+    return NULL;
+
+  if (percent <= 0)
+    pos = 0;
+  else if (percent >= 100)
+    pos = n - 1;
+  else
+    pos = (int)((percent * n + 99) / 100) - 1;
+
+  // The item in modification takes its place among the values of the tree
+  if (pending != NULL)
+  {
+    lower = lower_values(aggr, *pending);
+    if (pos == lower)
+      return pending;
+    if (pos > lower)
+      pos--;
+  }
+  return &((const SetValue *)aggr->_order.getNth(pos))->_value;
+}
+
+/**
+ * @brief Number of the items stored in this Set with a value of some attribute lower than a value
+ *
+ * @param kind SET_AGGR_ORDER_N, SET_AGGR_ORDER_F or SET_AGGR_ORDER_A
+ * @param n_attr Number of attribute
+ * @param value The value
+ * @return long The number of items
+ */
+long Set::rank(int kind, int n_attr, const Value &value)
+{
+  SetAggr *aggr = this->aggr(kind, n_attr);
+  const Value *pending;
+  MatchCount *counter;
+  long res = 0;
+
+  if (kind == SET_AGGR_ORDER_A && value.str.str_p == NULL)
+    return 0;
+
+  if (aggr == NULL)
+  {
+    BTState state = _mem.getIterator();
+    while (counter = (MatchCount *)BTree::Walk(state))
+    {
+      const Value &item_value = value_of(counter->item, n_attr);
+      if ((kind != SET_AGGR_ORDER_A || item_value.str.str_p != NULL) && compare_values(kind, item_value, value) < 0)
+        res++;
+    }
+    return res;
+  }
+
+  res = lower_values(aggr, value);
+  if (pending_value(aggr, pending) && compare_values(kind, *pending, value) < 0)
+    res++;
+  return res;
+}
+
+/**
+ * @brief Number of distinct values of some attribute for all the items stored in this Set.
+ *        They are counted in the order tree the first time, and then kept by its insertions and deletions
+ *
+ * @param kind SET_AGGR_ORDER_N, SET_AGGR_ORDER_F or SET_AGGR_ORDER_A
+ * @param n_attr Number of attribute
+ * @return long The number of values, the NULL strings are not counted
+ */
+long Set::distinct(int kind, int n_attr)
+{
+  SetAggr *aggr = this->aggr(kind, n_attr, TRUE);
+  const Value *pending;
+  const SetValue *counted, *last;
+  long res;
+
+  if (aggr->_distinct < 0)
+  {
+    aggr->_distinct = 0;
+    last = NULL;
+    BTState state = aggr->_order.getIterator();
+    while (counted = (const SetValue *)BTree::Walk(state))
+    {
+      if (last == NULL || compare_values(kind, last->_value, counted->_value) != 0)
+        aggr->_distinct++;
+      last = counted;
+    }
+  }
+
+  res = aggr->_distinct;
+  if (pending_value(aggr, pending) && equal_values(aggr, *pending) == 0)
+    res++;
+  return res;
+}
+
+/**
+ * @brief Integer value of some attribute at a percentile of the items stored in this Set (see percentile)
+ *
+ * @param n_attr Number of attribute
+ * @param percent The percentile, from 0 to 100 (50 for the median)
+ * @return long The value found, 0 if the set is empty
+ */
+long Set::percentile_set_n(int n_attr, long percent)
+{
+  const Value *value = percentile(SET_AGGR_ORDER_N, n_attr, percent);
+
+  return (value != NULL) ? value->num : 0;
+}
+
+/**
+ * @brief Float value of some attribute at a percentile of the items stored in this Set (see percentile)
+ *
+ * @param n_attr Number of attribute
+ * @param percent The percentile, from 0 to 100 (50 for the median)
+ * @return float The value found, 0 if the set is empty
+ */
+float Set::percentile_set_f(int n_attr, long percent)
+{
+  const Value *value = percentile(SET_AGGR_ORDER_F, n_attr, percent);
+
+  return (value != NULL) ? value->flo : 0;
+}
+
+/**
+ * @brief String value of some attribute at a percentile of the items stored in this Set (see percentile)
+ *
+ * @param n_attr Number of attribute
+ * @param percent The percentile, from 0 to 100 (50 for the median)
+ * @return char * A copy of the value found, NULL if no item has a string
+ */
+char *
+Set::percentile_set_a(int n_attr, long percent)
+{
+  const Value *value = percentile(SET_AGGR_ORDER_A, n_attr, percent);
+
+  return (value != NULL) ? strdup(value->str.str_p) : NULL;
+}
+
+/**
+ * @brief Number of items stored in this Set with an integer value of some attribute lower than a value
+ *
+ * @param n_attr Number of attribute
+ * @param value The value
+ * @return long The number of items
+ */
+long Set::rank_set_n(int n_attr, long value)
+{
+  Value bound;
+
+  bound.num = value;
+  return rank(SET_AGGR_ORDER_N, n_attr, bound);
+}
+
+/**
+ * @brief Number of items stored in this Set with a float value of some attribute lower than a value
+ *
+ * @param n_attr Number of attribute
+ * @param value The value
+ * @return long The number of items
+ */
+long Set::rank_set_f(int n_attr, float value)
+{
+  Value bound;
+
+  bound.flo = value;
+  return rank(SET_AGGR_ORDER_F, n_attr, bound);
+}
+
+/**
+ * @brief Number of items stored in this Set with a string value of some attribute lower than a value
+ *
+ * @param n_attr Number of attribute
+ * @param value The value, no item is lower than NULL
+ * @return long The number of items
+ */
+long Set::rank_set_a(int n_attr, char *value)
+{
+  Value bound;
+
+  bound.str.str_p = value;
+  return rank(SET_AGGR_ORDER_A, n_attr, bound);
+}
+
+/**
+ * @brief Number of distinct integer values of some attribute for all the items stored in this Set
+ *
+ * @param n_attr Number of attribute
+ * @return long The number of values
+ */
+long Set::distinct_set_n(int n_attr)
+{
+  return distinct(SET_AGGR_ORDER_N, n_attr);
+}
+
+/**
+ * @brief Number of distinct float values of some attribute for all the items stored in this Set
+ *
+ * @param n_attr Number of attribute
+ * @return long The number of values
+ */
+long Set::distinct_set_f(int n_attr)
+{
+  return distinct(SET_AGGR_ORDER_F, n_attr);
+}
+
+/**
+ * @brief Number of distinct string values of some attribute for all the items stored in this Set
+ *
+ * @param n_attr Number of attribute
+ * @return long The number of values, the NULL strings are not counted
+ */
+long Set::distinct_set_a(int n_attr)
+{
+  return distinct(SET_AGGR_ORDER_A, n_attr);
+}
+
 /**
  * @brief Get the first item of set
  *        Indeed it is just a sample, not the first in order
@@ -451,8 +1315,28 @@ Set::first_item_of_set() const
 void Set::set_state(ObjState ost, Status *st, int pos)
 {
   int desired_tag;
+  MetaObj *item;
+
+  // All the items expired are in the old state and out in the new one
+  if (_last_op == SET_EXPIRY_OP)
+  {
+    desired_tag = (ost == OLD_ST) ? INSERT_TAG : RETRACT_TAG;
 
-  if (_last_op != 0)
+    if (_state != desired_tag)
+    {
+      BTState state = _expired.getIterator();
+      while (item = (MetaObj *)BTree::Walk(state))
+      {
+        if (desired_tag == INSERT_TAG)
+          add_elem(item);
+        else
+          delete_elem(item);
+      }
+      _state = desired_tag;
+    }
+  }
+
+  else if (_last_op != 0)
   {
     _last_obj->set_state(ost, st, pos); // This is the unique done on MODIFY
 
@@ -482,11 +1366,28 @@ MetaObj *
 Set::add_elem(MetaObj *elem)
 {
   MatchCount **res;
+  ObjectType *modified;
 
   if (elem == Single::null_single())
     return elem;
 
-  res = (MatchCount **)_mem.Insert(elem, Node::cmp_count_with_object);
+  if (_reads == SET_READ)
+    _reads = SET_CHANGED_AFTER_READ;
+
+  // A new item is counted before its insertion, the callers look at BTree::WasFound after it.
+  // The item of the object in modification is held (see sync)
+  if (_aggr != NULL)
+    sync();
+  if (_aggr != NULL && BTreeT<MatchCount, Node::CountCompare<MetaObj::Compare> >(&_mem).Find(elem) == NULL)
+  {
+    modified = modified_obj(Engine::current()->_set_log);
+    if (modified != NULL && elem->single()->key_obj() == modified)
+      _pending = elem;
+    else
+      count_item(elem);
+  }
+
+  res = BTreeT<MatchCount, Node::CountCompare<MetaObj::Compare> >(&_mem).Insert(elem);
 
   if (((MetaObj *)*res) == elem && !BTree::WasFound())
     *res = new MatchCount(elem);
@@ -514,7 +1415,7 @@ Set::find_elem(MetaObj *elem)
   if (elem == Single::null_single())
     return elem;
 
-  res = (MatchCount *)_mem.Find(elem, Node::cmp_count_with_object);
+  res = BTreeT<MatchCount, Node::CountCompare<MetaObj::Compare> >(&_mem).Find(elem);
   if (!res)
     return NULL;
   else
@@ -535,14 +1436,23 @@ Set::delete_elem(MetaObj *elem)
   if (elem == Single::null_single())
     return elem;
 
-  res = (MatchCount *)_mem.Find(elem, Node::cmp_count_with_object);
+  if (_reads == SET_READ)
+    _reads = SET_CHANGED_AFTER_READ;
+  if (_aggr != NULL)
+    sync();
+
+  res = BTreeT<MatchCount, Node::CountCompare<MetaObj::Compare> >(&_mem).Find(elem);
   if (res)
   {
     _last_obj = res->item;
 
     if (res->count == 0)
     {
-      res = (MatchCount *)_mem.Delete(elem, Node::cmp_count_with_object);
+      if (_last_obj == _pending)
+        _pending = NULL;
+      else if (_aggr != NULL)
+        uncount_item(_last_obj);
+      res = BTreeT<MatchCount, Node::CountCompare<MetaObj::Compare> >(&_mem).Delete(elem);
       delete (res);
     }
     else
@@ -556,6 +1466,48 @@ Set::delete_elem(MetaObj *elem)
     return NULL;
 }
 
+/**
+ * @brief Keep an item retracted by the expiry of a time window. It stays in the Set until the Set
+ *        is propagated once for all the items expired (see Node::set_expiry)
+ *
+ * @param elem The item of the set
+ * @return int TRUE if it is the first item expired in the Set
+ */
+int Set::expire_elem(MetaObj *elem)
+{
+  int first = (_expired.numItems() == 0);
+
+  if (*BTreeT<MetaObj, PointerCompare>(&_expired).Insert(elem) == elem && !BTree::WasFound())
+    elem->link();
+
+  return first;
+}
+
+/**
+ * @brief End the operation over the items expired, they are taken out of the Set
+ *
+ */
+void Set::end_expiry()
+{
+  set_state(NEW_ST, NULL, 0);
+  setOp(0, NULL);
+  free_expired();
+}
+
+PRIVATE void unlink_item(void *item, va_list)
+{
+  ((MetaObj *)item)->unlink();
+}
+
+/**
+ * @brief Free the items expired kept
+ *
+ */
+void Set::free_expired()
+{
+  _expired.Free(unlink_item);
+}
+
 /**
  * @brief Print in a FILE the object 
  * 
@@ -0,0 +1,448 @@
+/**
+ * @file shards.cpp
+ * @author Francisco Alcaraz
+ * @brief Sharded mode. The package is compiled once and instantiated in K engines, each one running
+ *        in its own thread. The objects passed to engine_loop are routed to a shard by hashing the value of
+ *        the partition attribute of their class (PARTITION BY), so all the objects with the same value meet in the
+ *        same engine. The objects of classes without partition attribute go to the first shard.
+ *        engine_refresh is broadcast to all the shards and the callbacks are called from the shard threads
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "engine.h"
+#include "classes.hpp"
+#include "shards.hpp"
+#include "error.hpp"
+
+Shard *Shard::_shards[MAXSHARDS];
+int Shard::_n_shards = 0;
+
+/**
+ * @brief Construct a new Shard:: Shard object, with its own engine and thread
+ *
+ */
+Shard::Shard()
+{
+  int err;
+
+  _engine = rce_engine_new();
+  _first = NULL;
+  _tail = &_first;
+  _busy = FALSE;
+  _stop = FALSE;
+
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_work_cond, NULL);
+  pthread_cond_init(&_idle_cond, NULL);
+
+  if ((err = pthread_create(&_thread, NULL, Shard::run, this)) != 0)
+    engine_fatal_err("pthread_create: %s\n", strerror(err));
+}
+
+/**
+ * @brief Destroy the Shard:: Shard object. The thread must be already stopped.
+ *        The objects that remain in the memories of its engine are retracted silently
+ *
+ */
+Shard::~Shard()
+{
+  rce_engine_free(_engine);
+  pthread_cond_destroy(&_idle_cond);
+  pthread_cond_destroy(&_work_cond);
+  pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * @brief Main loop of the thread of a shard. Takes the pending events and propagate them in the engine of the shard
+ *
+ * @param shard The shard
+ * @return void* NULL
+ */
+void *Shard::run(void *shard)
+{
+  Shard *me = (Shard *)shard;
+  ShardEvent *event, *next;
+
+  Engine::select(me->_engine);
+
+  pthread_mutex_lock(&me->_lock);
+  for (;;)
+  {
+    while (me->_first == NULL && !me->_stop)
+      pthread_cond_wait(&me->_work_cond, &me->_lock);
+
+    if (me->_first == NULL)
+      break;
+
+    event = me->_first;
+    me->_first = NULL;
+    me->_tail = &me->_first;
+    me->_busy = TRUE;
+    pthread_mutex_unlock(&me->_lock);
+
+    for (; event != NULL; event = next)
+    {
+      next = event->_next;
+      me->propagate(event);
+      free(event);
+    }
+
+    pthread_mutex_lock(&me->_lock);
+    me->_busy = FALSE;
+    if (me->_first == NULL)
+      pthread_cond_broadcast(&me->_idle_cond);
+  }
+  pthread_mutex_unlock(&me->_lock);
+
+  return NULL;
+}
+
+/**
+ * @brief Propagate an event in the engine of the shard. Called from the thread of the shard
+ *
+ * @param event The event
+ */
+void Shard::propagate(ShardEvent *event)
+{
+  if (event->_tag == SHARD_REFRESH)
+    engine_refresh(event->_time);
+
+  else
+  {
+    if (event->_tag == MODIFY_TAG)
+      Engine::_old_obj_modify = event->_old_obj;
+
+    // The object moves to other shard: it is retracted with the values it had in this one
+    if (event->_tag == RETRACT_TAG && event->_old_obj != NULL)
+    {
+      swap_values(event->_obj, event->_old_obj);
+      engine_loop(RETRACT_TAG, event->_obj);
+      swap_values(event->_obj, event->_old_obj);
+      free(event->_old_obj);
+    }
+    else
+      engine_loop(event->_tag, event->_obj);
+  }
+}
+
+/**
+ * @brief Swap the values of the attributes of an object and of its copy made by engine_modify
+ *
+ * @param obj The object
+ * @param copy The copy
+ */
+void Shard::swap_values(ObjectType *obj, ObjectType *copy)
+{
+  ObjClass *the_class = ObjClass::class_of(obj);
+  Value tmp_attr;
+  int n;
+
+  for (n = 1; n < the_class->n_attrs(); n++)
+  {
+    tmp_attr = copy->attr[n];
+    copy->attr[n] = obj->attr[n];
+    obj->attr[n] = tmp_attr;
+  }
+}
+
+/**
+ * @brief Queue an event to be propagated by the shard
+ *
+ * @param event The event
+ */
+void Shard::put(ShardEvent *event)
+{
+  event->_next = NULL;
+
+  pthread_mutex_lock(&_lock);
+  *_tail = event;
+  _tail = &event->_next;
+  pthread_cond_signal(&_work_cond);
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief Wait until all the events queued in the shard have been propagated
+ *
+ */
+void Shard::wait_idle()
+{
+  pthread_mutex_lock(&_lock);
+  while (_first != NULL || _busy)
+    pthread_cond_wait(&_idle_cond, &_lock);
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief Stop the thread of the shard once the events queued have been propagated
+ *
+ */
+void Shard::stop()
+{
+  pthread_mutex_lock(&_lock);
+  _stop = TRUE;
+  pthread_cond_signal(&_work_cond);
+  pthread_mutex_unlock(&_lock);
+
+  pthread_join(_thread, NULL);
+}
+
+/**
+ * @brief Start the sharded mode over the package loaded
+ *
+ * @param n_shards Number of shards (engines and threads)
+ * @return int The number of shards, or ERROR
+ */
+int Shard::start(int n_shards)
+{
+  int n;
+
+  if (_n_shards > 0 || n_shards <= 0 || n_shards > MAXSHARDS)
+    return ERROR;
+
+  for (n = 0; n < n_shards; n++)
+    _shards[n] = new Shard();
+
+  _n_shards = n_shards;
+  return n_shards;
+}
+
+/**
+ * @brief End the sharded mode. The events queued are propagated before the shards are freed
+ *
+ */
+void Shard::stop_all()
+{
+  int n, n_shards = _n_shards;
+
+  _n_shards = 0;
+
+  for (n = 0; n < n_shards; n++)
+    _shards[n]->stop();
+
+  for (n = 0; n < n_shards; n++)
+  {
+    delete _shards[n];
+    _shards[n] = NULL;
+  }
+}
+
+/**
+ * @brief Wait until all the shards have propagated the events queued
+ *
+ */
+void Shard::sync()
+{
+  int n;
+
+  for (n = 0; n < _n_shards; n++)
+    _shards[n]->wait_idle();
+}
+
+/**
+ * @brief Number of inferences done by all the shards, once the events queued have been propagated
+ *
+ * @return int The number of inferences
+ */
+int Shard::inf_cnt()
+{
+  int n, cnt = 0;
+
+  sync();
+  for (n = 0; n < _n_shards; n++)
+    cnt += _shards[n]->_engine->_n_inf;
+
+  return cnt;
+}
+
+/**
+ * @brief Reset the inferences counter of all the shards, once the events queued have been propagated
+ *
+ */
+void Shard::reset_inf_cnt()
+{
+  int n;
+
+  sync();
+  for (n = 0; n < _n_shards; n++)
+    _shards[n]->_engine->_n_inf = 0;
+}
+
+/**
+ * @brief Hash of an attribute value
+ *
+ * @param value The value
+ * @param type Its type
+ * @return ULong The hash
+ */
+PRIVATE
+ULong hash_value(Value *value, int type)
+{
+  ULong hash;
+  const unsigned char *p;
+
+  switch (type)
+  {
+  case TYPE_STR:
+    // FNV-1a
+    hash = 14695981039346656037UL;
+    if (value->str.str_p != NULL)
+      for (p = (const unsigned char *)value->str.str_p; *p != '\0'; p++)
+        hash = (hash ^ *p) * 1099511628211UL;
+    return hash;
+
+  case TYPE_FLO:
+    hash = 0;
+    memcpy(&hash, &value->flo, sizeof(value->flo));
+    break;
+
+  default:
+    hash = (ULong)value->num;
+    break;
+  }
+
+  // Fibonacci hashing spreads the consecutive values
+  return (hash * 11400714819323198485UL) >> 32;
+}
+
+/**
+ * @brief Shard where an object must be propagated
+ *
+ * @param obj The object
+ * @return Shard* The shard
+ */
+Shard *Shard::of_object(ObjectType *obj)
+{
+  ObjClass *the_class = ObjClass::class_of(obj);
+  int attr;
+
+  if (the_class == NULL)
+    engine_fatal_err("Unknown class %s in object propagation\n", obj->attr[0].str.str_p);
+
+  if ((attr = the_class->partition_attr()) == -1)
+    return _shards[0];
+
+  return _shards[hash_value(&obj->attr[attr], the_class->attr_type(attr)) % _n_shards];
+}
+
+/**
+ * @brief Build an event over an object
+ *
+ * @param tag INSERT_TAG, MODIFY_TAG, od RETRACT_TAG
+ * @param obj The object
+ * @param old_obj The copy made by engine_modify, or NULL
+ * @return ShardEvent* The event
+ */
+ShardEvent *Shard::new_event(int tag, ObjectType *obj, ObjectType *old_obj)
+{
+  ShardEvent *event;
+
+  if ((event = (ShardEvent *)malloc(sizeof(ShardEvent))) == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  event->_tag = tag;
+  event->_obj = obj;
+  event->_old_obj = old_obj;
+  event->_time = 0;
+
+  return event;
+}
+
+/**
+ * @brief Route an event over an object to its shard. Called by engine_loop in sharded mode
+ *    A modification is routed by the value of the partition attribute before the change. When the
+ *    change moves the object to other shard, it is retracted from the old shard and inserted in the new one
+ *
+ * @param tag INSERT_TAG, MODIFY_TAG, od RETRACT_TAG
+ * @param obj The object to be propagated
+ */
+void Shard::route(int tag, ObjectType *obj)
+{
+  ObjectType *old_obj;
+  Shard *old_shard, *new_shard;
+
+  if (tag != MODIFY_TAG || Engine::_old_obj_modify == NULL)
+  {
+    of_object(obj)->put(new_event(tag, obj, NULL));
+    return;
+  }
+
+  // The copy of the object made by engine_modify goes with the event
+  old_obj = Engine::_old_obj_modify;
+  Engine::_old_obj_modify = NULL;
+
+  old_shard = of_object(old_obj);
+  new_shard = of_object(obj);
+
+  if (old_shard == new_shard)
+    old_shard->put(new_event(MODIFY_TAG, obj, old_obj));
+  else
+  {
+    // The old shard gives the old values back to the object before the new shard can see it
+    old_shard->put(new_event(RETRACT_TAG, obj, old_obj));
+    old_shard->wait_idle();
+    new_shard->put(new_event(INSERT_TAG, obj, NULL));
+  }
+}
+
+/**
+ * @brief Broadcast engine_refresh to all the shards
+ *
+ * @param real_time Time stamp
+ */
+void Shard::refresh(long real_time)
+{
+  ShardEvent *event;
+  int n;
+
+  for (n = 0; n < _n_shards; n++)
+  {
+    event = new_event(SHARD_REFRESH, NULL, NULL);
+    event->_time = real_time;
+    _shards[n]->put(event);
+  }
+}
+
+//
+// API of the sharded mode
+//
+
+/**
+ * @brief Start the sharded mode. The package must be already loaded.
+ *        From now on engine_loop and engine_refresh called out of the shards are routed to them
+ *
+ * @param n_shards Number of shards (engines and threads)
+ * @return int The number of shards, or ERROR if the sharded mode was already started or the number is not valid
+ */
+PUBLIC
+int rce_shards_start(int n_shards)
+{
+  return Shard::start(n_shards);
+}
+
+/**
+ * @brief Wait until all the events routed to the shards have been propagated
+ *
+ */
+PUBLIC
+void rce_shards_sync()
+{
+  Shard::sync();
+}
+
+/**
+ * @brief End the sharded mode. The pending events are propagated and then the objects
+ *        in the memories of the shards are retracted silently
+ *
+ */
+PUBLIC
+void rce_shards_stop()
+{
+  Shard::stop_all();
+}
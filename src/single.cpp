@@ -16,6 +16,7 @@
 #define STR(a) ((a == NULL) ? "(null)" : a)
 
 Single Single::_null_single;
+Slab Single::_slab("Single", sizeof(Single));
 
 /**
  * @brief Compare two Singles. The comparison is made comparing the
@@ -24,7 +25,7 @@ Single Single::_null_single;
  * @param obj2 Meta Object (Single) to compare to
  * @return int
  */
-int Single::compare(const MetaObj *obj2, va_list) const
+int Single::compare(const MetaObj *obj2) const
 {
   return obj2->single()->_key - _key;
 }
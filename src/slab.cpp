@@ -0,0 +1,237 @@
+/**
+ * @file slab.cpp
+ * @author Francisco Alcaraz
+ * @brief Allocators of fixed size items for the structs that the inference creates and frees all the time
+ *        (Single, Compound, Set, MatchCount, ConflictSet, Action and AttrSet). The items are taken from malloc in blocks
+ *        and never returned to it. Each thread keeps a cache of free items of each allocator, so taking and
+ *        returning an item needs no lock. The caches exchange batches of items with the allocator, as an item
+ *        may be freed by other thread than the one that took it (parallel propagation, shards, snapshots).
+ *        When a thread ends its caches go back to the allocators
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "slab.hpp"
+#include "error.hpp"
+
+Slab *Slab::_slabs[MAXSLABS];
+int Slab::_n_slabs = 0;
+ENGINE_TLS SlabThread *Slab::_thread = NULL;
+SlabThread *Slab::_threads = NULL;
+pthread_mutex_t Slab::_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t Slab::_key;
+pthread_once_t Slab::_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Construct a new Slab:: Slab object. They are static members of the classes, built before main
+ *
+ * @param name Name of the class, for the statistics
+ * @param size Size of the class
+ */
+Slab::Slab(const char *name, size_t size)
+{
+  if (_n_slabs == MAXSLABS)
+    engine_fatal_err("Too many slabs\n");
+
+  // Room for the link of the free items, and aligned as malloc does
+  if (size < sizeof(SlabItem))
+    size = sizeof(SlabItem);
+  size = (size + sizeof(long double) - 1) & ~(sizeof(long double) - 1);
+
+  _name = name;
+  _size = size;
+  _depot = NULL;
+  _n_depot = 0;
+  _n_blocks = 0;
+  _n_items = 0;
+  pthread_mutex_init(&_lock, NULL);
+
+  _id = _n_slabs;
+  _slabs[_n_slabs++] = this;
+}
+
+/**
+ * @brief Create the key whose destructor returns the caches of a thread when it ends
+ *
+ */
+void Slab::create_key()
+{
+  int err;
+
+  if ((err = pthread_key_create(&_key, Slab::end_thread)) != 0)
+    engine_fatal_err("pthread_key_create: %s\n", strerror(err));
+}
+
+/**
+ * @brief First allocation in a thread. Create its caches
+ *
+ * @return SlabThread* The caches of the calling thread
+ */
+SlabThread *Slab::new_thread()
+{
+  SlabThread *thread;
+
+  pthread_once(&_key_once, Slab::create_key);
+
+  if ((thread = (SlabThread *)calloc(1, sizeof(SlabThread))) == NULL)
+    engine_fatal_err("calloc: %s\n", strerror(errno));
+
+  pthread_mutex_lock(&_threads_lock);
+  thread->_next = _threads;
+  if (_threads != NULL)
+    _threads->_prev = thread;
+  _threads = thread;
+  pthread_mutex_unlock(&_threads_lock);
+
+  pthread_setspecific(_key, thread);
+  _thread = thread;
+
+  return thread;
+}
+
+/**
+ * @brief The thread ends. Return all its free items to the allocators
+ *
+ * @param thread The caches of the thread
+ */
+void Slab::end_thread(void *thread)
+{
+  SlabThread *th = (SlabThread *)thread;
+  int n;
+
+  for (n = 0; n < _n_slabs; n++)
+    if (th->_cache[n]._n_free > 0)
+      _slabs[n]->flush(&th->_cache[n], th->_cache[n]._n_free);
+
+  pthread_mutex_lock(&_threads_lock);
+  if (th->_prev != NULL)
+    th->_prev->_next = th->_next;
+  else
+    _threads = th->_next;
+  if (th->_next != NULL)
+    th->_next->_prev = th->_prev;
+  pthread_mutex_unlock(&_threads_lock);
+
+  free(th);
+  _thread = NULL;
+}
+
+/**
+ * @brief The cache of the thread is empty. Take a batch of items returned by the threads, or a new block
+ *
+ * @param cache The cache of the calling thread
+ */
+void Slab::refill(SlabCache *cache)
+{
+  SlabItem *first, *last;
+  char *block;
+  long n;
+
+  pthread_mutex_lock(&_lock);
+  if (_depot != NULL)
+  {
+    first = last = _depot;
+    for (n = 1; n < SLABBATCH && last->_next != NULL; n++)
+      last = last->_next;
+
+    _depot = last->_next;
+    _n_depot -= n;
+    pthread_mutex_unlock(&_lock);
+
+    last->_next = cache->_free;
+    cache->_free = first;
+    __atomic_store_n(&cache->_n_free, cache->_n_free + n, __ATOMIC_RELAXED);
+    return;
+  }
+  _n_blocks++;
+  _n_items += SLABITEMS;
+  pthread_mutex_unlock(&_lock);
+
+  if ((block = (char *)malloc(SLABITEMS * _size)) == NULL)
+    engine_fatal_err("malloc: %s\n", strerror(errno));
+
+  for (n = SLABITEMS - 1; n >= 0; n--)
+  {
+    ((SlabItem *)(block + n * _size))->_next = cache->_free;
+    cache->_free = (SlabItem *)(block + n * _size);
+  }
+  __atomic_store_n(&cache->_n_free, cache->_n_free + SLABITEMS, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Return a batch of free items of a cache to the allocator
+ *
+ * @param cache The cache of the calling thread
+ * @param n_items The number of items to return
+ */
+void Slab::flush(SlabCache *cache, long n_items)
+{
+  SlabItem *first, *last;
+  long n;
+
+  first = last = cache->_free;
+  for (n = 1; n < n_items; n++)
+    last = last->_next;
+
+  cache->_free = last->_next;
+  __atomic_store_n(&cache->_n_free, cache->_n_free - n_items, __ATOMIC_RELAXED);
+
+  pthread_mutex_lock(&_lock);
+  last->_next = _depot;
+  _depot = first;
+  _n_depot += n_items;
+  pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @brief Occupancy of the allocators. The items free in the caches of the threads
+ *        are read while the threads go on, so it is an approximation
+ *
+ * @param stats Where the statistics are stored
+ * @param max_stats Room in stats
+ * @return int Number of statistics stored
+ */
+int Slab::stats(rce_slab_stats_t *stats, int max_stats)
+{
+  SlabThread *th;
+  long n_free;
+  int n;
+
+  for (n = 0; n < _n_slabs && n < max_stats; n++)
+  {
+    pthread_mutex_lock(&_slabs[n]->_lock);
+    stats[n].name = _slabs[n]->_name;
+    stats[n].size = _slabs[n]->_size;
+    stats[n].blocks = _slabs[n]->_n_blocks;
+    stats[n].items = _slabs[n]->_n_items;
+    n_free = _slabs[n]->_n_depot;
+    pthread_mutex_unlock(&_slabs[n]->_lock);
+
+    pthread_mutex_lock(&_threads_lock);
+    for (th = _threads; th != NULL; th = th->_next)
+      n_free += __atomic_load_n(&th->_cache[n]._n_free, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&_threads_lock);
+
+    stats[n].in_use = (n_free < stats[n].items) ? stats[n].items - n_free : 0;
+  }
+
+  return n;
+}
+
+/**
+ * @brief Occupancy of the allocators of the internal structs, shared by all the engines
+ *
+ * @param stats Where the statistics are stored, one for each kind of struct
+ * @param max_stats Room in stats
+ * @return int Number of statistics stored
+ */
+PUBLIC
+int engine_slab_stats(rce_slab_stats_t *stats, int max_stats)
+{
+  return Slab::stats(stats, max_stats);
+}
@@ -0,0 +1,552 @@
+/**
+ * @file snapshot.cpp
+ * @author Francisco Alcaraz
+ * @brief Read-only queries over the memories of an engine from other threads. The reader queues a request
+ *        and the engine thread builds it at the end of the propagation in progress (or with engine_serve_snapshots),
+ *        when no memory is changing. The snapshot keeps copies of the objects found, so the reader can walk it
+ *        while the engine goes on, and the engine never waits for the readers.
+ * @version 1.0
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+
+#include "engine.h"
+#include "codes.h"
+#include "dasm_rete.hpp"
+#include "nodes.hpp"
+#include "metaobj.hpp"
+#include "single.hpp"
+#include "compound.hpp"
+#include "set.hpp"
+#include "classes.hpp"
+#include "rules.hpp"
+#include "eng.hpp"
+#include "strlow.hpp"
+#include "context.hpp"
+#include "snapshot.hpp"
+#include "error.hpp"
+
+/**
+ * @brief Order of the objects of a snapshot, by time and then by the copy
+ *
+ * @param item1 Single of the tree
+ * @param item2 Single inserted
+ * @return int <0, 0, >0
+ */
+PRIVATE
+int compare_snap_objs(const void *item1, const void *item2, va_list)
+{
+  ObjectType *obj1 = ((Single *)item1)->obj();
+  ObjectType *obj2 = ((Single *)item2)->obj();
+
+  if (obj1->time != obj2->time)
+    return (obj1->time < obj2->time) ? -1 : 1;
+
+  return (obj1 < obj2) ? -1 : (obj1 > obj2) ? 1 : 0;
+}
+
+/**
+ * @brief Free a copy of an object of a snapshot
+ *
+ * @param item Single of the copy
+ */
+PRIVATE
+void free_snap_obj(void *item, va_list)
+{
+  ObjectType *obj = ((Single *)item)->obj();
+  ObjClass *the_class = ObjClass::class_of(obj);
+  int n;
+
+  for (n = (the_class != NULL) ? the_class->n_attrs() - 1 : 0; n >= 0; n--)
+    if ((n == 0 || the_class->attr_type(n) == TYPE_STR) && obj->attr[n].str.dynamic_flags == DYNAMIC)
+      free(obj->attr[n].str.str_p);
+
+  free(obj);
+  delete (Single *)item;
+}
+
+/**
+ * @brief Used to free the temporary trees that only point to items of the engine
+ *
+ */
+PRIVATE
+void free_nothing(void *, va_list)
+{
+}
+
+//
+// SNAPSHOT
+//
+
+/**
+ * @brief Construct a new Snapshot:: Snapshot object
+ *
+ * @param ruleset Name of the RuleSet, NULL for all of them
+ * @param rule Name of the Rule, NULL for all of them
+ * @param class_name Name of the class of the objects, NULL for all of them. The subclasses are included
+ */
+Snapshot::Snapshot(char *ruleset, char *rule, char *class_name)
+{
+  _ruleset[0] = _rule[0] = _class[0] = '\0';
+  if (ruleset != NULL)
+    strlowerncpy(_ruleset, ruleset, MAXNAME);
+  if (rule != NULL)
+    strlowerncpy(_rule, rule, MAXNAME);
+  if (class_name != NULL)
+    strncpy(_class, class_name, MAXNAME - 1);
+  _class[MAXNAME - 1] = '\0';
+
+  _state = SNAP_QUEUED;
+  _abandoned = FALSE;
+  _next = NULL;
+}
+
+/**
+ * @brief Destroy the Snapshot:: Snapshot object, with the copies of the objects
+ *
+ */
+Snapshot::~Snapshot()
+{
+  _objs.Free(free_snap_obj);
+}
+
+/**
+ * @brief Walk function to collect the memories of a rule. Called from for_each_rule
+ *
+ * @param node The production node
+ * @param list The snapshot, the tree of nodes visited, the tree of objects seen and the class
+ */
+PRIVATE
+void collect_rule(const void *node, va_list list)
+{
+  Snapshot *snap = va_arg(list, Snapshot *);
+  BTree *visited = va_arg(list, BTree *);
+  BTree *seen = va_arg(list, BTree *);
+  ObjClass *filter = va_arg(list, ObjClass *);
+
+  snap->collect_node((Node *)node, *visited, *seen, filter);
+}
+
+/**
+ * @brief Copy the objects in the memories of the rules requested. Called by the engine thread
+ *
+ */
+void Snapshot::build()
+{
+  BTree visited, seen;
+  ObjClass *filter = NULL;
+
+  if (_class[0] != '\0' && (filter = *ObjClass::get_class(_class)) == NULL)
+    return;
+
+  for_each_rule((_ruleset[0] != '\0') ? _ruleset : NULL, (_rule[0] != '\0') ? _rule : NULL,
+                collect_rule, this, &visited, &seen, filter);
+
+  visited.Free(free_nothing);
+  seen.Free(free_nothing);
+}
+
+/**
+ * @brief Collect the memories of a node and those of the nodes above it, until the last intra nodes
+ *        (as Node::reset_nodes_up does)
+ *
+ * @param node The node
+ * @param visited Nodes already collected, the rules may share them
+ * @param seen Objects already copied
+ * @param filter Class of the objects, NULL for all
+ */
+void Snapshot::collect_node(Node *node, BTree &visited, BTree &seen, ObjClass *filter)
+{
+  BTree *mem;
+  ULong pos;
+
+  if (node == NULL || node->len() == 0)
+    return;
+
+  visited.Insert(node, BTree::compareEq);
+  if (BTree::WasFound())
+    return;
+
+  switch (dasm_code(node->get_code(0)))
+  {
+  case AND:
+  case WAND:
+  case NAND:
+  case OAND:
+  case NWAND:
+  case OWAND:
+    pos = (node->is_inter_w()) ? WAND_NODE_MEM_START_POS : AND_NODE_MEM_START_POS;
+
+    if (node->get_code(AND_NODE_FLAGS_POS) & IS_HASHED)
+    {
+      collect_hash_mem(Engine::node_hash_mem(node->get_code(pos)), seen, filter);
+      collect_hash_mem(Engine::node_hash_mem(node->get_code(pos + 1)), seen, filter);
+      break;
+    }
+
+    if (node->get_code(AND_NODE_FLAGS_POS) & IS_BPTREE)
+    {
+      collect_bp_mem(Engine::node_bp_mem(node->get_code(pos)), seen, filter);
+      collect_bp_mem(Engine::node_bp_mem(node->get_code(pos + 1)), seen, filter);
+      break;
+    }
+
+    // The left memory of the asymmetric nodes keeps MatchCounts
+    mem = Engine::node_mem(node->get_code(pos));
+    collect_mem(mem->getIterator(), node->get_code(AND_NODE_NKEYS_POS), node->is_inter_asym(), seen, filter);
+    mem = Engine::node_mem(node->get_code(pos + 1));
+    collect_mem(mem->getIterator(), node->get_code(AND_NODE_NKEYS_POS), FALSE, seen, filter);
+    break;
+
+  case MAKESET:
+    mem = Engine::node_mem(node->get_code(SET_NODE_MEM_POS));
+    collect_mem(mem->getIterator(), 0, FALSE, seen, filter);
+    break;
+
+  case PROD:
+    mem = Engine::node_mem(node->get_code(PROD_NODE_MEM_POS));
+    collect_mem(mem->getIterator(), 0, FALSE, seen, filter);
+    break;
+  }
+
+  collect_node(node->parent_node(LEFT_MEM), visited, seen, filter);
+  collect_node(node->parent_node(RIGHT_MEM), visited, seen, filter);
+}
+
+/**
+ * @brief Collect the items of a memory. With keys the items of a level are the trees of the next one
+ *
+ * @param state Iterator of the memory
+ * @param n_keys Number of keys (levels) of the memory
+ * @param counters TRUE if the items are MatchCounts
+ * @param seen Objects already copied
+ * @param filter Class of the objects, NULL for all
+ */
+void Snapshot::collect_mem(BTState state, int n_keys, int counters, BTree &seen, ObjClass *filter)
+{
+  const void *item;
+
+  while ((item = BTree::Walk(state)) != NULL)
+  {
+    if (n_keys > 0)
+      collect_mem(BTState((const BTNode *)item), n_keys - 1, counters, seen, filter);
+    else if (counters)
+      collect(((MatchCount *)item)->item, seen, filter);
+    else
+      collect((MetaObj *)item, seen, filter);
+  }
+}
+
+/**
+ * @brief Collect the items of a hash memory, group by group
+ *
+ * @param mem The memory
+ * @param seen Objects already copied
+ * @param filter Class of the objects, NULL for all
+ */
+void Snapshot::collect_hash_mem(HashMem *mem, BTree &seen, ObjClass *filter)
+{
+  BTree *group;
+
+  for (ULong n = 0; n < mem->size(); n++)
+    if ((group = mem->group(n)) != NULL)
+      collect_mem(group->getIterator(), 0, FALSE, seen, filter);
+}
+
+/**
+ * @brief Collect the items of a B+tree memory, walking its leaves
+ *
+ * @param mem The memory
+ * @param seen Objects already copied
+ * @param filter Class of the objects, NULL for all
+ */
+void Snapshot::collect_bp_mem(BPTree *mem, BTree &seen, ObjClass *filter)
+{
+  BPState state = mem->getIterator();
+  const void *item;
+
+  while ((item = BPTree::Walk(state)) != NULL)
+    collect((MetaObj *)item, seen, filter);
+}
+
+/**
+ * @brief Collect the objects of an item of a memory
+ *
+ * @param item The item
+ * @param seen Objects already copied
+ * @param filter Class of the objects, NULL for all
+ */
+void Snapshot::collect(MetaObj *item, BTree &seen, ObjClass *filter)
+{
+  if (item == NULL)
+    return;
+
+  switch (item->class_type())
+  {
+  case SINGLE:
+    if (item->single()->obj() != NULL && !item->single()->has_been_deleted())
+      add(item->single()->obj(), seen, filter);
+    break;
+
+  case COMPOUND:
+    collect(item->compound()->left(), seen, filter);
+    collect(item->compound()->right(), seen, filter);
+    break;
+
+  case SET:
+    collect_mem(item->set()->get_tree()->getIterator(), 0, TRUE, seen, filter);
+    break;
+  }
+}
+
+/**
+ * @brief Add a copy of an object, if it was not already added and it is of the class requested
+ *
+ * @param obj The object
+ * @param seen Objects already copied
+ * @param filter Class of the objects, NULL for all
+ */
+void Snapshot::add(ObjectType *obj, BTree &seen, ObjClass *filter)
+{
+  ObjClass *the_class = ObjClass::class_of(obj);
+  ObjectType *copy;
+  int n;
+
+  if (the_class == NULL || (filter != NULL && !the_class->is_subclass(filter)))
+    return;
+
+  seen.Insert(obj, BTree::compareEq);
+  if (BTree::WasFound())
+    return;
+
+  copy = new_object(the_class->n_attrs() - 1, obj->time);
+  objcpy(copy, obj, the_class->n_attrs() - 1);
+
+  // The strings may be freed by the engine while the snapshot is read, but the interned ones
+  for (n = 0; n < the_class->n_attrs(); n++)
+  {
+    if ((n == 0 || the_class->attr_type(n) == TYPE_STR) && copy->attr[n].str.str_p != NULL)
+    {
+      if (copy->attr[n].str.dynamic_flags & INTERNED)
+      {
+        copy->attr[n].str.dynamic_flags = INTERNED;
+        continue;
+      }
+
+      copy->attr[n].str.str_p = strdup(copy->attr[n].str.str_p);
+      copy->attr[n].str.dynamic_flags = DYNAMIC;
+    }
+  }
+
+  _objs.Insert(new Single(copy), compare_snap_objs);
+}
+
+//
+// QUEUE OF REQUESTS
+//
+
+/**
+ * @brief Construct a new SnapshotQueue:: SnapshotQueue object
+ *
+ */
+SnapshotQueue::SnapshotQueue()
+{
+  _requests = NULL;
+  _tail = &_requests;
+  _n_requests = 0;
+
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_served, NULL);
+}
+
+/**
+ * @brief Destroy the SnapshotQueue:: SnapshotQueue object. No reader may be waiting
+ *
+ */
+SnapshotQueue::~SnapshotQueue()
+{
+  Snapshot *snap;
+
+  while ((snap = _requests) != NULL)
+  {
+    _requests = snap->_next;
+    delete snap;
+  }
+
+  pthread_cond_destroy(&_served);
+  pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * @brief Ask for a snapshot and wait until the engine thread builds it. Called from any thread but the engine one
+ *
+ * @param ruleset Name of the RuleSet, NULL for all of them
+ * @param rule Name of the Rule, NULL for all of them
+ * @param class_name Name of the class of the objects, NULL for all of them
+ * @param timeout Milliseconds to wait, 0 for no limit
+ * @return Snapshot* The snapshot, NULL if it was not built in time
+ */
+Snapshot *SnapshotQueue::request(char *ruleset, char *rule, char *class_name, int timeout)
+{
+  Snapshot *snap = new Snapshot(ruleset, rule, class_name), **p;
+  struct timespec limit;
+  int err = 0;
+
+  if (timeout > 0)
+  {
+    clock_gettime(CLOCK_REALTIME, &limit);
+    limit.tv_sec += timeout / 1000;
+    limit.tv_nsec += (timeout % 1000) * 1000000L;
+    if (limit.tv_nsec >= 1000000000L)
+    {
+      limit.tv_sec++;
+      limit.tv_nsec -= 1000000000L;
+    }
+  }
+
+  pthread_mutex_lock(&_lock);
+  *_tail = snap;
+  _tail = &snap->_next;
+  __atomic_store_n(&_n_requests, _n_requests + 1, __ATOMIC_RELEASE);
+
+  while (snap->_state != SNAP_READY && err == 0)
+  {
+    if (timeout > 0)
+      err = pthread_cond_timedwait(&_served, &_lock, &limit);
+    else
+      pthread_cond_wait(&_served, &_lock);
+  }
+
+  if (snap->_state == SNAP_QUEUED)
+  {
+    for (p = &_requests; *p != snap; p = &((*p)->_next));
+    if ((*p = snap->_next) == NULL)
+      _tail = p;
+    __atomic_store_n(&_n_requests, _n_requests - 1, __ATOMIC_RELEASE);
+    delete snap;
+    snap = NULL;
+  }
+  else if (snap->_state == SNAP_BUILDING)
+  {
+    // The engine thread will free it
+    snap->_abandoned = TRUE;
+    snap = NULL;
+  }
+  pthread_mutex_unlock(&_lock);
+
+  return snap;
+}
+
+/**
+ * @brief Build all the snapshots requested. Called by the engine thread
+ *
+ */
+void SnapshotQueue::serve_requests()
+{
+  Snapshot *list, *snap, *next;
+
+  pthread_mutex_lock(&_lock);
+  list = _requests;
+  _requests = NULL;
+  _tail = &_requests;
+  __atomic_store_n(&_n_requests, 0, __ATOMIC_RELEASE);
+  for (snap = list; snap != NULL; snap = snap->_next)
+    snap->_state = SNAP_BUILDING;
+  pthread_mutex_unlock(&_lock);
+
+  for (snap = list; snap != NULL; snap = snap->_next)
+    snap->build();
+
+  pthread_mutex_lock(&_lock);
+  for (snap = list; snap != NULL; snap = next)
+  {
+    next = snap->_next;
+    snap->_next = NULL;
+    if (snap->_abandoned)
+      delete snap;
+    else
+      snap->_state = SNAP_READY;
+  }
+  pthread_cond_broadcast(&_served);
+  pthread_mutex_unlock(&_lock);
+}
+
+//
+// API
+//
+
+/**
+ * @brief Get a copy of the objects kept in the memories of some rules of the engine selected in the calling thread.
+ *      It must be called from other thread than the one that runs the engine
+ *
+ * @param ruleset Name of the RuleSet, NULL for all of them
+ * @param rule Name of the Rule, NULL for all of them
+ * @param class_name Name of the class of the objects (subclasses included), NULL for all of them
+ * @param timeout Milliseconds to wait for the engine, 0 for no limit
+ * @return rce_snapshot_t* The snapshot, NULL if the engine has not built it in time
+ */
+PUBLIC
+rce_snapshot_t *engine_snapshot(char *ruleset, char *rule, char *class_name, int timeout)
+{
+  return rce_engine_snapshot(Engine::current(), ruleset, rule, class_name, timeout);
+}
+
+/**
+ * @brief Build the snapshots requested to the engine selected in the calling thread.
+ *      The engine does it at the end of each propagation, this is for an engine that is idle
+ *
+ */
+PUBLIC
+void engine_serve_snapshots()
+{
+  Engine *engine = Engine::current();
+
+  if (!engine->_in_the_loop)
+    engine->_snaps->serve();
+}
+
+/**
+ * @brief engine_snapshot over an engine instance
+ *
+ * @param engine The engine
+ * @param ruleset Name of the RuleSet, NULL for all of them
+ * @param rule Name of the Rule, NULL for all of them
+ * @param class_name Name of the class of the objects (subclasses included), NULL for all of them
+ * @param timeout Milliseconds to wait for the engine, 0 for no limit
+ * @return rce_snapshot_t* The snapshot, NULL if the engine has not built it in time
+ */
+PUBLIC
+rce_snapshot_t *rce_engine_snapshot(rce_engine_t *engine, char *ruleset, char *rule, char *class_name, int timeout)
+{
+  return engine->_snaps->request(ruleset, rule, class_name, timeout);
+}
+
+/**
+ * @brief Start a walk over the objects of a snapshot, ordered by time. It is done with get_obj_of_set,
+ *      n_obj_of_set and end_obj_of_set, as in the sets
+ *
+ * @param snap The snapshot
+ * @return void* The state of the walk
+ */
+PUBLIC
+void *snapshot_objs(rce_snapshot_t *snap)
+{
+  return new BTState(snap->_objs.getIterator());
+}
+
+/**
+ * @brief Free a snapshot and the copies of its objects
+ *
+ * @param snap The snapshot
+ */
+PUBLIC
+void snapshot_free(rce_snapshot_t *snap)
+{
+  delete snap;
+}
@@ -30,8 +30,9 @@
 %token FUNCTION PROCEDURE
 %token PATT_VAR IDENT INTEGER FLOAT CHAR STRING
 %token COUNT_SET SUM_SET PROD_SET MIN_SET MAX_SET CONCAT_SET TIME_FUN
+%token MEDIAN_SET PERCENTILE_SET RANK_SET DISTINCT_SET
 %token IS_A ABSTRACT RESTRICTS TEMPORAL TRIGGER PERMANENT TIMED UNTIMED
-%token WINDOW
+%token WINDOW PARTITION BY
 %token CAT_HIGH CAT_NORMAL CAT_LOW
 %token IMPL
 %token CREATE MODIFY CHANGE DELETE CALL
@@ -89,7 +90,12 @@ obj_dcl_body    : normal_obj_body
 normal_obj_body : superclass_def
                   '{'
                        normal_attr_set
-                  '}'                           { end_def_class(); }
+                  '}'
+                  partition_def                 { end_def_class(); }
+                ;
+
+partition_def   :
+                | PARTITION BY IDENT            { partition_class($3.ident); }
                 ;
  
 
@@ -360,6 +366,15 @@ simple_value    : STRING                { $$.exp=create_val(TYPE_STR, $1); }
                 | MAX_SET '(' var_or_ref_expr ')'  {$$.exp=create_primitive(MAXS, 1, create_val(TYPE_NUM, $3));}
                 | CONCAT_SET '(' var_or_ref_expr ',' expression ')'
                                                    {$$.exp=create_primitive(CONCS, 2, create_val(TYPE_NUM, $3), $5.exp);}
+                | MEDIAN_SET '(' var_or_ref_expr ')'
+                                                   {StackType half; half.num = 50;
+                                                    $$.exp=create_primitive(PCTS, 2, create_val(TYPE_NUM, $3), create_val(TYPE_NUM, half));}
+                | PERCENTILE_SET '(' var_or_ref_expr ',' expression ')'
+                                                   {$$.exp=create_primitive(PCTS, 2, create_val(TYPE_NUM, $3), $5.exp);}
+                | RANK_SET '(' var_or_ref_expr ',' expression ')'
+                                                   {$$.exp=create_primitive(RNKS, 2, create_val(TYPE_NUM, $3), $5.exp);}
+                | DISTINCT_SET '(' var_or_ref_expr ')'
+                                                   {$$.exp=create_primitive(DSTS, 1, create_val(TYPE_NUM, $3));}
                 | TIME_FUN '(' patt_num ')'        {$$.exp=create_primitive(PUSHT, 1, create_val(TYPE_NUM, $3));}
                 | IDENT '(' exp_arg_decls0 ')'     { $$.exp=create_fun($1.ident, $3.arg); }
                 ;
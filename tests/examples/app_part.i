@@ -0,0 +1,5 @@
+1 llamada(abonado 600100200, duracion 30)
+1 llamada(abonado 600100300, duracion 45)
+1 llamada(abonado 600100200, duracion 12)
+1 llamada_larga(abonado 600100300, duracion 300, destino 0044)
+1 llamada(abonado 600100400, duracion 5)
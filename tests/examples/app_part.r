@@ -0,0 +1,32 @@
+PACKAGE part
+
+CLASS llamada
+{
+   abonado     : STRING
+   duracion    : INTEGER
+} PARTITION BY abonado
+
+CLASS llamada_larga IS_A llamada
+{
+   destino     : STRING
+}
+
+CLASS total
+{
+   abonado     : STRING
+   llamadas    : INTEGER
+   duracion    : INTEGER
+} PARTITION BY abonado
+
+RULESET facturacion
+
+RULE sumar NORMAL
+{
+   lls: {llamada(abonado a)} / count(lls) > 1
+   ->
+   total(abonado a, llamadas count(lls), duracion sum(lls.duracion))
+}
+
+END
+
+END
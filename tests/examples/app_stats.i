@@ -0,0 +1,19 @@
+0 m(g 1, v 10, s a)
+0 m(g 1, v 30, s b)
+0 m(g 1, v 20, s a)
+0 m(g 1, v 40)
+0 m(g 2, v 1, s z)
+; 10 20 30 40: median 20 p0 10 p40 20 p100 40 rank 1/20 2/25 distinct 2
+5 probe(g 1, x 20)
+5 bump(was 10, now 50)
+; 20 30 40 50: median 30 p0 20 p40 30 p100 50 rank 0/20 1/25 distinct 2
+5 probe(g 1, x 20)
+5 m(g 1, v 30, s c)
+; 20 30 30 40 50: median 30 p0 20 p40 30 p100 50 rank 1/30 1/25 distinct 3
+0 probe(g 1, x 30)
+60 m(g 1, v 35, s c)
+0 bump(was 40, now 5)
+; 5 20 30 30 35 50: median 30 p0 5 p40 30 p100 50 rank 0/5 2/25 distinct 3
+0 probe(g 1, x 5)
+; the items of T=0 have expired, 30 35: median 30 p0 30 p40 30 p100 35 rank 1/35 0/25 distinct 1
+30 probe(g 1, x 35)
@@ -0,0 +1,48 @@
+; The order statistics of a set follow its items while they are inserted,
+; modified by a rule and expired by the time window
+
+PACKAGE stats
+
+TEMPORAL CLASS m
+{
+  g : INTEGER
+  v : INTEGER
+  s : STRING
+}
+
+CLASS probe
+{
+  g : INTEGER
+  x : INTEGER
+}
+
+CLASS bump
+{
+  was : INTEGER
+  now : INTEGER
+}
+
+RULESET stats
+
+RULE show NORMAL TIMED 100
+{
+  s:{ m(g k) }
+  p:probe(g k)
+->
+  CALL printf("n %d median %d p0 %d p40 %d p100 %d rank %d/%d %d/25 distinct %d\n",
+              count(s), median(s.v), percentile(s.v, 0), percentile(s.v, 40), percentile(s.v, 100),
+              rank(s.v, p.x), p.x, rank(s.v, 25), distinct_count(s.s))
+  DELETE p
+}
+
+RULE move NORMAL
+{
+  b:bump(was f, now t)
+  mm:m(v f)
+->
+  MODIFY mm(v t)
+  DELETE b
+}
+
+END
+END
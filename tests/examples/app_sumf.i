@@ -0,0 +1,10 @@
+0 evs(v 1e20)
+0 evi(v inf)
+0 evp(v 1e-200)
+0 evp(v 1e-200)
+50 evs(v 1.0)
+0 evi(v 1.0)
+0 evp(v 1.0)
+20 evs(v 0.5)
+0 evi(v 0.5)
+0 evp(v 0.5)
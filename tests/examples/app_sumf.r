@@ -0,0 +1,51 @@
+; The float sums and products of the sets are counted again when their items expire,
+; the values taken out can not be subtracted or divided without losing the result
+
+PACKAGE sumf
+
+TEMPORAL CLASS evs
+{
+  v : FLOAT
+}
+
+TEMPORAL CLASS evi
+{
+  v : FLOAT
+}
+
+TEMPORAL CLASS evp
+{
+  v : FLOAT
+}
+
+RULESET sumf
+
+RULE s NORMAL TIMED 60
+{
+  s:{ evs() }
+  /
+  sum(s.v) > 1.2 & sum(s.v) < 2.0
+->
+  CALL printf("sum %f\n", sum(s.v))
+}
+
+RULE i NORMAL TIMED 60
+{
+  i:{ evi() }
+  /
+  sum(i.v) > 1.2 & sum(i.v) < 2.0
+->
+  CALL printf("sum inf %f\n", sum(i.v))
+}
+
+RULE p NORMAL TIMED 60
+{
+  p:{ evp() }
+  /
+  prod(p.v) > 0.4 & prod(p.v) < 0.6
+->
+  CALL printf("prod %f\n", prod(p.v))
+}
+
+END
+END
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
  
 
 #include <engine.h>
@@ -19,11 +20,22 @@
 
 PRIVATE BTree obj_tree;
 PRIVATE BTree obj_new_tree;
+PRIVATE pthread_mutex_t tree_lock = PTHREAD_MUTEX_INITIALIZER;   // In sharded mode the callbacks come from the shards
 PRIVATE long curr_time = 0;
 
 PUBLIC int context = 0;
 PUBLIC int danger = 0;
 PUBLIC int free_p = 0;
+PUBLIC int shards = 0;
+PUBLIC int interned = 0;
+PUBLIC int queued = 0;
+PUBLIC int async_cb = 0;
+PUBLIC int expiry = 0;
+PUBLIC int batch = 0;
+
+PRIVATE ObjectType **batch_objs = NULL;
+PRIVATE int n_batch = 0;
+PRIVATE volatile int snapshots_end = FALSE;
 
 time_t time(time_t *tloc)
 {
@@ -70,6 +82,21 @@ void attr_info(void *clase, char *attr, int &num, int &type)
 
  
 
+void
+read_str(Value &value, char *str)
+{
+   if (interned)
+   {
+      value.str.str_p = engine_intern(str);
+      value.str.dynamic_flags = INTERNED;
+   }
+   else
+   {
+      value.str.str_p = strdup(str);
+      value.str.dynamic_flags = DYNAMIC;
+   }
+}
+
 ObjectType *
 read_obj(FILE *file)
 {
@@ -97,8 +124,7 @@ read_obj(FILE *file)
    clase = class_of(classname, n_attrs);
 
    obj= new_object(n_attrs-1, curr_time);
-   obj->attr[0].str.str_p = strdup(classname);
-   obj->attr[0].str.dynamic_flags = DYNAMIC;
+   read_str(obj->attr[0], classname);
 
    do 
    {
@@ -124,8 +150,7 @@ read_obj(FILE *file)
                 obj->attr[attr].num = val[0];
                 break;
             case TYPE_STR :
-                obj->attr[attr].str.str_p = strdup(val);
-                obj->attr[attr].str.dynamic_flags = DYNAMIC;
+                read_str(obj->attr[attr], val);
                 break;
           }
         }
@@ -161,7 +186,9 @@ int compare_obj(const void *obj1, const void *obj2, va_list)
 void
 insert_obj(ObjectType *obj)
 {
+   pthread_mutex_lock(&tree_lock);
    obj_tree.Insert(obj, compare_obj);
+   pthread_mutex_unlock(&tree_lock);
 }
 
 void
@@ -173,7 +200,9 @@ insert_new_obj(ObjectType *obj)
      //sleep(2);
      //return;
    }
+   pthread_mutex_lock(&tree_lock);
    obj_new_tree.Insert(obj, compare_obj);
+   pthread_mutex_unlock(&tree_lock);
 }
 
 void
@@ -188,6 +217,8 @@ delete_new_obj(ObjectType *obj)
      //return;
    }
 
+   pthread_mutex_lock(&tree_lock);
+
    // Para no interferir con la liberacion
    if ((obj_found = (ObjectType *)obj_new_tree.Delete(obj, compare_obj)) == NULL)
    {
@@ -195,6 +226,8 @@ delete_new_obj(ObjectType *obj)
       printf("WAS ORIGINAL:");
    } else printf("WAS GENERATED:");
 
+   pthread_mutex_unlock(&tree_lock);
+
    if (obj_found != NULL)
    {
      free_obj(obj_found);
@@ -206,12 +239,78 @@ delete_new_obj(ObjectType *obj)
    }
 }
 
+/**
+ * @brief Propagate an object by the way chosen in the options: engine_loop or the queue of
+ *    engine_submit, waiting for the shards and delivering the asynchronous callbacks after it
+ *
+ * @param tag INSERT_TAG or RETRACT_TAG
+ * @param obj The object
+ */
+void
+propagate(int tag, ObjectType *obj)
+{
+   if (queued)
+   {
+      engine_submit(tag, obj);
+      engine_drain(0);
+   }
+   else
+      engine_loop(tag, obj);
+
+   if (shards)
+     rce_shards_sync();
+   if (async_cb)
+     engine_poll_events(0, FALSE);
+}
+
+/**
+ * @brief Propagate the insertions gathered for engine_loop_batch
+ */
+void
+flush_batch()
+{
+   if (n_batch == 0)
+     return;
+
+   engine_loop_batch(INSERT_TAG, batch_objs, n_batch);
+   n_batch = 0;
+
+   if (shards)
+     rce_shards_sync();
+   if (async_cb)
+     engine_poll_events(0, FALSE);
+}
+
+/**
+ * @brief Reader of snapshots of all the memories while the objects are propagated.
+ *    The objects are only walked, so the output is the same
+ */
+void *
+snapshot_reader(void *)
+{
+   rce_snapshot_t *snap;
+   void *state;
+
+   while (!snapshots_end)
+   {
+      if ((snap = engine_snapshot(NULL, NULL, NULL, 100)) == NULL)
+        continue;
+
+      state = snapshot_objs(snap);
+      while (get_obj_of_set(state) != NULL)
+        ;
+      end_obj_of_set(state);
+      snapshot_free(snap);
+   }
+   return NULL;
+}
+
 void
 delete_tree_item(void *obj, va_list)
 {
    printf("AN OBJECT IS RETRACTED ");
    print_obj(stdout, ((ObjectType *)obj)); printf("\n");
-   engine_loop(RETRACT_TAG, ((ObjectType *)obj));
+   propagate(RETRACT_TAG, (ObjectType *)obj);
    free_obj((ObjectType *)obj);
 
 }
@@ -243,6 +342,10 @@ main(int argc, char *argv[])
    int len_entrada;
    int retract = FALSE;
    int pnet=0;
+   int n_threads = 0;
+   int snapshots = FALSE;
+   pthread_t reader;
+   long next;
 
    extern int optind;
    extern char *optarg;
@@ -251,7 +354,7 @@ main(int argc, char *argv[])
 
    set_comp_warnings(1);
  
-   while ((c=getopt(argc,argv,"cfpthi:r")) != -1)
+   while ((c=getopt(argc,argv,"cfpthi:rs:IHBRVFqb:aP:Se")) != -1)
    {
      switch(c)
      {
@@ -273,16 +376,69 @@ main(int argc, char *argv[])
        case 'f':
 	      free_p = TRUE;
 	      break;
+       case 's':
+          shards = atoi(optarg);
+          break;
+       case 'I':
+          interned = TRUE;
+          break;
+       case 'H':
+          set_hash_memories(FALSE);
+          break;
+       case 'B':
+          set_bptree_memories(FALSE);
+          break;
+       case 'R':
+          set_range_keys(FALSE);
+          break;
+       case 'V':
+          set_simd_rank(FALSE);
+          break;
+       case 'F':
+          set_flat_tuples(FALSE);
+          break;
+       case 'q':
+          queued = TRUE;
+          break;
+       case 'b':
+          batch = atoi(optarg);
+          break;
+       case 'a':
+          async_cb = TRUE;
+          break;
+       case 'P':
+          n_threads = atoi(optarg);
+          break;
+       case 'S':
+          snapshots = TRUE;
+          break;
+       case 'e':
+          expiry = TRUE;
+          break;
        case 'h':
        case '?':
-	      printf("Usage : %s [-p][-h][-t][-r][f][-i objfile] rulesfile\n", argv[0]);
+	      printf("Usage : %s [-p][-h][-t][-r][f][-I][-H][-B][-R][-V][-F][-q][-a][-S][-e][-b size][-P threads][-s shards][-i objfile] rulesfile [rsetfile ...]\n", argv[0]);
           printf(" -p : Print the nodes net\n");
           printf(" -t : Enable traces in /tmp/engine.log\n");
           printf(" -i objfile : Define an input objects file\n");
           printf(" -r : Retract all the objects that remain still alive\n");
           printf(" -f : Free the package at the end\n");
+          printf(" -I : Intern the strings of the objects read\n");
+          printf(" -s shards : Propagate the objects in sharded mode with that number of shards\n");
+          printf(" -H : Disable the hash memories\n");
+          printf(" -B : Disable the B+tree memories\n");
+          printf(" -R : Disable the range keys\n");
+          printf(" -V : Disable the SIMD rank of the B+tree keys\n");
+          printf(" -F : Disable the flat tuples\n");
+          printf(" -q : Propagate the objects through engine_submit and engine_drain\n");
+          printf(" -b size : Propagate the objects of the same time with engine_loop_batch, up to size at once\n");
+          printf(" -a : Deliver the callbacks asynchronously with engine_poll_events\n");
+          printf(" -P threads : Propagate in parallel with that number of threads\n");
+          printf(" -S : Take snapshots of the memories from other thread while the objects are propagated\n");
+          printf(" -e : Call engine_refresh before each object when engine_next_expiry is due\n");
           printf(" -h : Show this help\n");
           printf(" rulesfile: Input rules file (package)\n");
+          printf(" rsetfile: RuleSet files loaded after the package with load_rsets\n");
           exit(0);
 
      }
@@ -290,7 +446,7 @@ main(int argc, char *argv[])
 
    if (argc==optind)
    {
-      fprintf(stderr, "Usage : %s [-p][-h][-t][-r][f][-i objfile] rulesfile\n", argv[0]);
+      fprintf(stderr, "Usage : %s [-p][-h][-t][-r][f][-I][-H][-B][-R][-V][-F][-q][-a][-S][-e][-b size][-P threads][-s shards][-i objfile] rulesfile [rsetfile ...]\n", argv[0]);
       fprintf(stderr, "Usage : %s -h for help\n", argv[0]);
       fprintf(stderr, "You must indicate a rules file\n");
       exit(1);   
@@ -329,11 +485,35 @@ main(int argc, char *argv[])
    if (load_pkg(fich_entrada) == 0)
      exit(1);
 
+   if (optind + 1 < argc && load_rsets(argv + optind + 1, argc - optind - 1) == 0)
+     exit(1);
+
    printf("Code read\n");
 
    if(pnet) 
      print_net();
 
+   if (shards && rce_shards_start(shards) == ERROR)
+   {
+      fprintf(stderr, "Bad number of shards %d\n", shards);
+      exit(1);
+   }
+
+   if (n_threads && engine_parallel(n_threads) == ERROR)
+   {
+      fprintf(stderr, "Bad number of threads %d\n", n_threads);
+      exit(1);
+   }
+
+   if (async_cb)
+     engine_async_callbacks(CALLBACKS_GROW, 0);
+
+   if (batch > 0)
+     batch_objs = (ObjectType **)malloc(batch * sizeof(ObjectType *));
+
+   if (snapshots)
+     pthread_create(&reader, NULL, snapshot_reader, NULL);
+
    reset_inf_cnt();
    
    n_objs=0;
@@ -342,10 +522,22 @@ main(int argc, char *argv[])
    while ((obj = read_obj(f_obj)) != NULL)
    {
      // _mynum++;
+      // The objects of a batch share the time stamp
+      if (batch > 0 && (n_batch == batch || (n_batch > 0 && batch_objs[0]->time != obj->time)))
+        flush_batch();
+
+      if (expiry && (next = engine_next_expiry()) != -1 && next <= obj->time)
+        engine_refresh(obj->time);
+
       printf("AN OBJECT IS INSERTED (%d) T=%ld ", n_objs++, obj->time); print_obj(stdout, obj); printf("\n");
 
       insert_obj(obj);
-      engine_loop(INSERT_TAG, obj);
+
+      // The clock of the tester goes with the objects, so each one is propagated before reading the next
+      if (batch > 0)
+        batch_objs[n_batch++] = obj;
+      else
+        propagate(INSERT_TAG, obj);
 
       // Just to test some modifications
       /*
@@ -359,6 +551,8 @@ main(int argc, char *argv[])
 //sleep(2);
    }
 
+   flush_batch();
+
    if (f_obj != stdin)
      fclose(f_obj);
 
@@ -371,9 +565,18 @@ main(int argc, char *argv[])
 
    }
 
+   if (snapshots)
+   {
+      snapshots_end = TRUE;
+      pthread_join(reader, NULL);
+   }
+
    fprintf(stdout, "\n%d inferences done\n", get_inf_cnt());
 //engine_refresh(0);
 
+   if (async_cb)
+     engine_async_callbacks(CALLBACKS_SYNC, 0);
+
    del_callback_func(WHEN_ALL, callbackfunc);
 
    if (free_p) {